@@ -389,13 +389,14 @@ void Application::Start() {
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
-    protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+    protocol_->OnIncomingAudio([this](AudioStreamPacketPtr packet) {
         if (device_state_ == kDeviceStateSpeaking) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveMode(false);
+        audio_service_.SetUplinkFrameDuration(protocol_->uplink_frame_duration());
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
                 protocol_->server_sample_rate(), codec->output_sample_rate());
@@ -588,6 +589,13 @@ void Application::OnClockTimer() {
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
+        // Opus frame timing, and packet / task pools that should stop creating objects once warmed up
+        audio_service_.PrintStats();
+        // Music download speed, buffer, decode time and underruns while a song is streaming
+        auto music = Board::GetInstance().GetMusic();
+        if (music) {
+            music->PrintStats();
+        }
     }
 }
 
@@ -620,9 +628,11 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+                auto stamps = packet->stamps;
                 if (!protocol_->SendAudio(std::move(packet))) {
                     break;
                 }
+                audio_service_.RecordPacketSent(stamps);
             }
         }
 
@@ -849,85 +859,17 @@ void Application::SetAecMode(AecMode mode) {
 }
 
 // 新增：接收外部音频数据（如音乐播放）
-void Application::AddAudioData(AudioStreamPacket&& packet) {
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (device_state_ == kDeviceStateIdle && codec->output_enabled()) {
-        // packet.payload包含的是原始PCM数据（int16_t）
-        if (packet.payload.size() >= 2) {
-            size_t num_samples = packet.payload.size() / sizeof(int16_t);
-            std::vector<int16_t> pcm_data(num_samples);
-            memcpy(pcm_data.data(), packet.payload.data(), packet.payload.size());
-            
-            // 检查采样率是否匹配，如果不匹配则进行简单重采样
-            if (packet.sample_rate != codec->output_sample_rate()) {
-                // ESP_LOGI(TAG, "Resampling music audio from %d to %d Hz", 
-                //         packet.sample_rate, codec->output_sample_rate());
-                
-                // 验证采样率参数
-                if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
-                    ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
-                            packet.sample_rate, codec->output_sample_rate());
-                    return;
-                }
-                
-                std::vector<int16_t> resampled;
-                
-                if (packet.sample_rate > codec->output_sample_rate()) {
-                    ESP_LOGI(TAG, "音乐播放：将采样率从 %d Hz 切换到 %d Hz", 
-                        codec->output_sample_rate(), packet.sample_rate);
-
-                    // 尝试动态切换采样率
-                    if (codec->SetOutputSampleRate(packet.sample_rate)) {
-                        ESP_LOGI(TAG, "成功切换到音乐播放采样率: %d Hz", packet.sample_rate);
-                    } else {
-                        ESP_LOGW(TAG, "无法切换采样率，继续使用当前采样率: %d Hz", codec->output_sample_rate());
-                    }
-                } else {
-                    // 上采样：线性插值
-                    float upsample_ratio = codec->output_sample_rate() / static_cast<float>(packet.sample_rate);
-                    size_t expected_size = static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f);
-                    resampled.reserve(expected_size);
-                    
-                    for (size_t i = 0; i < pcm_data.size(); ++i) {
-                        // 添加原始样本
-                        resampled.push_back(pcm_data[i]);
-                        
-                        // 计算需要插值的样本数
-                        int interpolation_count = static_cast<int>(upsample_ratio) - 1;
-                        if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
-                            int16_t current = pcm_data[i];
-                            int16_t next = pcm_data[i + 1];
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                float t = static_cast<float>(j) / (interpolation_count + 1);
-                                int16_t interpolated = static_cast<int16_t>(current + (next - current) * t);
-                                resampled.push_back(interpolated);
-                            }
-                        } else if (interpolation_count > 0) {
-                            // 最后一个样本，直接重复
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                resampled.push_back(pcm_data[i]);
-                            }
-                        }
-                    }
-                    
-                    ESP_LOGI(TAG, "Upsampled %d -> %d samples (ratio: %.2f)", 
-                            pcm_data.size(), resampled.size(), upsample_ratio);
-                }
-                
-                pcm_data = std::move(resampled);
-            }
-            
-            // 确保音频输出已启用
-            if (!codec->output_enabled()) {
-                codec->EnableOutput(true);
-            }
-            
-            // 发送PCM数据到音频编解码器
-            codec->OutputData(pcm_data);
-            
-            audio_service_.UpdateOutputTimestamp();
-        }
+// The PCM frame is queued to the audio service, the caller gets a recycled buffer back in pcm
+// Music keeps playing under the TTS, the mixer ducks it while the assistant speaks
+bool Application::AddAudioData(std::vector<int16_t>&& pcm, int sample_rate, int64_t position_us) {
+    if ((device_state_ != kDeviceStateIdle && device_state_ != kDeviceStateSpeaking) || pcm.empty()) {
+        return false;
+    }
+    if (sample_rate <= 0) {
+        ESP_LOGE(TAG, "Invalid sample rate: %d", sample_rate);
+        return false;
     }
+    return audio_service_.PushPcmToPlaybackQueue(std::move(pcm), sample_rate, position_us);
 }
 
 void Application::PlaySound(const std::string_view& sound) {
@@ -59,7 +59,7 @@ public:
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     
-    void AddAudioData(AudioStreamPacket&& packet);
+    bool AddAudioData(std::vector<int16_t>&& pcm, int sample_rate, int64_t position_us = -1);
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
 
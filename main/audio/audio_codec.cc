@@ -3,12 +3,32 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_heap_caps.h>
 #include <cstring>
 #include <driver/i2s_common.h>
 
+#include "pcm_kernels.h"
+
 #define TAG "AudioCodec"
 
+AudioCodecScratchBuffer::~AudioCodecScratchBuffer() {
+    if (data_ != nullptr) {
+        heap_caps_free(data_);
+    }
+}
+
+int32_t* AudioCodecScratchBuffer::data() {
+    if (data_ == nullptr) {
+        data_ = (int32_t*)heap_caps_malloc(AUDIO_CODEC_SCRATCH_SAMPLES * sizeof(int32_t), MALLOC_CAP_DMA);
+        if (data_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate the scratch buffer");
+        }
+    }
+    return data_;
+}
+
 AudioCodec::AudioCodec() {
+    UpdateOutputVolumeFactor();
 }
 
 AudioCodec::~AudioCodec() {
@@ -33,6 +53,7 @@ void AudioCodec::Start() {
         ESP_LOGW(TAG, "Output volume value (%d) is too small, setting to default (10)", output_volume_);
         output_volume_ = 10;
     }
+    UpdateOutputVolumeFactor();
 
     // 保存原始输出采样率
     if (original_output_sample_rate_ == 0) {
@@ -55,12 +76,19 @@ void AudioCodec::Start() {
 
 void AudioCodec::SetOutputVolume(int volume) {
     output_volume_ = volume;
+    UpdateOutputVolumeFactor();
     ESP_LOGI(TAG, "Set output volume to %d", output_volume_);
     
     Settings settings("audio", true);
     settings.SetInt("output_volume", output_volume_);
 }
 
+void AudioCodec::UpdateOutputVolumeFactor() {
+    // Cached here so the write path does not need pow() for every buffer
+    int volume = output_volume_ < 0 ? 0 : output_volume_ > 100 ? 100 : output_volume_;
+    output_volume_factor_ = volume * volume * PCM_UNITY_GAIN / (100 * 100);
+}
+
 void AudioCodec::EnableInput(bool enable) {
     if (enable == input_enabled_) {
         return;
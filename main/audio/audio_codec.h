@@ -14,6 +14,26 @@
 #define AUDIO_CODEC_DMA_DESC_NUM 6
 #define AUDIO_CODEC_DMA_FRAME_NUM 240
 #define AUDIO_CODEC_DEFAULT_MIC_GAIN 30.0
+// Samples converted per I2S call by the codecs that widen / narrow the samples themselves
+#define AUDIO_CODEC_SCRATCH_SAMPLES (AUDIO_CODEC_DMA_FRAME_NUM * 2)
+
+/*
+ * Fixed-size 32-bit sample buffer in DMA capable memory, allocated on first use.
+ * Use one per direction, Read() and Write() run on different tasks.
+ */
+class AudioCodecScratchBuffer {
+public:
+    AudioCodecScratchBuffer() = default;
+    ~AudioCodecScratchBuffer();
+    AudioCodecScratchBuffer(const AudioCodecScratchBuffer&) = delete;
+    AudioCodecScratchBuffer& operator=(const AudioCodecScratchBuffer&) = delete;
+
+    // AUDIO_CODEC_SCRATCH_SAMPLES long, nullptr if it could not be allocated
+    int32_t* data();
+
+private:
+    int32_t* data_ = nullptr;
+};
 
 class AudioCodec {
 public:
@@ -37,8 +57,12 @@ public:
     inline int input_channels() const { return input_channels_; }
     inline int output_channels() const { return output_channels_; }
     inline int output_volume() const { return output_volume_; }
+    // Q16 gain for codecs that scale the samples in software, (volume / 100)^2
+    inline int32_t output_volume_factor() const { return output_volume_factor_; }
     inline bool input_enabled() const { return input_enabled_; }
     inline bool output_enabled() const { return output_enabled_; }
+    // Samples per channel the I2S DMA holds ahead of the speaker once the output is running
+    inline int output_latency_samples() const { return AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM; }
 
 protected:
     i2s_chan_handle_t tx_handle_ = nullptr;
@@ -54,6 +78,11 @@ protected:
     int input_channels_ = 1;
     int output_channels_ = 1;
     int output_volume_ = 70;
+    int32_t output_volume_factor_ = 0;
+    AudioCodecScratchBuffer tx_scratch_;
+    AudioCodecScratchBuffer rx_scratch_;
+
+    void UpdateOutputVolumeFactor();
 
     virtual int Read(int16_t* dest, int samples) = 0;
     virtual int Write(const int16_t* data, int samples) = 0;
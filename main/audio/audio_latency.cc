@@ -0,0 +1,128 @@
+#include "audio_latency.h"
+
+#include <esp_log.h>
+#include <cJSON.h>
+#include <cstdio>
+
+#define TAG "AudioLatency"
+
+static const uint32_t kBucketBoundsMs[AUDIO_LATENCY_BUCKETS - 1] = AUDIO_LATENCY_BUCKET_BOUNDS_MS;
+
+static const char* const kStageNames[kAudioLatencyStageCount] = {
+    "capture_to_processed",
+    "processed_to_encoded",
+    "encoded_to_sent",
+    "capture_to_sent",
+    "received_to_decoded",
+    "decoded_to_played",
+    "received_to_played",
+};
+
+// Short names for the log line
+static const char* const kStageLabels[kAudioLatencyStageCount] = {
+    "cap>afe", "afe>enc", "enc>send", "cap>send", "recv>dec", "dec>i2s", "recv>i2s",
+};
+
+void AudioLatencyHistogram::Add(uint32_t latency_us) {
+    uint32_t latency_ms = latency_us / 1000;
+    int bucket = 0;
+    while (bucket < AUDIO_LATENCY_BUCKETS - 1 && latency_ms >= kBucketBoundsMs[bucket]) {
+        bucket++;
+    }
+    buckets[bucket]++;
+    count++;
+    total_us += latency_us;
+    if (latency_us > max_us) {
+        max_us = latency_us;
+    }
+}
+
+uint32_t AudioLatencyHistogram::PercentileMs(int percent) const {
+    if (count == 0) {
+        return 0;
+    }
+    uint32_t rank = (count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int bucket = 0; bucket < AUDIO_LATENCY_BUCKETS - 1; bucket++) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return kBucketBoundsMs[bucket];
+        }
+    }
+    return max_us / 1000;
+}
+
+void AudioLatencyTracer::Record(AudioLatencyStage stage, int64_t from_us, int64_t to_us) {
+    if (from_us <= 0 || to_us < from_us) {
+        return;
+    }
+    uint32_t latency_us = to_us - from_us;
+    std::lock_guard<std::mutex> lock(mutex_);
+    total_[stage].Add(latency_us);
+    window_[stage].Add(latency_us);
+}
+
+std::string AudioLatencyTracer::GetJson() {
+    AudioLatencyHistogram stages[kAudioLatencyStageCount];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < kAudioLatencyStageCount; i++) {
+            stages[i] = total_[i];
+        }
+    }
+
+    cJSON* root = cJSON_CreateObject();
+    cJSON* bounds = cJSON_CreateArray();
+    for (auto bound : kBucketBoundsMs) {
+        cJSON_AddItemToArray(bounds, cJSON_CreateNumber(bound));
+    }
+    cJSON_AddItemToObject(root, "bucket_upper_bounds_ms", bounds);
+
+    for (int i = 0; i < kAudioLatencyStageCount; i++) {
+        auto& stage = stages[i];
+        cJSON* item = cJSON_CreateObject();
+        cJSON_AddNumberToObject(item, "count", stage.count);
+        cJSON_AddNumberToObject(item, "avg_ms", stage.count ? stage.total_us / stage.count / 1000 : 0);
+        cJSON_AddNumberToObject(item, "p50_ms", stage.PercentileMs(50));
+        cJSON_AddNumberToObject(item, "p95_ms", stage.PercentileMs(95));
+        cJSON_AddNumberToObject(item, "max_ms", stage.max_us / 1000);
+        cJSON* buckets = cJSON_CreateArray();
+        for (auto count : stage.buckets) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(count));
+        }
+        cJSON_AddItemToObject(item, "histogram", buckets);
+        cJSON_AddItemToObject(root, kStageNames[i], item);
+    }
+
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
+
+void AudioLatencyTracer::PrintStats() {
+    AudioLatencyHistogram stages[kAudioLatencyStageCount];
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int i = 0; i < kAudioLatencyStageCount; i++) {
+            stages[i] = window_[i];
+            window_[i] = AudioLatencyHistogram();
+        }
+    }
+
+    std::string line;
+    char buffer[64];
+    for (int i = 0; i < kAudioLatencyStageCount; i++) {
+        auto& stage = stages[i];
+        if (stage.count == 0) {
+            continue;
+        }
+        snprintf(buffer, sizeof(buffer), " %s=%lu/%lu/%lu", kStageLabels[i],
+            (uint32_t)(stage.total_us / stage.count / 1000), stage.PercentileMs(95), stage.max_us / 1000);
+        line += buffer;
+    }
+    if (!line.empty()) {
+        ESP_LOGI(TAG, "Latency ms (avg/p95/max):%s", line.c_str());
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef AUDIO_LATENCY_H
+#define AUDIO_LATENCY_H
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+// Local time (esp_timer_get_time, in us) at which a frame passed each stage, 0 if it did not
+struct AudioLatencyStamps {
+    int64_t capture = 0;        // Read from the codec
+    int64_t processed = 0;      // Output by the audio processor
+    int64_t encoded = 0;
+    int64_t received = 0;       // Handed over by the protocol
+    int64_t decoded = 0;
+};
+
+enum AudioLatencyStage {
+    // Uplink
+    kAudioLatencyCaptureToProcessed,
+    kAudioLatencyProcessedToEncoded,
+    kAudioLatencyEncodedToSent,
+    kAudioLatencyCaptureToSent,
+    // Downlink
+    kAudioLatencyReceivedToDecoded,
+    kAudioLatencyDecodedToPlayed,
+    kAudioLatencyReceivedToPlayed,
+    kAudioLatencyStageCount,
+};
+
+// Upper bounds of the histogram buckets in ms, the last bucket holds everything above
+#define AUDIO_LATENCY_BUCKET_BOUNDS_MS { 5, 10, 20, 50, 100, 200, 500, 1000, 2000 }
+#define AUDIO_LATENCY_BUCKETS 10
+
+struct AudioLatencyHistogram {
+    uint32_t buckets[AUDIO_LATENCY_BUCKETS] = {};
+    uint32_t count = 0;
+    uint64_t total_us = 0;
+    uint32_t max_us = 0;
+
+    void Add(uint32_t latency_us);
+    // Upper bound of the bucket holding the given percentile, the max for the last bucket
+    uint32_t PercentileMs(int percent) const;
+};
+
+/*
+ * Per-stage latency histograms of the audio pipeline, fed by the audio tasks.
+ * Every stage is kept twice: since boot for GetJson(), and since the last PrintStats() for the log.
+ */
+class AudioLatencyTracer {
+public:
+    // Ignored if the frame was not stamped at from_us
+    void Record(AudioLatencyStage stage, int64_t from_us, int64_t to_us);
+
+    std::string GetJson();
+    void PrintStats();
+
+private:
+    std::mutex mutex_;
+    AudioLatencyHistogram total_[kAudioLatencyStageCount];
+    AudioLatencyHistogram window_[kAudioLatencyStageCount];
+};
+
+#endif // AUDIO_LATENCY_H
@@ -0,0 +1,141 @@
+#include "audio_mixer.h"
+#include "pcm_kernels.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "AudioMixer"
+
+#define DUCK_GAIN (AUDIO_MIXER_DUCK_VOLUME * PCM_UNITY_GAIN / 100)
+
+
+AudioMixer::AudioMixer() : duck_gain_(PCM_UNITY_GAIN) {
+    for (auto& source : sources_) {
+        source.volume_gain = PCM_UNITY_GAIN;
+    }
+}
+
+void AudioMixer::Configure(int sample_rate) {
+    frame_samples_ = sample_rate * AUDIO_MIXER_FRAME_MS / 1000;
+    duck_attack_step_ = (PCM_UNITY_GAIN - DUCK_GAIN) * AUDIO_MIXER_FRAME_MS / AUDIO_MIXER_DUCK_ATTACK_MS;
+    duck_release_step_ = (PCM_UNITY_GAIN - DUCK_GAIN) * AUDIO_MIXER_FRAME_MS / AUDIO_MIXER_DUCK_RELEASE_MS;
+    hold_frames_ = AUDIO_MIXER_DUCK_HOLD_MS / AUDIO_MIXER_FRAME_MS;
+    voice_silent_frames_ = hold_frames_ + 1;
+    duck_gain_ = PCM_UNITY_GAIN;
+    for (auto& source : sources_) {
+        source.pcm.clear();
+        source.pcm.reserve(frame_samples_ * 2);
+        source.offset = 0;
+        source.gain = source.volume_gain;
+    }
+    ESP_LOGI(TAG, "Mixing %u samples per frame at %d Hz", frame_samples_, sample_rate);
+}
+
+void AudioMixer::ApplyClear(Source& source) {
+    if (source.clear_requested.exchange(false)) {
+        source.pcm.clear();
+        source.offset = 0;
+    }
+}
+
+size_t AudioMixer::Available(AudioMixerSource source) {
+    auto& s = sources_[source];
+    ApplyClear(s);
+    return s.pcm.size() - s.offset;
+}
+
+void AudioMixer::Append(AudioMixerSource source, const int16_t* pcm, size_t samples) {
+    auto& s = sources_[source];
+    ApplyClear(s);
+    /* Move the unplayed samples to the front, the buffer only grows to its largest block */
+    if (s.offset > 0) {
+        size_t remaining = s.pcm.size() - s.offset;
+        memmove(s.pcm.data(), s.pcm.data() + s.offset, remaining * sizeof(int16_t));
+        s.pcm.resize(remaining);
+        s.offset = 0;
+    }
+    s.pcm.insert(s.pcm.end(), pcm, pcm + samples);
+}
+
+bool AudioMixer::Mix(std::vector<int16_t>& out, bool flush) {
+    bool has_frame = false;
+    bool has_samples = false;
+    for (int i = 0; i < kAudioMixerSourceCount; i++) {
+        size_t available = Available(static_cast<AudioMixerSource>(i));
+        has_frame |= available >= frame_samples_;
+        has_samples |= available > 0;
+    }
+    if (!has_samples || (!has_frame && !flush)) {
+        return false;
+    }
+    int64_t start_time = esp_timer_get_time();
+
+    /* Duck the music while the voice plays, and for a short hold after it, so it does not pump between sentences */
+    if (Available(kAudioMixerSourceVoice) > 0) {
+        voice_silent_frames_ = 0;
+    } else if (voice_silent_frames_ <= hold_frames_) {
+        voice_silent_frames_++;
+    }
+    if (voice_silent_frames_ <= hold_frames_) {
+        duck_gain_ = std::max(duck_gain_ - duck_attack_step_, static_cast<int32_t>(DUCK_GAIN));
+    } else {
+        duck_gain_ = std::min(duck_gain_ + duck_release_step_, static_cast<int32_t>(PCM_UNITY_GAIN));
+    }
+
+    /* 16-bit samples times Q16 gains up to unity fit in 32 bits, the sum is clipped once at the end */
+    mix_.assign(frame_samples_, 0);
+    for (int i = 0; i < kAudioMixerSourceCount; i++) {
+        auto& s = sources_[i];
+        int32_t target = s.volume_gain;
+        if (i == kAudioMixerSourceMusic) {
+            target = static_cast<int32_t>(static_cast<int64_t>(target) * duck_gain_ / PCM_UNITY_GAIN);
+        }
+        size_t samples = std::min(s.pcm.size() - s.offset, frame_samples_);
+        const int16_t* in = s.pcm.data() + s.offset;
+        int32_t gain = s.gain;
+        int32_t step = (target - s.gain) / static_cast<int32_t>(frame_samples_);
+        for (size_t j = 0; j < samples; j++) {
+            gain += step;
+            mix_[j] += (static_cast<int32_t>(in[j]) * gain) >> 16;
+        }
+        s.gain = target;
+        s.offset += samples;
+        if (s.offset == s.pcm.size()) {
+            s.pcm.clear();
+            s.offset = 0;
+        }
+    }
+
+    out.resize(frame_samples_);
+    for (size_t j = 0; j < frame_samples_; j++) {
+        out[j] = static_cast<int16_t>(std::clamp<int32_t>(mix_[j], INT16_MIN, INT16_MAX));
+    }
+
+    uint32_t elapsed_us = esp_timer_get_time() - start_time;
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.frames++;
+    if (duck_gain_ < PCM_UNITY_GAIN) {
+        stats_.ducked_frames++;
+    }
+    stats_.total_us += elapsed_us;
+    stats_.max_us = std::max(stats_.max_us, elapsed_us);
+    return true;
+}
+
+void AudioMixer::SetVolume(AudioMixerSource source, int volume) {
+    volume = std::clamp(volume, 0, 100);
+    sources_[source].volume_gain = volume * PCM_UNITY_GAIN / 100;
+}
+
+void AudioMixer::Clear(AudioMixerSource source) {
+    sources_[source].clear_requested = true;
+}
+
+AudioMixerStats AudioMixer::GetStats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    auto stats = stats_;
+    stats_ = AudioMixerStats();
+    return stats;
+}
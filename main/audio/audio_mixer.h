@@ -0,0 +1,89 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// The mixer writes the codec in frames of this duration
+#define AUDIO_MIXER_FRAME_MS 20
+// Music volume while the voice is playing, in percent of its own volume
+#define AUDIO_MIXER_DUCK_VOLUME 25
+// Ramp times of the ducking gain, and how long it stays down after the voice stopped
+#define AUDIO_MIXER_DUCK_ATTACK_MS 60
+#define AUDIO_MIXER_DUCK_RELEASE_MS 600
+#define AUDIO_MIXER_DUCK_HOLD_MS 400
+
+enum AudioMixerSource {
+    kAudioMixerSourceVoice,     // Decoded downlink: TTS, sound cues and the audio testing loopback
+    kAudioMixerSourceMusic,     // PCM source frames
+    kAudioMixerSourceCount,
+};
+
+// Collected between two GetStats() calls
+struct AudioMixerStats {
+    uint32_t frames = 0;
+    uint32_t ducked_frames = 0;
+    uint32_t total_us = 0;
+    uint32_t max_us = 0;
+};
+
+/*
+ * Mixes the playback sources into fixed-size frames for the codec.
+ *
+ * Every source has a linear sample buffer that keeps its capacity, so mixing does not allocate
+ * once warmed up. Each source has its own volume, and the music is ducked by the voice: its gain
+ * ramps down to AUDIO_MIXER_DUCK_VOLUME when the voice starts, and back up once the voice has
+ * been silent for AUDIO_MIXER_DUCK_HOLD_MS. Gains are Q16 and ramp linearly over each frame.
+ *
+ * Append() / Mix() belong to the audio output task. SetVolume() and Clear() may be called from
+ * any task, a clear is applied by the output task on its next call.
+ */
+class AudioMixer {
+public:
+    AudioMixer();
+
+    void Configure(int sample_rate);
+    inline size_t frame_samples() const { return frame_samples_; }
+
+    size_t Available(AudioMixerSource source);
+    void Append(AudioMixerSource source, const int16_t* pcm, size_t samples);
+    /*
+     * Writes the next frame to out. Without flush a frame is only mixed once a source has a whole
+     * frame buffered, with flush the sources with a partial frame are played out padded with silence.
+     * Returns false if there was nothing to mix.
+     */
+    bool Mix(std::vector<int16_t>& out, bool flush);
+
+    void SetVolume(AudioMixerSource source, int volume);
+    void Clear(AudioMixerSource source);
+    AudioMixerStats GetStats();
+
+private:
+    struct Source {
+        std::vector<int16_t> pcm;
+        size_t offset = 0;
+        int32_t gain = 0;                       // Q16 gain at the end of the last frame
+        std::atomic<int32_t> volume_gain;       // Q16 gain set by SetVolume()
+        std::atomic<bool> clear_requested = false;
+    };
+
+    Source sources_[kAudioMixerSourceCount];
+    size_t frame_samples_ = 0;
+    int32_t duck_attack_step_ = 0;
+    int32_t duck_release_step_ = 0;
+    int32_t duck_gain_;
+    int hold_frames_ = 0;
+    int voice_silent_frames_ = 0;
+    // Accumulator of the frame being mixed
+    std::vector<int32_t> mix_;
+
+    std::mutex stats_mutex_;
+    AudioMixerStats stats_;
+
+    void ApplyClear(Source& source);
+};
+
+#endif // AUDIO_MIXER_H
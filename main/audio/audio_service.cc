@@ -1,5 +1,8 @@
 #include "audio_service.h"
+#include "pcm_kernels.h"
 #include <esp_log.h>
+#include <algorithm>
+#include <cstring>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -18,8 +21,29 @@
 #define TAG "AudioService"
 
 
-AudioService::AudioService() {
+AudioService::AudioService()
+    : audio_task_pool_(AUDIO_TASK_POOL_SIZE, [](AudioTask& task) {
+          task.timestamp = 0;
+          task.sample_rate = 0;
+          task.position_us = -1;
+          task.stamps = AudioLatencyStamps();
+          task.pcm.clear();
+          if (task.pcm.capacity() > AUDIO_TASK_MAX_PCM_SAMPLES) {
+              std::vector<int16_t>().swap(task.pcm);
+              return true;
+          }
+          return false;
+      }),
+      audio_decode_queue_(MAX_DECODE_PACKETS_IN_QUEUE(MIN_OPUS_FRAME_DURATION_MS)),
+      audio_send_queue_(MAX_SEND_PACKETS_IN_QUEUE(MIN_OPUS_FRAME_DURATION_MS)),
+      audio_testing_queue_(AUDIO_TESTING_MAX_DURATION_MS / MIN_OPUS_FRAME_DURATION_MS),
+      audio_encode_queue_(MAX_ENCODE_TASKS_IN_QUEUE),
+      audio_playback_queue_(MAX_PLAYBACK_TASKS_IN_QUEUE),
+      audio_pcm_queue_(MAX_PCM_TASKS_IN_QUEUE),
+      output_tap_(AUDIO_OUTPUT_TAP_SAMPLES) {
     event_group_ = xEventGroupCreate();
+    audio_decode_queue_.SetLimit(MAX_DECODE_PACKETS_IN_QUEUE(DEFAULT_OPUS_FRAME_DURATION_MS));
+    SetUplinkFrameDuration(DEFAULT_OPUS_FRAME_DURATION_MS);
 }
 
 AudioService::~AudioService() {
@@ -34,9 +58,10 @@ void AudioService::Initialize(AudioCodec* codec) {
     codec_->Start();
 
     /* Setup the audio codec */
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, DEFAULT_OPUS_FRAME_DURATION_MS);
+    opus_encoder_ = std::make_unique<UplinkOpusEncoder>(16000, 1, uplink_frame_duration_);
     opus_encoder_->SetComplexity(0);
+    opus_encoder_->SetParams(encoder_policy_.GetParams());
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
@@ -60,11 +85,13 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
-        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
+        int64_t capture_time = PopCaptureStamp(data.size());
+        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data), capture_time);
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+        encoder_policy_.OnVoiceDetected(speaking);
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -124,15 +151,21 @@ void AudioService::Start() {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
         vTaskDelete(NULL);
-    }, "audio_output", 2048, this, 3, &audio_output_task_handle_);
+    }, "audio_output", 2048 * 2, this, 3, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus encoder and decoder tasks, a slow frame on one side must not stall the other */
+    xTaskCreatePinnedToCore([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusEncodeTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_encode", 2048 * 13, this, OPUS_ENCODE_TASK_PRIORITY, &opus_encode_task_handle_, OPUS_ENCODE_TASK_CORE);
+
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusDecodeTask();
+        vTaskDelete(NULL);
+    }, "opus_decode", 2048 * 6, this, OPUS_DECODE_TASK_PRIORITY, &opus_decode_task_handle_, OPUS_DECODE_TASK_CORE);
 }
 
 void AudioService::Stop() {
@@ -140,14 +173,27 @@ void AudioService::Stop() {
     service_stopped_ = true;
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING |
-        AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+        AS_EVENT_AUDIO_PROCESSOR_RUNNING |
+        AS_EVENT_ENCODE_QUEUE_AVAILABLE |
+        AS_EVENT_DECODE_QUEUE_AVAILABLE |
+        AS_EVENT_PCM_QUEUE_AVAILABLE);
+
+    audio_encode_queue_.Clear();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_pcm_queue_.Clear();
+    audio_testing_queue_.Clear();
+    mixer_.Clear(kAudioMixerSourceVoice);
+    mixer_.Clear(kAudioMixerSourceMusic);
+    NotifyTask(opus_encode_task_handle_);
+    NotifyTask(opus_decode_task_handle_);
+    NotifyTask(audio_output_task_handle_);
+}
 
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+void AudioService::NotifyTask(TaskHandle_t task) {
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
@@ -156,31 +202,28 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
     }
 
+    /* All buffers below are only resized, so once warmed up a frame is captured without allocating */
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate);
-        if (!codec_->InputData(data)) {
+        capture_buffer_.resize(samples * codec_->input_sample_rate() / sample_rate);
+        if (!codec_->InputData(capture_buffer_)) {
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            size_t frames = capture_buffer_.size() / 2;
+            capture_mic_.resize(frames);
+            capture_reference_.resize(frames);
+            PcmDeinterleave2(capture_buffer_.data(), frames, capture_mic_.data(), capture_reference_.data());
+
+            resampled_mic_.resize(input_resampler_.GetOutputSamples(frames));
+            resampled_reference_.resize(reference_resampler_.GetOutputSamples(frames));
+            input_resampler_.Process(capture_mic_.data(), frames, resampled_mic_.data());
+            reference_resampler_.Process(capture_reference_.data(), frames, resampled_reference_.data());
+
+            data.resize(resampled_mic_.size() * 2);
+            PcmInterleave2(resampled_mic_.data(), resampled_reference_.data(), resampled_mic_.size(), data.data());
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            data.resize(input_resampler_.GetOutputSamples(capture_buffer_.size()));
+            input_resampler_.Process(capture_buffer_.data(), capture_buffer_.size(), data.data());
         }
     } else {
         data.resize(samples);
@@ -221,34 +264,30 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            if (audio_testing_queue_.Size() >= audio_testing_queue_.limit()) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
-            int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
+            int samples = uplink_frame_duration_ * 16000 / 1000;
+            if (ReadAudioData(input_frame_, 16000, samples)) {
+                int64_t capture_time = esp_timer_get_time();
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    PcmExtractFirstChannel2(input_frame_.data(), input_frame_.size() / 2, input_frame_.data());
+                    input_frame_.resize(input_frame_.size() / 2);
                 }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
+                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(input_frame_), capture_time);
                 continue;
             }
         }
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    wake_word_->Feed(data);
+                if (ReadAudioData(input_frame_, 16000, samples)) {
+                    wake_word_->Feed(input_frame_);
                     continue;
                 }
             }
@@ -256,11 +295,11 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
-                    audio_processor_->Feed(std::move(data));
+                if (ReadAudioData(input_frame_, 16000, samples)) {
+                    PushCaptureStamp(input_frame_.size() / codec_->input_channels(), esp_timer_get_time());
+                    audio_processor_->Feed(std::move(input_frame_));
                     continue;
                 }
             }
@@ -274,117 +313,394 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
+    mixer_.Configure(codec_->output_sample_rate());
+    output_tap_.SetSampleRate(codec_->output_sample_rate());
+    size_t frame_samples = mixer_.frame_samples();
+    /* Set after a whole PCM source frame was mixed, until the PCM source runs dry */
+    bool pcm_playing = false;
+    bool flush = false;
+    /* Last decoded task moved into the mixer, its stamps are recorded once its first samples are played */
+    AudioLatencyStamps voice_stamps;
+    uint32_t voice_timestamp = 0;
+    bool voice_pending = false;
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
+        if (pcm_clock_reset_.exchange(false)) {
+            ResetPcmClock();
+        }
+
+        /* Fill every mixer source up to one frame, the queues hold the rest */
+        AudioTaskPtr task;
+        bool made_room = false;
+        while (mixer_.Available(kAudioMixerSourceVoice) < frame_samples) {
+            bool popped = audio_playback_queue_.Pop(task, made_room);
+            /* The opus decode task stops decoding while the playback queue is full */
+            if (made_room) {
+                NotifyTask(opus_decode_task_handle_);
+            }
+            if (!popped) {
+                break;
+            }
+            if (voice_pending) {
+                RecordVoicePlayed(voice_stamps, voice_timestamp);
+            }
+            mixer_.Append(kAudioMixerSourceVoice, task->pcm.data(), task->pcm.size());
+            voice_stamps = task->stamps;
+            voice_timestamp = task->timestamp;
+            voice_pending = true;
+        }
+        while (mixer_.Available(kAudioMixerSourceMusic) < frame_samples) {
+            bool popped = audio_pcm_queue_.Pop(task, made_room);
+            if (made_room) {
+                xEventGroupSetBits(event_group_, AS_EVENT_PCM_QUEUE_AVAILABLE);
+            }
+            if (!popped) {
+                break;
+            }
+            auto& pcm = ConvertPcmSampleRate(*task);
+            if (task->position_us >= 0) {
+                pcm_stamps_.push_back({pcm_appended_samples_, task->position_us});
+            }
+            mixer_.Append(kAudioMixerSourceMusic, pcm.data(), pcm.size());
+            pcm_appended_samples_ += pcm.size();
+            std::lock_guard<std::mutex> lock(timing_mutex_);
+            pcm_stats_.frames++;
+        }
+
+        size_t music_available = mixer_.Available(kAudioMixerSourceMusic);
+        bool music_frame = music_available >= frame_samples;
+        if (!music_frame && pcm_playing && pcm_streaming_) {
+            std::lock_guard<std::mutex> lock(timing_mutex_);
+            pcm_stats_.underruns++;
+        }
+        pcm_playing = music_frame;
+
+        if (!mixer_.Mix(output_frame_, flush)) {
+            /* A partial frame is played out if nothing follows it within a frame */
+            bool partial = mixer_.Available(kAudioMixerSourceVoice) > 0 || mixer_.Available(kAudioMixerSourceMusic) > 0;
+            /* The next PCM stream must not start with the tail of the previous one */
+            if (!partial && !pcm_streaming_) {
+                pcm_resampler_.Reset();
+            }
+            flush = ulTaskNotifyTake(pdTRUE, partial ? pdMS_TO_TICKS(AUDIO_MIXER_FRAME_MS) + 1 : portMAX_DELAY) == 0;
+            if (service_stopped_) {
+                break;
+            }
+            if (!flush) {
+                debug_statistics_.audio_output_wakeups++;
+                if (audio_playback_queue_.Empty() && audio_pcm_queue_.Empty()) {
+                    debug_statistics_.audio_output_spurious_wakeups++;
+                }
+            }
+            continue;
+        }
+        flush = false;
         if (service_stopped_) {
             break;
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
-
         if (!codec_->output_enabled()) {
             codec_->EnableOutput(true);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
         }
-        codec_->OutputData(task->pcm);
+        /* Visualizers read what is played, the volume of the codec aside */
+        output_tap_.Write(output_frame_.data(), output_frame_.size());
+        codec_->OutputData(output_frame_);
+        size_t music_mixed = music_available - std::min(music_available, mixer_.Available(kAudioMixerSourceMusic));
+        UpdatePcmClock(music_mixed, output_frame_.size());
+        if (voice_pending) {
+            RecordVoicePlayed(voice_stamps, voice_timestamp);
+            voice_pending = false;
+        }
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
         debug_statistics_.playback_count++;
+    }
+
+    ESP_LOGW(TAG, "Audio output task stopped");
+}
+
+void AudioService::RecordVoicePlayed(const AudioLatencyStamps& stamps, uint32_t timestamp) {
+    int64_t played_time = esp_timer_get_time();
+    latency_tracer_.Record(kAudioLatencyDecodedToPlayed, stamps.decoded, played_time);
+    latency_tracer_.Record(kAudioLatencyReceivedToPlayed, stamps.received, played_time);
 
 #if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
-        }
+    /* Record the timestamp for server AEC */
+    if (timestamp > 0) {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        timestamp_queue_.push_back(timestamp);
+    }
 #endif
+}
+
+void AudioService::ResetPcmClock() {
+    pcm_stamps_.clear();
+    pcm_mixed_samples_ = 0;
+    pcm_appended_samples_ = mixer_.Available(kAudioMixerSourceMusic);
+}
+
+void AudioService::UpdatePcmClock(size_t pcm_samples, size_t frame_samples) {
+    int sample_rate = codec_->output_sample_rate();
+    int64_t now = esp_timer_get_time();
+    int64_t frame_us = (int64_t)frame_samples * 1000000 / sample_rate;
+    int64_t dma_us = (int64_t)codec_->output_latency_samples() * 1000000 / sample_rate;
+    /* The DMA drains in real time between the writes, and the write blocks while it is full */
+    int64_t queued_us = std::max<int64_t>(0, output_queued_us_ - (now - output_written_time_us_));
+    output_queued_us_ = std::min(dma_us, queued_us + frame_us);
+    output_written_time_us_ = now;
+    if (pcm_samples == 0) {
+        return;
     }
 
-    ESP_LOGW(TAG, "Audio output task stopped");
+    /* The latest stamp at or before the first PCM source sample of the frame */
+    uint64_t first_sample = pcm_mixed_samples_;
+    pcm_mixed_samples_ += pcm_samples;
+    while (pcm_stamps_.size() > 1 && pcm_stamps_[1].sample <= first_sample) {
+        pcm_stamps_.pop_front();
+    }
+    if (pcm_stamps_.empty() || pcm_stamps_.front().sample > first_sample) {
+        return;
+    }
+    auto& stamp = pcm_stamps_.front();
+    int64_t position_us = stamp.position_us + (int64_t)(first_sample - stamp.sample) * 1000000 / sample_rate;
+
+    if (pcm_clock_reset_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(pcm_clock_mutex_);
+    pcm_clock_.valid = true;
+    pcm_clock_.position_us = position_us;
+    pcm_clock_.end_us = position_us + (int64_t)pcm_samples * 1000000 / sample_rate;
+    pcm_clock_.written_time_us = now;
+    pcm_clock_.latency_us = output_queued_us_ - frame_us;
+}
+
+int64_t AudioService::GetPcmPlaybackPosition() {
+    std::lock_guard<std::mutex> lock(pcm_clock_mutex_);
+    if (!pcm_clock_.valid) {
+        return -1;
+    }
+    int64_t played_us = esp_timer_get_time() - pcm_clock_.written_time_us - pcm_clock_.latency_us;
+    return std::min(pcm_clock_.position_us + played_us, pcm_clock_.end_us);
+}
+
+std::vector<int16_t>& AudioService::ConvertPcmSampleRate(AudioTask& task) {
+    int output_rate = codec_->output_sample_rate();
+    if (task.sample_rate <= 0 || task.sample_rate == output_rate) {
+        return task.pcm;
+    }
+
+    /* The codec keeps its sample rate, reconfiguring I2S in the middle of a stream would click */
+    if (pcm_resampler_.input_sample_rate() != task.sample_rate || pcm_resampler_.output_sample_rate() != output_rate) {
+        pcm_resampler_.Configure(task.sample_rate, output_rate);
+    }
+    pcm_resample_buffer_.resize(pcm_resampler_.GetOutputSamples(task.pcm.size()));
+    pcm_resample_buffer_.resize(pcm_resampler_.Process(task.pcm.data(), task.pcm.size(), pcm_resample_buffer_.data()));
+    return pcm_resample_buffer_;
 }
 
-void AudioService::OpusCodecTask() {
+void AudioService::OpusDecodeTask() {
+    bool woken = false;
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
+        /* Decode only when the playback queue has room, the output task wakes us up when it makes some */
+        AudioStreamPacketPtr packet;
+        JitterBufferResult result = kJitterBufferWait;
+        TickType_t wait_ticks = portMAX_DELAY;
+        if (!audio_playback_queue_.Full()) {
+            /* Move the arrived packets into the jitter buffer, which puts them back in order */
+            while (!jitter_buffer_.Full() && PopPacketToDecode(packet)) {
+                jitter_buffer_.Put(std::move(packet));
+            }
+            int wait_ms;
+            result = jitter_buffer_.Get(packet, wait_ms);
+            if (wait_ms >= 0) {
+                wait_ticks = pdMS_TO_TICKS(wait_ms) + 1;
+            }
+        }
+        if (result == kJitterBufferWait) {
+            if (woken) {
+                debug_statistics_.decode_spurious_wakeups++;
+            }
+            ulTaskNotifyTake(pdTRUE, wait_ticks);
+            if (service_stopped_) {
+                break;
+            }
+            debug_statistics_.decode_wakeups++;
+            woken = true;
+            continue;
+        }
+        woken = false;
         if (service_stopped_) {
             break;
         }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
+        int64_t start_time = esp_timer_get_time();
+        auto task = audio_task_pool_.Acquire();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
+        /* The loss of the received stream drives the FEC of the sent one */
+        if (result == kJitterBufferLost) {
+            encoder_policy_.OnReceivedFrame(true);
+        } else if (packet->sequence != 0) {
+            encoder_policy_.OnReceivedFrame(false);
+        }
 
+        bool decoded;
+        if (result == kJitterBufferFrame) {
+            task->timestamp = packet->timestamp;
+            task->stamps.received = packet->stamps.received;
             SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+            decoded = opus_decoder_->Decode(std::move(packet->payload), task->pcm);
+            if (decoded) {
+                /* Keep a copy for the concealment of a following lost frame */
+                last_decoded_pcm_.assign(task->pcm.begin(), task->pcm.end());
+                concealed_frames_ = 0;
+            }
+        } else {
+            decoded = ConcealFrame(task->pcm);
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
+        if (decoded) {
+            // Resample if the sample rate is different
+            if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+                resample_buffer_.resize(output_resampler_.GetOutputSamples(task->pcm.size()));
+                resample_buffer_.resize(output_resampler_.Process(task->pcm.data(), task->pcm.size(), resample_buffer_.data()));
+                // Keep both buffers alive, the decoded one is reused for the next resampling
+                task->pcm.swap(resample_buffer_);
             }
-            debug_statistics_.decode_count++;
-        }
-        
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+            RecordFrameTiming(decode_timing_, start_time);
+            task->stamps.decoded = esp_timer_get_time();
+            latency_tracer_.Record(kAudioLatencyReceivedToDecoded, task->stamps.received, task->stamps.decoded);
+
+            audio_playback_queue_.Push(std::move(task));
+            NotifyTask(audio_output_task_handle_);
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
+        }
+        debug_statistics_.decode_count++;
+    }
+
+    ESP_LOGW(TAG, "Opus decode task stopped");
+}
+
+bool AudioService::ConcealFrame(std::vector<int16_t>& pcm) {
+    concealed_frames_++;
+
+    /* An empty packet makes the Opus decoder extrapolate the missing frame (PLC) */
+    std::vector<uint8_t> plc_packet;
+    if (opus_decoder_->Decode(std::move(plc_packet), pcm) && !pcm.empty()) {
+        return true;
+    }
+
+    /* Otherwise repeat the last decoded frame, halving its level for each frame in a row */
+    if (last_decoded_pcm_.empty()) {
+        return false;
+    }
+    int shift = std::min(concealed_frames_, 15);
+    pcm.resize(last_decoded_pcm_.size());
+    for (size_t i = 0; i < pcm.size(); i++) {
+        pcm[i] = last_decoded_pcm_[i] >> shift;
+    }
+    return true;
+}
+
+void AudioService::OpusEncodeTask() {
+    bool woken = false;
+    while (true) {
+        /* Encode only when the send queue has room, the application wakes us up when it makes some */
+        AudioTaskPtr task;
+        bool made_room = false;
+        if (audio_send_queue_.Full() || !audio_encode_queue_.Pop(task, made_room)) {
+            if (woken) {
+                debug_statistics_.encode_spurious_wakeups++;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            if (service_stopped_) {
+                break;
             }
+            debug_statistics_.encode_wakeups++;
+            woken = true;
+            continue;
+        }
+        woken = false;
+        if (made_room) {
+            xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_QUEUE_AVAILABLE);
+        }
+        if (service_stopped_) {
+            break;
+        }
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
-                }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+        /* The uplink frame duration only changes between two listening sessions */
+        if (opus_encoder_->duration_ms() != uplink_frame_duration_) {
+            ESP_LOGI(TAG, "Opus encoder frame duration: %d ms", uplink_frame_duration_.load());
+            opus_encoder_ = std::make_unique<UplinkOpusEncoder>(16000, 1, uplink_frame_duration_);
+            opus_encoder_->SetComplexity(0);
+            opus_encoder_->SetParams(encoder_policy_.GetParams());
+        }
+        if (task->type == kAudioTaskTypeEncodeToSendQueue &&
+            encoder_policy_.Update(audio_send_queue_.Size(), audio_send_queue_.limit())) {
+            opus_encoder_->SetParams(encoder_policy_.GetParams());
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        auto packet = AudioStreamPacket::Create();
+        packet->frame_duration = opus_encoder_->duration_ms();
+        packet->sample_rate = 16000;
+        packet->timestamp = task->timestamp;
+        packet->stamps = task->stamps;
+        if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to encode audio");
+            continue;
+        }
+        RecordFrameTiming(encode_timing_, start_time);
+        packet->stamps.encoded = esp_timer_get_time();
+
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            encoder_policy_.OnEncodedFrame(packet->payload.size());
+            latency_tracer_.Record(kAudioLatencyCaptureToProcessed, packet->stamps.capture, packet->stamps.processed);
+            latency_tracer_.Record(kAudioLatencyProcessedToEncoded, packet->stamps.processed, packet->stamps.encoded);
+            audio_send_queue_.Push(std::move(packet));
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
+        } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+            audio_testing_queue_.Push(std::move(packet));
         }
+        debug_statistics_.encode_count++;
+    }
+
+    ESP_LOGW(TAG, "Opus encode task stopped");
+}
+
+void AudioService::RecordFrameTiming(FrameTimingStats& stats, int64_t start_time) {
+    uint32_t elapsed_us = esp_timer_get_time() - start_time;
+    std::lock_guard<std::mutex> lock(timing_mutex_);
+    if (stats.frames == 0 || elapsed_us < stats.min_us) {
+        stats.min_us = elapsed_us;
+    }
+    if (elapsed_us > stats.max_us) {
+        stats.max_us = elapsed_us;
     }
+    stats.total_us += elapsed_us;
+    stats.frames++;
+}
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+bool AudioService::PopPacketToDecode(AudioStreamPacketPtr& packet) {
+    bool made_room = false;
+    bool popped = audio_decode_queue_.Pop(packet, made_room);
+    if (made_room) {
+        xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE);
+    }
+    if (popped) {
+        return true;
+    }
+
+    /* Play back the recorded audio after audio testing is finished */
+    if (!(xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_TESTING_RUNNING)) {
+        return audio_testing_queue_.Pop(packet);
+    }
+    return false;
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -395,64 +711,129 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     opus_decoder_.reset();
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+    if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec_->output_sample_rate());
+        output_resampler_.Configure(opus_decoder_->sample_rate(), codec_->output_sample_rate());
     }
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, int64_t capture_time) {
+    auto task = audio_task_pool_.Acquire();
     task->type = type;
-    task->pcm = std::move(pcm);
-    
-    /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    task->stamps.capture = capture_time;
+    task->stamps.processed = esp_timer_get_time();
+    /* Swap rather than move, the producer gets the recycled buffer of the task back for its next frame */
+    task->pcm.swap(pcm);
 
     /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        if (!timestamp_queue_.empty()) {
+            if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
+                task->timestamp = timestamp_queue_.front();
+            } else {
+                ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+            }
+            timestamp_queue_.pop_front();
         }
-        timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
+    /* Push the task to the encode queue, wait for the opus codec task if it is full */
+    std::lock_guard<std::mutex> lock(encode_producer_mutex_);
+    while (true) {
+        xEventGroupClearBits(event_group_, AS_EVENT_ENCODE_QUEUE_AVAILABLE);
+        if (service_stopped_ || audio_encode_queue_.Push(std::move(task))) {
+            break;
+        }
+        xEventGroupWaitBits(event_group_, AS_EVENT_ENCODE_QUEUE_AVAILABLE, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+    NotifyTask(opus_encode_task_handle_);
 }
 
-bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
+bool AudioService::PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait) {
+    std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+    /* Only packets from the network are traced, local sounds are pushed in bursts */
+    if (packet->sequence != 0) {
+        packet->stamps.received = esp_timer_get_time();
+    }
+    jitter_buffer_.OnArrival(packet->sequence, packet->frame_duration);
+    if (packet->frame_duration > 0 && packet->frame_duration != decode_frame_duration_) {
+        decode_frame_duration_ = packet->frame_duration;
+        audio_decode_queue_.SetLimit(MAX_DECODE_PACKETS_IN_QUEUE(decode_frame_duration_));
+    }
+    while (true) {
+        xEventGroupClearBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE);
+        if (audio_decode_queue_.Push(std::move(packet))) {
+            break;
+        }
+        if (!wait || service_stopped_) {
             return false;
         }
+        xEventGroupWaitBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE, pdFALSE, pdFALSE, portMAX_DELAY);
     }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
+    NotifyTask(opus_decode_task_handle_);
     return true;
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
-        return nullptr;
+bool AudioService::PushPcmToPlaybackQueue(std::vector<int16_t>&& pcm, int sample_rate, int64_t position_us, bool wait) {
+    auto task = audio_task_pool_.Acquire();
+    task->type = kAudioTaskTypePcmToPlaybackQueue;
+    task->sample_rate = sample_rate;
+    task->position_us = position_us;
+    /* Swap rather than move, the source gets the recycled buffer of the task back for its next frame */
+    task->pcm.swap(pcm);
+    pcm_streaming_ = true;
+
+    while (true) {
+        xEventGroupClearBits(event_group_, AS_EVENT_PCM_QUEUE_AVAILABLE);
+        if (audio_pcm_queue_.Push(std::move(task))) {
+            break;
+        }
+        if (!wait || service_stopped_) {
+            std::lock_guard<std::mutex> lock(timing_mutex_);
+            pcm_stats_.dropped++;
+            return false;
+        }
+        xEventGroupWaitBits(event_group_, AS_EVENT_PCM_QUEUE_AVAILABLE, pdFALSE, pdFALSE, portMAX_DELAY);
+    }
+    NotifyTask(audio_output_task_handle_);
+
+    uint32_t queued = audio_pcm_queue_.Size();
+    std::lock_guard<std::mutex> lock(timing_mutex_);
+    pcm_stats_.peak_queued = std::max(pcm_stats_.peak_queued, queued);
+    return true;
+}
+
+void AudioService::EndPcmStream(bool flush) {
+    pcm_streaming_ = false;
+    if (flush) {
+        audio_pcm_queue_.Clear();
+        mixer_.Clear(kAudioMixerSourceMusic);
+        /* The output task drops the stamps of the flushed frames, the clock stops right away */
+        pcm_clock_reset_ = true;
+        std::lock_guard<std::mutex> lock(pcm_clock_mutex_);
+        pcm_clock_.valid = false;
+    }
+    /* Let the output task drop the flushed frames and restore the output sample rate */
+    NotifyTask(audio_output_task_handle_);
+}
+
+AudioStreamPacketPtr AudioService::PopPacketFromSendQueue() {
+    AudioStreamPacketPtr packet;
+    bool made_room = false;
+    audio_send_queue_.Pop(packet, made_room);
+    /* The opus encode task stops encoding while the send queue is full */
+    if (made_room) {
+        NotifyTask(opus_encode_task_handle_);
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
     return packet;
 }
 
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
-        wake_word_->EncodeWakeWordData();
+        /* The channel may still change the duration, the packets keep the one they were encoded with */
+        wake_word_frame_duration_ = uplink_frame_duration_;
+        wake_word_->EncodeWakeWordData(wake_word_frame_duration_);
     }
 }
 
@@ -460,8 +841,10 @@ const std::string& AudioService::GetLastWakeWord() const {
     return wake_word_->GetLastDetectedWakeWord();
 }
 
-std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
+AudioStreamPacketPtr AudioService::PopWakeWordPacket() {
+    auto packet = AudioStreamPacket::Create();
+    packet->sample_rate = 16000;
+    packet->frame_duration = wake_word_frame_duration_;
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
@@ -494,12 +877,18 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+            audio_processor_->Initialize(codec_, uplink_frame_duration_);
+            processor_frame_duration_ = uplink_frame_duration_;
             audio_processor_initialized_ = true;
+        } else if (processor_frame_duration_ != uplink_frame_duration_) {
+            /* The processor is stopped here, so its output frame size can be changed safely */
+            audio_processor_->SetFrameDuration(uplink_frame_duration_);
+            processor_frame_duration_ = uplink_frame_duration_;
         }
 
         /* We should make sure no audio is playing */
         ResetDecoder();
+        ResetCaptureStamps();
         audio_input_need_warmup_ = true;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
@@ -515,23 +904,36 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        /* The opus decode task plays back audio_testing_queue_ in place of audio_decode_queue_ */
+        audio_decode_queue_.Clear();
+        NotifyTask(opus_decode_task_handle_);
     }
 }
 
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
     if (!audio_processor_initialized_) {
-        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+        audio_processor_->Initialize(codec_, uplink_frame_duration_);
+        processor_frame_duration_ = uplink_frame_duration_;
         audio_processor_initialized_ = true;
     }
 
     audio_processor_->EnableDeviceAec(enable);
 }
 
+void AudioService::SetUplinkFrameDuration(int frame_duration_ms) {
+    if (!Protocol::IsValidFrameDuration(frame_duration_ms)) {
+        ESP_LOGW(TAG, "Invalid uplink frame duration: %d ms", frame_duration_ms);
+        return;
+    }
+    if (frame_duration_ms != uplink_frame_duration_) {
+        ESP_LOGI(TAG, "Uplink frame duration: %d ms", frame_duration_ms);
+    }
+    uplink_frame_duration_ = frame_duration_ms;
+    audio_send_queue_.SetLimit(MAX_SEND_PACKETS_IN_QUEUE(frame_duration_ms));
+    audio_testing_queue_.SetLimit(AUDIO_TESTING_MAX_DURATION_MS / frame_duration_ms);
+}
+
 void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
@@ -544,7 +946,7 @@ void AudioService::PlaySound(const std::string_view& sound) {
         p += sizeof(BinaryProtocol3);
 
         auto payload_size = ntohs(p3->payload_size);
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AudioStreamPacket::Create();
         packet->sample_rate = 16000;
         packet->frame_duration = 60;
         packet->payload.resize(payload_size);
@@ -556,18 +958,23 @@ void AudioService::PlaySound(const std::string_view& sound) {
 }
 
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.Empty() && audio_decode_queue_.Empty() && jitter_buffer_.Empty() &&
+        audio_playback_queue_.Empty() && audio_pcm_queue_.Empty() && audio_testing_queue_.Empty();
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
     opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        timestamp_queue_.clear();
+    }
+    audio_decode_queue_.Clear();
+    jitter_buffer_.Reset();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    mixer_.Clear(kAudioMixerSourceVoice);
+    NotifyTask(opus_decode_task_handle_);
+    NotifyTask(audio_output_task_handle_);
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -587,4 +994,103 @@ void AudioService::CheckAndUpdateAudioPowerState() {
 
 void AudioService::UpdateOutputTimestamp() {
     last_output_time_ = std::chrono::steady_clock::now();
-}
\ No newline at end of file
+}
+void AudioService::PrintStats() {
+    FrameTimingStats encode_timing, decode_timing;
+    PcmPlaybackStats pcm;
+    {
+        std::lock_guard<std::mutex> lock(timing_mutex_);
+        encode_timing = encode_timing_;
+        decode_timing = decode_timing_;
+        pcm = pcm_stats_;
+        encode_timing_ = FrameTimingStats();
+        decode_timing_ = FrameTimingStats();
+        pcm_stats_ = PcmPlaybackStats();
+    }
+    auto print_timing = [](const char* name, const FrameTimingStats& stats) {
+        if (stats.frames > 0) {
+            ESP_LOGI(TAG, "%s: frames=%lu avg=%luus min=%luus max=%luus", name,
+                stats.frames, stats.total_us / stats.frames, stats.min_us, stats.max_us);
+        }
+    };
+    print_timing("Opus encode", encode_timing);
+    print_timing("Opus decode", decode_timing);
+
+    auto jitter = jitter_buffer_.GetStats();
+    uint32_t played = jitter.frames + jitter.concealed;
+    ESP_LOGI(TAG, "Jitter buffer: jitter=%lums target=%lu frames, concealed=%lu/%lu (%lu%%), late=%lu skipped=%lu underruns=%lu avg_delay=%lums",
+        jitter.jitter_ms, jitter.target_frames, jitter.concealed, played, played ? jitter.concealed * 100 / played : 0,
+        jitter.late, jitter.skipped, jitter.underruns, jitter.frames ? jitter.total_delay_ms / jitter.frames : 0);
+
+    if (pcm.frames > 0 || pcm.dropped > 0) {
+        ESP_LOGI(TAG, "PCM playback: frames=%lu underruns=%lu dropped=%lu peak_queued=%lu/%u",
+            pcm.frames, pcm.underruns, pcm.dropped, pcm.peak_queued, audio_pcm_queue_.limit());
+    }
+
+    auto mixer = mixer_.GetStats();
+    if (mixer.frames > 0) {
+        ESP_LOGI(TAG, "Mixer: frames=%lu ducked=%lu avg=%luus max=%luus",
+            mixer.frames, mixer.ducked_frames, mixer.total_us / mixer.frames, mixer.max_us);
+    }
+
+    auto encoder = encoder_policy_.GetStats();
+    auto params = encoder_policy_.GetParams();
+    ESP_LOGI(TAG, "Opus encoder: bitrate=%dbps dtx=%d fec=%d loss=%d%%, sent frames=%lu bytes=%lu dtx_frames=%lu bitrate_changes=%lu",
+        params.bitrate, params.dtx, params.fec, params.packet_loss_percent,
+        encoder.frames, encoder.bytes, encoder.dtx_frames, encoder.bitrate_changes);
+
+    auto packets = AudioStreamPacket::Pool().GetStats();
+    auto tasks = audio_task_pool_.GetStats();
+    ESP_LOGI(TAG, "Packet pool: acquired=%lu created=%lu fallbacks=%lu trimmed=%lu in_use=%lu peak=%lu",
+        packets.acquired, packets.created, packets.fallbacks, packets.trimmed, packets.in_use, packets.peak_in_use);
+    ESP_LOGI(TAG, "Task pool: acquired=%lu created=%lu fallbacks=%lu trimmed=%lu in_use=%lu peak=%lu",
+        tasks.acquired, tasks.created, tasks.fallbacks, tasks.trimmed, tasks.in_use, tasks.peak_in_use);
+
+    latency_tracer_.PrintStats();
+}
+
+void AudioService::RecordPacketSent(const AudioLatencyStamps& stamps) {
+    int64_t sent_time = esp_timer_get_time();
+    latency_tracer_.Record(kAudioLatencyEncodedToSent, stamps.encoded, sent_time);
+    latency_tracer_.Record(kAudioLatencyCaptureToSent, stamps.capture, sent_time);
+}
+
+std::string AudioService::GetStatsJson() {
+    return latency_tracer_.GetJson();
+}
+
+void AudioService::PushCaptureStamp(size_t samples, int64_t time) {
+    std::lock_guard<std::mutex> lock(capture_stamps_mutex_);
+    processor_input_samples_ += samples;
+    if (capture_stamps_count_ == AUDIO_CAPTURE_STAMP_SLOTS) {
+        /* The processor is far behind, forget the oldest frame */
+        capture_stamps_head_ = (capture_stamps_head_ + 1) % AUDIO_CAPTURE_STAMP_SLOTS;
+        capture_stamps_count_--;
+    }
+    size_t index = (capture_stamps_head_ + capture_stamps_count_) % AUDIO_CAPTURE_STAMP_SLOTS;
+    capture_stamps_[index] = { processor_input_samples_, time };
+    capture_stamps_count_++;
+}
+
+int64_t AudioService::PopCaptureStamp(size_t samples) {
+    std::lock_guard<std::mutex> lock(capture_stamps_mutex_);
+    processor_output_samples_ += samples;
+    /* The last output sample was captured with the first frame that ends at or after it */
+    while (capture_stamps_count_ > 0) {
+        auto& stamp = capture_stamps_[capture_stamps_head_];
+        if (stamp.end_sample >= processor_output_samples_) {
+            return stamp.time;
+        }
+        capture_stamps_head_ = (capture_stamps_head_ + 1) % AUDIO_CAPTURE_STAMP_SLOTS;
+        capture_stamps_count_--;
+    }
+    return 0;
+}
+
+void AudioService::ResetCaptureStamps() {
+    std::lock_guard<std::mutex> lock(capture_stamps_mutex_);
+    capture_stamps_head_ = 0;
+    capture_stamps_count_ = 0;
+    processor_input_samples_ = 0;
+    processor_output_samples_ = 0;
+}
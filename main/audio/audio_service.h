@@ -3,9 +3,9 @@
 
 #include <memory>
 #include <deque>
-#include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -21,26 +21,76 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "spsc_queue.h"
+#include "object_pool.h"
+#include "jitter_buffer.h"
+#include "uplink_opus_encoder.h"
+#include "audio_latency.h"
+#include "pcm_resampler.h"
+#include "audio_mixer.h"
+#include "audio_tap.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Jitter Buffer] -> [Opus Decoder] -> {Playback Queue} -> [Mixer] -> (Speaker)
+ * 3. (Music decoder) -> {PCM Queue} -> [Resampler] -> [Mixer] -> (Speaker)
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * The mixer ducks the music while the decoded audio (TTS, sound cues) is playing. PCM frames may
+ * carry the media position of their first sample, from which the output task keeps a playback clock
+ * of the PCM source: the position of the sample reaching the speaker, behind the I2S DMA buffers.
+ *
+ * We use one task for MIC / Speaker / Processors, and one task each for Opus Encoder and Opus Decoder,
+ * so a slow frame on one direction does not delay the other.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
- * 
+ *
+ * Every queue is a lock-free SPSC ring. A task waiting for data is woken by a task notification
+ * from the producer of its queue only, and a producer waiting for space is woken by an event bit
+ * set from the consumer when the queue was full.
+ *
+ * Packets and tasks are recycled through object pools, so the steady state does not touch the heap.
  */
 
-#define OPUS_FRAME_DURATION_MS 60
+/*
+ * The uplink frame duration is negotiated at runtime (see Protocol::uplink_frame_duration), and the
+ * decode queue follows the frame duration of the received packets. The rings are allocated for the
+ * shortest frames, their limit is derived from the current frame duration.
+ */
 #define MAX_ENCODE_TASKS_IN_QUEUE 2
 #define MAX_PLAYBACK_TASKS_IN_QUEUE 2
-#define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+// Decoded PCM frames from a local source (music), about 200 ms of 1152-sample MP3 frames at 44.1 kHz
+#define MAX_PCM_TASKS_IN_QUEUE 8
+#define MAX_DECODE_PACKETS_IN_QUEUE(frame_duration_ms) (2400 / (frame_duration_ms))
+#define MAX_SEND_PACKETS_IN_QUEUE(frame_duration_ms) (2400 / (frame_duration_ms))
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + MAX_PCM_TASKS_IN_QUEUE + 4)
+#define AUDIO_TASK_MAX_PCM_SAMPLES 4096
+// Capture times of the frames inside the audio processor, which buffers more than one frame
+#define AUDIO_CAPTURE_STAMP_SLOTS 16
+// Played samples kept for visualizers, readers get windows of up to half of it
+#define AUDIO_OUTPUT_TAP_SAMPLES 4096
+
+#ifdef CONFIG_OPUS_ENCODE_TASK_PRIORITY
+#define OPUS_ENCODE_TASK_PRIORITY CONFIG_OPUS_ENCODE_TASK_PRIORITY
+#define OPUS_DECODE_TASK_PRIORITY CONFIG_OPUS_DECODE_TASK_PRIORITY
+#else
+#define OPUS_ENCODE_TASK_PRIORITY 2
+#define OPUS_DECODE_TASK_PRIORITY 2
+#endif
+// A negative core from Kconfig means the task is not pinned
+#if defined(CONFIG_OPUS_ENCODE_TASK_CORE) && CONFIG_OPUS_ENCODE_TASK_CORE >= 0
+#define OPUS_ENCODE_TASK_CORE CONFIG_OPUS_ENCODE_TASK_CORE
+#else
+#define OPUS_ENCODE_TASK_CORE tskNO_AFFINITY
+#endif
+#if defined(CONFIG_OPUS_DECODE_TASK_CORE) && CONFIG_OPUS_DECODE_TASK_CORE >= 0
+#define OPUS_DECODE_TASK_CORE CONFIG_OPUS_DECODE_TASK_CORE
+#else
+#define OPUS_DECODE_TASK_CORE tskNO_AFFINITY
+#endif
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -50,6 +100,9 @@
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
+#define AS_EVENT_ENCODE_QUEUE_AVAILABLE     (1 << 4)
+#define AS_EVENT_DECODE_QUEUE_AVAILABLE     (1 << 5)
+#define AS_EVENT_PCM_QUEUE_AVAILABLE        (1 << 6)
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
@@ -63,19 +116,56 @@ enum AudioTaskType {
     kAudioTaskTypeEncodeToSendQueue,
     kAudioTaskTypeEncodeToTestingQueue,
     kAudioTaskTypeDecodeToPlaybackQueue,
+    kAudioTaskTypePcmToPlaybackQueue,
 };
 
 struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    int sample_rate;        // PCM source tasks only, the decoded tasks are already at the codec rate
+    int64_t position_us;    // PCM source tasks only, media position of the first sample, -1 if not known
+    AudioLatencyStamps stamps;
 };
 
+using AudioTaskPtr = ObjectPool<AudioTask>::Ptr;
+
 struct DebugStatistics {
     uint32_t input_count = 0;
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    uint32_t encode_wakeups = 0;
+    uint32_t encode_spurious_wakeups = 0;
+    uint32_t decode_wakeups = 0;
+    uint32_t decode_spurious_wakeups = 0;
+    uint32_t audio_output_wakeups = 0;
+    uint32_t audio_output_spurious_wakeups = 0;
+};
+
+// Time spent per Opus frame, collected between two PrintStats() calls
+struct FrameTimingStats {
+    uint32_t frames = 0;
+    uint32_t total_us = 0;
+    uint32_t min_us = 0;
+    uint32_t max_us = 0;
+};
+
+// Published by the audio output task after every frame written with PCM source samples in it
+struct PcmPlaybackClock {
+    bool valid = false;
+    int64_t position_us = 0;        // Media position of the first PCM source sample of the frame
+    int64_t end_us = 0;             // Media position after the last PCM source sample of the frame
+    int64_t written_time_us = 0;    // When the frame was written to the codec
+    int64_t latency_us = 0;         // Audio queued in the DMA ahead of the frame at that time
+};
+
+// PCM source playback, collected between two PrintStats() calls
+struct PcmPlaybackStats {
+    uint32_t frames = 0;
+    uint32_t underruns = 0;         // PCM queue ran empty while the source was still streaming
+    uint32_t dropped = 0;           // Frames refused because the queue was full and the source did not wait
+    uint32_t peak_queued = 0;
 };
 
 class AudioService {
@@ -87,9 +177,11 @@ public:
     void Start();
     void Stop();
     void EncodeWakeWord();
-    std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
+    AudioStreamPacketPtr PopWakeWordPacket();
     const std::string& GetLastWakeWord() const;
     bool IsVoiceDetected() const { return voice_detected_; }
+    int uplink_frame_duration() const { return uplink_frame_duration_; }
+    OpusEncoderParams GetEncoderParams() { return encoder_policy_.GetParams(); }
     bool IsIdle();
     bool IsWakeWordRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING; }
     bool IsAudioProcessorRunning() const { return xEventGroupGetBits(event_group_) & AS_EVENT_AUDIO_PROCESSOR_RUNNING; }
@@ -98,16 +190,41 @@ public:
     void EnableVoiceProcessing(bool enable);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    void SetUplinkFrameDuration(int frame_duration_ms);
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
-    bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
-    std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    bool PushPacketToDecodeQueue(AudioStreamPacketPtr packet, bool wait = false);
+    /*
+     * Queues a decoded mono PCM frame from a local source for playback. The frame is swapped with
+     * the recycled buffer of a pooled task, so the caller gets a buffer with capacity back.
+     * Frames at a different sample rate than the codec are resampled by the output task.
+     * position_us is the media position of the first sample, which drives GetPcmPlaybackPosition().
+     */
+    bool PushPcmToPlaybackQueue(std::vector<int16_t>&& pcm, int sample_rate, int64_t position_us = -1, bool wait = true);
+    // The PCM source stopped streaming: the queued frames are played out, or dropped if flush is set
+    void EndPcmStream(bool flush);
+    /*
+     * Media position of the PCM source sample reaching the speaker now, in microseconds. It advances
+     * with the system clock between the frames and stops at the last sample written, so it can be
+     * read at any time. Returns -1 until a frame with a position was played after the last flush.
+     */
+    int64_t GetPcmPlaybackPosition();
+    // Latest mixed output at the codec sample rate, readable from any task without blocking playback
+    AudioTap& GetOutputTap() { return output_tap_; }
+    // Volume (0-100) of a playback source in the mixer, on top of the codec output volume
+    void SetMixerVolume(AudioMixerSource source, int volume) { mixer_.SetVolume(source, volume); }
+    AudioStreamPacketPtr PopPacketFromSendQueue();
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     
     void UpdateOutputTimestamp();
+    void PrintStats();
+    // Called by the application once a packet from the send queue went out
+    void RecordPacketSent(const AudioLatencyStamps& stamps);
+    std::string GetStatsJson();
+    ObjectPool<AudioTask>::Stats GetTaskPoolStats() { return audio_task_pool_.GetStats(); }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -115,11 +232,25 @@ private:
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
+    std::unique_ptr<UplinkOpusEncoder> opus_encoder_;
+    OpusEncoderPolicy encoder_policy_;
     std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    PcmResampler output_resampler_;
+    std::vector<int16_t> resample_buffer_;
+    // Capture scratch buffers of ReadAudioData(), they keep their capacity from frame to frame
+    std::vector<int16_t> capture_buffer_;
+    std::vector<int16_t> capture_mic_;
+    std::vector<int16_t> capture_reference_;
+    std::vector<int16_t> resampled_mic_;
+    std::vector<int16_t> resampled_reference_;
+    // Frame of the audio input task, handed to the encode queue and swapped for a recycled buffer
+    std::vector<int16_t> input_frame_;
+    // Owned by the opus decode task
+    JitterBuffer jitter_buffer_;
+    std::vector<int16_t> last_decoded_pcm_;
+    int concealed_frames_ = 0;
     DebugStatistics debug_statistics_;
 
     EventGroupHandle_t event_group_;
@@ -127,22 +258,69 @@ private:
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    ObjectPool<AudioTask> audio_task_pool_;
+    SpscQueue<AudioStreamPacketPtr> audio_decode_queue_;
+    SpscQueue<AudioStreamPacketPtr> audio_send_queue_;
+    SpscQueue<AudioStreamPacketPtr> audio_testing_queue_;
+    SpscQueue<AudioTaskPtr> audio_encode_queue_;
+    SpscQueue<AudioTaskPtr> audio_playback_queue_;
+    SpscQueue<AudioTaskPtr> audio_pcm_queue_;
+    // The decode and encode queues have more than one producer task, so producers take turns
+    std::mutex decode_producer_mutex_;
+    std::mutex encode_producer_mutex_;
     // For server AEC
+    std::mutex timestamp_mutex_;
     std::deque<uint32_t> timestamp_queue_;
 
+    std::mutex timing_mutex_;
+    FrameTimingStats encode_timing_;
+    FrameTimingStats decode_timing_;
+    PcmPlaybackStats pcm_stats_;
+    AudioLatencyTracer latency_tracer_;
+
+    // Maps the audio processor output back to the capture time of its samples
+    struct CaptureStamp {
+        uint64_t end_sample;
+        int64_t time;
+    };
+    std::mutex capture_stamps_mutex_;
+    CaptureStamp capture_stamps_[AUDIO_CAPTURE_STAMP_SLOTS];
+    size_t capture_stamps_head_ = 0;
+    size_t capture_stamps_count_ = 0;
+    uint64_t processor_input_samples_ = 0;
+    uint64_t processor_output_samples_ = 0;
+
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
     bool service_stopped_ = true;
     bool audio_input_need_warmup_ = false;
+    std::atomic<int> uplink_frame_duration_ = DEFAULT_OPUS_FRAME_DURATION_MS;
+    int processor_frame_duration_ = 0;
+    int wake_word_frame_duration_ = DEFAULT_OPUS_FRAME_DURATION_MS;
+    int decode_frame_duration_ = 0;
+    std::atomic<bool> pcm_streaming_ = false;
+    // Owned by the audio output task
+    PcmResampler pcm_resampler_;
+    std::vector<int16_t> pcm_resample_buffer_;
+    AudioMixer mixer_;
+    std::vector<int16_t> output_frame_;
+    AudioTap output_tap_;
+    // Owned by the audio output task: media positions of the PCM source samples appended to the mixer
+    struct PcmStamp {
+        uint64_t sample;
+        int64_t position_us;
+    };
+    std::deque<PcmStamp> pcm_stamps_;
+    uint64_t pcm_appended_samples_ = 0;
+    uint64_t pcm_mixed_samples_ = 0;
+    int64_t output_queued_us_ = 0;       // Audio in the DMA right after the last write
+    int64_t output_written_time_us_ = 0;
+    std::atomic<bool> pcm_clock_reset_ = false;
+    std::mutex pcm_clock_mutex_;
+    PcmPlaybackClock pcm_clock_;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
     std::chrono::steady_clock::time_point last_input_time_;
@@ -150,8 +328,20 @@ private:
 
     void AudioInputTask();
     void AudioOutputTask();
-    void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void OpusEncodeTask();
+    void OpusDecodeTask();
+    bool ConcealFrame(std::vector<int16_t>& pcm);
+    std::vector<int16_t>& ConvertPcmSampleRate(AudioTask& task);
+    void ResetPcmClock();
+    void UpdatePcmClock(size_t pcm_samples, size_t frame_samples);
+    void RecordVoicePlayed(const AudioLatencyStamps& stamps, uint32_t timestamp);
+    void RecordFrameTiming(FrameTimingStats& stats, int64_t start_time);
+    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm, int64_t capture_time = 0);
+    void PushCaptureStamp(size_t samples, int64_t time);
+    int64_t PopCaptureStamp(size_t samples);
+    void ResetCaptureStamps();
+    bool PopPacketToDecode(AudioStreamPacketPtr& packet);
+    void NotifyTask(TaskHandle_t task);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
 };
@@ -0,0 +1,130 @@
+#include "audio_tap.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "AudioTap"
+
+
+AudioTap::AudioTap(size_t capacity) {
+    capacity_ = 1;
+    while (capacity_ < capacity) {
+        capacity_ <<= 1;
+    }
+    mask_ = capacity_ - 1;
+    buffer_ = (int16_t*)heap_caps_calloc_prefer(capacity_, sizeof(int16_t), 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u samples", capacity_);
+        capacity_ = 0;
+        mask_ = 0;
+    }
+}
+
+AudioTap::~AudioTap() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+void AudioTap::Write(const int16_t* samples, size_t count) {
+    if (buffer_ == nullptr) {
+        return;
+    }
+    uint64_t start = end_.load(std::memory_order_relaxed);
+    if (count > capacity_) {
+        /* Only the tail of an oversized block stays in the ring */
+        start += count - capacity_;
+        samples += count - capacity_;
+        count = capacity_;
+    }
+    /* Readers that see any of the new samples also see the announcement */
+    reserved_.store(start + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    size_t index = start & mask_;
+    size_t first = std::min(count, capacity_ - index);
+    memcpy(buffer_ + index, samples, first * sizeof(int16_t));
+    memcpy(buffer_, samples + first, (count - first) * sizeof(int16_t));
+    end_.store(start + count, std::memory_order_release);
+    write_time_us_.store(esp_timer_get_time(), std::memory_order_relaxed);
+
+    /* Seq_cst against RemoveListener(): either we see the slot cleared or it waits for us */
+    notifying_.store(true);
+    for (auto& listener : listeners_) {
+        TaskHandle_t task = listener.task.load();
+        if (task != nullptr && start + count >= listener.next.load(std::memory_order_relaxed)) {
+            listener.next.store(start + count + listener.interval.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            xTaskNotifyGive(task);
+        }
+    }
+    notifying_.store(false);
+}
+
+bool AudioTap::AddListener(TaskHandle_t task, size_t interval) {
+    for (auto& listener : listeners_) {
+        TaskHandle_t expected = nullptr;
+        if (listener.task.compare_exchange_strong(expected, task)) {
+            /* A Write() in between may use the values of the previous listener, one early or late wake-up at worst */
+            listener.interval.store(interval, std::memory_order_relaxed);
+            listener.next.store(0, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    ESP_LOGW(TAG, "No free listener slot");
+    return false;
+}
+
+void AudioTap::RemoveListener(TaskHandle_t task) {
+    for (auto& listener : listeners_) {
+        TaskHandle_t expected = task;
+        listener.task.compare_exchange_strong(expected, nullptr);
+    }
+    while (notifying_.load()) {
+        vTaskDelay(1);
+    }
+}
+
+bool AudioTap::Read(int16_t* out, size_t samples, int decimation, uint64_t* end_position) const {
+    if (decimation < 1) {
+        decimation = 1;
+    }
+    size_t needed = samples * decimation;
+    /* The writer adds a frame at a time, half the ring leaves it room to write while we copy */
+    if (buffer_ == nullptr || needed == 0 || needed > capacity_ / 2) {
+        return false;
+    }
+    uint64_t end = end_.load(std::memory_order_acquire);
+    if (end < needed) {
+        return false;
+    }
+    uint64_t begin = end - needed;
+
+    size_t index = begin & mask_;
+    if (decimation == 1) {
+        size_t first = std::min(needed, capacity_ - index);
+        memcpy(out, buffer_ + index, first * sizeof(int16_t));
+        memcpy(out + first, buffer_, (needed - first) * sizeof(int16_t));
+    } else {
+        for (size_t i = 0; i < samples; i++) {
+            int32_t sum = 0;
+            for (int j = 0; j < decimation; j++) {
+                sum += buffer_[index];
+                index = (index + 1) & mask_;
+            }
+            out[i] = sum / decimation;
+        }
+    }
+
+    /* Samples of the window that were overwritten during the copy make it useless */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (reserved_.load(std::memory_order_relaxed) - begin > capacity_) {
+        return false;
+    }
+    if (end_position != nullptr) {
+        *end_position = end;
+    }
+    return true;
+}
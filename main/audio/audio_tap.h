@@ -0,0 +1,83 @@
+#ifndef AUDIO_TAP_H
+#define AUDIO_TAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/*
+ * Lock-free single-writer / multi-reader ring of the mono PCM played by the speaker, for
+ * visualizers such as a spectrum analyzer, a VU meter or a mouth animation.
+ *
+ * The output task writes every mixed frame, so readers see music, TTS and sound cues alike.
+ * The writer never waits: it announces the samples it is about to overwrite, copies the frame
+ * and publishes the new end. A reader copies the window it wants and then checks whether the
+ * writer announced an overwrite of that window meanwhile, in which case the copy is discarded
+ * (seqlock style). Readers do not touch any shared state, so any number of tasks can read.
+ *
+ * Positions are free running sample counters. A reader compares the end position of its last
+ * read with position() to find out whether anything new was played.
+ *
+ * Instead of polling, a task can register as a listener: it gets a task notification whenever
+ * at least interval new samples were played since its previous one, and sleeps while nothing
+ * is played at all.
+ */
+class AudioTap {
+public:
+    // capacity is rounded up to a power of two
+    explicit AudioTap(size_t capacity);
+    ~AudioTap();
+
+    AudioTap(const AudioTap&) = delete;
+    AudioTap& operator=(const AudioTap&) = delete;
+
+    // Writer side, only called by the audio output task
+    void Write(const int16_t* samples, size_t count);
+    void SetSampleRate(int sample_rate) { sample_rate_ = sample_rate; }
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline size_t capacity() const { return capacity_; }
+    // Position after the last sample written
+    inline uint64_t position() const { return end_.load(std::memory_order_acquire); }
+    // esp_timer time of the last Write(), 0 before the first one
+    inline int64_t write_time_us() const { return write_time_us_.load(std::memory_order_relaxed); }
+
+    /*
+     * Notifies task (xTaskNotifyGive) once interval samples were written since its previous
+     * notification, the first Write() after registering notifies right away. Returns false if
+     * all AUDIO_TAP_MAX_LISTENERS slots are taken.
+     */
+    bool AddListener(TaskHandle_t task, size_t interval);
+    // After it returns the writer does not touch task anymore, so the task may be deleted
+    void RemoveListener(TaskHandle_t task);
+
+    /*
+     * Copies the latest samples * decimation played samples into out, each output sample the
+     * average of decimation consecutive ones. Returns false if fewer samples were played so far,
+     * if the window does not fit into half the ring, or if the writer overtook the copy.
+     * end_position, if given, receives the position after the last sample read.
+     */
+    bool Read(int16_t* out, size_t samples, int decimation = 1, uint64_t* end_position = nullptr) const;
+
+private:
+    static constexpr int AUDIO_TAP_MAX_LISTENERS = 4;
+    struct Listener {
+        std::atomic<TaskHandle_t> task = nullptr;
+        std::atomic<uint32_t> interval = 0;
+        std::atomic<uint64_t> next = 0;     // Position that triggers the next notification
+    };
+
+    int16_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    std::atomic<int> sample_rate_ = 0;
+    std::atomic<uint64_t> end_ = 0;         // Published end of the written samples
+    std::atomic<uint64_t> reserved_ = 0;    // End of the samples being written, ahead of end_ during a Write()
+    std::atomic<int64_t> write_time_us_ = 0;
+    Listener listeners_[AUDIO_TAP_MAX_LISTENERS];
+    std::atomic<bool> notifying_ = false;   // Set while the writer walks the listeners
+};
+
+#endif // AUDIO_TAP_H
@@ -1,8 +1,10 @@
 #include "no_audio_codec.h"
 
 #include <esp_log.h>
-#include <cmath>
 #include <cstring>
+#include <algorithm>
+
+#include "pcm_kernels.h"
 
 #define TAG "NoAudioCodec"
 
@@ -279,42 +281,43 @@ NoAudioCodecSimplexPdm::NoAudioCodecSimplexPdm(int input_sample_rate, int output
 }
 
 int NoAudioCodec::Write(const int16_t* data, int samples) {
-    std::vector<int32_t> buffer(samples);
-
-    // output_volume_: 0-100
-    // volume_factor_: 0-65536
-    int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-    for (int i = 0; i < samples; i++) {
-        int64_t temp = int64_t(data[i]) * volume_factor; // 使用 int64_t 进行乘法运算
-        if (temp > INT32_MAX) {
-            buffer[i] = INT32_MAX;
-        } else if (temp < INT32_MIN) {
-            buffer[i] = INT32_MIN;
-        } else {
-            buffer[i] = static_cast<int32_t>(temp);
-        }
+    int32_t* buffer = tx_scratch_.data();
+    if (buffer == nullptr) {
+        return 0;
     }
 
-    size_t bytes_written;
-    ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * sizeof(int32_t), &bytes_written, portMAX_DELAY));
-    return bytes_written / sizeof(int32_t);
+    // The samples are widened to 32 bits with the volume applied, one scratch buffer at a time
+    int written = 0;
+    while (written < samples) {
+        int chunk = std::min(samples - written, AUDIO_CODEC_SCRATCH_SAMPLES);
+        PcmGainWiden32(data + written, chunk, output_volume_factor_, buffer);
+
+        size_t bytes_written;
+        ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer, chunk * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+        written += bytes_written / sizeof(int32_t);
+    }
+    return written;
 }
 
 int NoAudioCodec::Read(int16_t* dest, int samples) {
-    size_t bytes_read;
-
-    std::vector<int32_t> bit32_buffer(samples);
-    if (i2s_channel_read(rx_handle_, bit32_buffer.data(), samples * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
-        ESP_LOGE(TAG, "Read Failed!");
+    int32_t* buffer = rx_scratch_.data();
+    if (buffer == nullptr) {
         return 0;
     }
 
-    samples = bytes_read / sizeof(int32_t);
-    for (int i = 0; i < samples; i++) {
-        int32_t value = bit32_buffer[i] >> 12;
-        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+    int read = 0;
+    while (read < samples) {
+        int chunk = std::min(samples - read, AUDIO_CODEC_SCRATCH_SAMPLES);
+        size_t bytes_read;
+        if (i2s_channel_read(rx_handle_, buffer, chunk * sizeof(int32_t), &bytes_read, portMAX_DELAY) != ESP_OK) {
+            ESP_LOGE(TAG, "Read Failed!");
+            return read;
+        }
+        int chunk_read = bytes_read / sizeof(int32_t);
+        PcmNarrow32(buffer, chunk_read, 12, dest + read);
+        read += chunk_read;
     }
-    return samples;
+    return read;
 }
 
 int NoAudioCodecSimplexPdm::Read(int16_t* dest, int samples) {
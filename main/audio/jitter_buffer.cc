@@ -0,0 +1,205 @@
+#include "jitter_buffer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "JitterBuffer"
+
+// Arrival deviations larger than this are pauses between sentences rather than network jitter
+#define JITTER_BUFFER_MAX_DEVIATION_MS JITTER_BUFFER_MAX_TARGET_MS
+
+
+JitterBuffer::JitterBuffer() {
+    entries_.reserve(JITTER_BUFFER_MAX_PACKETS);
+}
+
+void JitterBuffer::OnArrival(uint32_t sequence, int frame_duration_ms) {
+    if (sequence == 0 || frame_duration_ms <= 0) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    int32_t advance = sequence - last_arrival_sequence_;
+    if (!has_last_arrival_ || advance < -JITTER_BUFFER_MAX_PACKETS) {
+        /* First packet, or the sender restarted its sequence */
+        has_last_arrival_ = true;
+    } else if (advance <= 0) {
+        /* Reordered or duplicated packet, it says nothing about the transit time */
+        return;
+    } else {
+        /* Interarrival jitter from RFC 3550: J += (|D| - J) / 16 */
+        int64_t expected = (int64_t)advance * frame_duration_ms * 1000;
+        int64_t deviation = std::llabs((now - last_arrival_time_) - expected);
+        if (deviation < JITTER_BUFFER_MAX_DEVIATION_MS * 1000) {
+            int32_t jitter = jitter_us_;
+            jitter_us_ = jitter + ((int32_t)deviation - jitter) / 16;
+        }
+    }
+    last_arrival_sequence_ = sequence;
+    last_arrival_time_ = now;
+}
+
+void JitterBuffer::Put(AudioStreamPacketPtr packet) {
+    if (reset_requested_) {
+        ApplyReset();
+    }
+    if (packet->frame_duration > 0) {
+        frame_duration_ms_ = packet->frame_duration;
+    }
+
+    if (packet->sequence == 0) {
+        held_packet_ = std::move(packet);
+        has_held_packet_ = true;
+        return;
+    }
+
+    uint32_t sequence = packet->sequence;
+    if (started_ && (int32_t)(sequence - next_sequence_) < 0) {
+        stats_.late++;
+        ESP_LOGD(TAG, "Late packet %lu, expected %lu", sequence, next_sequence_);
+        return;
+    }
+
+    /* Most packets arrive in order, so search the insert position from the back */
+    auto it = entries_.end();
+    while (it != entries_.begin() && (int32_t)((it - 1)->packet->sequence - sequence) >= 0) {
+        if ((it - 1)->packet->sequence == sequence) {
+            stats_.duplicates++;
+            return;
+        }
+        --it;
+    }
+    entries_.insert(it, Entry{std::move(packet), esp_timer_get_time()});
+    buffered_ = entries_.size();
+}
+
+JitterBufferResult JitterBuffer::Get(AudioStreamPacketPtr& packet, int& wait_ms) {
+    if (reset_requested_) {
+        ApplyReset();
+    }
+
+    int64_t now = esp_timer_get_time();
+    int64_t frame_us = (int64_t)frame_duration_ms_ * 1000;
+    wait_ms = -1;
+    if (entries_.empty()) {
+        if (held_packet_) {
+            packet = std::move(held_packet_);
+            has_held_packet_ = false;
+            return kJitterBufferFrame;
+        }
+        if (playing_ && !stalled_) {
+            if (now < next_slot_time_) {
+                /* A packet may still arrive before the slot, look again then */
+                wait_ms = (next_slot_time_ - now) / 1000 + 1;
+            } else {
+                stats_.underruns++;
+                stalled_ = true;
+            }
+        }
+        return kJitterBufferWait;
+    }
+
+    if (stalled_) {
+        /* Build up the depth again, with the jitter that caused the stall. Unless this is a pause
+         * between sentences, the sequence goes on where it stopped */
+        stalled_ = false;
+        playing_ = false;
+        resuming_ = now - next_slot_time_ <= JITTER_BUFFER_MAX_TARGET_MS * 1000;
+    }
+
+    if (!playing_) {
+        /* Build up the target depth first, unless the packets have already waited that long */
+        int target = TargetFrames();
+        int64_t waited = now - entries_.front().arrival_time;
+        if (!held_packet_ && (int)entries_.size() < target && waited < target * frame_us) {
+            wait_ms = (target * frame_us - waited) / 1000 + 1;
+            return kJitterBufferWait;
+        }
+        if (!resuming_) {
+            /* Frames missed while we were not playing are not concealed */
+            uint32_t sequence = entries_.front().packet->sequence;
+            if (started_ && (int32_t)(sequence - next_sequence_) > 0) {
+                stats_.skipped += sequence - next_sequence_;
+            }
+            next_sequence_ = sequence;
+        }
+        resuming_ = false;
+        playing_ = true;
+        started_ = true;
+        next_slot_time_ = now;
+    }
+
+    int32_t gap = entries_.front().packet->sequence - next_sequence_;
+    if (held_packet_ || gap > JITTER_BUFFER_MAX_PACKETS) {
+        stats_.skipped += gap;
+        next_sequence_ = entries_.front().packet->sequence;
+        packet = TakeFront(now);
+        AdvanceSlot(now);
+        return kJitterBufferFrame;
+    }
+
+    if (gap == 0) {
+        packet = TakeFront(now);
+        AdvanceSlot(now);
+        return kJitterBufferFrame;
+    }
+
+    /* The next packet is missing, it has until its slot to arrive */
+    if (now < next_slot_time_) {
+        wait_ms = (next_slot_time_ - now) / 1000 + 1;
+        return kJitterBufferWait;
+    }
+    stats_.concealed++;
+    next_sequence_++;
+    AdvanceSlot(now);
+    return kJitterBufferLost;
+}
+
+AudioStreamPacketPtr JitterBuffer::TakeFront(int64_t now) {
+    auto& entry = entries_.front();
+    auto packet = std::move(entry.packet);
+    stats_.total_delay_ms += (now - entry.arrival_time) / 1000;
+    stats_.frames++;
+    entries_.erase(entries_.begin());
+    buffered_ = entries_.size();
+    next_sequence_++;
+    return packet;
+}
+
+void JitterBuffer::AdvanceSlot(int64_t now) {
+    /* A frame taken after its slot means the speaker is behind the clock, follow the speaker */
+    next_slot_time_ = std::max(next_slot_time_, now) + (int64_t)frame_duration_ms_ * 1000;
+}
+
+int JitterBuffer::TargetFrames() const {
+    /* One frame plus three times the jitter, like most VoIP playout buffers */
+    int frame_us = frame_duration_ms_ * 1000;
+    int target = 1 + (3 * jitter_us_ + frame_us - 1) / frame_us;
+    int max_target = std::max(1, JITTER_BUFFER_MAX_TARGET_MS / frame_duration_ms_);
+    return std::min(target, max_target);
+}
+
+void JitterBuffer::Reset() {
+    reset_requested_ = true;
+}
+
+void JitterBuffer::ApplyReset() {
+    reset_requested_ = false;
+    entries_.clear();
+    buffered_ = 0;
+    held_packet_.reset();
+    has_held_packet_ = false;
+    started_ = false;
+    playing_ = false;
+    stalled_ = false;
+    resuming_ = false;
+}
+
+JitterBufferStats JitterBuffer::GetStats() {
+    JitterBufferStats stats = stats_;
+    stats.jitter_ms = jitter_us_ / 1000;
+    stats.target_frames = TargetFrames();
+    return stats;
+}
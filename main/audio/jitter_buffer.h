@@ -0,0 +1,100 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "protocol.h"
+
+// Enough to hold JITTER_BUFFER_MAX_TARGET_MS of 20 ms frames
+#define JITTER_BUFFER_MAX_PACKETS 24
+// Upper bound of the adaptive playout delay
+#define JITTER_BUFFER_MAX_TARGET_MS 400
+
+enum JitterBufferResult {
+    kJitterBufferFrame,     // A packet is ready to be decoded
+    kJitterBufferLost,      // The next packet is missing and has to be concealed
+    kJitterBufferWait,      // Nothing to play yet, ask again after wait_ms (or on the next packet if -1)
+};
+
+struct JitterBufferStats {
+    uint32_t frames = 0;            // Packets released for decoding
+    uint32_t concealed = 0;         // Missing packets released as lost
+    uint32_t late = 0;              // Packets dropped because their slot was already played
+    uint32_t duplicates = 0;
+    uint32_t skipped = 0;           // Missing packets not worth concealing (long gaps, flushes)
+    uint32_t underruns = 0;         // Playout slots that came due with nothing to play
+    uint32_t total_delay_ms = 0;    // Sum of the time released packets spent in the buffer
+    uint32_t jitter_ms = 0;
+    uint32_t target_frames = 0;
+};
+
+/*
+ * Reorders sequenced packets and releases them at a playout depth adapted to the arrival jitter.
+ *
+ * Playout follows a clock of one slot per frame, started once the target depth is buffered. A
+ * packet that is there is handed out whenever the decoder asks, the playback queue bounds how far
+ * ahead of the speaker that goes; a missing one is given until its slot to arrive and is then
+ * released as lost. A slot that comes due with the buffer empty is an underrun, after which the
+ * depth is built up again. A stall shorter than JITTER_BUFFER_MAX_TARGET_MS keeps the sequence, so
+ * a packet lost meanwhile is still concealed; after a longer pause (between two sentences) playout
+ * starts over from the first packet there.
+ *
+ * OnArrival() is called by the network side for every packet, in arrival order, and updates the
+ * interarrival jitter estimate (RFC 3550). Put() / Get() / Full() belong to the decode task only.
+ * Reset() may be called from any task and is applied by the decode task on its next call.
+ *
+ * Packets without a sequence number (sequence == 0, e.g. local sounds) are not reordered: one of
+ * them is held until the sequenced packets before it are played, skipping any missing one.
+ */
+class JitterBuffer {
+public:
+    JitterBuffer();
+
+    void OnArrival(uint32_t sequence, int frame_duration_ms);
+    void Put(AudioStreamPacketPtr packet);
+    JitterBufferResult Get(AudioStreamPacketPtr& packet, int& wait_ms);
+    void Reset();
+
+    inline bool Full() const { return buffered_ >= JITTER_BUFFER_MAX_PACKETS || has_held_packet_; }
+    inline bool Empty() const { return buffered_ == 0 && !has_held_packet_; }
+    JitterBufferStats GetStats();
+
+private:
+    struct Entry {
+        AudioStreamPacketPtr packet;
+        int64_t arrival_time;
+    };
+
+    // Sorted by sequence, reserved up front so inserting never allocates
+    std::vector<Entry> entries_;
+    AudioStreamPacketPtr held_packet_;
+    std::atomic<bool> has_held_packet_ = false;
+    std::atomic<size_t> buffered_ = 0;
+    std::atomic<bool> reset_requested_ = false;
+
+    bool started_ = false;
+    bool playing_ = false;
+    bool stalled_ = false;          // A slot came due with nothing to play
+    bool resuming_ = false;         // Restarting after a short stall, next_sequence_ is kept
+    uint32_t next_sequence_ = 0;
+    int64_t next_slot_time_ = 0;    // When the speaker needs the frame of next_sequence_
+    int frame_duration_ms_ = 60;
+
+    // Network side
+    bool has_last_arrival_ = false;
+    uint32_t last_arrival_sequence_ = 0;
+    int64_t last_arrival_time_ = 0;
+    std::atomic<int32_t> jitter_us_ = 0;
+
+    JitterBufferStats stats_;
+
+    void ApplyReset();
+    int TargetFrames() const;
+    AudioStreamPacketPtr TakeFront(int64_t now);
+    void AdvanceSlot(int64_t now);
+};
+
+#endif // JITTER_BUFFER_H
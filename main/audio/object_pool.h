@@ -0,0 +1,125 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed-size pool of recycled objects for the audio path.
+ *
+ * All max_size objects are created by the constructor and then only recycled: the Ptr
+ * deleter hands the object back to the free list instead of freeing it, so any storage it
+ * owns (e.g. a payload vector) keeps its capacity for the next frame. That storage is not
+ * reserved up front, it grows on the first use of each object: reserving the bound for every
+ * object would take the worst case of the whole pool from internal RAM at boot, while the
+ * free list is LIFO and in practice only the few objects of the steady-state depth are used.
+ * When the pool is exhausted Acquire() falls back to the heap and counts it, the extra
+ * object is freed again on release.
+ *
+ * The recycle callback resets an object before it goes back to the free list and returns
+ * true if it had to drop storage that grew past its bound.
+ */
+template <typename T>
+class ObjectPool {
+public:
+    struct Stats {
+        uint32_t acquired = 0;      // Total Acquire() calls
+        uint32_t created = 0;       // Objects allocated from the heap, including the preallocated ones
+        uint32_t fallbacks = 0;     // Acquire() calls made while the pool was exhausted
+        uint32_t trimmed = 0;       // Released objects whose storage exceeded its bound
+        uint32_t in_use = 0;
+        uint32_t peak_in_use = 0;
+    };
+
+    class Deleter {
+    public:
+        Deleter() = default;
+        explicit Deleter(ObjectPool* pool) : pool_(pool) {}
+
+        void operator()(T* object) const {
+            if (pool_ != nullptr) {
+                pool_->Release(object);
+            } else {
+                delete object;
+            }
+        }
+
+    private:
+        ObjectPool* pool_ = nullptr;
+    };
+
+    using Ptr = std::unique_ptr<T, Deleter>;
+
+    ObjectPool(size_t max_size, std::function<bool(T&)> recycle)
+        : max_size_(max_size), recycle_(recycle) {
+        free_list_.reserve(max_size);
+        for (size_t i = 0; i < max_size; i++) {
+            free_list_.push_back(new T());
+        }
+        stats_.created = max_size;
+    }
+    ~ObjectPool() {
+        for (auto object : free_list_) {
+            delete object;
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    Ptr Acquire() {
+        T* object = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.acquired++;
+            if (++stats_.in_use > stats_.peak_in_use) {
+                stats_.peak_in_use = stats_.in_use;
+            }
+            if (!free_list_.empty()) {
+                object = free_list_.back();
+                free_list_.pop_back();
+            } else {
+                stats_.created++;
+                stats_.fallbacks++;
+            }
+        }
+        if (object == nullptr) {
+            object = new T();
+        }
+        return Ptr(object, Deleter(this));
+    }
+
+    Stats GetStats() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+    inline size_t max_size() const { return max_size_; }
+
+private:
+    void Release(T* object) {
+        bool trimmed = recycle_ ? recycle_(*object) : false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.in_use--;
+        if (trimmed) {
+            stats_.trimmed++;
+        }
+        if (free_list_.size() < max_size_) {
+            free_list_.push_back(object);
+            return;
+        }
+        delete object;
+    }
+
+    size_t max_size_;
+    std::function<bool(T&)> recycle_;
+    std::mutex mutex_;
+    std::vector<T*> free_list_;
+    Stats stats_;
+};
+
+#endif // OBJECT_POOL_H
@@ -0,0 +1,105 @@
+#include "opus_encoder_policy.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "OpusEncoderPolicy"
+
+// Opus DTX frames only carry the TOC byte (and at most one more)
+#define OPUS_DTX_FRAME_MAX_BYTES 2
+
+
+void OpusEncoderPolicy::OnVoiceDetected(bool speaking) {
+    voice_detected_ = speaking;
+}
+
+void OpusEncoderPolicy::OnReceivedFrame(bool lost) {
+    received_frames_++;
+    if (lost) {
+        lost_frames_++;
+    }
+}
+
+void OpusEncoderPolicy::OnEncodedFrame(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.frames++;
+    stats_.bytes += bytes;
+    if (bytes <= OPUS_DTX_FRAME_MAX_BYTES) {
+        stats_.dtx_frames++;
+    }
+}
+
+bool OpusEncoderPolicy::Update(size_t send_queue_size, size_t send_queue_limit) {
+    OpusEncoderParams params;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        params = params_;
+    }
+    int64_t now_ms = esp_timer_get_time() / 1000;
+
+    /* Silence frames are cheap with DTX, but keep full frames while speaking to avoid onset artifacts */
+    params.dtx = !voice_detected_;
+
+    /* Step the bitrate down quickly when the send queue fills up, and back up slowly once it is drained */
+    size_t fill_percent = send_queue_limit > 0 ? send_queue_size * 100 / send_queue_limit : 0;
+    if (fill_percent >= OPUS_POLICY_QUEUE_HIGH_PERCENT) {
+        queue_low_since_ = 0;
+        if (params.bitrate > OPUS_POLICY_MIN_BITRATE && now_ms - last_step_down_time_ >= OPUS_POLICY_STEP_DOWN_HOLD_MS) {
+            params.bitrate = std::max(params.bitrate - OPUS_POLICY_BITRATE_STEP, OPUS_POLICY_MIN_BITRATE);
+            last_step_down_time_ = now_ms;
+        }
+    } else if (fill_percent <= OPUS_POLICY_QUEUE_LOW_PERCENT) {
+        if (queue_low_since_ == 0) {
+            queue_low_since_ = now_ms;
+        } else if (params.bitrate < OPUS_POLICY_MAX_BITRATE && now_ms - queue_low_since_ >= OPUS_POLICY_STEP_UP_HOLD_MS) {
+            params.bitrate = std::min(params.bitrate + OPUS_POLICY_BITRATE_STEP, OPUS_POLICY_MAX_BITRATE);
+            queue_low_since_ = now_ms;
+        }
+    } else {
+        queue_low_since_ = 0;
+    }
+
+    /* FEC follows the loss of the last complete window, with some hysteresis */
+    loss_window_received_ += received_frames_.exchange(0);
+    loss_window_lost_ += lost_frames_.exchange(0);
+    if (loss_window_received_ >= OPUS_POLICY_LOSS_WINDOW_FRAMES) {
+        int loss_percent = loss_window_lost_ * 100 / loss_window_received_;
+        if (loss_percent >= OPUS_POLICY_LOSS_ON_PERCENT || (params.fec && loss_percent >= OPUS_POLICY_LOSS_OFF_PERCENT)) {
+            params.fec = true;
+            params.packet_loss_percent = std::min(loss_percent, OPUS_POLICY_MAX_LOSS_PERCENT);
+        } else {
+            params.fec = false;
+            params.packet_loss_percent = 0;
+        }
+        loss_window_received_ = 0;
+        loss_window_lost_ = 0;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool bitrate_changed = params.bitrate != params_.bitrate;
+    bool changed = bitrate_changed || params.dtx != params_.dtx || params.fec != params_.fec ||
+        params.packet_loss_percent != params_.packet_loss_percent;
+    if (bitrate_changed) {
+        ESP_LOGI(TAG, "Uplink bitrate %d -> %d bps, send queue %u/%u", params_.bitrate, params.bitrate,
+            send_queue_size, send_queue_limit);
+        stats_.bitrate_changes++;
+    }
+    if (params.fec != params_.fec) {
+        ESP_LOGI(TAG, "In-band FEC %s, packet loss %d%%", params.fec ? "enabled" : "disabled", params.packet_loss_percent);
+    }
+    params_ = params;
+    return changed;
+}
+
+OpusEncoderParams OpusEncoderPolicy::GetParams() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return params_;
+}
+
+OpusEncoderPolicyStats OpusEncoderPolicy::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats_ = OpusEncoderPolicyStats();
+    return stats;
+}
@@ -0,0 +1,79 @@
+#ifndef OPUS_ENCODER_POLICY_H
+#define OPUS_ENCODER_POLICY_H
+
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// Uplink bitrate range for 16 kHz mono speech, SILK wideband is still intelligible at the low end
+#define OPUS_POLICY_MAX_BITRATE 16000
+#define OPUS_POLICY_MIN_BITRATE 8000
+#define OPUS_POLICY_BITRATE_STEP 4000
+// Send queue fill levels (percent of its limit) to step the bitrate down / up
+#define OPUS_POLICY_QUEUE_HIGH_PERCENT 50
+#define OPUS_POLICY_QUEUE_LOW_PERCENT 10
+// Minimum time between two steps down, and time the queue has to stay low before a step up
+#define OPUS_POLICY_STEP_DOWN_HOLD_MS 500
+#define OPUS_POLICY_STEP_UP_HOLD_MS 3000
+// Loss is measured over windows of this many frames, FEC is turned on at LOSS_ON and off below LOSS_OFF
+#define OPUS_POLICY_LOSS_WINDOW_FRAMES 50
+#define OPUS_POLICY_LOSS_ON_PERCENT 2
+#define OPUS_POLICY_LOSS_OFF_PERCENT 1
+#define OPUS_POLICY_MAX_LOSS_PERCENT 30
+
+struct OpusEncoderParams {
+    int bitrate = OPUS_POLICY_MAX_BITRATE;
+    bool dtx = false;
+    bool fec = false;
+    int packet_loss_percent = 0;    // Expected loss passed to the encoder, sizes the FEC data
+};
+
+// Encoded frames and bytes, collected between two GetStats() calls
+struct OpusEncoderPolicyStats {
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    uint32_t dtx_frames = 0;        // Frames the encoder reduced to a DTX marker
+    uint32_t bitrate_changes = 0;
+};
+
+/*
+ * Chooses the uplink Opus encoder parameters:
+ * - DTX while the audio processor reports silence, so the silence between sentences costs a few bytes per frame
+ * - the target bitrate from the send queue depth: a queue that fills up means the link can not keep up
+ * - in-band FEC with the measured packet loss once the link starts losing packets
+ *
+ * The packet loss is measured on the received audio (frames the jitter buffer had to conceal), as the
+ * downlink shares the connection with the uplink and the server does not report the uplink loss.
+ *
+ * Update() and OnEncodedFrame() belong to the encode task, the other inputs may come from any task.
+ */
+class OpusEncoderPolicy {
+public:
+    void OnVoiceDetected(bool speaking);
+    void OnReceivedFrame(bool lost);
+    void OnEncodedFrame(size_t bytes);
+
+    // Returns true if the parameters changed and have to be applied to the encoder
+    bool Update(size_t send_queue_size, size_t send_queue_limit);
+
+    OpusEncoderParams GetParams();
+    OpusEncoderPolicyStats GetStats();
+
+private:
+    std::mutex mutex_;
+    OpusEncoderParams params_;
+    OpusEncoderPolicyStats stats_;
+
+    std::atomic<bool> voice_detected_ = false;
+    std::atomic<uint32_t> received_frames_ = 0;
+    std::atomic<uint32_t> lost_frames_ = 0;
+
+    // Encode task state
+    int64_t last_step_down_time_ = 0;
+    int64_t queue_low_since_ = 0;
+    uint32_t loss_window_received_ = 0;
+    uint32_t loss_window_lost_ = 0;
+};
+
+#endif // OPUS_ENCODER_POLICY_H
@@ -0,0 +1,83 @@
+#include "pcm_kernels.h"
+
+#include <cstring>
+
+/*
+ * Samples are little endian on all ESP32 targets: the first sample of a pair is the low
+ * half of the word. memcpy keeps the word accesses free of alignment and aliasing issues,
+ * the compiler turns it into single loads and stores.
+ */
+static inline uint32_t LoadPair(const int16_t* p) {
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline void StorePair(int16_t* p, uint32_t word) {
+    memcpy(p, &word, sizeof(word));
+}
+
+void PcmDeinterleave2(const int16_t* in, size_t frames, int16_t* left, int16_t* right) {
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        uint32_t frame0 = LoadPair(in + 2 * i);
+        uint32_t frame1 = LoadPair(in + 2 * i + 2);
+        StorePair(left + i, (frame0 & 0xFFFF) | (frame1 << 16));
+        StorePair(right + i, (frame0 >> 16) | (frame1 & 0xFFFF0000));
+    }
+    if (i < frames) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+void PcmInterleave2(const int16_t* left, const int16_t* right, size_t frames, int16_t* out) {
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        uint32_t left_pair = LoadPair(left + i);
+        uint32_t right_pair = LoadPair(right + i);
+        StorePair(out + 2 * i, (left_pair & 0xFFFF) | (right_pair << 16));
+        StorePair(out + 2 * i + 2, (left_pair >> 16) | (right_pair & 0xFFFF0000));
+    }
+    if (i < frames) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+void PcmExtractFirstChannel2(const int16_t* in, size_t frames, int16_t* out) {
+    /* Each write lands at or before the words it was built from, so in place works */
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        uint32_t frame0 = LoadPair(in + 2 * i);
+        uint32_t frame1 = LoadPair(in + 2 * i + 2);
+        StorePair(out + i, (frame0 & 0xFFFF) | (frame1 << 16));
+    }
+    if (i < frames) {
+        out[i] = in[2 * i];
+    }
+}
+
+/* The loops below are plain enough for the compiler to unroll and vectorize */
+void PcmGainWiden32(const int16_t* in, size_t samples, int32_t gain, int32_t* out) {
+    for (size_t i = 0; i < samples; i++) {
+        out[i] = int32_t(in[i]) * gain;
+    }
+}
+
+void PcmGainWiden32Dup2(const int16_t* in, size_t samples, int32_t gain, int32_t* out) {
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = int32_t(in[i]) * gain;
+        out[2 * i] = value;
+        out[2 * i + 1] = value;
+    }
+}
+
+void PcmNarrow32(const int32_t* in, size_t samples, int shift, int16_t* out) {
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = in[i] >> shift;
+        value = value > INT16_MAX ? INT16_MAX : value;
+        value = value < -INT16_MAX ? -INT16_MAX : value;
+        out[i] = int16_t(value);
+    }
+}
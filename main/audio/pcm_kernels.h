@@ -0,0 +1,37 @@
+#ifndef PCM_KERNELS_H
+#define PCM_KERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Channel (de)interleaving kernels for the capture path.
+ *
+ * The loops move two 16-bit samples per 32-bit word, which halves the loads and stores
+ * compared to a sample by sample copy on the ESP32 cores. All functions take frame counts
+ * (one sample per channel) and do not allocate.
+ */
+
+// in: L0 R0 L1 R1 ... -> left: L0 L1 ..., right: R0 R1 ...
+void PcmDeinterleave2(const int16_t* in, size_t frames, int16_t* left, int16_t* right);
+
+// left: L0 L1 ..., right: R0 R1 ... -> out: L0 R0 L1 R1 ...
+void PcmInterleave2(const int16_t* left, const int16_t* right, size_t frames, int16_t* out);
+
+// Keeps the first channel of a stereo stream, out may be the same buffer as in
+void PcmExtractFirstChannel2(const int16_t* in, size_t frames, int16_t* out);
+
+/*
+ * Output gain stage of the I2S codecs: out[i] = in[i] * gain, gain is Q16 and at most PCM_UNITY_GAIN.
+ * The product of a 16-bit sample and a gain up to unity always fits in 32 bits, so no clipping
+ * and no 64-bit multiply are needed.
+ */
+#define PCM_UNITY_GAIN 65536
+void PcmGainWiden32(const int16_t* in, size_t samples, int32_t gain, int32_t* out);
+// Same, writing each sample to both slots of a stereo frame (mono stream on a stereo bus)
+void PcmGainWiden32Dup2(const int16_t* in, size_t samples, int32_t gain, int32_t* out);
+
+// Input stage of the I2S codecs: out[i] = in[i] >> shift, clipped to +-INT16_MAX
+void PcmNarrow32(const int32_t* in, size_t samples, int shift, int16_t* out);
+
+#endif // PCM_KERNELS_H
@@ -0,0 +1,154 @@
+#include "pcm_resampler.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+
+#define TAG "PcmResampler"
+
+#define COEFFICIENT_SHIFT 14
+
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+bool PcmResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    if (input_sample_rate <= 0 || output_sample_rate <= 0) {
+        ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", input_sample_rate, output_sample_rate);
+        return false;
+    }
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+
+    uint32_t divisor = std::gcd(input_sample_rate, output_sample_rate);
+    up_ = output_sample_rate / divisor;
+    down_ = input_sample_rate / divisor;
+    if (up_ > PCM_RESAMPLER_MAX_PHASES) {
+        down_ = std::max<uint32_t>(1, (static_cast<uint64_t>(down_) * PCM_RESAMPLER_MAX_PHASES + up_ / 2) / up_);
+        up_ = PCM_RESAMPLER_MAX_PHASES;
+        divisor = std::gcd(up_, down_);
+        up_ /= divisor;
+        down_ /= divisor;
+        ESP_LOGW(TAG, "Ratio %d/%d approximated by %lu/%lu", output_sample_rate, input_sample_rate, up_, down_);
+    }
+
+    coefficients_.clear();
+    buffer_.clear();
+    phase_ = 0;
+    start_ = 0;
+    if (up_ == down_) {
+        taps_ = 0;
+        return true;
+    }
+
+    /* The cutoff is the lower of the two Nyquist frequencies, in units of the input rate */
+    double cutoff = std::min(1.0, static_cast<double>(up_) / down_) * PCM_RESAMPLER_ROLLOFF;
+    size_t half = std::min<size_t>(std::ceil(PCM_RESAMPLER_HALF_TAPS / std::min(1.0, static_cast<double>(up_) / down_)),
+        PCM_RESAMPLER_MAX_TAPS / 2);
+    taps_ = 2 * half;
+
+    coefficients_.resize(up_ * taps_);
+    double window_scale = 1.0 / BesselI0(PCM_RESAMPLER_KAISER_BETA);
+    std::vector<double> phase_coefficients(taps_);
+    for (uint32_t p = 0; p < up_; p++) {
+        double frac = static_cast<double>(p) / up_;
+        double sum = 0;
+        for (size_t j = 0; j < taps_; j++) {
+            /* Tap j weights the input sample (j - half + 1) after the current one */
+            double delta = static_cast<double>(j) - (half - 1) - frac;
+            double x = delta / half;
+            double window = x * x < 1.0 ? BesselI0(PCM_RESAMPLER_KAISER_BETA * std::sqrt(1.0 - x * x)) * window_scale : 0.0;
+            double arg = M_PI * cutoff * delta;
+            double sinc = arg == 0.0 ? 1.0 : std::sin(arg) / arg;
+            phase_coefficients[j] = cutoff * sinc * window;
+            sum += phase_coefficients[j];
+        }
+
+        /* Normalize every phase to a DC gain of exactly one, the rounding error goes to the center tap */
+        int16_t* phase = &coefficients_[p * taps_];
+        int32_t total = 0;
+        size_t center = 0;
+        for (size_t j = 0; j < taps_; j++) {
+            phase[j] = static_cast<int16_t>(std::lround(phase_coefficients[j] / sum * (1 << COEFFICIENT_SHIFT)));
+            total += phase[j];
+            if (phase[j] > phase[center]) {
+                center = j;
+            }
+        }
+        phase[center] += (1 << COEFFICIENT_SHIFT) - total;
+    }
+
+    buffer_.assign(taps_ - 1, 0);
+    ESP_LOGI(TAG, "Resampling %d -> %d Hz: %lu phases, %u taps", input_sample_rate, output_sample_rate, up_, taps_);
+    return true;
+}
+
+void PcmResampler::Reset() {
+    phase_ = 0;
+    start_ = 0;
+    if (taps_ > 0) {
+        buffer_.assign(taps_ - 1, 0);
+    }
+}
+
+size_t PcmResampler::GetOutputSamples(size_t input_samples) const {
+    if (taps_ == 0) {
+        return input_samples;
+    }
+    /* Output k is produced while start_ + (phase_ + k * down_) / up_ + taps_ <= buffer size */
+    size_t size = buffer_.size() + input_samples;
+    if (size < start_ + taps_) {
+        return 0;
+    }
+    uint64_t positions = static_cast<uint64_t>(size - start_ - taps_ + 1) * up_;
+    return (positions - phase_ + down_ - 1) / down_;
+}
+
+size_t PcmResampler::Process(const int16_t* in, size_t samples, int16_t* out) {
+    if (taps_ == 0) {
+        memcpy(out, in, samples * sizeof(int16_t));
+        return samples;
+    }
+
+    size_t size = buffer_.size();
+    buffer_.resize(size + samples);
+    memcpy(buffer_.data() + size, in, samples * sizeof(int16_t));
+    size += samples;
+
+    size_t produced = 0;
+    const int16_t* input = buffer_.data();
+    while (start_ + taps_ <= size) {
+        const int16_t* x = input + start_;
+        const int16_t* h = &coefficients_[phase_ * taps_];
+        int32_t acc = 1 << (COEFFICIENT_SHIFT - 1);
+        for (size_t j = 0; j < taps_; j++) {
+            acc += static_cast<int32_t>(x[j]) * h[j];
+        }
+        acc >>= COEFFICIENT_SHIFT;
+        out[produced++] = static_cast<int16_t>(std::clamp<int32_t>(acc, INT16_MIN, INT16_MAX));
+
+        phase_ += down_;
+        start_ += phase_ / up_;
+        phase_ %= up_;
+    }
+
+    /* Keep the samples the next outputs still need, a large decimation step may skip past the end */
+    size_t consumed = std::min(start_, size);
+    memmove(buffer_.data(), buffer_.data() + consumed, (size - consumed) * sizeof(int16_t));
+    buffer_.resize(size - consumed);
+    start_ -= consumed;
+    return produced;
+}
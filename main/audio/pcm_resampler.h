@@ -0,0 +1,59 @@
+#ifndef PCM_RESAMPLER_H
+#define PCM_RESAMPLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Half length of the interpolation kernel in input samples when upsampling, 8 zero crossings per side
+#define PCM_RESAMPLER_HALF_TAPS 8
+// Downsampling stretches the kernel by the decimation ratio, up to this many taps per output sample
+#define PCM_RESAMPLER_MAX_TAPS 64
+// All pairs of the MP3 / Opus sample rates need at most 640 phases (11025 -> 48000)
+#define PCM_RESAMPLER_MAX_PHASES 640
+// Passband edge relative to the lower Nyquist frequency
+#define PCM_RESAMPLER_ROLLOFF 0.9
+#define PCM_RESAMPLER_KAISER_BETA 8.0
+
+/*
+ * Fixed-point polyphase resampler for mono 16-bit PCM, for any pair of sample rates.
+ *
+ * The ratio is reduced to up / down and each of the up phases gets its own windowed-sinc
+ * (Kaiser) filter, so the inner loop is a plain 16x16 multiply-accumulate over the taps.
+ * Coefficients are Q14: with a DC gain of one the sum of a whole phase stays within 32 bits.
+ * Ratios that would need more than PCM_RESAMPLER_MAX_PHASES phases are approximated, the pitch
+ * error stays below 0.1%.
+ *
+ * The resampler is streaming: it keeps the last input samples between Process() calls, so a
+ * block may produce one sample more or less than its share. The delay is half the kernel.
+ * Configure() allocates, Process() does not once the first block of a given size went through.
+ */
+class PcmResampler {
+public:
+    bool Configure(int input_sample_rate, int output_sample_rate);
+    void Reset();
+
+    // Upper bound of the samples the next Process() call writes for this many input samples
+    size_t GetOutputSamples(size_t input_samples) const;
+    // Returns the number of samples written to out
+    size_t Process(const int16_t* in, size_t samples, int16_t* out);
+
+    inline int input_sample_rate() const { return input_sample_rate_; }
+    inline int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    uint32_t up_ = 1;
+    uint32_t down_ = 1;
+    size_t taps_ = 0;
+    // up_ phases of taps_ coefficients, phase p is used for outputs at p / up_ past an input sample
+    std::vector<int16_t> coefficients_;
+    // Input history followed by the current block
+    std::vector<int16_t> buffer_;
+    // Offset in buffer_ of the first tap of the next output, and its phase
+    size_t start_ = 0;
+    uint32_t phase_ = 0;
+};
+
+#endif // PCM_RESAMPLER_H
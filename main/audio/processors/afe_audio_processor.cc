@@ -84,6 +84,11 @@ size_t AfeAudioProcessor::GetFeedSize() {
     return afe_iface_->get_feed_chunksize(afe_data_) * codec_->input_channels();
 }
 
+void AfeAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    // The processor task picks up the new size with the next frame it fetches
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+}
+
 void AfeAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (afe_data_ == nullptr) {
         return;
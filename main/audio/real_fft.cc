@@ -0,0 +1,143 @@
+#include "real_fft.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#define TAG "RealFft"
+
+
+bool RealFft::Configure(int size) {
+    if (size < 8 || size > 4096 || (size & (size - 1)) != 0) {
+        ESP_LOGE(TAG, "Unsupported FFT size: %d", size);
+        return false;
+    }
+    size_ = size;
+    int half = size / 2;
+
+    cos_.resize(half);
+    sin_.resize(half);
+    for (int k = 0; k < half; k++) {
+        double angle = 2.0 * M_PI * k / size;
+        cos_[k] = cos(angle);
+        sin_[k] = sin(angle);
+    }
+
+    int bits = 0;
+    while ((1 << bits) < half) {
+        bits++;
+    }
+    bit_reverse_.resize(half);
+    for (int i = 0; i < half; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse_[i] = reversed;
+    }
+
+    window_.resize(size);
+    for (int i = 0; i < size; i++) {
+        double hann = 0.5 * (1.0 - cos(2.0 * M_PI * i / (size - 1)));
+        window_[i] = hann / 32768.0 / size;
+    }
+    spectrum_.resize(size);
+    return true;
+}
+
+void RealFft::Transform(float* data) {
+    int n = size_ / 2;
+    for (int i = 0; i < n; i++) {
+        int j = bit_reverse_[i];
+        if (j > i) {
+            std::swap(data[2 * i], data[2 * j]);
+            std::swap(data[2 * i + 1], data[2 * j + 1]);
+        }
+    }
+
+    /* The first stage only has the twiddle 1 */
+    for (int k = 0; k < n; k += 2) {
+        float* a = data + 2 * k;
+        float re = a[2];
+        float im = a[3];
+        a[2] = a[0] - re;
+        a[3] = a[1] - im;
+        a[0] += re;
+        a[1] += im;
+    }
+
+    for (int m = 4; m <= n; m <<= 1) {
+        int half = m >> 1;
+        /* exp(-2 pi i j / m) is entry j * N / m of the table */
+        int step = size_ / m;
+        for (int j = 0; j < half; j++) {
+            float w_re = cos_[j * step];
+            float w_im = -sin_[j * step];
+            for (int k = j; k < n; k += m) {
+                float* a = data + 2 * k;
+                float* b = data + 2 * (k + half);
+                float t_re = w_re * b[0] - w_im * b[1];
+                float t_im = w_re * b[1] + w_im * b[0];
+                b[0] = a[0] - t_re;
+                b[1] = a[1] - t_im;
+                a[0] += t_re;
+                a[1] += t_im;
+            }
+        }
+    }
+}
+
+void RealFft::Split(float* data) {
+    /*
+     * With Z the transform of z[k] = x[2k] + i x[2k+1], the even and odd halves of x are
+     * E[k] = (Z[k] + conj(Z[M-k])) / 2 and O[k] = (Z[k] - conj(Z[M-k])) / 2i, and
+     * X[k] = E[k] + W^k O[k], X[M-k] = conj(E[k] - W^k O[k]) with W = exp(-2 pi i / N).
+     */
+    int n = size_ / 2;
+    float dc = data[0] + data[1];
+    float nyquist = data[0] - data[1];
+    data[0] = dc;
+    data[1] = nyquist;
+    for (int k = 1; k <= n / 2; k++) {
+        float* a = data + 2 * k;
+        float* b = data + 2 * (n - k);
+        float e_re = 0.5f * (a[0] + b[0]);
+        float e_im = 0.5f * (a[1] - b[1]);
+        float o_re = 0.5f * (a[1] + b[1]);
+        float o_im = -0.5f * (a[0] - b[0]);
+        float w_re = cos_[k];
+        float w_im = -sin_[k];
+        float t_re = w_re * o_re - w_im * o_im;
+        float t_im = w_re * o_im + w_im * o_re;
+        b[0] = e_re - t_re;
+        b[1] = t_im - e_im;
+        a[0] = e_re + t_re;
+        a[1] = e_im + t_im;
+    }
+}
+
+void RealFft::Forward(const float* in, float* out) {
+    if (size_ == 0) {
+        return;
+    }
+    memcpy(out, in, size_ * sizeof(float));
+    Transform(out);
+    Split(out);
+}
+
+void RealFft::AddPowerSpectrum(const int16_t* samples, float* power) {
+    if (size_ == 0) {
+        return;
+    }
+    float* data = spectrum_.data();
+    for (int i = 0; i < size_; i++) {
+        data[i] = samples[i] * window_[i];
+    }
+    Transform(data);
+    Split(data);
+    power[0] += data[0] * data[0];
+    for (int k = 1; k < size_ / 2; k++) {
+        power[k] += data[2 * k] * data[2 * k] + data[2 * k + 1] * data[2 * k + 1];
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef REAL_FFT_H
+#define REAL_FFT_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Forward FFT of a real signal, for spectrum analysis.
+ *
+ * An N-point real input is packed into an N/2-point complex sequence (even samples as the real
+ * part, odd samples as the imaginary part), transformed in place by a radix-2 kernel and split
+ * into the bins of the real spectrum, which takes about half the work of a complex N-point FFT.
+ * Configure() computes the twiddles, the bit reversal permutation and the Hann window once, so
+ * a transform does no trigonometry, no division and no allocation.
+ */
+class RealFft {
+public:
+    // size is a power of two from 8 to 4096, returns false otherwise. Transforms do nothing until configured
+    bool Configure(int size);
+
+    inline int size() const { return size_; }
+    // Bins 0 .. size / 2 - 1, the Nyquist bin is left out
+    inline int bins() const { return size_ / 2; }
+
+    /*
+     * Transforms size samples into bins() complex values, interleaved re, im. Bin 0 holds the
+     * DC term in re and the Nyquist term in im. The output is not scaled, input and output may
+     * not overlap.
+     */
+    void Forward(const float* in, float* out);
+
+    /*
+     * Applies the Hann window to size samples and adds the power of each bin to power[], scaled
+     * so that a full scale sine gives about 1/16 in its bin (amplitude normalized by N).
+     * Call it for several blocks to average them.
+     */
+    void AddPowerSpectrum(const int16_t* samples, float* power);
+
+private:
+    int size_ = 0;
+    // cos and sin of 2 pi k / N for k < N / 2, stage s of the N/2-point FFT uses every N/2^s-th one
+    std::vector<float> cos_;
+    std::vector<float> sin_;
+    std::vector<uint16_t> bit_reverse_;
+    // Hann window with the int16 scale and the 1/N normalization folded in
+    std::vector<float> window_;
+    std::vector<float> spectrum_;
+
+    // Complex N/2-point FFT in place
+    void Transform(float* data);
+    // Turns the transform of the packed sequence into the real spectrum, in place
+    void Split(float* data);
+};
+
+#endif // REAL_FFT_H
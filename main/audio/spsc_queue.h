@@ -0,0 +1,109 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bounded lock-free single-producer / single-consumer ring.
+ *
+ * Push() must only be called from the producer task and Pop() only from the consumer task.
+ * Size() and Clear() may be called from any task: Clear() records the current write position
+ * and the consumer drops everything before it on its next Pop(), so the producer and the
+ * consumer never touch the same slot.
+ *
+ * Head and tail are free running counters, the slot index is taken modulo the capacity.
+ */
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots_(capacity), limit_(capacity) {}
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    inline size_t capacity() const { return slots_.size(); }
+
+    /* Number of items Push() accepts, at most the capacity. May be changed at any time */
+    inline size_t limit() const { return limit_; }
+    void SetLimit(size_t limit) { limit_ = limit < slots_.size() ? limit : slots_.size(); }
+
+    bool Push(T&& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= limit_) {
+            return false;
+        }
+        slots_[tail % slots_.size()] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        bool made_room;
+        return Pop(item, made_room);
+    }
+
+    /*
+     * made_room is set when this call freed space a producer may be blocked on: the ring was
+     * full before, or exactly one slot is free after it. The producer only sleeps after seeing
+     * the ring full, so the consumer should wake it whenever made_room is set.
+     */
+    bool Pop(T& item, bool& made_room) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        size_t limit = limit_;
+        bool was_full = tail - head >= limit;
+
+        /* Drop the items discarded by Clear() */
+        uint32_t discard_until = discard_until_.load(std::memory_order_acquire);
+        while (head != tail && static_cast<int32_t>(discard_until - head) > 0) {
+            slots_[head % slots_.size()] = T();
+            head++;
+        }
+
+        bool popped = head != tail;
+        if (popped) {
+            item = std::move(slots_[head % slots_.size()]);
+            head++;
+        }
+        head_.store(head, std::memory_order_release);
+        made_room = was_full || tail_.load(std::memory_order_acquire) - head == limit - 1;
+        return popped;
+    }
+
+    size_t Size() const {
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t discard_until = discard_until_.load(std::memory_order_acquire);
+        if (static_cast<int32_t>(discard_until - head) > 0) {
+            head = discard_until;
+        }
+        return static_cast<int32_t>(tail - head) > 0 ? tail - head : 0;
+    }
+
+    inline bool Empty() const { return Size() == 0; }
+
+    /* Counts the slots discarded by Clear() but not yet dropped, like Push() does */
+    inline bool Full() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) >= limit_;
+    }
+
+    void Clear() {
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        uint32_t current = discard_until_.load(std::memory_order_relaxed);
+        while (static_cast<int32_t>(tail - current) > 0 &&
+            !discard_until_.compare_exchange_weak(current, tail, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+    }
+
+private:
+    std::vector<T> slots_;
+    std::atomic<size_t> limit_;
+    std::atomic<uint32_t> head_ = 0;
+    std::atomic<uint32_t> tail_ = 0;
+    std::atomic<uint32_t> discard_until_ = 0;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,66 @@
+#include "uplink_opus_encoder.h"
+
+#include <esp_log.h>
+#include <opus.h>
+
+#define TAG "UplinkOpusEncoder"
+
+// Largest packet asked from the encoder, far above the uplink bitrates
+#define UPLINK_OPUS_MAX_PACKET_SIZE 1000
+
+
+UplinkOpusEncoder::UplinkOpusEncoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms) {
+    frame_size_ = sample_rate / 1000 * duration_ms;
+
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    SetParams(OpusEncoderParams());
+}
+
+UplinkOpusEncoder::~UplinkOpusEncoder() {
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+void UplinkOpusEncoder::SetComplexity(int complexity) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+    }
+}
+
+void UplinkOpusEncoder::SetParams(const OpusEncoderParams& params) {
+    if (encoder_ == nullptr) {
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(params.bitrate));
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(params.dtx ? 1 : 0));
+    opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(params.fec ? 1 : 0));
+    opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(params.packet_loss_percent));
+}
+
+bool UplinkOpusEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (encoder_ == nullptr) {
+        return false;
+    }
+    if (pcm.size() != static_cast<size_t>(frame_size_ * channels_)) {
+        ESP_LOGE(TAG, "Audio data size %u is not equal to frame size %d", pcm.size(), frame_size_ * channels_);
+        return false;
+    }
+
+    opus.resize(UPLINK_OPUS_MAX_PACKET_SIZE);
+    auto ret = opus_encode(encoder_, pcm.data(), frame_size_, opus.data(), opus.size());
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
+        opus.clear();
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef UPLINK_OPUS_ENCODER_H
+#define UPLINK_OPUS_ENCODER_H
+
+#include <vector>
+#include <cstdint>
+
+#include "opus_encoder_policy.h"
+
+struct OpusEncoder;
+
+/*
+ * Opus encoder for the uplink stream. Unlike OpusEncoderWrapper it exposes the rate control
+ * (bitrate, DTX, in-band FEC), which is driven by OpusEncoderPolicy.
+ * Only used by the encode task.
+ */
+class UplinkOpusEncoder {
+public:
+    UplinkOpusEncoder(int sample_rate, int channels, int duration_ms);
+    ~UplinkOpusEncoder();
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+
+    void SetComplexity(int complexity);
+    void SetParams(const OpusEncoderParams& params);
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    int frame_size_;
+};
+
+#endif // UPLINK_OPUS_ENCODER_H
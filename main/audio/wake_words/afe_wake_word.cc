@@ -151,9 +151,10 @@ void AfeWakeWord::StoreWakeWordData(const int16_t* data, size_t samples) {
     }
 }
 
-void AfeWakeWord::EncodeWakeWordData() {
+void AfeWakeWord::EncodeWakeWordData(int frame_duration_ms) {
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
+    wake_word_frame_duration_ = frame_duration_ms;
     if (wake_word_encode_task_stack_ == nullptr) {
         wake_word_encode_task_stack_ = (StackType_t*)heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM);
         assert(wake_word_encode_task_stack_ != nullptr);
@@ -167,7 +168,7 @@ void AfeWakeWord::EncodeWakeWordData() {
         auto this_ = (AfeWakeWord*)arg;
         {
             auto start_time = esp_timer_get_time();
-            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+            auto encoder = std::make_unique<OpusEncoderWrapper>(16000, 1, this_->wake_word_frame_duration_);
             encoder->SetComplexity(0); // 0 is the fastest
 
             int packets = 0;
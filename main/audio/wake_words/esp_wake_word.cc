@@ -74,7 +74,7 @@ size_t EspWakeWord::GetFeedSize() {
     return wakenet_iface_->get_samp_chunksize(wakenet_data_) * codec_->input_channels();
 }
 
-void EspWakeWord::EncodeWakeWordData() {
+void EspWakeWord::EncodeWakeWordData(int frame_duration_ms) {
 }
 
 bool EspWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
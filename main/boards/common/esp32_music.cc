@@ -5,18 +5,17 @@
 #include "application.h"
 #include "protocols/protocol.h"
 #include "display/display.h"
+#include "resumable_download.h"
+#include "device_state_event.h"
 
 #include <esp_log.h>
-#include <esp_heap_caps.h>
 #include <esp_pthread.h>
 #include <esp_timer.h>
 #include <mbedtls/sha256.h>
 #include <cJSON.h>
 #include <cstring>
 #include <chrono>
-#include <sstream>
 #include <algorithm>
-#include <cctype>  // 为isdigit函数
 #include <thread>   // 为线程ID比较
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
@@ -164,13 +163,34 @@ static std::string buildUrlWithParams(const std::string& base_url, const std::st
 
 Esp32Music::Esp32Music() : last_downloaded_data_(), current_music_url_(), current_song_name_(),
                          song_name_displayed_(false), current_lyric_url_(), lyrics_(), 
-                         current_lyric_index_(-1), lyric_thread_(), is_lyric_running_(false),
+                         current_lyric_index_(-1), lyric_song_id_(0), lyric_threads_(0),
                          display_mode_(DISPLAY_MODE_LYRICS), is_playing_(false), is_downloading_(false), 
-                         play_thread_(), download_thread_(), audio_buffer_(), buffer_mutex_(), 
-                         buffer_cv_(), buffer_size_(0), mp3_decoder_(nullptr), mp3_frame_info_(), 
-                         mp3_decoder_initialized_(false) {
+                         play_thread_(), download_thread_(),
+                         stream_buffer_(STREAM_BUFFER_SIZE, STREAM_GUARD_SIZE, STREAM_BUFFER_SIZE,
+                                        STREAM_LOW_WATERMARK, STREAM_START_WATERMARK),
+                         song_boundary_(NO_SONG_BOUNDARY), audio_data_offset_(0), stream_bitrate_(0),
+                         stream_start_offset_(0), stream_start_time_ms_(0) {
     ESP_LOGI(TAG, "Music player initialized with default spectrum display mode");
-    InitializeMp3Decoder();
+    song_start_us_ = 0;
+    cache_.Initialize();
+    // 播放线程把数据读完、开始等数据时，下载线程可能在等当前歌曲快要播完
+    stream_buffer_.SetReaderWaitCallback([this]() { NotifyStreamThreads(); });
+    // 暂停中的播放线程等设备状态变化后再检查是否继续播放
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([this](DeviceState, DeviceState) {
+        NotifyStreamThreads();
+    });
+    
+    esp_timer_create_args_t lyric_timer_args = {
+        .callback = [](void* arg) {
+            Esp32Music* music = (Esp32Music*)arg;
+            music->OnLyricTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lyric_timer",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&lyric_timer_args, &lyric_timer_);
 }
 
 Esp32Music::~Esp32Music() {
@@ -179,13 +199,11 @@ Esp32Music::~Esp32Music() {
     // 停止所有操作
     is_downloading_ = false;
     is_playing_ = false;
-    is_lyric_running_ = false;
+    lyric_song_id_++;
     
     // 通知所有等待的线程
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    stream_buffer_.Abort();
+    NotifyStreamThreads();
     
     // 等待下载线程结束，设置5秒超时
     if (download_thread_.joinable()) {
@@ -208,10 +226,7 @@ Esp32Music::~Esp32Music() {
             is_downloading_ = false;
             
             // 通知条件变量
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
+            stream_buffer_.Abort();
             
             // 检查线程是否已经结束
             if (!download_thread_.joinable()) {
@@ -250,10 +265,7 @@ Esp32Music::~Esp32Music() {
             is_playing_ = false;
             
             // 通知条件变量
-            {
-                std::lock_guard<std::mutex> lock(buffer_mutex_);
-                buffer_cv_.notify_all();
-            }
+            stream_buffer_.Abort();
             
             // 检查线程是否已经结束
             if (!play_thread_.joinable()) {
@@ -267,29 +279,59 @@ Esp32Music::~Esp32Music() {
         ESP_LOGI(TAG, "Playback thread finished");
     }
     
-    // 等待歌词线程结束
-    if (lyric_thread_.joinable()) {
-        ESP_LOGI(TAG, "Waiting for lyric thread to finish");
-        lyric_thread_.join();
-        ESP_LOGI(TAG, "Lyric thread finished");
+    // 等待歌词下载线程结束，编号已经变了，它们在下一次读取或重试前就会退出
+    if (lyric_threads_ > 0) {
+        ESP_LOGI(TAG, "Waiting for lyric threads to finish");
+        while (lyric_threads_ > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        ESP_LOGI(TAG, "Lyric threads finished");
     }
     
-    // 清理缓冲区和MP3解码器
+    // 清理缓冲区、解码器和歌词定时器
     ClearAudioBuffer();
-    CleanupMp3Decoder();
+    decoder_.reset();
+    if (lyric_timer_ != nullptr) {
+        esp_timer_stop(lyric_timer_);
+        esp_timer_delete(lyric_timer_);
+        lyric_timer_ = nullptr;
+    }
     
     ESP_LOGI(TAG, "Music player destroyed successfully");
 }
 
-bool Esp32Music::Download(const std::string& song_name, const std::string& artist_name) {
-    ESP_LOGI(TAG, "小智开源音乐固件qq交流群:826072986");
-    ESP_LOGI(TAG, "Starting to get music details for: %s", song_name.c_str());
+// 先查Flash缓存，缓存中没有时请求音乐接口
+bool Esp32Music::FindSong(const std::string& song_name, const std::string& artist_name, QueuedSong& song) {
+    std::string cache_key = MusicCache::MakeKey(song_name, artist_name);
+    size_t audio_size = 0;
+    if (cache_.Lookup(cache_key, audio_size)) {
+        ESP_LOGI(TAG, "Playing %s from cache (%u bytes)", song_name.c_str(), audio_size);
+        last_downloaded_data_ = "{\"title\": \"" + song_name + "\", \"cached\": true}";
+        song.name = song_name;
+        song.music_url = MUSIC_CACHE_URL_PREFIX + cache_key;
+        song.lyric_url.clear();
+        song.cache_key = cache_key;
+    } else if (ResolveSong(song_name, artist_name, song)) {
+        song.cache_key = cache_key;
+    } else {
+        return false;
+    }
     
+    auto stats = cache_.GetStats();
+    if (stats.lookups > 0) {
+        ESP_LOGI(TAG, "Music cache: hit rate %lu/%lu (%lu%%), %llu bytes saved", stats.hits, stats.lookups,
+                stats.hits * 100 / stats.lookups, stats.bytes_saved);
+    }
+    return true;
+}
+
+// 请求音乐接口，解析出歌曲的音频和歌词URL
+bool Esp32Music::ResolveSong(const std::string& song_name, const std::string& artist_name, QueuedSong& song) {
     // 清空之前的下载数据
     last_downloaded_data_.clear();
     
     // 保存歌名用于后续显示
-    current_song_name_ = song_name;
+    song.name = song_name;
     
     // 第一步：请求stream_pcm接口获取音频信息
     std::string base_url = "http://www.xiaozhishop.xyz:5005";
@@ -365,17 +407,12 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     std::string path = audio_path.substr(0, query_pos);
                     std::string query = audio_path.substr(query_pos + 1);
                     
-                    current_music_url_ = buildUrlWithParams(base_url, path, query);
+                    song.music_url = buildUrlWithParams(base_url, path, query);
                 } else {
-                    current_music_url_ = base_url + audio_path;
+                    song.music_url = base_url + audio_path;
                 }
                 
-                ESP_LOGI(TAG, "小智开源音乐固件qq交流群:826072986");
-                ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
-                song_name_displayed_ = false;  // 重置歌名显示标志
-                StartStreaming(current_music_url_);
-                
-                // 处理歌词URL - 只有在歌词显示模式下才启动歌词
+                // 处理歌词URL
                 if (cJSON_IsString(lyric_url) && lyric_url->valuestring && strlen(lyric_url->valuestring) > 0) {
                     // 拼接完整的歌词下载URL，使用相同的URL构建逻辑
                     std::string lyric_path = lyric_url->valuestring;
@@ -384,30 +421,9 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                         std::string path = lyric_path.substr(0, query_pos);
                         std::string query = lyric_path.substr(query_pos + 1);
                         
-                        current_lyric_url_ = buildUrlWithParams(base_url, path, query);
+                        song.lyric_url = buildUrlWithParams(base_url, path, query);
                     } else {
-                        current_lyric_url_ = base_url + lyric_path;
-                    }
-                    
-                    // 根据显示模式决定是否启动歌词
-                    if (display_mode_ == DISPLAY_MODE_LYRICS) {
-                        ESP_LOGI(TAG, "Loading lyrics for: %s (lyrics display mode)", song_name.c_str());
-                        
-                        // 启动歌词下载和显示
-                        if (is_lyric_running_) {
-                            is_lyric_running_ = false;
-                            if (lyric_thread_.joinable()) {
-                                lyric_thread_.join();
-                            }
-                        }
-                        
-                        is_lyric_running_ = true;
-                        current_lyric_index_ = -1;
-                        lyrics_.clear();
-                        
-                        lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
-                    } else {
-                        ESP_LOGI(TAG, "Lyric URL found but spectrum display mode is active, skipping lyrics");
+                        song.lyric_url = base_url + lyric_path;
                     }
                 } else {
                     ESP_LOGW(TAG, "No lyric URL found for this song");
@@ -432,43 +448,133 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
     return false;
 }
 
+bool Esp32Music::Download(const std::string& song_name, const std::string& artist_name) {
+    ESP_LOGI(TAG, "小智开源音乐固件qq交流群:826072986");
+    ESP_LOGI(TAG, "Starting to get music details for: %s", song_name.c_str());
+    
+    QueuedSong song;
+    if (!FindSong(song_name, artist_name, song)) {
+        return false;
+    }
+    current_song_name_ = song.name;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        current_lyric_url_ = song.lyric_url;
+    }
+    
+    ESP_LOGI(TAG, "小智开源音乐固件qq交流群:826072986");
+    ESP_LOGI(TAG, "Starting streaming playback for: %s", song_name.c_str());
+    song_name_displayed_ = false;  // 重置歌名显示标志
+    StartSong(song);
+    
+    // 只有在歌词显示模式下才启动歌词
+    StartLyrics();
+    return true;
+}
 
+// 排队下一首：下载线程下载完当前歌曲后预取它的开头，播放线程播完当前歌曲后直接切换过去
+bool Esp32Music::QueueNext(const std::string& song_name, const std::string& artist_name) {
+    if (!is_playing_) {
+        return Download(song_name, artist_name);
+    }
+    
+    QueuedSong song;
+    if (!FindSong(song_name, artist_name, song)) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (!next_song_.music_url.empty()) {
+        ESP_LOGI(TAG, "Replacing queued song: %s", next_song_.name.c_str());
+    }
+    next_song_ = std::move(song);
+    ESP_LOGI(TAG, "Queued next song: %s", next_song_.name.c_str());
+    queue_cv_.notify_all();
+    return true;
+}
 
 std::string Esp32Music::GetDownloadResult() {
     return last_downloaded_data_;
 }
 
-// 开始流式播放
+// 开始流式播放，直接给出的URL不缓存
 bool Esp32Music::StartStreaming(const std::string& music_url) {
-    if (music_url.empty()) {
+    QueuedSong song;
+    song.name = current_song_name_;
+    song.music_url = music_url;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        song.lyric_url = current_lyric_url_;
+    }
+    return StartSong(song);
+}
+
+bool Esp32Music::StartSong(const QueuedSong& song) {
+    // 新的歌曲，丢掉上一首的帧索引
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex_);
+        seek_index_.clear();
+        audio_data_offset_ = 0;
+        stream_bitrate_ = 0;
+    }
+    return StartStreamingAt(song, 0, 0);
+}
+
+// 从文件的指定字节偏移开始下载和播放，start_time_ms是这个位置对应的播放时间
+bool Esp32Music::StartStreamingAt(const QueuedSong& song, size_t offset, int64_t start_time_ms) {
+    if (song.music_url.empty()) {
         ESP_LOGE(TAG, "Music URL is empty");
         return false;
     }
     
-    ESP_LOGD(TAG, "Starting streaming for URL: %s", music_url.c_str());
+    ESP_LOGD(TAG, "Starting streaming for URL: %s at offset %u", song.music_url.c_str(), offset);
     
     // 停止之前的播放和下载
     is_downloading_ = false;
     is_playing_ = false;
+    NotifyStreamThreads();
     
     // 等待之前的线程完全结束
     if (download_thread_.joinable()) {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();  // 通知线程退出
-        }
+        stream_buffer_.Abort();  // 通知线程退出
         download_thread_.join();
     }
     if (play_thread_.joinable()) {
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();  // 通知线程退出
-        }
+        stream_buffer_.Abort();  // 通知线程退出
         play_thread_.join();
     }
     
-    // 清空缓冲区
+    // 丢弃还没播放的音乐帧。新的歌曲重新识别格式；同一首歌里跳转时保留从文件头解析出的参数，
+    // 只丢掉上一段数据留下的解码状态（比如MP3的比特池）
+    FlushPcmPlayback();
+    if (offset == 0) {
+        decoder_.reset();
+    } else if (decoder_) {
+        decoder_->Reset(offset);
+    }
+    
+    // 已经预取但还没开始播放的下一首放回队列，之后重新预取
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!incoming_song_.music_url.empty() && next_song_.music_url.empty()) {
+            next_song_ = std::move(incoming_song_);
+        }
+        incoming_song_ = QueuedSong();
+        current_music_url_ = song.music_url;
+        current_cache_key_ = song.cache_key;
+    }
+    // 正在播放的歌曲不能在缓存下一首时被淘汰
+    cache_.Pin(song.cache_key);
+    song_boundary_ = NO_SONG_BOUNDARY;
+    stream_start_offset_ = offset;
+    stream_start_time_ms_ = start_time_ms;
+    
+    // 清空缓冲区和统计
     ClearAudioBuffer();
+    ResetStats();
+    if (!stream_buffer_.Allocate()) {
+        return false;
+    }
     
     // 配置线程栈大小以避免栈溢出
     esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
@@ -479,7 +585,7 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     
     // 开始下载线程
     is_downloading_ = true;
-    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, music_url);
+    download_thread_ = std::thread(&Esp32Music::DownloadAudioStream, this, song, offset);
     
     // 开始播放线程（会等待缓冲区有足够数据）
     is_playing_ = true;
@@ -490,13 +596,58 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     return true;
 }
 
+// 跳转到当前歌曲的指定时间
+bool Esp32Music::Seek(int64_t position_ms) {
+    if (!is_playing_) {
+        ESP_LOGW(TAG, "No streaming in progress, cannot seek");
+        return false;
+    }
+    position_ms = std::max<int64_t>(position_ms, 0);
+    
+    QueuedSong song;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        song.name = current_song_name_;
+        song.music_url = current_music_url_;
+        song.cache_key = current_cache_key_;
+    }
+    
+    size_t offset = 0;
+    {
+        std::lock_guard<std::mutex> lock(seek_mutex_);
+        // 找到目标时间之前最近的索引帧，再按码率估算剩下的距离
+        auto it = std::upper_bound(seek_index_.begin(), seek_index_.end(), position_ms,
+            [](int64_t time_ms, const std::pair<int64_t, size_t>& entry) { return time_ms < entry.first; });
+        int64_t base_time_ms = 0;
+        size_t base_offset = audio_data_offset_;
+        if (it != seek_index_.begin()) {
+            --it;
+            base_time_ms = it->first;
+            base_offset = it->second;
+        }
+        if (position_ms > base_time_ms && stream_bitrate_ <= 0) {
+            ESP_LOGW(TAG, "Bitrate unknown, cannot seek to %lldms", position_ms);
+            return false;
+        }
+        // 估算的位置不在帧边界上，播放线程会从那里找到下一个帧同步字
+        offset = base_offset + (size_t)((position_ms - base_time_ms) * stream_bitrate_ / 8000);
+    }
+    
+    ESP_LOGI(TAG, "Seeking to %lldms, byte offset %u", position_ms, offset);
+    
+    // 重新从头查找歌词，重新显示歌名
+    current_lyric_index_ = -1;
+    song_name_displayed_ = false;
+    return StartStreamingAt(song, offset, position_ms);
+}
+
 // 停止流式播放
 bool Esp32Music::StopStreaming() {
     ESP_LOGI(TAG, "Stopping music streaming - current state: downloading=%d, playing=%d", 
             is_downloading_.load(), is_playing_.load());
 
-    // 重置采样率到原始值
-    ResetSampleRate();
+    // 丢弃还没播放的音乐帧
+    FlushPcmPlayback();
     
     // 检查是否有流式播放正在进行
     if (!is_playing_ && !is_downloading_) {
@@ -517,10 +668,8 @@ bool Esp32Music::StopStreaming() {
     }
     
     // 通知所有等待的线程
-    {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
-    }
+    stream_buffer_.Abort();
+    NotifyStreamThreads();
     
     // 等待线程结束（避免重复代码，让StopStreaming也能等待线程完全停止）
     if (download_thread_.joinable()) {
@@ -534,10 +683,7 @@ bool Esp32Music::StopStreaming() {
         is_playing_ = false;
         
         // 通知条件变量，确保线程能够退出
-        {
-            std::lock_guard<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.notify_all();
-        }
+        stream_buffer_.Abort();
         
         // 使用超时机制等待线程结束，避免死锁
         bool thread_finished = false;
@@ -566,6 +712,14 @@ bool Esp32Music::StopStreaming() {
         }
     }
     
+    // 停止播放时也清空排队的歌曲
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        next_song_ = QueuedSong();
+        incoming_song_ = QueuedSong();
+    }
+    song_boundary_ = NO_SONG_BOUNDARY;
+    
     // 在线程完全结束后，只在频谱模式下停止FFT显示
     if (display && display_mode_ == DISPLAY_MODE_SPECTRUM) {
         display->stopFft();
@@ -578,188 +732,237 @@ bool Esp32Music::StopStreaming() {
     return true;
 }
 
-// 流式下载音频数据
-void Esp32Music::DownloadAudioStream(const std::string& music_url) {
-    ESP_LOGD(TAG, "Starting audio stream download from: %s", music_url.c_str());
+// 流式下载音频数据，当前歌曲下载完后接着把排队的下一首写入同一个环形缓冲区
+void Esp32Music::DownloadAudioStream(QueuedSong song, size_t offset) {
+    ESP_LOGD(TAG, "Starting audio stream download from: %s", song.music_url.c_str());
     
     // 验证URL有效性
-    if (music_url.empty() || music_url.find("http") != 0) {
-        ESP_LOGE(TAG, "Invalid URL format: %s", music_url.c_str());
-        is_downloading_ = false;
-        return;
-    }
-    
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    // 设置基本请求头
-    http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
-    http->SetHeader("Accept", "*/*");
-    http->SetHeader("Range", "bytes=0-");  // 支持断点续传
-    
-    // 添加ESP32认证头
-    add_auth_headers(http.get());
-    
-    if (!http->Open("GET", music_url)) {
-        ESP_LOGE(TAG, "Failed to connect to music stream URL");
+    if (song.music_url.find("http") != 0 && song.music_url.find(MUSIC_CACHE_URL_PREFIX) != 0) {
+        ESP_LOGE(TAG, "Invalid URL format: %s", song.music_url.c_str());
         is_downloading_ = false;
+        stream_buffer_.SetEndOfStream();
         return;
     }
     
-    int status_code = http->GetStatusCode();
-    if (status_code != 200 && status_code != 206) {  // 206 for partial content
-        ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
-        http->Close();
-        is_downloading_ = false;
-        return;
-    }
-    
-    ESP_LOGI(TAG, "Started downloading audio stream, status: %d", status_code);
-    
-    // 分块读取音频数据
-    const size_t chunk_size = 4096;  // 4KB每块
-    char buffer[chunk_size];
-    size_t total_downloaded = 0;
-    
-    while (is_downloading_ && is_playing_) {
-        int bytes_read = http->Read(buffer, chunk_size);
-        if (bytes_read < 0) {
-            ESP_LOGE(TAG, "Failed to read audio data: error code %d", bytes_read);
-            break;
+    while (DownloadSong(song, offset, 0)) {
+        // 完整下载的歌曲存入缓存
+        if (cache_.EndWrite()) {
+            StorePendingLyrics(song.cache_key);
         }
-        if (bytes_read == 0) {
-            ESP_LOGI(TAG, "Audio stream download completed, total: %d bytes", total_downloaded);
-            break;
-        }
-        
-        // 打印数据块信息
-        // ESP_LOGI(TAG, "Downloaded chunk: %d bytes at offset %d", bytes_read, total_downloaded);
         
-        // 安全地打印数据块的十六进制内容（前16字节）
-        if (bytes_read >= 16) {
-            // ESP_LOGI(TAG, "Data: %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %02X ...", 
-            //         (unsigned char)buffer[0], (unsigned char)buffer[1], (unsigned char)buffer[2], (unsigned char)buffer[3],
-            //         (unsigned char)buffer[4], (unsigned char)buffer[5], (unsigned char)buffer[6], (unsigned char)buffer[7],
-            //         (unsigned char)buffer[8], (unsigned char)buffer[9], (unsigned char)buffer[10], (unsigned char)buffer[11],
-            //         (unsigned char)buffer[12], (unsigned char)buffer[13], (unsigned char)buffer[14], (unsigned char)buffer[15]);
-        } else {
-            ESP_LOGI(TAG, "Data chunk too small: %d bytes", bytes_read);
-        }
-        
-        // 尝试检测文件格式（检查文件头）
-        if (total_downloaded == 0 && bytes_read >= 4) {
-            if (memcmp(buffer, "ID3", 3) == 0) {
-                ESP_LOGI(TAG, "Detected MP3 file with ID3 tag");
-            } else if (buffer[0] == 0xFF && (buffer[1] & 0xE0) == 0xE0) {
-                ESP_LOGI(TAG, "Detected MP3 file header");
-            } else if (memcmp(buffer, "RIFF", 4) == 0) {
-                ESP_LOGI(TAG, "Detected WAV file");
-            } else if (memcmp(buffer, "fLaC", 4) == 0) {
-                ESP_LOGI(TAG, "Detected FLAC file");
-            } else if (memcmp(buffer, "OggS", 4) == 0) {
-                ESP_LOGI(TAG, "Detected OGG file");
-            } else {
-                ESP_LOGI(TAG, "Unknown audio format, first 4 bytes: %02X %02X %02X %02X", 
-                        (unsigned char)buffer[0], (unsigned char)buffer[1], 
-                        (unsigned char)buffer[2], (unsigned char)buffer[3]);
+        // 当前歌曲播完之前都可以排队下一首，剩下不到一次解码的数据时要结束数据流，让播放线程把它播完
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() {
+                return !next_song_.music_url.empty() || !is_downloading_ || !is_playing_ ||
+                    stream_buffer_.Size() <= STREAM_GUARD_SIZE;
+            });
+            if (next_song_.music_url.empty() || !is_downloading_ || !is_playing_) {
+                break;
             }
+            incoming_song_ = std::move(next_song_);
+            next_song_ = QueuedSong();
+            song = incoming_song_;
         }
         
-        // 创建音频数据块
-        uint8_t* chunk_data = (uint8_t*)heap_caps_malloc(bytes_read, MALLOC_CAP_SPIRAM);
-        if (!chunk_data) {
-            ESP_LOGE(TAG, "Failed to allocate memory for audio chunk");
+        // 预取下一首的开头，写在当前歌曲的数据后面，播放线程到这个位置时切换歌曲
+        song_boundary_ = stream_buffer_.GetStats().bytes_written;
+        ESP_LOGI(TAG, "Prefetching next song: %s", song.name.c_str());
+        if (!DownloadSong(song, 0, MUSIC_PREFETCH_SIZE)) {
             break;
         }
-        memcpy(chunk_data, buffer, bytes_read);
         
-        // 等待缓冲区有空间
+        // 等当前歌曲播完再下载剩下的部分，在这之前停止播放就不会浪费流量
         {
-            std::unique_lock<std::mutex> lock(buffer_mutex_);
-            buffer_cv_.wait(lock, [this] { return buffer_size_ < MAX_BUFFER_SIZE || !is_downloading_; });
-            
-            if (is_downloading_) {
-                audio_buffer_.push(AudioChunk(chunk_data, bytes_read));
-                buffer_size_ += bytes_read;
-                total_downloaded += bytes_read;
-                
-                // 通知播放线程有新数据
-                buffer_cv_.notify_one();
-                
-                if (total_downloaded % (256 * 1024) == 0) {  // 每256KB打印一次进度
-                    ESP_LOGI(TAG, "Downloaded %d bytes, buffer size: %d", total_downloaded, buffer_size_);
-                }
-            } else {
-                heap_caps_free(chunk_data);
-                break;
-            }
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this]() {
+                return !is_downloading_ || !is_playing_ || song_boundary_ == NO_SONG_BOUNDARY;
+            });
         }
+        offset = MUSIC_PREFETCH_SIZE;
     }
     
-    http->Close();
+    // 没下载完的歌曲不进缓存
+    cache_.AbortWrite();
     is_downloading_ = false;
     
-    // 通知播放线程下载完成
+    // 通知播放线程下载完成，缓冲区里剩下的数据继续播放
+    stream_buffer_.SetEndOfStream();
+    
+    ESP_LOGI(TAG, "Audio stream download thread finished");
+}
+
+// 缓存中的歌曲从Flash读取，其他的从网络下载
+bool Esp32Music::DownloadSong(const QueuedSong& song, size_t offset, size_t end) {
+    if (song.music_url.find(MUSIC_CACHE_URL_PREFIX) == 0) {
+        // 缓存中的歌曲没有Content-Type，只按文件头识别格式
+        if (offset == 0) {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            stream_content_type_.clear();
+        }
+        return ReadCachedRange(song.cache_key, offset, end);
+    }
+    return DownloadRange(song.music_url, offset, end, song.cache_key);
+}
+
+// 从Flash缓存读取歌曲的[offset, end)部分写入环形缓冲区
+bool Esp32Music::ReadCachedRange(const std::string& cache_key, size_t offset, size_t end) {
+    const size_t chunk_size = 4096;
+    while (is_downloading_ && is_playing_ && (end == 0 || offset < end)) {
+        size_t region_size = 0;
+        uint8_t* buffer = stream_buffer_.WaitWriteRegion(region_size);
+        if (buffer == nullptr) {
+            return false;
+        }
+        size_t read_size = std::min(region_size, chunk_size);
+        if (end > 0) {
+            read_size = std::min(read_size, end - offset);
+        }
+        int bytes_read = cache_.ReadAudio(cache_key, offset, buffer, read_size);
+        if (bytes_read < 0) {
+            // 跳转时歌曲可能已经被换出缓存
+            ESP_LOGE(TAG, "Failed to read %s from cache at offset %u", cache_key.c_str(), offset);
+            return false;
+        }
+        if (bytes_read == 0) {
+            break;
+        }
+        stream_buffer_.CommitWrite(bytes_read);
+        offset += bytes_read;
+    }
+    return is_downloading_ && is_playing_;
+}
+
+// 把歌曲下载完之前就下载好的歌词存入缓存
+void Esp32Music::StorePendingLyrics(const std::string& cache_key) {
+    std::string lyrics;
     {
-        std::lock_guard<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.notify_all();
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        if (pending_lyrics_key_ != cache_key) {
+            return;
+        }
+        lyrics = std::move(pending_lyrics_);
+        pending_lyrics_.clear();
+        pending_lyrics_key_.clear();
     }
+    cache_.StoreLyrics(cache_key, lyrics);
+}
+
+// 下载文件的[offset, end)部分写入环形缓冲区，end为0表示下载到文件末尾
+// 连接断开或读取出错时，用Range请求从已收到的位置继续下载，返回false表示下载被停止或多次重试仍然失败
+bool Esp32Music::DownloadRange(const std::string& music_url, size_t offset, size_t end, const std::string& cache_key) {
+    auto network = Board::GetInstance().GetNetwork();
+    size_t position = offset;
     
-    ESP_LOGI(TAG, "Audio stream download thread finished");
+    ResumableDownloadCallbacks callbacks;
+    callbacks.create_http = [this, network]() {
+        auto http = network->CreateHttp(0);
+        
+        // 设置基本请求头，Range由ResumableDownload添加
+        http->SetHeader("User-Agent", "ESP32-Music-Player/1.0");
+        http->SetHeader("Accept", "*/*");
+        
+        // 添加ESP32认证头
+        add_auth_headers(http.get());
+        
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.connections++;
+        return http;
+    };
+    callbacks.is_running = [this]() {
+        return is_downloading_ && is_playing_;
+    };
+    callbacks.on_response = [this, end, &cache_key](int status_code, size_t request_offset, size_t body_end,
+            const std::string& content_type) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            stream_content_type_ = content_type;
+        }
+        // 从头下载的歌曲边播边写入缓存
+        if (request_offset == 0 && !cache_key.empty()) {
+            cache_.BeginWrite(cache_key, end == 0 ? body_end : 0);
+        }
+    };
+    callbacks.wait_write_region = [this](size_t& size) {
+        // 等待缓冲区有空间（缓冲区满后要降到低水位才继续下载），直接读入环形缓冲区的空闲区域
+        return stream_buffer_.WaitWriteRegion(size);
+    };
+    callbacks.commit_write = [this, &position](const uint8_t* data, size_t size) {
+        stream_buffer_.CommitWrite(size);
+        cache_.Write(data, size);
+        position += size;
+        if (position % (256 * 1024) == 0) {  // 每256KB打印一次进度
+            ESP_LOGI(TAG, "Downloaded %u bytes, buffer size: %u", position, stream_buffer_.Size());
+        }
+    };
+    callbacks.on_read = [this](size_t bytes, int64_t read_us, int64_t ttfb_us) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.download_bytes += bytes;
+        stats_.download_us += read_us;
+        if (ttfb_us >= 0) {
+            stats_.last_ttfb_ms = ttfb_us / 1000;
+            stats_.max_ttfb_ms = std::max(stats_.max_ttfb_ms, stats_.last_ttfb_ms);
+        }
+    };
+    
+    ResumableDownload download(MUSIC_RESUME_MAX_RETRIES, MUSIC_RESUME_BACKOFF_MS, std::move(callbacks));
+    if (!download.Run(music_url, offset, end)) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Audio stream download completed, total: %u bytes", download.offset());
+    return true;
 }
 
 // 流式播放音频数据
 void Esp32Music::PlayAudioStream() {
     ESP_LOGI(TAG, "Starting audio stream playback");
     
-    // 初始化时间跟踪变量
-    current_play_time_ms_ = 0;
+    // 初始化时间跟踪变量，跳转后从跳转的位置开始计时
+    current_play_time_ms_ = stream_start_time_ms_;
     last_frame_time_ms_ = 0;
     total_frames_decoded_ = 0;
     
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (!codec || !codec->output_enabled()) {
-        ESP_LOGE(TAG, "Audio codec not available or not enabled");
-        is_playing_ = false;
-        return;
-    }
-    
-    if (!mp3_decoder_initialized_) {
-        ESP_LOGE(TAG, "MP3 decoder not initialized");
+    // 等待缓冲区有足够数据开始播放
+    if (!stream_buffer_.WaitForStart()) {
+        ESP_LOGW(TAG, "No audio data to play");
         is_playing_ = false;
+        NotifyStreamThreads();
         return;
     }
     
-    
-    // 等待缓冲区有足够数据开始播放
-    {
-        std::unique_lock<std::mutex> lock(buffer_mutex_);
-        buffer_cv_.wait(lock, [this] { 
-            return buffer_size_ >= MIN_BUFFER_SIZE || (!is_downloading_ && !audio_buffer_.empty()); 
-        });
-    }
-    
     ESP_LOGI(TAG, "小智开源音乐固件qq交流群:826072986");
-    ESP_LOGI(TAG, "Starting playback with buffer size: %d", buffer_size_);
+    ESP_LOGI(TAG, "Starting playback with buffer size: %d", stream_buffer_.Size());
     
     size_t total_played = 0;
-    uint8_t* mp3_input_buffer = nullptr;
-    int bytes_left = 0;
-    uint8_t* read_ptr = nullptr;
-    
-    // 分配MP3输入缓冲区
-    mp3_input_buffer = (uint8_t*)heap_caps_malloc(8192, MALLOC_CAP_SPIRAM);
-    if (!mp3_input_buffer) {
-        ESP_LOGE(TAG, "Failed to allocate MP3 input buffer");
-        is_playing_ = false;
-        return;
-    }
     
-    // 标记是否已经处理过ID3标签
-    bool id3_processed = false;
+    // 标记是否已经处理过ID3标签，跳转到文件中间时不用处理
+    bool id3_processed = stream_start_offset_ > 0;
+    // 当前歌曲中的字节偏移，用于记录帧索引
+    size_t stream_position = stream_start_offset_;
+    // 从环形缓冲区读出的总字节数，用于判断是否到了下一首的起始位置
+    uint64_t stream_read = 0;
+    int64_t next_index_time_ms = current_play_time_ms_;
+    // 媒体时间：按解码出的样本数累计（采样率变化时换一个起点），跨过无缝切换的歌曲继续累计，
+    // 随PCM帧送给AudioService，由它得出扬声器正在播放的位置
+    int64_t media_base_us = stream_start_time_ms_ * 1000;
+    int64_t media_samples = 0;
+    int media_sample_rate = 0;
+    auto media_time_us = [&]() {
+        return media_sample_rate > 0 ? media_base_us + media_samples * 1000000 / media_sample_rate : media_base_us;
+    };
+    song_start_us_ = 0;
+    int64_t next_stats_sample_us = 0;
+    
+    // 歌词模式下按播放时钟刷新歌词
+    ScheduleLyrics();
+    // 解码出的交织PCM，和送往AudioService的单声道PCM帧（入队时换回一个已回收的缓冲区）
+    std::vector<int16_t> pcm_buffer;
+    std::vector<int16_t> pcm_frame;
+    // 设备忙时暂停播放，进入暂停时丢弃一次还没播放的音乐帧
+    bool paused = false;
     
     while (is_playing_) {
-        // 检查设备状态，只有在空闲状态才播放音乐
+        // 检查设备状态，只有在空闲和说话状态才播放音乐，说话时混音器会压低音乐音量
         auto& app = Application::GetInstance();
         DeviceState current_state = app.GetDeviceState();
         
@@ -770,12 +973,24 @@ void Esp32Music::PlayAudioStream() {
             app.ToggleChatState(); // 变成待机状态
             vTaskDelay(pdMS_TO_TICKS(300));
             continue;
-        } else if (current_state != kDeviceStateIdle) { // 不是待机状态，就一直卡在这里，不让播放音乐
-            ESP_LOGD(TAG, "Device state is %d, pausing music playback", current_state);
-            // 如果不是空闲状态，暂停播放
-            vTaskDelay(pdMS_TO_TICKS(50));
+        } else if (current_state != kDeviceStateIdle && current_state != kDeviceStateSpeaking) { // 不是待机或说话状态，就一直卡在这里，不让播放音乐
+            if (!paused) {
+                ESP_LOGI(TAG, "Device state is %d, pausing music playback", current_state);
+                // 如果不是空闲状态，暂停播放，丢弃还没播放的音乐帧
+                app.GetAudioService().EndPcmStream(true);
+                paused = true;
+            }
+            // 等设备状态变化或者停止播放
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_cv_.wait(lock, [this, &app, current_state]() {
+                return !is_playing_ || app.GetDeviceState() != current_state;
+            });
             continue;
         }
+        if (paused) {
+            ESP_LOGI(TAG, "Device state is %d, resuming music playback", current_state);
+            paused = false;
+        }
         
         // 设备状态检查通过，显示当前播放的歌名
         if (!song_name_displayed_ && !current_song_name_.empty()) {
@@ -800,207 +1015,253 @@ void Esp32Music::PlayAudioStream() {
             }
         }
         
-        // 如果需要更多MP3数据，从缓冲区读取
-        if (bytes_left < 4096) {  // 保持至少4KB数据用于解码
-            AudioChunk chunk;
-            
-            // 从缓冲区获取音频数据
-            {
-                std::unique_lock<std::mutex> lock(buffer_mutex_);
-                if (audio_buffer_.empty()) {
-                    if (!is_downloading_) {
-                        // 下载完成且缓冲区为空，播放结束
-                        ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played);
-                        break;
-                    }
-                    // 等待新数据
-                    buffer_cv_.wait(lock, [this] { return !audio_buffer_.empty() || !is_downloading_; });
-                    if (audio_buffer_.empty()) {
-                        continue;
-                    }
+        // 直接从环形缓冲区取音频数据（保持至少4KB数据用于解码），回绕处的数据由缓冲区拼接成连续的
+        size_t available = 0;
+        uint8_t* data = stream_buffer_.WaitReadRegion(STREAM_GUARD_SIZE, available);
+        if (data == nullptr) {
+            // 下载完成且缓冲区为空，播放结束
+            ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played);
+            break;
+        }
+        
+        // 不把下一首的数据送给当前歌曲的解码，到了下一首的起始位置就直接切换过去，中间不停顿
+        uint64_t song_boundary = song_boundary_;
+        if (song_boundary != NO_SONG_BOUNDARY) {
+            if (stream_read >= song_boundary) {
+                std::string cache_key;
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    current_song_name_ = incoming_song_.name;
+                    current_music_url_ = incoming_song_.music_url;
+                    current_cache_key_ = incoming_song_.cache_key;
+                    current_lyric_url_ = incoming_song_.lyric_url;
+                    cache_key = current_cache_key_;
+                    incoming_song_ = QueuedSong();
                 }
-                
-                chunk = audio_buffer_.front();
-                audio_buffer_.pop();
-                buffer_size_ -= chunk.size;
-                
-                // 通知下载线程缓冲区有空间
-                buffer_cv_.notify_one();
-            }
-            
-            // 将新数据添加到MP3输入缓冲区
-            if (chunk.data && chunk.size > 0) {
-                // 移动剩余数据到缓冲区开头
-                if (bytes_left > 0 && read_ptr != mp3_input_buffer) {
-                    memmove(mp3_input_buffer, read_ptr, bytes_left);
+                cache_.Pin(cache_key);
+                {
+                    std::lock_guard<std::mutex> lock(seek_mutex_);
+                    seek_index_.clear();
+                    audio_data_offset_ = 0;
+                    stream_bitrate_ = 0;
                 }
+                // 通知下载线程继续下载下一首剩下的部分
+                song_boundary_ = NO_SONG_BOUNDARY;
+                NotifyStreamThreads();
+                ESP_LOGI(TAG, "Switching to next song: %s", current_song_name_.c_str());
                 
-                // 检查缓冲区空间
-                size_t space_available = 8192 - bytes_left;
-                size_t copy_size = std::min(chunk.size, space_available);
+                // 下一首可能是另一种格式，取到数据后重新识别
+                decoder_.reset();
+                song_start_us_ = media_time_us();
+                current_play_time_ms_ = 0;
+                total_frames_decoded_ = 0;
+                next_index_time_ms = 0;
+                id3_processed = false;
+                stream_position = 0;
                 
-                // 复制新数据
-                memcpy(mp3_input_buffer + bytes_left, chunk.data, copy_size);
-                bytes_left += copy_size;
-                read_ptr = mp3_input_buffer;
-                
-                // 检查并跳过ID3标签（仅在开始时处理一次）
-                if (!id3_processed && bytes_left >= 10) {
-                    size_t id3_skip = SkipId3Tag(read_ptr, bytes_left);
-                    if (id3_skip > 0) {
-                        read_ptr += id3_skip;
-                        bytes_left -= id3_skip;
-                        ESP_LOGI(TAG, "Skipped ID3 tag: %u bytes", (unsigned int)id3_skip);
-                    }
-                    id3_processed = true;
+                // 频谱显示已经在运行，只更新歌名
+                auto display = Board::GetInstance().GetDisplay();
+                if (display) {
+                    std::string formatted_song_name = "《" + current_song_name_ + "》播放中...";
+                    display->SetMusicInfo(formatted_song_name.c_str());
                 }
-                
-                // 释放chunk内存
-                heap_caps_free(chunk.data);
+                // 只清掉上一首的歌词，歌词下载在单独的线程里，不会让解码停下来
+                StartLyrics();
+                continue;
             }
+            available = std::min<uint64_t>(available, song_boundary - stream_read);
         }
         
-        // 尝试找到MP3帧同步
-        int sync_offset = MP3FindSyncWord(read_ptr, bytes_left);
-        if (sync_offset < 0) {
-            ESP_LOGW(TAG, "No MP3 sync word found, skipping %d bytes", bytes_left);
-            bytes_left = 0;
-            continue;
+        // 检查并跳过ID3标签（仅在开始时处理一次），标签可能比当前缓冲的数据大
+        if (!id3_processed) {
+            id3_processed = true;
+            size_t id3_skip = SkipId3Tag(data, available);
+            if (id3_skip > 0) {
+                ESP_LOGI(TAG, "Skipped ID3 tag: %u bytes", (unsigned int)id3_skip);
+                stream_buffer_.Skip(id3_skip);
+                stream_read += id3_skip;
+                stream_position += id3_skip;
+                std::lock_guard<std::mutex> lock(seek_mutex_);
+                audio_data_offset_ = stream_position;
+                continue;
+            }
         }
         
-        // 跳过到同步位置
-        if (sync_offset > 0) {
-            read_ptr += sync_offset;
-            bytes_left -= sync_offset;
+        // 每首歌开始时按文件头和Content-Type选择解码器
+        if (!decoder_) {
+            std::string content_type;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex_);
+                content_type = stream_content_type_;
+            }
+            MusicFormat format = DetectMusicFormat(data, available, content_type);
+            decoder_ = CreateMusicDecoder(format);
+            if (!decoder_) {
+                // AAC和Ogg/Vorbis只能识别，没有解码器，服务器需要提供MP3、Ogg/Opus或WAV
+                ESP_LOGE(TAG, "Cannot play %s stream", MusicFormatName(format));
+                break;
+            }
+            ESP_LOGI(TAG, "Decoding %s stream", MusicFormatName(format));
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.format = format;
         }
         
-        // 解码MP3帧
-        int16_t pcm_buffer[2304];
-        int decode_result = MP3Decode(mp3_decoder_, &read_ptr, &bytes_left, pcm_buffer, 0);
+        // 解码一帧，解码器报告用掉的字节数和这一帧在数据中的起始位置
+        size_t consumed = 0;
+        size_t frame_offset = 0;
+        MusicFrameInfo frame_info;
+        int64_t decode_start = esp_timer_get_time();
+        MusicDecodeResult decode_result = decoder_->DecodeFrame(data, available, consumed, frame_offset,
+            pcm_buffer, frame_info);
+        int64_t decode_end = esp_timer_get_time();
+        if (consumed == 0 && decode_result != kMusicDecodeFrame) {
+            // 剩下的数据不够一帧，只会发生在歌曲结尾，丢掉
+            consumed = available;
+        }
+        size_t frame_position = stream_position + frame_offset;
+        stream_buffer_.Consume(consumed);
+        stream_read += consumed;
+        stream_position += consumed;
         
-        if (decode_result == 0) {
-            // 解码成功，获取帧信息
-            MP3GetLastFrameInfo(mp3_decoder_, &mp3_frame_info_);
+        // 记录解码耗时和缓冲区大小
+        {
+            size_t buffered = stream_buffer_.Size();
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            if (decode_result == kMusicDecodeFrame) {
+                uint32_t decode_us = decode_end - decode_start;
+                stats_.decoded_frames++;
+                stats_.decode_total_us += decode_us;
+                stats_.decode_max_us = std::max(stats_.decode_max_us, decode_us);
+            }
+            buffer_min_ = std::min(buffer_min_, buffered);
+            if (decode_end >= next_stats_sample_us) {
+                next_stats_sample_us = decode_end + MUSIC_STATS_SAMPLE_INTERVAL_MS * 1000;
+                size_t index = (buffer_history_head_ + buffer_history_count_) % MUSIC_STATS_HISTORY_SIZE;
+                buffer_history_kb_[index] = buffered / 1024;
+                if (buffer_history_count_ < MUSIC_STATS_HISTORY_SIZE) {
+                    buffer_history_count_++;
+                } else {
+                    buffer_history_head_ = (buffer_history_head_ + 1) % MUSIC_STATS_HISTORY_SIZE;
+                }
+            }
+        }
+        
+        if (decode_result == kMusicDecodeFrame) {
             total_frames_decoded_++;
             
             // 基本的帧信息有效性检查，防止除零错误
-            if (mp3_frame_info_.samprate == 0 || mp3_frame_info_.nChans == 0) {
+            if (frame_info.sample_rate == 0 || frame_info.channels == 0) {
                 ESP_LOGW(TAG, "Invalid frame info: rate=%d, channels=%d, skipping", 
-                        mp3_frame_info_.samprate, mp3_frame_info_.nChans);
+                        frame_info.sample_rate, frame_info.channels);
                 continue;
             }
             
+            // 每隔一段时间记录一帧的位置，用于按时间跳转；跳回去重播的部分已经记录过了
+            if (current_play_time_ms_ >= next_index_time_ms) {
+                std::lock_guard<std::mutex> lock(seek_mutex_);
+                if ((seek_index_.empty() || seek_index_.back().first < current_play_time_ms_) &&
+                    seek_index_.size() < MUSIC_SEEK_INDEX_MAX_ENTRIES) {
+                    seek_index_.emplace_back(current_play_time_ms_, frame_position);
+                }
+                stream_bitrate_ = frame_info.bitrate;
+                next_index_time_ms = current_play_time_ms_ + MUSIC_SEEK_INDEX_INTERVAL_MS;
+            }
+            
             // 计算当前帧的持续时间(毫秒)
-            int frame_duration_ms = (mp3_frame_info_.outputSamps * 1000) / 
-                                  (mp3_frame_info_.samprate * mp3_frame_info_.nChans);
+            int sample_count = pcm_buffer.size();
+            int frame_duration_ms = (sample_count * 1000) / 
+                                  (frame_info.sample_rate * frame_info.channels);
             
             // 更新当前播放时间
             current_play_time_ms_ += frame_duration_ms;
             
             ESP_LOGD(TAG, "Frame %d: time=%lldms, duration=%dms, rate=%d, ch=%d", 
                     total_frames_decoded_, current_play_time_ms_, frame_duration_ms,
-                    mp3_frame_info_.samprate, mp3_frame_info_.nChans);
+                    frame_info.sample_rate, frame_info.channels);
             
-            // 更新歌词显示
-            int buffer_latency_ms = 600; // 实测调整值
-            UpdateLyricDisplay(current_play_time_ms_ + buffer_latency_ms);
+            // 这一帧第一个样本的媒体时间
+            if (frame_info.sample_rate != media_sample_rate) {
+                if (media_sample_rate > 0) {
+                    ESP_LOGI(TAG, "Stream sample rate changed from %d to %d Hz", media_sample_rate, frame_info.sample_rate);
+                }
+                {
+                    std::lock_guard<std::mutex> lock(stats_mutex_);
+                    stats_.sample_rate_switches += media_sample_rate > 0 ? 1 : 0;
+                    stats_.sample_rate = frame_info.sample_rate;
+                }
+                media_base_us = media_time_us();
+                media_samples = 0;
+                media_sample_rate = frame_info.sample_rate;
+            }
+            int64_t frame_position_us = media_time_us();
+            media_samples += sample_count / frame_info.channels;
             
-            // 将PCM数据发送到Application的音频解码队列
-            if (mp3_frame_info_.outputSamps > 0) {
-                int16_t* final_pcm_data = pcm_buffer;
-                int final_sample_count = mp3_frame_info_.outputSamps;
-                std::vector<int16_t> mono_buffer;
-                
+            // 将PCM数据送入AudioService的PCM播放队列
+            if (sample_count > 0) {
                 // 如果是双通道，转换为单通道混合
-                if (mp3_frame_info_.nChans == 2) {
+                if (frame_info.channels == 2) {
                     // 双通道转单通道：将左右声道混合
-                    int stereo_samples = mp3_frame_info_.outputSamps;  // 包含左右声道的总样本数
-                    int mono_samples = stereo_samples / 2;  // 实际的单声道样本数
-                    
-                    mono_buffer.resize(mono_samples);
-                    
+                    int mono_samples = sample_count / 2;  // 实际的单声道样本数
+                    pcm_frame.resize(mono_samples);
                     for (int i = 0; i < mono_samples; ++i) {
                         // 混合左右声道 (L + R) / 2
                         int left = pcm_buffer[i * 2];      // 左声道
                         int right = pcm_buffer[i * 2 + 1]; // 右声道
-                        mono_buffer[i] = (int16_t)((left + right) / 2);
+                        pcm_frame[i] = (int16_t)((left + right) / 2);
                     }
-                    
-                    final_pcm_data = mono_buffer.data();
-                    final_sample_count = mono_samples;
 
                     ESP_LOGD(TAG, "Converted stereo to mono: %d -> %d samples", 
-                            stereo_samples, mono_samples);
-                } else if (mp3_frame_info_.nChans == 1) {
-                    // 已经是单声道，无需转换
-                    ESP_LOGD(TAG, "Already mono audio: %d samples", final_sample_count);
+                            sample_count, mono_samples);
                 } else {
-                    ESP_LOGW(TAG, "Unsupported channel count: %d, treating as mono", 
-                            mp3_frame_info_.nChans);
+                    if (frame_info.channels != 1) {
+                        ESP_LOGW(TAG, "Unsupported channel count: %d, treating as mono", 
+                                frame_info.channels);
+                    }
+                    pcm_frame.assign(pcm_buffer.begin(), pcm_buffer.end());
                 }
-                
-                // 创建AudioStreamPacket
-                AudioStreamPacket packet;
-                packet.sample_rate = mp3_frame_info_.samprate;
-                packet.frame_duration = 60;  // 使用Application默认的帧时长
-                packet.timestamp = 0;
-                
-                // 将int16_t PCM数据转换为uint8_t字节数组
+                int final_sample_count = pcm_frame.size();
                 size_t pcm_size_bytes = final_sample_count * sizeof(int16_t);
-                packet.payload.resize(pcm_size_bytes);
-                memcpy(packet.payload.data(), final_pcm_data, pcm_size_bytes);
 
-                if (final_pcm_data_fft == nullptr) {
-                    final_pcm_data_fft = (int16_t*)heap_caps_malloc(
-                        final_sample_count * sizeof(int16_t),
-                        MALLOC_CAP_SPIRAM
-                    );
-                }
-                
-                memcpy(
-                    final_pcm_data_fft,
-                    final_pcm_data,
-                    final_sample_count * sizeof(int16_t)
-                );
-                
                 ESP_LOGD(TAG, "Sending %d PCM samples (%d bytes, rate=%d, channels=%d->1) to Application", 
-                        final_sample_count, pcm_size_bytes, mp3_frame_info_.samprate, mp3_frame_info_.nChans);
+                        final_sample_count, pcm_size_bytes, frame_info.sample_rate, frame_info.channels);
                 
-                // 发送到Application的音频解码队列
-                app.AddAudioData(std::move(packet));
+                // 送入AudioService的PCM播放队列，队列满时在这里等待
+                app.AddAudioData(std::move(pcm_frame), frame_info.sample_rate, frame_position_us);
                 total_played += pcm_size_bytes;
                 
                 // 打印播放进度
                 if (total_played % (128 * 1024) == 0) {
-                    ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played, buffer_size_);
+                    ESP_LOGI(TAG, "Played %d bytes, buffer size: %d", total_played, stream_buffer_.Size());
                 }
             }
-            
-        } else {
-            // 解码失败
-            ESP_LOGW(TAG, "MP3 decode failed with error: %d", decode_result);
-            
-            // 跳过一些字节继续尝试
-            if (bytes_left > 1) {
-                read_ptr++;
-                bytes_left--;
-            } else {
-                bytes_left = 0;
-            }
         }
     }
     
-    // 清理
-    if (mp3_input_buffer) {
-        heap_caps_free(mp3_input_buffer);
+    // 打印缓冲区统计：水位、欠载次数和下载暂停次数
+    auto stats = stream_buffer_.GetStats();
+    ESP_LOGI(TAG, "Stream buffer: size=%u/%u peak=%u written=%llu read=%llu underruns=%lu (%llums) writer_pauses=%lu",
+            stats.size, stats.capacity, stats.peak_size, stats.bytes_written, stats.bytes_read,
+            stats.underruns, stats.underrun_us / 1000, stats.writer_pauses);
+    auto cache_stats = cache_.GetStats();
+    if (cache_stats.capacity > 0) {
+        ESP_LOGI(TAG, "Music cache: hits=%lu/%lu saved=%llu bytes, entries=%lu used=%u/%u stored=%lu evictions=%lu corrupted=%lu",
+                cache_stats.hits, cache_stats.lookups, cache_stats.bytes_saved, cache_stats.entries,
+                cache_stats.used_bytes, cache_stats.capacity, cache_stats.stored, cache_stats.evictions,
+                cache_stats.corrupted);
     }
     
     // 播放结束时进行基本清理，但不调用StopStreaming避免线程自我等待
+    // 已入队的音乐帧继续播放完
+    Application::GetInstance().GetAudioService().EndPcmStream(false);
     ESP_LOGI(TAG, "Audio stream playback finished, total played: %d bytes", total_played);
     ESP_LOGI(TAG, "Performing basic cleanup from play thread");
     
-    // 停止播放标志
+    // 停止播放标志，下载线程可能在等这首歌播完
     is_playing_ = false;
+    NotifyStreamThreads();
+    if (lyric_timer_ != nullptr) {
+        esp_timer_stop(lyric_timer_);
+    }
     
     // 只在频谱显示模式下才停止FFT显示
     if (display_mode_ == DISPLAY_MODE_SPECTRUM) {
@@ -1015,63 +1276,25 @@ void Esp32Music::PlayAudioStream() {
     }
 }
 
+// 等待的条件在queue_mutex_保护下检查，加锁后再通知，避免线程检查完条件还没开始等待时错过通知
+void Esp32Music::NotifyStreamThreads() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    queue_cv_.notify_all();
+}
+
 // 清空音频缓冲区
 void Esp32Music::ClearAudioBuffer() {
-    std::lock_guard<std::mutex> lock(buffer_mutex_);
-    
-    while (!audio_buffer_.empty()) {
-        AudioChunk chunk = audio_buffer_.front();
-        audio_buffer_.pop();
-        if (chunk.data) {
-            heap_caps_free(chunk.data);
-        }
-    }
-    
-    buffer_size_ = 0;
+    stream_buffer_.Reset();
     ESP_LOGI(TAG, "Audio buffer cleared");
 }
 
-// 初始化MP3解码器
-bool Esp32Music::InitializeMp3Decoder() {
-    mp3_decoder_ = MP3InitDecoder();
-    if (mp3_decoder_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to initialize MP3 decoder");
-        mp3_decoder_initialized_ = false;
-        return false;
-    }
-    
-    mp3_decoder_initialized_ = true;
-    ESP_LOGI(TAG, "MP3 decoder initialized successfully");
-    return true;
-}
-
-// 清理MP3解码器
-void Esp32Music::CleanupMp3Decoder() {
-    if (mp3_decoder_ != nullptr) {
-        MP3FreeDecoder(mp3_decoder_);
-        mp3_decoder_ = nullptr;
-    }
-    mp3_decoder_initialized_ = false;
-    ESP_LOGI(TAG, "MP3 decoder cleaned up");
-}
-
-// 重置采样率到原始值
-void Esp32Music::ResetSampleRate() {
-    auto& board = Board::GetInstance();
-    auto codec = board.GetAudioCodec();
-    if (codec && codec->original_output_sample_rate() > 0 && 
-        codec->output_sample_rate() != codec->original_output_sample_rate()) {
-        ESP_LOGI(TAG, "重置采样率：从 %d Hz 重置到原始值 %d Hz", 
-                codec->output_sample_rate(), codec->original_output_sample_rate());
-        if (codec->SetOutputSampleRate(-1)) {  // -1 表示重置到原始值
-            ESP_LOGI(TAG, "成功重置采样率到原始值: %d Hz", codec->output_sample_rate());
-        } else {
-            ESP_LOGW(TAG, "无法重置采样率到原始值");
-        }
-    }
+// 结束PCM流：丢弃还没播放的音乐帧
+// 编解码器不再切换采样率，音乐帧由AudioService重采样到输出采样率
+void Esp32Music::FlushPcmPlayback() {
+    Application::GetInstance().GetAudioService().EndPcmStream(true);
 }
 
-// 跳过MP3文件开头的ID3标签
+// 跳过文件开头的ID3标签
 size_t Esp32Music::SkipId3Tag(uint8_t* data, size_t size) {
     if (!data || size < 10) {
         return 0;
@@ -1091,17 +1314,12 @@ size_t Esp32Music::SkipId3Tag(uint8_t* data, size_t size) {
     // ID3v2头部(10字节) + 标签内容
     size_t total_skip = 10 + tag_size;
     
-    // 确保不超过可用数据大小
-    if (total_skip > size) {
-        total_skip = size;
-    }
-    
     ESP_LOGI(TAG, "Found ID3v2 tag, skipping %u bytes", (unsigned int)total_skip);
     return total_skip;
 }
 
 // 下载歌词
-bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
+bool Esp32Music::DownloadLyrics(uint32_t song_id, const std::string& lyric_url, const std::string& cache_key) {
     ESP_LOGI(TAG, "Downloading lyrics from: %s", lyric_url.c_str());
     
     // 检查URL是否为空
@@ -1119,11 +1337,17 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
     int redirect_count = 0;
     const int max_redirects = 5;  // 最多允许5次重定向
     
-    while (retry_count < max_retries && !success && redirect_count < max_redirects) {
+    // 换歌或者停止播放之后，歌词编号会变，不再下载
+    while (retry_count < max_retries && !success && redirect_count < max_redirects && lyric_song_id_ == song_id) {
         if (retry_count > 0) {
             ESP_LOGI(TAG, "Retrying lyric download (attempt %d of %d)", retry_count + 1, max_retries);
-            // 重试前暂停一下
-            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            // 重试前暂停一下，期间换歌就马上退出
+            for (int i = 0; i < 10 && lyric_song_id_ == song_id; i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+            if (lyric_song_id_ != song_id) {
+                break;
+            }
         }
         
         // 使用Board提供的HTTP客户端
@@ -1182,7 +1406,7 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         // 由于无法获取Content-Length和Content-Type头，我们不知道预期大小和内容类型
         ESP_LOGD(TAG, "Starting to read lyric content");
         
-        while (true) {
+        while (lyric_song_id_ == song_id) {
             bytes_read = http->Read(buffer, sizeof(buffer) - 1);
             // ESP_LOGD(TAG, "Lyric HTTP read returned %d bytes", bytes_read); // 注释掉以减少日志输出
             
@@ -1228,6 +1452,11 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
         }
     }
     
+    if (!success && lyric_song_id_ != song_id) {
+        ESP_LOGI(TAG, "Song changed, lyric download stopped");
+        return false;
+    }
+    
     // 检查是否超过了最大重试次数
     if (retry_count >= max_retries) {
         ESP_LOGE(TAG, "Failed to download lyrics after %d attempts", max_retries);
@@ -1245,147 +1474,146 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
     }
     
     ESP_LOGI(TAG, "Lyrics downloaded successfully, size: %d bytes", lyric_content.length());
-    return ParseLyrics(lyric_content);
+    
+    // 按开始下载时的歌曲存入缓存，下载期间换了歌也不会存到下一首名下；歌曲还没存入缓存时先留着，等歌曲下载完再存
+    if (!cache_key.empty() && !cache_.StoreLyrics(cache_key, lyric_content)) {
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        pending_lyrics_key_ = cache_key;
+        pending_lyrics_ = lyric_content;
+    }
+    return ParseLyrics(song_id, lyric_content);
 }
 
 // 解析歌词
-bool Esp32Music::ParseLyrics(const std::string& lyric_content) {
+bool Esp32Music::ParseLyrics(uint32_t song_id, const std::string& lyric_content) {
     ESP_LOGI(TAG, "Parsing lyrics content");
     
-    // 使用锁保护lyrics_数组访问
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    lyrics_.clear();
+    bool parsed;
+    {
+        // StartLyrics()在这把锁里换编号，换过之后不会再显示上一首的歌词
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        if (lyric_song_id_ != song_id) {
+            ESP_LOGI(TAG, "Song changed, lyrics dropped");
+            return false;
+        }
+        parsed = lyrics_.Parse(lyric_content.data(), lyric_content.size());
+        current_lyric_index_ = -1;
+    }
     
-    // 按行分割歌词内容
-    std::istringstream stream(lyric_content);
-    std::string line;
+    // 歌词可能在开始播放之后才下载好，马上显示当前这一句
+    ScheduleLyrics();
+    return parsed;
+}
+
+// 根据显示模式决定是否下载和显示当前歌曲的歌词
+void Esp32Music::StartLyrics() {
+    // 换一个编号并清掉上一首的歌词，上一首还在下载的歌词线程自己会退出，不在这里等它
+    uint32_t song_id;
+    {
+        std::lock_guard<std::mutex> lock(lyrics_mutex_);
+        song_id = ++lyric_song_id_;
+        lyrics_.Clear();
+    }
+    current_lyric_index_ = -1;
     
-    while (std::getline(stream, line)) {
-        // 去除行尾的回车符
-        if (!line.empty() && line.back() == '\r') {
-            line.pop_back();
-        }
-        
-        // 跳过空行
-        if (line.empty()) {
-            continue;
-        }
-        
-        // 解析LRC格式: [mm:ss.xx]歌词文本
-        if (line.length() > 10 && line[0] == '[') {
-            size_t close_bracket = line.find(']');
-            if (close_bracket != std::string::npos) {
-                std::string tag_or_time = line.substr(1, close_bracket - 1);
-                std::string content = line.substr(close_bracket + 1);
-                
-                // 检查是否是元数据标签而不是时间戳
-                // 元数据标签通常是 [ti:标题], [ar:艺术家], [al:专辑] 等
-                size_t colon_pos = tag_or_time.find(':');
-                if (colon_pos != std::string::npos) {
-                    std::string left_part = tag_or_time.substr(0, colon_pos);
-                    
-                    // 检查冒号左边是否是时间（数字）
-                    bool is_time_format = true;
-                    for (char c : left_part) {
-                        if (!isdigit(c)) {
-                            is_time_format = false;
-                            break;
-                        }
-                    }
-                    
-                    // 如果不是时间格式，跳过这一行（元数据标签）
-                    if (!is_time_format) {
-                        // 可以在这里处理元数据，例如提取标题、艺术家等信息
-                        ESP_LOGD(TAG, "Skipping metadata tag: [%s]", tag_or_time.c_str());
-                        continue;
-                    }
-                    
-                    // 是时间格式，解析时间戳
-                    try {
-                        int minutes = std::stoi(tag_or_time.substr(0, colon_pos));
-                        float seconds = std::stof(tag_or_time.substr(colon_pos + 1));
-                        int timestamp_ms = minutes * 60 * 1000 + (int)(seconds * 1000);
-                        
-                        // 安全处理歌词文本，确保UTF-8编码正确
-                        std::string safe_lyric_text;
-                        if (!content.empty()) {
-                            // 创建安全副本并验证字符串
-                            safe_lyric_text = content;
-                            // 确保字符串以null结尾
-                            safe_lyric_text.shrink_to_fit();
-                        }
-                        
-                        lyrics_.push_back(std::make_pair(timestamp_ms, safe_lyric_text));
-                        
-                        if (!safe_lyric_text.empty()) {
-                            // 限制日志输出长度，避免中文字符截断问题
-                            size_t log_len = std::min(safe_lyric_text.length(), size_t(50));
-                            std::string log_text = safe_lyric_text.substr(0, log_len);
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] %s", timestamp_ms, log_text.c_str());
-                        } else {
-                            ESP_LOGD(TAG, "Parsed lyric: [%d ms] (empty)", timestamp_ms);
-                        }
-                    } catch (const std::exception& e) {
-                        ESP_LOGW(TAG, "Failed to parse time: %s", tag_or_time.c_str());
-                    }
-                }
-            }
+    std::string lyric_url;
+    std::string cache_key;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        lyric_url = current_lyric_url_;
+        cache_key = current_cache_key_;
+    }
+    if (display_mode_ != DISPLAY_MODE_LYRICS) {
+        if (!lyric_url.empty()) {
+            ESP_LOGI(TAG, "Lyric URL found but spectrum display mode is active, skipping lyrics");
         }
+        return;
     }
     
-    // 按时间戳排序
-    std::sort(lyrics_.begin(), lyrics_.end());
+    // 缓存中有歌词就不用再下载
+    std::string cached_lyrics;
+    if (!cache_key.empty() && cache_.ReadLyrics(cache_key, cached_lyrics)) {
+        ESP_LOGI(TAG, "Loading lyrics for: %s from cache", current_song_name_.c_str());
+        ParseLyrics(song_id, cached_lyrics);
+        return;
+    }
+    
+    if (lyric_url.empty()) {
+        return;
+    }
+    ESP_LOGI(TAG, "Loading lyrics for: %s (lyrics display mode)", current_song_name_.c_str());
     
-    ESP_LOGI(TAG, "Parsed %d lyric lines", lyrics_.size());
-    return !lyrics_.empty();
+    // 启动歌词下载，URL和缓存键按值传给线程
+    lyric_threads_++;
+    std::thread(&Esp32Music::LyricDisplayThread, this, song_id, std::move(lyric_url), std::move(cache_key)).detach();
 }
 
-// 歌词显示线程
-void Esp32Music::LyricDisplayThread() {
+// 歌词下载线程
+void Esp32Music::LyricDisplayThread(uint32_t song_id, std::string lyric_url, std::string cache_key) {
     ESP_LOGI(TAG, "Lyric display thread started");
     
-    if (!DownloadLyrics(current_lyric_url_)) {
+    // 歌词由歌词定时器按播放时钟显示，这个线程下载完就退出
+    if (!DownloadLyrics(song_id, lyric_url, cache_key) && lyric_song_id_ == song_id) {
         ESP_LOGE(TAG, "Failed to download or parse lyrics");
-        is_lyric_running_ = false;
-        return;
-    }
-    
-    // 定期检查是否需要更新显示(频率可以降低)
-    while (is_lyric_running_ && is_playing_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
     }
     
     ESP_LOGI(TAG, "Lyric display thread finished");
+    // 析构函数等这个计数变成0，之后不能再访问成员
+    lyric_threads_--;
 }
 
-void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    if (lyrics_.empty()) {
+// 当前歌曲播放到扬声器的位置：AudioService的播放时钟减去歌曲的起始位置
+int64_t Esp32Music::GetPlaybackPositionMs() {
+    if (!is_playing_) {
+        return -1;
+    }
+    int64_t position_us = Application::GetInstance().GetAudioService().GetPcmPlaybackPosition();
+    if (position_us < 0) {
+        return -1;
+    }
+    return std::max<int64_t>(position_us - song_start_us_, 0) / 1000;
+}
+
+// 歌词定时器，在esp_timer任务中运行：显示当前这一句，再把定时器定在下一句的时间
+void Esp32Music::OnLyricTimer() {
+    if (!is_playing_) {
         return;
     }
-    
-    // 查找当前应该显示的歌词
-    int new_lyric_index = -1;
-    
-    // 从当前歌词索引开始查找，提高效率
-    int start_index = (current_lyric_index_.load() >= 0) ? current_lyric_index_.load() : 0;
-    
-    // 正向查找：找到最后一个时间戳小于等于当前时间的歌词
-    for (int i = start_index; i < (int)lyrics_.size(); i++) {
-        if (lyrics_[i].first <= current_time_ms) {
-            new_lyric_index = i;
-        } else {
-            break;  // 时间戳已超过当前时间
+    int64_t position_ms = GetPlaybackPositionMs();
+    int64_t delay_ms = LYRIC_CLOCK_RETRY_MS;
+    if (position_ms >= 0) {
+        int64_t next_time_ms = UpdateLyricDisplay(position_ms);
+        if (next_time_ms < 0) {
+            // 已经是最后一句，或者还没有歌词，歌词解析完会重新定时
+            return;
         }
+        // 时钟可能因为欠载停下或者因为丢弃音乐帧跳过一段，最长等一会儿就重新对一次
+        delay_ms = std::min<int64_t>(next_time_ms - position_ms, LYRIC_TIMER_MAX_DELAY_MS);
     }
+    // 其他线程刚重新定时的话这里会失败，以那次为准
+    esp_timer_start_once(lyric_timer_, std::max<int64_t>(delay_ms, 1) * 1000);
+}
+
+// 马上按播放时钟重新显示歌词，之后由定时器自己定下一次的时间
+void Esp32Music::ScheduleLyrics() {
+    if (lyric_timer_ == nullptr || display_mode_ != DISPLAY_MODE_LYRICS || !is_playing_) {
+        return;
+    }
+    esp_timer_stop(lyric_timer_);
+    esp_timer_start_once(lyric_timer_, 0);
+}
+
+// 显示current_time_ms时的歌词，返回下一句的时间，没有下一句时返回-1
+int64_t Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
+    std::lock_guard<std::mutex> lock(lyrics_mutex_);
     
-    // 如果没有找到(可能当前时间比第一句歌词还早)，显示空
-    if (new_lyric_index == -1) {
-        new_lyric_index = -1;
+    if (lyrics_.empty()) {
+        return -1;
     }
     
+    // 二分查找最后一句时间不晚于当前时间的歌词，跳转之后也一样；比第一句还早时为-1，显示空
+    int new_lyric_index = lyrics_.Find(current_time_ms);
+    
     // 如果歌词索引发生变化，更新显示
     if (new_lyric_index != current_lyric_index_) {
         current_lyric_index_ = new_lyric_index;
@@ -1393,20 +1621,17 @@ void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
         auto& board = Board::GetInstance();
         auto display = board.GetDisplay();
         if (display) {
-            std::string lyric_text;
-            
-            if (current_lyric_index_ >= 0 && current_lyric_index_ < (int)lyrics_.size()) {
-                lyric_text = lyrics_[current_lyric_index_].second;
-            }
+            const char* lyric_text = new_lyric_index >= 0 ? lyrics_.text(new_lyric_index) : "";
             
             // 显示歌词
-            display->SetChatMessage("lyric", lyric_text.c_str());
+            display->SetChatMessage("lyric", lyric_text);
             
             ESP_LOGD(TAG, "Lyric update at %lldms: %s", 
                     current_time_ms, 
-                    lyric_text.empty() ? "(no lyric)" : lyric_text.c_str());
+                    lyric_text[0] == '\0' ? "(no lyric)" : lyric_text);
         }
     }
+    return lyrics_.NextTimeMs(new_lyric_index);
 }
 
 // 删除复杂的认证初始化方法，使用简单的静态函数
@@ -1436,3 +1661,97 @@ void Esp32Music::SetDisplayMode(DisplayMode mode) {
             (old_mode == DISPLAY_MODE_SPECTRUM) ? "SPECTRUM" : "LYRICS",
             (mode == DISPLAY_MODE_SPECTRUM) ? "SPECTRUM" : "LYRICS");
 }
+
+void Esp32Music::ResetStats() {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_ = MusicStreamStats();
+    buffer_history_head_ = 0;
+    buffer_history_count_ = 0;
+    buffer_min_ = SIZE_MAX;
+}
+
+// 打印播放统计，由Application每10秒调用一次
+void Esp32Music::PrintStats() {
+    if (!is_playing_) {
+        return;
+    }
+    MusicStreamStats stats;
+    size_t buffer_min;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats = stats_;
+        buffer_min = buffer_min_ == SIZE_MAX ? 0 : buffer_min_;
+        buffer_min_ = SIZE_MAX;
+    }
+    auto buffer = stream_buffer_.GetStats();
+    int output_rate = Board::GetInstance().GetAudioCodec()->output_sample_rate();
+    
+    ESP_LOGI(TAG, "Music download: %llukbps bytes=%llu connections=%lu ttfb=%lums max_ttfb=%lums",
+            stats.download_us > 0 ? stats.download_bytes * 8000 / stats.download_us : 0, stats.download_bytes,
+            stats.connections, stats.last_ttfb_ms, stats.max_ttfb_ms);
+    ESP_LOGI(TAG, "Music buffer: %uKB min=%uKB peak=%uKB/%uKB underruns=%lu (%llums, max %lums)",
+            buffer.size / 1024, buffer_min / 1024, buffer.peak_size / 1024, buffer.capacity / 1024,
+            buffer.underruns, buffer.underrun_us / 1000, buffer.max_underrun_us / 1000);
+    if (stats.decoded_frames > 0) {
+        ESP_LOGI(TAG, "Music decode: %s frames=%lu avg=%lluus max=%luus, rate=%d->%dHz switches=%lu",
+                MusicFormatName(stats.format), stats.decoded_frames, stats.decode_total_us / stats.decoded_frames,
+                stats.decode_max_us, stats.sample_rate, output_rate, stats.sample_rate_switches);
+    }
+}
+
+// 播放统计，给MCP工具用，从本次开始播放起累计
+std::string Esp32Music::GetStatsJson() {
+    MusicStreamStats stats;
+    std::vector<uint16_t> history;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats = stats_;
+        for (size_t i = 0; i < buffer_history_count_; i++) {
+            history.push_back(buffer_history_kb_[(buffer_history_head_ + i) % MUSIC_STATS_HISTORY_SIZE]);
+        }
+    }
+    auto buffer = stream_buffer_.GetStats();
+    int output_rate = Board::GetInstance().GetAudioCodec()->output_sample_rate();
+    
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddBoolToObject(root, "playing", is_playing_.load());
+    
+    cJSON* download = cJSON_CreateObject();
+    cJSON_AddNumberToObject(download, "kbps", stats.download_us > 0 ? stats.download_bytes * 8000 / stats.download_us : 0);
+    cJSON_AddNumberToObject(download, "bytes", stats.download_bytes);
+    cJSON_AddNumberToObject(download, "connections", stats.connections);
+    cJSON_AddNumberToObject(download, "ttfb_ms", stats.last_ttfb_ms);
+    cJSON_AddNumberToObject(download, "max_ttfb_ms", stats.max_ttfb_ms);
+    cJSON_AddItemToObject(root, "download", download);
+    
+    cJSON* buffer_json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(buffer_json, "size_kb", buffer.size / 1024);
+    cJSON_AddNumberToObject(buffer_json, "peak_kb", buffer.peak_size / 1024);
+    cJSON_AddNumberToObject(buffer_json, "capacity_kb", buffer.capacity / 1024);
+    cJSON_AddNumberToObject(buffer_json, "underruns", buffer.underruns);
+    cJSON_AddNumberToObject(buffer_json, "underrun_ms", buffer.underrun_us / 1000);
+    cJSON_AddNumberToObject(buffer_json, "max_underrun_ms", buffer.max_underrun_us / 1000);
+    cJSON_AddNumberToObject(buffer_json, "history_interval_ms", MUSIC_STATS_SAMPLE_INTERVAL_MS);
+    cJSON* history_json = cJSON_CreateArray();
+    for (auto size_kb : history) {
+        cJSON_AddItemToArray(history_json, cJSON_CreateNumber(size_kb));
+    }
+    cJSON_AddItemToObject(buffer_json, "history_kb", history_json);
+    cJSON_AddItemToObject(root, "buffer", buffer_json);
+    
+    cJSON* decode = cJSON_CreateObject();
+    cJSON_AddStringToObject(decode, "format", MusicFormatName(stats.format));
+    cJSON_AddNumberToObject(decode, "frames", stats.decoded_frames);
+    cJSON_AddNumberToObject(decode, "avg_us", stats.decoded_frames ? stats.decode_total_us / stats.decoded_frames : 0);
+    cJSON_AddNumberToObject(decode, "max_us", stats.decode_max_us);
+    cJSON_AddNumberToObject(decode, "sample_rate", stats.sample_rate);
+    cJSON_AddNumberToObject(decode, "output_sample_rate", output_rate);
+    cJSON_AddNumberToObject(decode, "sample_rate_switches", stats.sample_rate_switches);
+    cJSON_AddItemToObject(root, "decode", decode);
+    
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string json(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return json;
+}
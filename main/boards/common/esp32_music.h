@@ -4,25 +4,33 @@
 #include <string>
 #include <thread>
 #include <atomic>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <memory>
+#include <cstdint>
 
-#include "music.h"
+#include <esp_timer.h>
 
-// MP3解码器支持
-extern "C" {
-#include "mp3dec.h"
-}
+#include "music.h"
+#include "stream_ring_buffer.h"
+#include "music_cache.h"
+#include "music_decoder.h"
+#include "lyric_timeline.h"
 
-// 音频数据块结构
-struct AudioChunk {
-    uint8_t* data;
-    size_t size;
-    
-    AudioChunk() : data(nullptr), size(0) {}
-    AudioChunk(uint8_t* d, size_t s) : data(d), size(s) {}
+// 音乐流的统计，卡顿时用来区分是网络、解码还是输出的问题；每次开始播放（包括跳转）时清零
+struct MusicStreamStats {
+    uint32_t connections = 0;       // 发起的下载请求数，包括续传
+    uint64_t download_bytes = 0;
+    int64_t download_us = 0;        // 等待网络数据的时间，不含缓冲区满时的暂停，用来计算网速
+    uint32_t last_ttfb_ms = 0;      // 最近一次请求从发起到收到第一个字节的时间
+    uint32_t max_ttfb_ms = 0;
+    MusicFormat format = kMusicFormatUnknown;
+    uint32_t decoded_frames = 0;
+    uint64_t decode_total_us = 0;
+    uint32_t decode_max_us = 0;
+    int sample_rate = 0;            // 当前解码出的采样率，和输出采样率不同时由AudioService重采样
+    uint32_t sample_rate_switches = 0;
 };
 
 class Esp32Music : public Music {
@@ -40,54 +48,118 @@ private:
     bool song_name_displayed_;
     
     // 歌词相关
-    std::string current_lyric_url_;
-    std::vector<std::pair<int, std::string>> lyrics_;  // 时间戳和歌词文本
-    std::mutex lyrics_mutex_;  // 保护lyrics_数组的互斥锁
+    std::string current_lyric_url_;    // 由queue_mutex_保护
+    LyricTimeline lyrics_;     // 按时间排序的歌词
+    std::mutex lyrics_mutex_;  // 保护lyrics_的互斥锁
     std::atomic<int> current_lyric_index_;
-    std::thread lyric_thread_;
-    std::atomic<bool> is_lyric_running_;
+    // 歌词下载线程分离运行，换歌时不等它。每首歌一个编号，编号变了的下载尽快退出，下载好的也不再显示
+    std::atomic<uint32_t> lyric_song_id_;
+    std::atomic<int> lyric_threads_;    // 还在运行的歌词下载线程数，析构时等它们退出
+    // 单次定时器，按AudioService的播放时钟定在下一句歌词的时间，不在解码循环里更新歌词
+    static constexpr int LYRIC_CLOCK_RETRY_MS = 100;        // 播放时钟还没开始时，隔这么久再看
+    static constexpr int LYRIC_TIMER_MAX_DELAY_MS = 1000;   // 最长等这么久重新对一次时钟
+    esp_timer_handle_t lyric_timer_ = nullptr;
     
     std::atomic<DisplayMode> display_mode_;
     std::atomic<bool> is_playing_;
     std::atomic<bool> is_downloading_;
     std::thread play_thread_;
     std::thread download_thread_;
-    int64_t current_play_time_ms_;  // 当前播放时间(毫秒)
+    int64_t current_play_time_ms_;  // 当前解码到的时间(毫秒)，比扬声器播出的位置超前队列中的音频
+    // 当前歌曲在播放时钟上的起始位置，无缝切换时播放时钟继续累计，歌曲内的位置从这里算起
+    std::atomic<int64_t> song_start_us_;
     int64_t last_frame_time_ms_;    // 上一帧的时间戳
     int total_frames_decoded_;      // 已解码的帧数
 
-    // 音频缓冲区
-    std::queue<AudioChunk> audio_buffer_;
-    std::mutex buffer_mutex_;
-    std::condition_variable buffer_cv_;
-    size_t buffer_size_;
-    static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;  // 256KB缓冲区（降低以减少brownout风险）
-    static constexpr size_t MIN_BUFFER_SIZE = 32 * 1024;   // 32KB最小播放缓冲（降低以减少brownout风险）
+    // 音频缓冲区：PSRAM中的环形缓冲区，下载线程直接写入，解码器直接从中读取
+    static constexpr size_t STREAM_BUFFER_SIZE = 256 * 1024;      // 256KB缓冲区（降低以减少brownout风险）
+    static constexpr size_t STREAM_GUARD_SIZE = MUSIC_DECODER_MIN_INPUT;  // 解码每次需要的连续数据
+    static constexpr size_t STREAM_LOW_WATERMARK = 192 * 1024;    // 缓冲区满后，降到这里才继续下载
+    static constexpr size_t STREAM_START_WATERMARK = 32 * 1024;   // 32KB最小播放缓冲（降低以减少brownout风险）
+    StreamRingBuffer stream_buffer_;
+
+    // 断点续传：连接断开后用Range请求从已收到的位置继续下载
+    static constexpr int MUSIC_RESUME_MAX_RETRIES = 5;            // 连续失败这么多次才放弃
+    static constexpr int MUSIC_RESUME_BACKOFF_MS = 500;           // 重连前的等待时间，按失败次数递增
+    // 当前歌曲下载完后，先只预取下一首的开头，等当前歌曲播完再继续下载
+    static constexpr size_t MUSIC_PREFETCH_SIZE = 64 * 1024;
+    static constexpr uint64_t NO_SONG_BOUNDARY = UINT64_MAX;
+
+    struct QueuedSong {
+        std::string name;
+        std::string music_url;      // 为空表示没有歌曲，缓存中的歌曲以MUSIC_CACHE_URL_PREFIX开头
+        std::string lyric_url;
+        std::string cache_key;      // 为空表示不缓存
+    };
+    std::mutex queue_mutex_;        // 保护下面两首歌、current_music_url_、current_cache_key_、current_lyric_url_和stream_content_type_
+    // 下载线程在这里等待排队下一首、当前歌曲快要播完、播放线程切换歌曲或停止播放，
+    // 暂停中的播放线程在这里等待设备状态变化
+    std::condition_variable queue_cv_;
+    std::string current_cache_key_;
+    std::string stream_content_type_;   // 最近一次下载响应的Content-Type，文件头识别不出格式时使用
+    QueuedSong next_song_;          // 排队等待播放的下一首
+    QueuedSong incoming_song_;      // 已经写入环形缓冲区、还没开始播放的下一首
+    // 下一首在环形缓冲区数据流中的起始位置（从Reset起写入的总字节数）
+    std::atomic<uint64_t> song_boundary_;
+
+    // 跳转：播放线程每隔一段时间记录一帧的播放时间和它在文件中的字节偏移
+    static constexpr int64_t MUSIC_SEEK_INDEX_INTERVAL_MS = 1000;
+    static constexpr size_t MUSIC_SEEK_INDEX_MAX_ENTRIES = 1800;   // 30分钟
+    std::mutex seek_mutex_;
+    std::vector<std::pair<int64_t, size_t>> seek_index_;
+    size_t audio_data_offset_;      // ID3标签之后第一帧的偏移
+    int stream_bitrate_;            // 最近记录的码率(bps)，用来估算索引之外的位置
+    size_t stream_start_offset_;    // 本次播放开始的字节偏移和对应的播放时间
+    int64_t stream_start_time_ms_;
+
+    // Flash上的歌曲缓存：最近播放的歌曲和歌词直接从缓存播放，不再请求网络
+    static constexpr const char* MUSIC_CACHE_URL_PREFIX = "cache:";
+    MusicCache cache_;
+    // 歌曲还没下载完时先保存下载好的歌词，歌曲存入缓存后一起保存
+    std::string pending_lyrics_key_;
+    std::string pending_lyrics_;
+    
+    // 解码器：每首歌开始播放时按文件头和Content-Type选择，只在播放线程中使用
+    std::unique_ptr<MusicDecoder> decoder_;
     
-    // MP3解码器相关
-    HMP3Decoder mp3_decoder_;
-    MP3FrameInfo mp3_frame_info_;
-    bool mp3_decoder_initialized_;
+    // 统计：播放线程每秒记录一次缓冲区大小，保留最近一分钟
+    static constexpr int MUSIC_STATS_SAMPLE_INTERVAL_MS = 1000;
+    static constexpr size_t MUSIC_STATS_HISTORY_SIZE = 60;
+    std::mutex stats_mutex_;        // 保护下面的统计
+    MusicStreamStats stats_;
+    uint16_t buffer_history_kb_[MUSIC_STATS_HISTORY_SIZE];
+    size_t buffer_history_head_ = 0;
+    size_t buffer_history_count_ = 0;
+    size_t buffer_min_ = SIZE_MAX;  // PrintStats()以来缓冲区的最小值
+    void ResetStats();
     
     // 私有方法
-    void DownloadAudioStream(const std::string& music_url);
+    bool FindSong(const std::string& song_name, const std::string& artist_name, QueuedSong& song);
+    bool ResolveSong(const std::string& song_name, const std::string& artist_name, QueuedSong& song);
+    bool StartSong(const QueuedSong& song);
+    bool StartStreamingAt(const QueuedSong& song, size_t offset, int64_t start_time_ms);
+    void DownloadAudioStream(QueuedSong song, size_t offset);
+    bool DownloadSong(const QueuedSong& song, size_t offset, size_t end);
+    bool DownloadRange(const std::string& music_url, size_t offset, size_t end, const std::string& cache_key);
+    bool ReadCachedRange(const std::string& cache_key, size_t offset, size_t end);
+    void StorePendingLyrics(const std::string& cache_key);
     void PlayAudioStream();
+    void NotifyStreamThreads();  // 改变了下载线程或暂停中的播放线程等待的条件后调用
     void ClearAudioBuffer();
-    bool InitializeMp3Decoder();
-    void CleanupMp3Decoder();
-    void ResetSampleRate();  // 重置采样率到原始值
+    void FlushPcmPlayback();  // 丢弃还没播放的音乐帧
     
     // 歌词相关私有方法
-    bool DownloadLyrics(const std::string& lyric_url);
-    bool ParseLyrics(const std::string& lyric_content);
-    void LyricDisplayThread();
-    void UpdateLyricDisplay(int64_t current_time_ms);
+    bool DownloadLyrics(uint32_t song_id, const std::string& lyric_url, const std::string& cache_key);
+    bool ParseLyrics(uint32_t song_id, const std::string& lyric_content);
+    void StartLyrics();
+    void LyricDisplayThread(uint32_t song_id, std::string lyric_url, std::string cache_key);
+    int64_t UpdateLyricDisplay(int64_t current_time_ms);
+    void ScheduleLyrics();
+    void OnLyricTimer();
     
     // ID3标签处理
     size_t SkipId3Tag(uint8_t* data, size_t size);
 
-    int16_t* final_pcm_data_fft = nullptr;
-
 public:
     Esp32Music();
     ~Esp32Music();
@@ -99,9 +171,16 @@ public:
     // 新增方法
     virtual bool StartStreaming(const std::string& music_url) override;
     virtual bool StopStreaming() override;  // 停止流式播放
-    virtual size_t GetBufferSize() const override { return buffer_size_; }
+    virtual size_t GetBufferSize() const override { return stream_buffer_.Size(); }
     virtual bool IsDownloading() const override { return is_downloading_; }
-    virtual int16_t* GetAudioData() override { return final_pcm_data_fft; }
+    virtual int64_t GetPlaybackPositionMs() override;
+    virtual void PrintStats() override;
+    virtual std::string GetStatsJson() override;
+
+    // 跳转到当前歌曲的指定时间
+    bool Seek(int64_t position_ms);
+    // 排队下一首，当前歌曲播完后无缝播放；没有正在播放的歌曲时立即播放
+    bool QueueNext(const std::string& song_name, const std::string& artist_name = "");
     
     // 显示模式控制方法
     void SetDisplayMode(DisplayMode mode);
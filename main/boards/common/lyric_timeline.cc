@@ -0,0 +1,196 @@
+#include "lyric_timeline.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+#define TAG "LyricTimeline"
+
+
+// Parses mm:ss, mm:ss.x, mm:ss.xx or mm:ss.xxx (some files use ':' before the fraction)
+static bool ParseTimeTag(const char* tag, size_t length, int32_t& time_ms) {
+    size_t pos = 0;
+    int32_t minutes = 0;
+    while (pos < length && tag[pos] >= '0' && tag[pos] <= '9' && minutes < 10000) {
+        minutes = minutes * 10 + (tag[pos++] - '0');
+    }
+    if (pos == 0 || pos >= length || tag[pos] != ':') {
+        return false;
+    }
+    size_t seconds_start = ++pos;
+    int32_t seconds = 0;
+    while (pos < length && tag[pos] >= '0' && tag[pos] <= '9' && pos - seconds_start < 2) {
+        seconds = seconds * 10 + (tag[pos++] - '0');
+    }
+    if (pos == seconds_start) {
+        return false;
+    }
+    int32_t fraction_ms = 0;
+    if (pos < length && (tag[pos] == '.' || tag[pos] == ':')) {
+        pos++;
+        int32_t scale = 100;
+        while (pos < length && tag[pos] >= '0' && tag[pos] <= '9') {
+            fraction_ms += (tag[pos++] - '0') * scale;
+            scale /= 10;
+        }
+    }
+    if (pos != length) {
+        return false;
+    }
+    time_ms = (minutes * 60 + seconds) * 1000 + fraction_ms;
+    return true;
+}
+
+// [offset:+/-ms], a positive offset shows the lyrics earlier
+static bool ParseOffsetTag(const char* tag, size_t length, int32_t& offset_ms) {
+    static constexpr char kOffsetTag[] = "offset:";
+    static constexpr size_t kOffsetTagLength = sizeof(kOffsetTag) - 1;
+    if (length <= kOffsetTagLength || strncasecmp(tag, kOffsetTag, kOffsetTagLength) != 0) {
+        return false;
+    }
+    size_t pos = kOffsetTagLength;
+    while (pos < length && tag[pos] == ' ') {
+        pos++;
+    }
+    bool negative = pos < length && tag[pos] == '-';
+    if (pos < length && (tag[pos] == '-' || tag[pos] == '+')) {
+        pos++;
+    }
+    int32_t value = 0;
+    while (pos < length && tag[pos] >= '0' && tag[pos] <= '9' && value < 10000000) {
+        value = value * 10 + (tag[pos++] - '0');
+    }
+    offset_ms = negative ? -value : value;
+    return true;
+}
+
+LyricTimeline::~LyricTimeline() {
+    Clear();
+}
+
+void LyricTimeline::Clear() {
+    lines_.clear();
+    lines_.shrink_to_fit();
+    if (arena_ != nullptr) {
+        heap_caps_free(arena_);
+        arena_ = nullptr;
+    }
+    arena_size_ = 0;
+}
+
+bool LyricTimeline::Parse(const char* content, size_t size) {
+    Clear();
+    if (content == nullptr || size == 0) {
+        return false;
+    }
+
+    /*
+     * The text of a line is shorter than the line, so the content size bounds the arena. The caps
+     * it got are kept for the final shrink, boards without PSRAM fall back to internal RAM.
+     */
+    uint32_t arena_caps = MALLOC_CAP_SPIRAM;
+    arena_ = (char*)heap_caps_malloc(size + 1, arena_caps);
+    if (arena_ == nullptr) {
+        arena_caps = MALLOC_CAP_DEFAULT;
+        arena_ = (char*)heap_caps_malloc(size + 1, arena_caps);
+    }
+    if (arena_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes for lyrics", size + 1);
+        return false;
+    }
+    /* Offset 0 is the empty string, shared by all blank lines */
+    arena_[0] = '\0';
+    size_t used = 1;
+    /* One entry per time tag, a line with several tags has several entries */
+    size_t time_tags = 0;
+    for (const char* tag = content; (tag = (const char*)memchr(tag, '[', content + size - tag)) != nullptr; tag++) {
+        if (tag + 1 < content + size && tag[1] >= '0' && tag[1] <= '9') {
+            time_tags++;
+        }
+    }
+    lines_.reserve(time_tags);
+
+    int32_t offset_ms = 0;
+    const char* end = content + size;
+    const char* line = content;
+    if (size >= 3 && memcmp(line, "\xEF\xBB\xBF", 3) == 0) {
+        line += 3;
+    }
+    while (line < end) {
+        const char* line_end = (const char*)memchr(line, '\n', end - line);
+        const char* next = line_end != nullptr ? line_end + 1 : end;
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+        if (line_end > line && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        /* Collect the leading time tags, the rest of the line is their text */
+        const char* pos = line;
+        size_t first_line = lines_.size();
+        while (pos < line_end && *pos == '[') {
+            const char* close = (const char*)memchr(pos + 1, ']', line_end - pos - 1);
+            if (close == nullptr) {
+                break;
+            }
+            int32_t time_ms = 0;
+            if (ParseTimeTag(pos + 1, close - pos - 1, time_ms)) {
+                lines_.push_back({time_ms, 0});
+            } else if (lines_.size() == first_line) {
+                /* Metadata such as [ti:], [ar:] and [offset:] */
+                ParseOffsetTag(pos + 1, close - pos - 1, offset_ms);
+                break;
+            } else {
+                break;
+            }
+            pos = close + 1;
+        }
+
+        if (lines_.size() > first_line && pos < line_end) {
+            size_t length = line_end - pos;
+            memcpy(arena_ + used, pos, length);
+            arena_[used + length] = '\0';
+            for (size_t i = first_line; i < lines_.size(); i++) {
+                lines_[i].text_offset = used;
+            }
+            used += length + 1;
+        }
+        line = next;
+    }
+
+    if (lines_.empty()) {
+        Clear();
+        return false;
+    }
+    if (offset_ms != 0) {
+        for (auto& entry : lines_) {
+            entry.time_ms = std::max<int32_t>(entry.time_ms - offset_ms, 0);
+        }
+    }
+    /* Lines with several times come out of order, equal times keep the file order */
+    std::stable_sort(lines_.begin(), lines_.end(),
+        [](const Line& a, const Line& b) { return a.time_ms < b.time_ms; });
+    lines_.shrink_to_fit();
+
+    char* arena = (char*)heap_caps_realloc(arena_, used, arena_caps);
+    if (arena != nullptr) {
+        arena_ = arena;
+    }
+    arena_size_ = used;
+    ESP_LOGI(TAG, "Parsed %u lyric lines, %u bytes of text", lines_.size(), arena_size_);
+    return true;
+}
+
+int LyricTimeline::Find(int64_t position_ms) const {
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), position_ms,
+        [](int64_t time_ms, const Line& entry) { return time_ms < entry.time_ms; });
+    return (int)(it - lines_.begin()) - 1;
+}
+
+int64_t LyricTimeline::NextTimeMs(int index) const {
+    size_t next = index + 1;
+    return next < lines_.size() ? lines_[next].time_ms : -1;
+}
@@ -0,0 +1,52 @@
+#ifndef LYRIC_TIMELINE_H
+#define LYRIC_TIMELINE_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Parsed LRC lyrics: a list of lines sorted by time, with their text in one arena.
+ *
+ * The parser walks the content once without building strings. The text of every line is copied
+ * into a single PSRAM block (internal RAM on boards without PSRAM) as a null-terminated string,
+ * so a song takes two allocations no matter how many lines it has. A line with several time tags
+ * ([00:12.00][01:30.50]text) is stored once and referenced by each of its times. The [offset:]
+ * tag is applied to all times.
+ *
+ * Not thread safe, the owner locks around Parse() and the lookups.
+ */
+class LyricTimeline {
+public:
+    LyricTimeline() = default;
+    ~LyricTimeline();
+
+    LyricTimeline(const LyricTimeline&) = delete;
+    LyricTimeline& operator=(const LyricTimeline&) = delete;
+
+    // Replaces the timeline, returns false if the content has no timed lines
+    bool Parse(const char* content, size_t size);
+    void Clear();
+
+    bool empty() const { return lines_.empty(); }
+    size_t size() const { return lines_.size(); }
+    int32_t time_ms(int index) const { return lines_[index].time_ms; }
+    const char* text(int index) const { return arena_ + lines_[index].text_offset; }
+
+    // Index of the line shown at position_ms, or -1 before the first line
+    int Find(int64_t position_ms) const;
+    // Time of the line after index, or -1 after the last line
+    int64_t NextTimeMs(int index) const;
+
+private:
+    struct Line {
+        int32_t time_ms;
+        uint32_t text_offset;
+    };
+
+    std::vector<Line> lines_;
+    char* arena_ = nullptr;
+    size_t arena_size_ = 0;
+};
+
+#endif // LYRIC_TIMELINE_H
@@ -0,0 +1,74 @@
+#include "mp3_music_decoder.h"
+
+#include <esp_log.h>
+
+#define TAG "Mp3MusicDecoder"
+
+
+Mp3MusicDecoder::~Mp3MusicDecoder() {
+    if (decoder_ != nullptr) {
+        MP3FreeDecoder(decoder_);
+    }
+}
+
+bool Mp3MusicDecoder::Initialize() {
+    decoder_ = MP3InitDecoder();
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to initialize MP3 decoder");
+        return false;
+    }
+    return true;
+}
+
+void Mp3MusicDecoder::Reset(size_t stream_offset) {
+    /* Drop the bit reservoir left by the data before the seek */
+    if (decoder_ != nullptr) {
+        MP3FreeDecoder(decoder_);
+    }
+    Initialize();
+}
+
+MusicDecodeResult Mp3MusicDecoder::DecodeFrame(const uint8_t* data, size_t size, size_t& consumed,
+    size_t& frame_offset, std::vector<int16_t>& pcm, MusicFrameInfo& info) {
+    consumed = 0;
+    frame_offset = 0;
+    if (decoder_ == nullptr) {
+        consumed = size;
+        return kMusicDecodeError;
+    }
+
+    int sync_offset = MP3FindSyncWord((unsigned char*)data, size);
+    if (sync_offset < 0) {
+        ESP_LOGW(TAG, "No MP3 sync word found, skipping %u bytes", size);
+        consumed = size;
+        return kMusicDecodeError;
+    }
+
+    unsigned char* read_ptr = (unsigned char*)data + sync_offset;
+    int bytes_left = size - sync_offset;
+    pcm.resize(MAX_NCHAN * MAX_NGRAN * MAX_NSAMP);
+    int result = MP3Decode(decoder_, &read_ptr, &bytes_left, pcm.data(), 0);
+    if (result == ERR_MP3_INDATA_UNDERFLOW) {
+        /* Only the garbage before the frame is used up */
+        consumed = sync_offset;
+        return kMusicDecodeNeedMore;
+    }
+    if (result != 0 && bytes_left > 0) {
+        /* Not a real frame, search again from the next byte */
+        read_ptr++;
+    }
+    consumed = read_ptr - data;
+    if (result != 0) {
+        ESP_LOGW(TAG, "MP3 decode failed with error: %d", result);
+        return kMusicDecodeError;
+    }
+
+    MP3FrameInfo frame_info;
+    MP3GetLastFrameInfo(decoder_, &frame_info);
+    frame_offset = sync_offset;
+    pcm.resize(frame_info.outputSamps);
+    info.sample_rate = frame_info.samprate;
+    info.channels = frame_info.nChans;
+    info.bitrate = frame_info.bitrate;
+    return kMusicDecodeFrame;
+}
@@ -0,0 +1,26 @@
+#ifndef MP3_MUSIC_DECODER_H
+#define MP3_MUSIC_DECODER_H
+
+#include "music_decoder.h"
+
+extern "C" {
+#include "mp3dec.h"
+}
+
+// MPEG-1/2 layer III through Helix, which finds the next frame sync on its own after a seek
+class Mp3MusicDecoder : public MusicDecoder {
+public:
+    Mp3MusicDecoder() = default;
+    virtual ~Mp3MusicDecoder();
+
+    virtual MusicFormat format() const override { return kMusicFormatMp3; }
+    virtual bool Initialize() override;
+    virtual void Reset(size_t stream_offset) override;
+    virtual MusicDecodeResult DecodeFrame(const uint8_t* data, size_t size, size_t& consumed, size_t& frame_offset,
+        std::vector<int16_t>& pcm, MusicFrameInfo& info) override;
+
+private:
+    HMP3Decoder decoder_ = nullptr;
+};
+
+#endif // MP3_MUSIC_DECODER_H
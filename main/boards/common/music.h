@@ -2,6 +2,7 @@
 #define MUSIC_H
 
 #include <string>
+#include <cstdint>
 
 class Music {
 public:
@@ -15,7 +16,11 @@ public:
     virtual bool StopStreaming() = 0;  // 停止流式播放
     virtual size_t GetBufferSize() const = 0;
     virtual bool IsDownloading() const = 0;
-    virtual int16_t* GetAudioData() = 0;
+    // 当前歌曲已经从扬声器播出的位置(毫秒)，没有在播放时返回-1
+    virtual int64_t GetPlaybackPositionMs() = 0;
+    // 播放统计：下载速度、缓冲区、解码耗时和欠载，PrintStats()打印到日志，GetStatsJson()给MCP工具
+    virtual void PrintStats() = 0;
+    virtual std::string GetStatsJson() = 0;
 };
 
 #endif // MUSIC_H 
\ No newline at end of file
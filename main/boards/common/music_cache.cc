@@ -0,0 +1,565 @@
+#include "music_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+#define TAG "MusicCache"
+
+// Two copies of the index, one per flash sector at the start of the first block
+#define INDEX_SECTOR_SIZE 4096
+
+
+MusicCache::MusicCache() {
+    memset(&index_, 0, sizeof(index_));
+    memset(block_used_, 0, sizeof(block_used_));
+    memset(verified_, 0, sizeof(verified_));
+}
+
+bool MusicCache::Initialize() {
+    static_assert(sizeof(Index) <= INDEX_SECTOR_SIZE, "Music cache index does not fit in a sector");
+    static_assert(2 * INDEX_SECTOR_SIZE <= MUSIC_CACHE_BLOCK_SIZE, "Music cache index does not fit in a block");
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+        MUSIC_CACHE_PARTITION_LABEL);
+    if (partition == nullptr) {
+        ESP_LOGI(TAG, "No %s partition, music cache disabled", MUSIC_CACHE_PARTITION_LABEL);
+        return false;
+    }
+    block_count_ = std::min<uint32_t>(partition->size / MUSIC_CACHE_BLOCK_SIZE, MUSIC_CACHE_MAX_BLOCKS);
+    if (block_count_ < 2) {
+        ESP_LOGW(TAG, "Partition %s is too small for the music cache", MUSIC_CACHE_PARTITION_LABEL);
+        return false;
+    }
+    partition_ = partition;
+    stats_.capacity = (block_count_ - 1) * MUSIC_CACHE_BLOCK_SIZE;
+
+    if (!LoadIndex()) {
+        ESP_LOGI(TAG, "No valid index, formatting the music cache");
+        ResetIndex();
+        if (!SaveIndex()) {
+            partition_ = nullptr;
+            return false;
+        }
+    }
+    RebuildBlockMap();
+    ESP_LOGI(TAG, "Music cache ready: %lu entries, %u/%u bytes used", stats_.entries, stats_.used_bytes,
+        stats_.capacity);
+    return true;
+}
+
+std::string MusicCache::MakeKey(const std::string& song_name, const std::string& artist_name) {
+    /* The same song is asked for with different spacing and case */
+    auto normalize = [](const std::string& text) {
+        std::string result;
+        for (char c : text) {
+            if (isspace((unsigned char)c)) {
+                continue;
+            }
+            result += (char)tolower((unsigned char)c);
+        }
+        return result;
+    };
+    return normalize(song_name) + "|" + normalize(artist_name);
+}
+
+uint32_t MusicCache::HashKey(const std::string& key) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (char c : key) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool MusicCache::LoadIndex() {
+    /* An index is a few KB, too much for the stack of the task that initializes the cache */
+    auto candidate = (Index*)heap_caps_malloc(sizeof(Index), MALLOC_CAP_8BIT);
+    if (candidate == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes to load the index", sizeof(Index));
+        return false;
+    }
+    bool found = false;
+    for (int slot = 0; slot < 2; slot++) {
+        if (esp_partition_read(partition_, slot * INDEX_SECTOR_SIZE, candidate, sizeof(Index)) != ESP_OK) {
+            continue;
+        }
+        if (candidate->magic != MAGIC || candidate->version != VERSION ||
+            candidate->block_size != MUSIC_CACHE_BLOCK_SIZE || candidate->block_count != block_count_) {
+            continue;
+        }
+        if (esp_rom_crc32_le(0, (const uint8_t*)candidate, offsetof(Index, crc)) != candidate->crc) {
+            ESP_LOGW(TAG, "Index copy %d is corrupted", slot);
+            continue;
+        }
+        if (!found || candidate->sequence > index_.sequence) {
+            index_ = *candidate;
+            index_slot_ = slot;
+            found = true;
+        }
+    }
+    heap_caps_free(candidate);
+    return found;
+}
+
+bool MusicCache::SaveIndex() {
+    /* Write the copy that is not the current one, so the current one survives a power loss */
+    int slot = 1 - index_slot_;
+    index_.sequence++;
+    index_.crc = esp_rom_crc32_le(0, (const uint8_t*)&index_, offsetof(Index, crc));
+    esp_err_t ret = esp_partition_erase_range(partition_, slot * INDEX_SECTOR_SIZE, INDEX_SECTOR_SIZE);
+    if (ret == ESP_OK) {
+        ret = esp_partition_write(partition_, slot * INDEX_SECTOR_SIZE, &index_, sizeof(index_));
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write the index: %s", esp_err_to_name(ret));
+        return false;
+    }
+    index_slot_ = slot;
+    index_save_time_ = esp_timer_get_time();
+    return true;
+}
+
+void MusicCache::ResetIndex() {
+    memset(&index_, 0, sizeof(index_));
+    index_.magic = MAGIC;
+    index_.version = VERSION;
+    index_.block_size = MUSIC_CACHE_BLOCK_SIZE;
+    index_.block_count = block_count_;
+    for (auto& entry : index_.entries) {
+        entry.first_block = NO_BLOCK;
+        entry.lyric_block = NO_BLOCK;
+    }
+    for (auto& next : index_.next_block) {
+        next = NO_BLOCK;
+    }
+}
+
+void MusicCache::RebuildBlockMap() {
+    memset(block_used_, 0, sizeof(block_used_));
+    block_used_[0] = true;
+    stats_.entries = 0;
+    stats_.used_bytes = 0;
+
+    /* Claims the blocks of a chain, a chain that is too short or runs into another one is invalid */
+    auto claim = [this](uint16_t block, uint32_t size) {
+        uint32_t blocks = (size + MUSIC_CACHE_BLOCK_SIZE - 1) / MUSIC_CACHE_BLOCK_SIZE;
+        std::vector<uint16_t> chain;
+        for (uint32_t i = 0; i < blocks; i++) {
+            if (block == 0 || block >= block_count_ || block_used_[block]) {
+                for (auto b : chain) {
+                    block_used_[b] = false;
+                }
+                return false;
+            }
+            block_used_[block] = true;
+            chain.push_back(block);
+            block = index_.next_block[block];
+        }
+        return true;
+    };
+
+    for (int i = 0; i < MUSIC_CACHE_MAX_ENTRIES; i++) {
+        auto& entry = index_.entries[i];
+        if (entry.first_block == NO_BLOCK) {
+            continue;
+        }
+        bool valid = claim(entry.first_block, entry.audio_size);
+        if (valid && entry.lyric_block != NO_BLOCK && !claim(entry.lyric_block, entry.lyric_size)) {
+            entry.lyric_block = NO_BLOCK;
+            entry.lyric_size = 0;
+        }
+        if (!valid) {
+            ESP_LOGW(TAG, "Dropping entry %.*s with a broken block chain", MUSIC_CACHE_KEY_SIZE, entry.key);
+            entry.first_block = NO_BLOCK;
+            entry.lyric_block = NO_BLOCK;
+            continue;
+        }
+        stats_.entries++;
+        stats_.used_bytes += entry.audio_size + entry.lyric_size;
+    }
+}
+
+int MusicCache::FindEntry(const std::string& key) {
+    uint32_t hash = HashKey(key);
+    for (int i = 0; i < MUSIC_CACHE_MAX_ENTRIES; i++) {
+        auto& entry = index_.entries[i];
+        if (entry.first_block != NO_BLOCK && entry.key_hash == hash &&
+            strncmp(entry.key, key.c_str(), MUSIC_CACHE_KEY_SIZE - 1) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool MusicCache::ReadChain(uint16_t block, size_t offset, uint8_t* data, size_t size) {
+    while (offset >= MUSIC_CACHE_BLOCK_SIZE && block != NO_BLOCK) {
+        block = index_.next_block[block];
+        offset -= MUSIC_CACHE_BLOCK_SIZE;
+    }
+    while (size > 0) {
+        if (block == NO_BLOCK || block >= block_count_) {
+            return false;
+        }
+        size_t bytes = std::min(size, MUSIC_CACHE_BLOCK_SIZE - offset);
+        if (esp_partition_read(partition_, block * MUSIC_CACHE_BLOCK_SIZE + offset, data, bytes) != ESP_OK) {
+            return false;
+        }
+        data += bytes;
+        size -= bytes;
+        offset = 0;
+        block = index_.next_block[block];
+    }
+    return true;
+}
+
+bool MusicCache::VerifyEntry(int entry) {
+    auto& e = index_.entries[entry];
+    std::vector<uint8_t> buffer(4096);
+    auto check = [&](uint16_t block, uint32_t size, uint32_t expected_crc) {
+        uint32_t crc = 0;
+        for (uint32_t offset = 0; offset < size; offset += buffer.size()) {
+            size_t bytes = std::min<size_t>(buffer.size(), size - offset);
+            if (!ReadChain(block, offset, buffer.data(), bytes)) {
+                return false;
+            }
+            crc = esp_rom_crc32_le(crc, buffer.data(), bytes);
+        }
+        return crc == expected_crc;
+    };
+    if (!check(e.first_block, e.audio_size, e.audio_crc)) {
+        return false;
+    }
+    if (e.lyric_block != NO_BLOCK && !check(e.lyric_block, e.lyric_size, e.lyric_crc)) {
+        /* Keep the song, the lyrics can be downloaded again */
+        FreeChain(e.lyric_block);
+        e.lyric_block = NO_BLOCK;
+        stats_.used_bytes -= e.lyric_size;
+        e.lyric_size = 0;
+    }
+    return true;
+}
+
+void MusicCache::FreeChain(uint16_t block) {
+    for (uint32_t i = 0; i < block_count_ && block != NO_BLOCK && block < block_count_; i++) {
+        uint16_t next = index_.next_block[block];
+        block_used_[block] = false;
+        index_.next_block[block] = NO_BLOCK;
+        block = next;
+    }
+}
+
+void MusicCache::RemoveEntry(int entry) {
+    auto& e = index_.entries[entry];
+    FreeChain(e.first_block);
+    FreeChain(e.lyric_block);
+    stats_.entries--;
+    stats_.used_bytes -= e.audio_size + e.lyric_size;
+    memset(&e, 0, sizeof(e));
+    e.first_block = NO_BLOCK;
+    e.lyric_block = NO_BLOCK;
+    verified_[entry] = false;
+}
+
+bool MusicCache::EvictLeastRecentlyUsed(int keep) {
+    int pinned = pinned_key_.empty() ? -1 : FindEntry(pinned_key_);
+    int oldest = -1;
+    for (int i = 0; i < MUSIC_CACHE_MAX_ENTRIES; i++) {
+        if (i == keep || i == pinned || index_.entries[i].first_block == NO_BLOCK) {
+            continue;
+        }
+        if (oldest < 0 || index_.entries[i].last_used < index_.entries[oldest].last_used) {
+            oldest = i;
+        }
+    }
+    if (oldest < 0) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Evicting %.*s", MUSIC_CACHE_KEY_SIZE, index_.entries[oldest].key);
+    RemoveEntry(oldest);
+    stats_.evictions++;
+    return SaveIndex();
+}
+
+uint16_t MusicCache::AllocateBlock(int keep) {
+    while (true) {
+        for (uint16_t block = 1; block < block_count_; block++) {
+            if (block_used_[block]) {
+                continue;
+            }
+            block_used_[block] = true;
+            index_.next_block[block] = NO_BLOCK;
+            return block;
+        }
+        if (!EvictLeastRecentlyUsed(keep)) {
+            return NO_BLOCK;
+        }
+    }
+}
+
+bool MusicCache::WriteBlock(uint16_t block, size_t offset, const uint8_t* data, size_t size) {
+    /*
+     * Blocks are written in order, so the sectors starting inside this write are still unerased.
+     * Erasing one sector at a time keeps each stall of the flash cache short for the other tasks.
+     */
+    size_t address = block * MUSIC_CACHE_BLOCK_SIZE;
+    for (size_t sector = (offset + INDEX_SECTOR_SIZE - 1) / INDEX_SECTOR_SIZE * INDEX_SECTOR_SIZE;
+         sector < offset + size; sector += INDEX_SECTOR_SIZE) {
+        if (esp_partition_erase_range(partition_, address + sector, INDEX_SECTOR_SIZE) != ESP_OK) {
+            return false;
+        }
+    }
+    return esp_partition_write(partition_, address + offset, data, size) == ESP_OK;
+}
+
+bool MusicCache::WriteChain(const uint8_t* data, size_t size, int keep, uint16_t& first_block) {
+    first_block = NO_BLOCK;
+    uint16_t last_block = NO_BLOCK;
+    for (size_t offset = 0; offset < size; offset += MUSIC_CACHE_BLOCK_SIZE) {
+        uint16_t block = AllocateBlock(keep);
+        size_t bytes = std::min<size_t>(MUSIC_CACHE_BLOCK_SIZE, size - offset);
+        if (block == NO_BLOCK || !WriteBlock(block, 0, data + offset, bytes)) {
+            if (block != NO_BLOCK) {
+                block_used_[block] = false;
+            }
+            FreeChain(first_block);
+            first_block = NO_BLOCK;
+            return false;
+        }
+        if (last_block == NO_BLOCK) {
+            first_block = block;
+        } else {
+            index_.next_block[last_block] = block;
+        }
+        last_block = block;
+    }
+    return true;
+}
+
+bool MusicCache::Lookup(const std::string& key, size_t& audio_size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (partition_ == nullptr) {
+        return false;
+    }
+    stats_.lookups++;
+    int entry = FindEntry(key);
+    if (entry < 0) {
+        return false;
+    }
+    if (!verified_[entry]) {
+        if (!VerifyEntry(entry)) {
+            ESP_LOGW(TAG, "CRC mismatch, dropping %s", key.c_str());
+            RemoveEntry(entry);
+            stats_.corrupted++;
+            SaveIndex();
+            return false;
+        }
+        verified_[entry] = true;
+    }
+    auto& e = index_.entries[entry];
+    e.last_used = ++index_.use_counter;
+    if (esp_timer_get_time() - index_save_time_ >= (int64_t)MUSIC_CACHE_LRU_SAVE_INTERVAL_MS * 1000) {
+        SaveIndex();
+    }
+    stats_.hits++;
+    audio_size = e.audio_size;
+    return true;
+}
+
+int MusicCache::ReadAudio(const std::string& key, size_t offset, uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (partition_ == nullptr) {
+        return -1;
+    }
+    int entry = FindEntry(key);
+    if (entry < 0) {
+        return -1;
+    }
+    auto& e = index_.entries[entry];
+    if (offset >= e.audio_size) {
+        return 0;
+    }
+    size = std::min<size_t>(size, e.audio_size - offset);
+    if (!ReadChain(e.first_block, offset, data, size)) {
+        return -1;
+    }
+    stats_.bytes_saved += size;
+    return size;
+}
+
+bool MusicCache::ReadLyrics(const std::string& key, std::string& lyrics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (partition_ == nullptr) {
+        return false;
+    }
+    int entry = FindEntry(key);
+    if (entry < 0 || index_.entries[entry].lyric_block == NO_BLOCK) {
+        return false;
+    }
+    auto& e = index_.entries[entry];
+    lyrics.resize(e.lyric_size);
+    if (!ReadChain(e.lyric_block, 0, (uint8_t*)lyrics.data(), e.lyric_size)) {
+        lyrics.clear();
+        return false;
+    }
+    stats_.bytes_saved += e.lyric_size;
+    return true;
+}
+
+bool MusicCache::StoreLyrics(const std::string& key, const std::string& lyrics) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (partition_ == nullptr || lyrics.empty()) {
+        return false;
+    }
+    int entry = FindEntry(key);
+    if (entry < 0) {
+        return false;
+    }
+    if (index_.entries[entry].lyric_block != NO_BLOCK) {
+        return true;
+    }
+    uint16_t first_block;
+    if (!WriteChain((const uint8_t*)lyrics.data(), lyrics.size(), entry, first_block)) {
+        ESP_LOGW(TAG, "No room for the lyrics of %s", key.c_str());
+        return false;
+    }
+    auto& e = index_.entries[entry];
+    e.lyric_block = first_block;
+    e.lyric_size = lyrics.size();
+    e.lyric_crc = esp_rom_crc32_le(0, (const uint8_t*)lyrics.data(), lyrics.size());
+    stats_.used_bytes += e.lyric_size;
+    return SaveIndex();
+}
+
+bool MusicCache::BeginWrite(const std::string& key, size_t size_hint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (partition_ == nullptr) {
+        return false;
+    }
+    DropSession();
+    if (size_hint > stats_.capacity) {
+        ESP_LOGI(TAG, "%s is larger than the cache (%u bytes), not caching it", key.c_str(), size_hint);
+        return false;
+    }
+    session_.active = true;
+    session_.key = key;
+    ESP_LOGI(TAG, "Caching %s", key.c_str());
+    return true;
+}
+
+bool MusicCache::Write(const uint8_t* data, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!session_.active) {
+        return false;
+    }
+    while (size > 0) {
+        size_t offset = session_.size % MUSIC_CACHE_BLOCK_SIZE;
+        if (offset == 0) {
+            uint16_t block = AllocateBlock(-1);
+            if (block == NO_BLOCK) {
+                ESP_LOGW(TAG, "%s does not fit in the cache", session_.key.c_str());
+                DropSession();
+                return false;
+            }
+            if (session_.last_block == NO_BLOCK) {
+                session_.first_block = block;
+            } else {
+                index_.next_block[session_.last_block] = block;
+            }
+            session_.last_block = block;
+        }
+        size_t bytes = std::min(size, MUSIC_CACHE_BLOCK_SIZE - offset);
+        if (!WriteBlock(session_.last_block, offset, data, bytes)) {
+            ESP_LOGE(TAG, "Failed to write %s", session_.key.c_str());
+            DropSession();
+            return false;
+        }
+        session_.crc = esp_rom_crc32_le(session_.crc, data, bytes);
+        session_.size += bytes;
+        data += bytes;
+        size -= bytes;
+    }
+    return true;
+}
+
+bool MusicCache::EndWrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!session_.active) {
+        return false;
+    }
+    if (session_.size == 0) {
+        DropSession();
+        return false;
+    }
+
+    /* A song that is stored again replaces its old copy */
+    int entry = FindEntry(session_.key);
+    if (entry >= 0) {
+        RemoveEntry(entry);
+    }
+    for (int i = 0; i < MUSIC_CACHE_MAX_ENTRIES && entry < 0; i++) {
+        if (index_.entries[i].first_block == NO_BLOCK) {
+            entry = i;
+        }
+    }
+    if (entry < 0) {
+        EvictLeastRecentlyUsed(-1);
+        for (int i = 0; i < MUSIC_CACHE_MAX_ENTRIES && entry < 0; i++) {
+            if (index_.entries[i].first_block == NO_BLOCK) {
+                entry = i;
+            }
+        }
+    }
+    if (entry < 0) {
+        DropSession();
+        return false;
+    }
+
+    auto& e = index_.entries[entry];
+    memset(&e, 0, sizeof(e));
+    strncpy(e.key, session_.key.c_str(), MUSIC_CACHE_KEY_SIZE - 1);
+    e.key_hash = HashKey(session_.key);
+    e.audio_size = session_.size;
+    e.audio_crc = session_.crc;
+    e.lyric_block = NO_BLOCK;
+    e.first_block = session_.first_block;
+    e.last_used = ++index_.use_counter;
+    verified_[entry] = true;
+    stats_.entries++;
+    stats_.used_bytes += e.audio_size;
+    stats_.stored++;
+    ESP_LOGI(TAG, "Cached %s: %lu bytes", session_.key.c_str(), e.audio_size);
+
+    /* The blocks now belong to the entry */
+    session_ = WriteSession();
+    return SaveIndex();
+}
+
+void MusicCache::AbortWrite() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DropSession();
+}
+
+void MusicCache::Pin(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pinned_key_ = key;
+}
+
+void MusicCache::DropSession() {
+    if (session_.active && session_.first_block != NO_BLOCK) {
+        FreeChain(session_.first_block);
+    }
+    session_ = WriteSession();
+}
+
+MusicCacheStats MusicCache::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,156 @@
+#ifndef MUSIC_CACHE_H
+#define MUSIC_CACHE_H
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+#include <esp_partition.h>
+
+// Label of the data partition holding the cache, boards without it simply play from the network
+#define MUSIC_CACHE_PARTITION_LABEL "music"
+// Songs are stored as chains of blocks, the first block of the partition holds the index
+#define MUSIC_CACHE_BLOCK_SIZE (32 * 1024)
+#define MUSIC_CACHE_MAX_BLOCKS 512
+#define MUSIC_CACHE_MAX_ENTRIES 24
+#define MUSIC_CACHE_KEY_SIZE 64
+// Lookups only update the LRU order in RAM, it is written with the next index write or after this long
+#define MUSIC_CACHE_LRU_SAVE_INTERVAL_MS (5 * 60 * 1000)
+
+struct MusicCacheStats {
+    uint32_t lookups = 0;
+    uint32_t hits = 0;
+    uint64_t bytes_saved = 0;       // Bytes read from flash instead of the network
+    uint32_t stored = 0;            // Songs written to the cache
+    uint32_t evictions = 0;
+    uint32_t corrupted = 0;         // Entries dropped because their data did not match the CRC
+    uint32_t entries = 0;
+    size_t used_bytes = 0;
+    size_t capacity = 0;
+};
+
+/*
+ * Size-bounded LRU cache of streamed songs and their lyrics on a raw data partition.
+ *
+ * The partition is split into blocks of MUSIC_CACHE_BLOCK_SIZE. The first block holds two copies
+ * of the index, written alternately with a sequence number and a CRC, so a power loss while
+ * writing the index falls back to the previous one. The index lists the entries, each with a key,
+ * the sizes and CRCs of its audio and lyrics, and its last use, plus the next block of every block
+ * in use. Blocks that no entry reaches are free.
+ *
+ * A song is written while it streams: BeginWrite() starts a session, Write() appends the audio
+ * in order and EndWrite() adds the entry to the index, so a song that did not finish downloading
+ * never shows up. When blocks run out the least recently used entries are evicted, except the
+ * pinned one that is being played from the cache while another song is written. The data of
+ * an entry is checked against its CRC the first time it is looked up after boot. Flash is erased
+ * one sector at a time just ahead of the writes, as an erase stalls every task running from flash.
+ * For the same reason a lookup does not save the index for its new LRU position: it goes out with
+ * the next write of the index (a new song, an eviction, lyrics), or with a lookup once
+ * MUSIC_CACHE_LRU_SAVE_INTERVAL_MS has passed. A power loss before that only loses some LRU order.
+ *
+ * All methods are thread safe, there is one write session at a time.
+ */
+class MusicCache {
+public:
+    MusicCache();
+
+    MusicCache(const MusicCache&) = delete;
+    MusicCache& operator=(const MusicCache&) = delete;
+
+    // Finds the partition and loads the index, returns false if the cache is not available
+    bool Initialize();
+    inline bool ready() const { return partition_ != nullptr; }
+
+    static std::string MakeKey(const std::string& song_name, const std::string& artist_name);
+
+    // Returns true and the audio size if the song is cached, and marks it as most recently used
+    bool Lookup(const std::string& key, size_t& audio_size);
+    // Returns the number of bytes read, 0 past the end, or -1 if the song is not cached (any more)
+    int ReadAudio(const std::string& key, size_t offset, uint8_t* data, size_t size);
+    bool ReadLyrics(const std::string& key, std::string& lyrics);
+    // Attaches lyrics to a cached song that has none yet
+    bool StoreLyrics(const std::string& key, const std::string& lyrics);
+
+    // Write session of a new song, Write() does nothing outside of a session. A song known to be
+    // larger than the cache is refused up front instead of evicting everything, 0 if the size is unknown
+    bool BeginWrite(const std::string& key, size_t size_hint);
+    bool Write(const uint8_t* data, size_t size);
+    bool EndWrite();
+    void AbortWrite();
+    // Keeps the entry of key (the song playing from the cache) from being evicted, an empty key unpins it
+    void Pin(const std::string& key);
+
+    MusicCacheStats GetStats();
+
+private:
+    static constexpr uint32_t MAGIC = 0x4D434348;   // "MCCH"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint16_t NO_BLOCK = 0xFFFF;
+
+    struct Entry {
+        char key[MUSIC_CACHE_KEY_SIZE];
+        uint32_t key_hash;
+        uint32_t audio_size;
+        uint32_t audio_crc;
+        uint32_t lyric_size;
+        uint32_t lyric_crc;
+        uint32_t last_used;
+        uint16_t first_block;       // NO_BLOCK marks an unused entry
+        uint16_t lyric_block;
+    };
+
+    struct Index {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sequence;
+        uint32_t block_size;
+        uint32_t block_count;
+        uint32_t use_counter;
+        Entry entries[MUSIC_CACHE_MAX_ENTRIES];
+        uint16_t next_block[MUSIC_CACHE_MAX_BLOCKS];
+        uint32_t crc;
+    };
+
+    struct WriteSession {
+        bool active = false;
+        std::string key;
+        uint16_t first_block = NO_BLOCK;
+        uint16_t last_block = NO_BLOCK;
+        uint32_t size = 0;
+        uint32_t crc = 0;
+    };
+
+    std::mutex mutex_;
+    const esp_partition_t* partition_ = nullptr;
+    uint32_t block_count_ = 0;
+    Index index_;
+    int index_slot_ = 0;
+    int64_t index_save_time_ = 0;
+    // Blocks owned by an entry or by the write session
+    bool block_used_[MUSIC_CACHE_MAX_BLOCKS];
+    // Entries whose data was checked since boot
+    bool verified_[MUSIC_CACHE_MAX_ENTRIES];
+    WriteSession session_;
+    std::string pinned_key_;
+    MusicCacheStats stats_;
+
+    static uint32_t HashKey(const std::string& key);
+    bool LoadIndex();
+    bool SaveIndex();
+    void ResetIndex();
+    void RebuildBlockMap();
+    int FindEntry(const std::string& key);
+    bool VerifyEntry(int entry);
+    void RemoveEntry(int entry);
+    // Evicts the least recently used entry other than keep and the pinned one
+    bool EvictLeastRecentlyUsed(int keep);
+    uint16_t AllocateBlock(int keep);
+    void FreeChain(uint16_t block);
+    bool ReadChain(uint16_t block, size_t offset, uint8_t* data, size_t size);
+    bool WriteBlock(uint16_t block, size_t offset, const uint8_t* data, size_t size);
+    bool WriteChain(const uint8_t* data, size_t size, int keep, uint16_t& first_block);
+    void DropSession();
+};
+
+#endif // MUSIC_CACHE_H
@@ -0,0 +1,127 @@
+#include "music_decoder.h"
+#include "mp3_music_decoder.h"
+#include "ogg_opus_music_decoder.h"
+#include "wav_music_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#define TAG "MusicDecoder"
+
+
+const char* MusicFormatName(MusicFormat format) {
+    switch (format) {
+        case kMusicFormatMp3:
+            return "MP3";
+        case kMusicFormatAac:
+            return "AAC";
+        case kMusicFormatOggOpus:
+            return "Ogg/Opus";
+        case kMusicFormatOggVorbis:
+            return "Ogg/Vorbis";
+        case kMusicFormatWav:
+            return "WAV";
+        default:
+            return "unknown";
+    }
+}
+
+static MusicFormat DetectFromMagic(const uint8_t* data, size_t size) {
+    if (size >= 3 && memcmp(data, "ID3", 3) == 0) {
+        return kMusicFormatMp3;
+    }
+    if (size >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0) {
+        return kMusicFormatWav;
+    }
+    if (size >= 8 && memcmp(data + 4, "ftyp", 4) == 0) {
+        return kMusicFormatAac;
+    }
+    if (size >= 27 && memcmp(data, "OggS", 4) == 0) {
+        /* The first page holds only the identification header of the codec */
+        size_t header_size = 27 + data[26];
+        if (size >= header_size + 8 && memcmp(data + header_size, "OpusHead", 8) == 0) {
+            return kMusicFormatOggOpus;
+        }
+        if (size >= header_size + 7 && memcmp(data + header_size, "\x01vorbis", 7) == 0) {
+            return kMusicFormatOggVorbis;
+        }
+        return kMusicFormatUnknown;
+    }
+    if (size >= 2 && data[0] == 0xFF) {
+        /* ADTS has the layer bits cleared, MPEG audio layers are 1 to 3 */
+        if ((data[1] & 0xF6) == 0xF0) {
+            return kMusicFormatAac;
+        }
+        if ((data[1] & 0xE0) == 0xE0 && (data[1] & 0x06) != 0) {
+            return kMusicFormatMp3;
+        }
+    }
+    return kMusicFormatUnknown;
+}
+
+static MusicFormat DetectFromContentType(std::string content_type) {
+    std::transform(content_type.begin(), content_type.end(), content_type.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+    content_type = content_type.substr(0, content_type.find(';'));
+    if (content_type == "audio/mpeg" || content_type == "audio/mp3") {
+        return kMusicFormatMp3;
+    }
+    if (content_type == "audio/aac" || content_type == "audio/aacp" || content_type == "audio/mp4" ||
+        content_type == "audio/x-m4a") {
+        return kMusicFormatAac;
+    }
+    if (content_type == "audio/ogg" || content_type == "audio/opus") {
+        return kMusicFormatOggOpus;
+    }
+    if (content_type == "audio/wav" || content_type == "audio/wave" || content_type == "audio/x-wav") {
+        return kMusicFormatWav;
+    }
+    return kMusicFormatUnknown;
+}
+
+MusicFormat DetectMusicFormat(const uint8_t* data, size_t size, const std::string& content_type) {
+    MusicFormat format = DetectFromMagic(data, size);
+    if (format != kMusicFormatUnknown) {
+        return format;
+    }
+    format = DetectFromContentType(content_type);
+    if (format != kMusicFormatUnknown) {
+        ESP_LOGI(TAG, "Format from Content-Type %s: %s", content_type.c_str(), MusicFormatName(format));
+        return format;
+    }
+    /* Servers used to send nothing but MP3, and the MP3 decoder finds the next frame on its own */
+    if (size >= 4) {
+        ESP_LOGW(TAG, "Unknown audio format, first 4 bytes: %02X %02X %02X %02X, trying MP3",
+            data[0], data[1], data[2], data[3]);
+    }
+    return kMusicFormatMp3;
+}
+
+std::unique_ptr<MusicDecoder> CreateMusicDecoder(MusicFormat format) {
+    std::unique_ptr<MusicDecoder> decoder;
+    switch (format) {
+        case kMusicFormatMp3:
+            decoder = std::make_unique<Mp3MusicDecoder>();
+            break;
+        case kMusicFormatOggOpus:
+            decoder = std::make_unique<OggOpusMusicDecoder>();
+            break;
+        case kMusicFormatWav:
+            decoder = std::make_unique<WavMusicDecoder>();
+            break;
+        case kMusicFormatAac:
+        case kMusicFormatOggVorbis:
+            ESP_LOGE(TAG, "%s streams are recognized but not supported, only MP3, Ogg/Opus and WAV can be played",
+                MusicFormatName(format));
+            return nullptr;
+        default:
+            ESP_LOGE(TAG, "No %s decoder in this build", MusicFormatName(format));
+            return nullptr;
+    }
+    if (!decoder->Initialize()) {
+        return nullptr;
+    }
+    return decoder;
+}
@@ -0,0 +1,73 @@
+#ifndef MUSIC_DECODER_H
+#define MUSIC_DECODER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+enum MusicFormat {
+    kMusicFormatUnknown,
+    kMusicFormatMp3,
+    kMusicFormatAac,            // ADTS stream or MP4/M4A container, detected only
+    kMusicFormatOggOpus,
+    kMusicFormatOggVorbis,      // Detected only
+    kMusicFormatWav,
+};
+
+struct MusicFrameInfo {
+    int sample_rate = 0;
+    int channels = 0;           // Channels of the decoded PCM, interleaved
+    int bitrate = 0;            // Bits per second of the encoded stream, used to estimate seek offsets
+};
+
+enum MusicDecodeResult {
+    kMusicDecodeFrame,          // A frame was decoded into pcm
+    kMusicDecodeNeedMore,       // The data ends in the middle of a frame, call again with the following data
+    kMusicDecodeError,          // The data could not be decoded and was skipped
+};
+
+/*
+ * Frame-level pull decoder of one song in a byte stream.
+ *
+ * The caller hands over whatever contiguous data it has buffered and the decoder decodes at most
+ * one frame from it, reporting how many bytes it used. Data a decoder needs to keep across calls
+ * (a page split between two regions, a container header) is copied by the decoder, so the caller
+ * never has to keep consumed bytes around. A decoder only returns kMusicDecodeNeedMore without
+ * consuming anything when a frame is larger than the data, which for a region of at least
+ * MUSIC_DECODER_MIN_INPUT bytes only happens at the end of a song.
+ */
+class MusicDecoder {
+public:
+    virtual ~MusicDecoder() = default;
+
+    virtual MusicFormat format() const = 0;
+    // Allocates the codec state, returns false if there is not enough memory
+    virtual bool Initialize() = 0;
+    // Restarts at stream_offset of the same song after a seek, keeping what was read from the headers
+    virtual void Reset(size_t stream_offset) = 0;
+    /*
+     * Decodes the next frame from data. consumed returns the bytes used, frame_offset the offset in
+     * data from which decoding of this frame can be restarted (0 if it started in earlier data).
+     */
+    virtual MusicDecodeResult DecodeFrame(const uint8_t* data, size_t size, size_t& consumed, size_t& frame_offset,
+        std::vector<int16_t>& pcm, MusicFrameInfo& info) = 0;
+};
+
+// Contiguous data a decoder is guaranteed to make progress on
+#define MUSIC_DECODER_MIN_INPUT 4096
+
+const char* MusicFormatName(MusicFormat format);
+// Sniffs the format from the first bytes of a song, then from the Content-Type header, defaulting to MP3
+MusicFormat DetectMusicFormat(const uint8_t* data, size_t size, const std::string& content_type);
+/*
+ * Returns an initialized decoder, or nullptr if the format is not supported in this build.
+ * AAC and Ogg/Vorbis are recognized so that such a stream fails with a clear message instead of
+ * being fed to the MP3 decoder, but no decoder is created for them: the managed components have
+ * no AAC or Vorbis decoder, and MP4/M4A would also need a demuxer for a moov box that is often
+ * at the end of the file. Servers still have to serve MP3, Ogg/Opus or WAV.
+ */
+std::unique_ptr<MusicDecoder> CreateMusicDecoder(MusicFormat format);
+
+#endif // MUSIC_DECODER_H
@@ -0,0 +1,220 @@
+#include "ogg_opus_music_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "OggOpusMusicDecoder"
+
+
+OggOpusMusicDecoder::~OggOpusMusicDecoder() {
+    if (decoder_ != nullptr) {
+        opus_decoder_destroy(decoder_);
+    }
+}
+
+bool OggOpusMusicDecoder::Initialize() {
+    /* The codec itself is created from the Opus header */
+    packet_.reserve(MAX_PACKET_SIZE);
+    return true;
+}
+
+void OggOpusMusicDecoder::Reset(size_t stream_offset) {
+    in_page_ = false;
+    segment_count_ = 0;
+    segment_index_ = 0;
+    segment_filled_ = 0;
+    packet_.clear();
+    skip_packet_ = false;
+    skip_continued_ = stream_offset > 0;
+    lost_sync_ = false;
+    if (stream_offset == 0) {
+        head_parsed_ = false;
+        tags_parsed_ = false;
+    } else {
+        pre_skip_ = 0;
+    }
+    if (decoder_ != nullptr) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
+
+bool OggOpusMusicDecoder::CreateDecoder(int channels) {
+    if (decoder_ != nullptr) {
+        if (channels_ == channels) {
+            opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+            return true;
+        }
+        opus_decoder_destroy(decoder_);
+        decoder_ = nullptr;
+    }
+    int error = 0;
+    decoder_ = opus_decoder_create(SAMPLE_RATE, channels, &error);
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create Opus decoder: %d", error);
+        return false;
+    }
+    channels_ = channels;
+    return true;
+}
+
+bool OggOpusMusicDecoder::ParsePageHeader(const uint8_t* data, size_t size, size_t& consumed) {
+    while (size - consumed >= PAGE_HEADER_SIZE) {
+        const uint8_t* page = data + consumed;
+        size_t remaining = size - consumed;
+        if (memcmp(page, "OggS", 4) != 0 || page[4] != 0) {
+            if (!lost_sync_) {
+                ESP_LOGW(TAG, "Lost Ogg page sync, searching for the next page");
+                lost_sync_ = true;
+            }
+            size_t skip = 1;
+            while (skip + 4 <= remaining && memcmp(page + skip, "OggS", 4) != 0) {
+                skip++;
+            }
+            consumed += skip;
+            packet_.clear();
+            skip_continued_ = true;
+            continue;
+        }
+
+        size_t header_size = PAGE_HEADER_SIZE + page[26];
+        if (remaining < header_size) {
+            return false;
+        }
+        lost_sync_ = false;
+        uint8_t header_type = page[5];
+        if (header_type & 0x02) {
+            /* First page of a (chained) stream, its headers follow */
+            head_parsed_ = false;
+            tags_parsed_ = false;
+        }
+        if (!(header_type & 0x01)) {
+            packet_.clear();
+            skip_packet_ = false;
+        } else if (skip_continued_) {
+            skip_packet_ = true;
+        }
+        skip_continued_ = false;
+
+        segment_count_ = page[26];
+        memcpy(segments_, page + PAGE_HEADER_SIZE, segment_count_);
+        segment_index_ = 0;
+        segment_filled_ = 0;
+        consumed += header_size;
+        in_page_ = true;
+        return true;
+    }
+    return false;
+}
+
+MusicDecodeResult OggOpusMusicDecoder::DecodePacket(std::vector<int16_t>& pcm, MusicFrameInfo& info) {
+    if (!head_parsed_) {
+        head_parsed_ = true;
+        if (packet_.size() >= 19 && memcmp(packet_.data(), "OpusHead", 8) == 0) {
+            int channels = packet_[9];
+            pre_skip_ = packet_[10] | (packet_[11] << 8);
+            int mapping_family = packet_[18];
+            if (mapping_family != 0 || channels < 1 || channels > 2) {
+                ESP_LOGE(TAG, "Unsupported Opus stream: %d channels, mapping family %d", channels, mapping_family);
+                if (decoder_ != nullptr) {
+                    opus_decoder_destroy(decoder_);
+                    decoder_ = nullptr;
+                }
+                return kMusicDecodeError;
+            }
+            if (!CreateDecoder(channels)) {
+                return kMusicDecodeError;
+            }
+            ESP_LOGI(TAG, "Opus stream: %d channels, pre-skip %d samples", channels, pre_skip_);
+            return kMusicDecodeNeedMore;
+        }
+        /* Joined in the middle of the stream, a stereo decoder plays mono streams as well */
+        ESP_LOGW(TAG, "No Opus header, decoding as stereo");
+        tags_parsed_ = true;
+        pre_skip_ = 0;
+        if (!CreateDecoder(2)) {
+            return kMusicDecodeError;
+        }
+    }
+    if (!tags_parsed_) {
+        tags_parsed_ = true;
+        if (packet_.size() >= 8 && memcmp(packet_.data(), "OpusTags", 8) == 0) {
+            return kMusicDecodeNeedMore;
+        }
+    }
+    if (decoder_ == nullptr) {
+        return kMusicDecodeError;
+    }
+
+    pcm.resize(MAX_FRAME_SAMPLES * channels_);
+    int samples = opus_decode(decoder_, packet_.data(), packet_.size(), pcm.data(), MAX_FRAME_SAMPLES, 0);
+    if (samples < 0) {
+        ESP_LOGW(TAG, "Opus decode failed with error: %d", samples);
+        return kMusicDecodeError;
+    }
+    info.sample_rate = SAMPLE_RATE;
+    info.channels = channels_;
+    info.bitrate = samples > 0 ? (int)((int64_t)packet_.size() * 8 * SAMPLE_RATE / samples) : 0;
+
+    /* The encoder delay at the start of the song is not part of the music */
+    int skip = std::min(pre_skip_, samples);
+    if (skip > 0) {
+        pcm.erase(pcm.begin(), pcm.begin() + skip * channels_);
+        pre_skip_ -= skip;
+        samples -= skip;
+    }
+    pcm.resize(samples * channels_);
+    return kMusicDecodeFrame;
+}
+
+MusicDecodeResult OggOpusMusicDecoder::DecodeFrame(const uint8_t* data, size_t size, size_t& consumed,
+    size_t& frame_offset, std::vector<int16_t>& pcm, MusicFrameInfo& info) {
+    consumed = 0;
+    frame_offset = 0;
+    while (true) {
+        if (!in_page_) {
+            size_t page_start = consumed;
+            if (!ParsePageHeader(data, size, consumed)) {
+                return kMusicDecodeNeedMore;
+            }
+            /* Decoding can restart at the page, the packet continued from before is dropped then */
+            frame_offset = page_start;
+        }
+
+        while (segment_index_ < segment_count_) {
+            size_t lacing = segments_[segment_index_];
+            size_t length = std::min(lacing - segment_filled_, size - consumed);
+            if (!skip_packet_) {
+                if (packet_.size() + length > MAX_PACKET_SIZE) {
+                    skip_packet_ = true;
+                    packet_.clear();
+                } else {
+                    packet_.insert(packet_.end(), data + consumed, data + consumed + length);
+                }
+            }
+            consumed += length;
+            segment_filled_ += length;
+            if (segment_filled_ < lacing) {
+                return kMusicDecodeNeedMore;
+            }
+            segment_filled_ = 0;
+            segment_index_++;
+            if (lacing == 255) {
+                /* The packet goes on in the next segment, or on the next page */
+                continue;
+            }
+
+            if (skip_packet_ || packet_.empty()) {
+                skip_packet_ = false;
+                packet_.clear();
+                continue;
+            }
+            auto result = DecodePacket(pcm, info);
+            packet_.clear();
+            if (result != kMusicDecodeNeedMore) {
+                return result;
+            }
+        }
+        in_page_ = false;
+    }
+}
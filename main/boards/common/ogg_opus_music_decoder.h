@@ -0,0 +1,54 @@
+#ifndef OGG_OPUS_MUSIC_DECODER_H
+#define OGG_OPUS_MUSIC_DECODER_H
+
+#include "music_decoder.h"
+
+#include <opus.h>
+
+/*
+ * Opus in an Ogg container, decoded at 48 kHz.
+ *
+ * Pages are demuxed as the data comes in: the page header is parsed from the data and the packet
+ * bytes are collected into one buffer, so pages and packets may span any number of calls. After a
+ * seek the demuxer searches for the next page and drops the packet continued from the page before.
+ * Only channel mapping family 0 (mono and stereo) is supported.
+ */
+class OggOpusMusicDecoder : public MusicDecoder {
+public:
+    OggOpusMusicDecoder() = default;
+    virtual ~OggOpusMusicDecoder();
+
+    virtual MusicFormat format() const override { return kMusicFormatOggOpus; }
+    virtual bool Initialize() override;
+    virtual void Reset(size_t stream_offset) override;
+    virtual MusicDecodeResult DecodeFrame(const uint8_t* data, size_t size, size_t& consumed, size_t& frame_offset,
+        std::vector<int16_t>& pcm, MusicFrameInfo& info) override;
+
+private:
+    static constexpr int SAMPLE_RATE = 48000;
+    static constexpr int MAX_FRAME_SAMPLES = 5760;      // 120ms, the longest Opus packet
+    static constexpr size_t MAX_PACKET_SIZE = 8192;     // Larger packets (cover art in the tags) are skipped
+    static constexpr size_t PAGE_HEADER_SIZE = 27;
+
+    OpusDecoder* decoder_ = nullptr;
+    int channels_ = 0;
+    bool head_parsed_ = false;
+    bool tags_parsed_ = false;
+    int pre_skip_ = 0;              // Samples at the start of the song to drop
+
+    bool in_page_ = false;
+    uint8_t segments_[255];
+    int segment_count_ = 0;
+    int segment_index_ = 0;
+    size_t segment_filled_ = 0;
+    std::vector<uint8_t> packet_;
+    bool skip_packet_ = false;      // The packet being collected is dropped
+    bool skip_continued_ = false;   // The next page continues a packet that was not collected
+    bool lost_sync_ = false;
+
+    bool ParsePageHeader(const uint8_t* data, size_t size, size_t& consumed);
+    bool CreateDecoder(int channels);
+    MusicDecodeResult DecodePacket(std::vector<int16_t>& pcm, MusicFrameInfo& info);
+};
+
+#endif // OGG_OPUS_MUSIC_DECODER_H
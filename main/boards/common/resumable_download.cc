@@ -0,0 +1,136 @@
+#include "resumable_download.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+
+#define TAG "ResumableDownload"
+
+#define CHUNK_SIZE 4096
+
+
+ResumableDownload::ResumableDownload(int max_retries, int backoff_ms, ResumableDownloadCallbacks callbacks)
+    : max_retries_(max_retries), backoff_ms_(backoff_ms), callbacks_(std::move(callbacks)) {
+}
+
+bool ResumableDownload::Run(const std::string& url, size_t offset, size_t end) {
+    offset_ = offset;
+    requests_ = 0;
+    int failures = 0;
+
+    while (IsRunning()) {
+        if (failures > 0) {
+            if (failures > max_retries_) {
+                ESP_LOGE(TAG, "Giving up at offset %u after %d retries", offset_, max_retries_);
+                return false;
+            }
+            ESP_LOGW(TAG, "Resuming at offset %u (attempt %d of %d)", offset_, failures, max_retries_);
+            vTaskDelay(pdMS_TO_TICKS(backoff_ms_ * failures));
+            if (!IsRunning()) {
+                break;
+            }
+        }
+
+        auto http = callbacks_.create_http();
+        std::string range = "bytes=" + std::to_string(offset_) + "-";
+        if (end > 0) {
+            range += std::to_string(end - 1);
+        }
+        http->SetHeader("Range", range);
+
+        int64_t request_time = esp_timer_get_time();
+        bool first_byte = true;
+        requests_++;
+        if (!http->Open("GET", url)) {
+            ESP_LOGE(TAG, "Failed to connect to %s", url.c_str());
+            failures++;
+            continue;
+        }
+
+        int status_code = http->GetStatusCode();
+        if (status_code == 416) {
+            /* The range starts at or past the end of the file */
+            ESP_LOGW(TAG, "Range %s not satisfiable, nothing left to download", range.c_str());
+            http->Close();
+            return true;
+        }
+        if (status_code != 200 && status_code != 206) {
+            ESP_LOGE(TAG, "HTTP GET failed with status code: %d", status_code);
+            http->Close();
+            if (status_code >= 500) {
+                /* Server errors may be temporary */
+                failures++;
+                continue;
+            }
+            return false;
+        }
+
+        /* 200 is the whole file from its start, the part already written is dropped */
+        size_t position = (status_code == 206) ? offset_ : 0;
+        size_t body_length = http->GetBodyLength();
+        size_t body_end = body_length > 0 ? position + body_length : 0;
+        std::string content_type = http->GetResponseHeader("Content-Type");
+        ESP_LOGI(TAG, "Downloading at offset %u, status: %d, length: %u, type: %s", offset_, status_code,
+            body_length, content_type.c_str());
+        if (callbacks_.on_response) {
+            callbacks_.on_response(status_code, offset_, body_end, content_type);
+        }
+
+        bool connection_lost = false;
+        while (IsRunning() && (end == 0 || offset_ < end)) {
+            char discard[512];
+            char* buffer = discard;
+            size_t read_size = std::min(sizeof(discard), offset_ - position);
+            if (position == offset_) {
+                size_t region_size = 0;
+                buffer = (char*)callbacks_.wait_write_region(region_size);
+                if (buffer == nullptr) {
+                    http->Close();
+                    return false;
+                }
+                read_size = std::min<size_t>(region_size, CHUNK_SIZE);
+                if (end > 0) {
+                    read_size = std::min(read_size, end - offset_);
+                }
+            }
+
+            int64_t read_time = esp_timer_get_time();
+            int bytes_read = http->Read(buffer, read_size);
+            if (bytes_read > 0 && callbacks_.on_read) {
+                int64_t now = esp_timer_get_time();
+                callbacks_.on_read(bytes_read, now - read_time, first_byte ? now - request_time : -1);
+                first_byte = false;
+            }
+            if (bytes_read < 0) {
+                ESP_LOGE(TAG, "Failed to read: error code %d", bytes_read);
+                connection_lost = true;
+                break;
+            }
+            if (bytes_read == 0) {
+                /* With a known length, a connection closed early is resumed */
+                if (body_end > 0 && position < body_end) {
+                    ESP_LOGW(TAG, "Connection closed at %u of %u bytes", position, body_end);
+                    connection_lost = true;
+                }
+                break;
+            }
+            position += bytes_read;
+            if (buffer == discard) {
+                continue;
+            }
+
+            callbacks_.commit_write((const uint8_t*)buffer, bytes_read);
+            offset_ += bytes_read;
+            failures = 0;
+        }
+
+        http->Close();
+        if (!connection_lost) {
+            return IsRunning();
+        }
+        failures++;
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#ifndef RESUMABLE_DOWNLOAD_H
+#define RESUMABLE_DOWNLOAD_H
+
+#include <http.h>
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+struct ResumableDownloadCallbacks {
+    // Creates the connection for one request with the headers set, the Range header is added here
+    std::function<std::unique_ptr<Http>()> create_http;
+    // Checked before every request and read, the download stops once it returns false
+    std::function<bool()> is_running;
+    // A request was answered with 200 or 206, offset is the first byte this request writes
+    std::function<void(int status_code, size_t offset, size_t body_end, const std::string& content_type)> on_response;
+    // Returns the free region to read into, or nullptr to stop
+    std::function<uint8_t*(size_t& size)> wait_write_region;
+    // The first size bytes of the region hold new data
+    std::function<void(const uint8_t* data, size_t size)> commit_write;
+    // Every successful read, ttfb_us is the time since the request for the first read of a connection, -1 otherwise
+    std::function<void(size_t bytes, int64_t read_us, int64_t ttfb_us)> on_read;
+};
+
+/*
+ * Downloads the [offset, end) part of a file over HTTP and resumes after a failure.
+ *
+ * A failed open, a read error, a 5xx response or a connection closed before the announced body
+ * length opens a new request with "Range: bytes=<offset>-" from the last byte written. It waits
+ * backoff_ms times the number of consecutive failures before each retry and gives up after
+ * max_retries of them; a read that delivers data resets the count. A server that ignores Range
+ * answers 200 from the start of the file, the bytes already written are then read and dropped.
+ */
+class ResumableDownload {
+public:
+    ResumableDownload(int max_retries, int backoff_ms, ResumableDownloadCallbacks callbacks);
+
+    // end 0 reads to the end of the file. Returns false if stopped, or if the retries ran out
+    bool Run(const std::string& url, size_t offset, size_t end);
+
+    // The byte after the last one written
+    inline size_t offset() const { return offset_; }
+    // Requests made by the last Run(), including the resumed ones
+    inline uint32_t requests() const { return requests_; }
+
+private:
+    int max_retries_;
+    int backoff_ms_;
+    ResumableDownloadCallbacks callbacks_;
+    size_t offset_ = 0;
+    uint32_t requests_ = 0;
+
+    bool IsRunning() const { return !callbacks_.is_running || callbacks_.is_running(); }
+};
+
+#endif // RESUMABLE_DOWNLOAD_H
@@ -0,0 +1,172 @@
+#include "stream_ring_buffer.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "StreamRingBuffer"
+
+
+StreamRingBuffer::StreamRingBuffer(size_t capacity, size_t guard_size, size_t high_watermark, size_t low_watermark,
+    size_t start_watermark)
+    : capacity_(capacity), guard_size_(std::min(guard_size, capacity)), high_watermark_(std::min(high_watermark, capacity)),
+      low_watermark_(std::min(low_watermark, high_watermark)), start_watermark_(std::min(start_watermark, high_watermark)) {
+    stats_.capacity = capacity_;
+}
+
+StreamRingBuffer::~StreamRingBuffer() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+bool StreamRingBuffer::Allocate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffer_ != nullptr) {
+        return true;
+    }
+    buffer_ = (uint8_t*)heap_caps_malloc(capacity_ + guard_size_, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u bytes", capacity_ + guard_size_);
+        return false;
+    }
+    ESP_LOGI(TAG, "Allocated %u bytes, watermarks: start=%u low=%u high=%u", capacity_, start_watermark_,
+        low_watermark_, high_watermark_);
+    return true;
+}
+
+uint8_t* StreamRingBuffer::WaitWriteRegion(size_t& size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!write_paused_ && size_ >= high_watermark_) {
+        write_paused_ = true;
+        stats_.writer_pauses++;
+    }
+    cv_.wait(lock, [this] { return aborted_ || !write_paused_; });
+    if (aborted_ || buffer_ == nullptr) {
+        size = 0;
+        return nullptr;
+    }
+    size = std::min(capacity_ - size_, capacity_ - write_pos_);
+    return buffer_ + write_pos_;
+}
+
+void StreamRingBuffer::CommitWrite(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_pos_ = (write_pos_ + size) % capacity_;
+    size_ += size;
+    stats_.bytes_written += size;
+    stats_.peak_size = std::max(stats_.peak_size, size_);
+    cv_.notify_all();
+}
+
+void StreamRingBuffer::SetEndOfStream() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    end_of_stream_ = true;
+    cv_.notify_all();
+}
+
+bool StreamRingBuffer::WaitForStart() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return aborted_ || end_of_stream_ || size_ >= start_watermark_; });
+    started_ = true;
+    return !aborted_ && size_ > 0;
+}
+
+uint8_t* StreamRingBuffer::WaitReadRegion(size_t min_size, size_t& size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    min_size = std::min(min_size, guard_size_);
+    if (size_ < min_size && !end_of_stream_ && !aborted_) {
+        /* The network did not keep up with the decoder */
+        if (reader_wait_callback_) {
+            lock.unlock();
+            reader_wait_callback_();
+            lock.lock();
+        }
+        int64_t wait_start = esp_timer_get_time();
+        cv_.wait(lock, [this, min_size] { return aborted_ || end_of_stream_ || size_ >= min_size; });
+        if (started_) {
+            uint32_t wait_us = esp_timer_get_time() - wait_start;
+            stats_.underruns++;
+            stats_.underrun_us += wait_us;
+            stats_.max_underrun_us = std::max(stats_.max_underrun_us, wait_us);
+        }
+    }
+    if (aborted_ || size_ == 0) {
+        size = 0;
+        return nullptr;
+    }
+
+    size = std::min(size_, guard_size_);
+    size_t contiguous = capacity_ - read_pos_;
+    if (contiguous < size) {
+        /* Mirror the wrapped part behind the end, the writer never writes to the guard area */
+        memcpy(buffer_ + capacity_, buffer_, size - contiguous);
+    }
+    return buffer_ + read_pos_;
+}
+
+void StreamRingBuffer::Consume(size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size = std::min(size, size_);
+    read_pos_ = (read_pos_ + size) % capacity_;
+    size_ -= size;
+    stats_.bytes_read += size;
+    /* Only wake the writer once there is room for a long run of reads */
+    if (write_paused_ && size_ <= low_watermark_) {
+        write_paused_ = false;
+        cv_.notify_all();
+    }
+}
+
+bool StreamRingBuffer::Skip(size_t size) {
+    while (size > 0) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this] { return aborted_ || end_of_stream_ || size_ > 0; });
+        if (aborted_ || size_ == 0) {
+            return false;
+        }
+        size_t skipped = std::min(size, size_);
+        read_pos_ = (read_pos_ + skipped) % capacity_;
+        size_ -= skipped;
+        stats_.bytes_read += skipped;
+        size -= skipped;
+        if (write_paused_ && size_ <= low_watermark_) {
+            write_paused_ = false;
+            cv_.notify_all();
+        }
+    }
+    return true;
+}
+
+void StreamRingBuffer::Abort() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    aborted_ = true;
+    cv_.notify_all();
+}
+
+void StreamRingBuffer::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    read_pos_ = 0;
+    write_pos_ = 0;
+    size_ = 0;
+    end_of_stream_ = false;
+    aborted_ = false;
+    write_paused_ = false;
+    started_ = false;
+    stats_ = StreamRingBufferStats();
+    stats_.capacity = capacity_;
+}
+
+size_t StreamRingBuffer::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+StreamRingBufferStats StreamRingBuffer::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto stats = stats_;
+    stats.size = size_;
+    return stats;
+}
@@ -0,0 +1,95 @@
+#ifndef STREAM_RING_BUFFER_H
+#define STREAM_RING_BUFFER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+struct StreamRingBufferStats {
+    size_t capacity = 0;
+    size_t size = 0;                // Bytes buffered now
+    size_t peak_size = 0;
+    uint64_t bytes_written = 0;
+    uint64_t bytes_read = 0;
+    uint32_t underruns = 0;         // Reads that had to wait for data after the start watermark was reached
+    uint64_t underrun_us = 0;       // Time those reads waited
+    uint32_t max_underrun_us = 0;
+    uint32_t writer_pauses = 0;     // Times the writer stopped at the high watermark
+};
+
+/*
+ * Byte ring between a network writer and a decoder reader, allocated once in PSRAM.
+ *
+ * The writer reads straight into the free region returned by WaitWriteRegion(), and the reader
+ * decodes straight from the region returned by WaitReadRegion(), so the data is copied once
+ * from the network into the ring and never again. A read region that crosses the end of the ring
+ * is made contiguous by mirroring the first bytes of the ring into a guard area after its end,
+ * so a region of up to guard_size bytes is always contiguous.
+ *
+ * Flow control uses watermarks instead of a size check per chunk: the writer stops when the
+ * buffered data reaches the high watermark and is only woken once the reader drained it to the
+ * low watermark, and the reader starts once the start watermark is reached (or the stream ended).
+ *
+ * One writer thread and one reader thread. Abort() wakes both and makes every wait fail until
+ * the next Reset().
+ */
+class StreamRingBuffer {
+public:
+    StreamRingBuffer(size_t capacity, size_t guard_size, size_t high_watermark, size_t low_watermark,
+        size_t start_watermark);
+    ~StreamRingBuffer();
+
+    StreamRingBuffer(const StreamRingBuffer&) = delete;
+    StreamRingBuffer& operator=(const StreamRingBuffer&) = delete;
+
+    // Allocates the ring on first use, returns false if there is not enough memory
+    bool Allocate();
+
+    // Writer: returns the contiguous free region, or nullptr once aborted
+    uint8_t* WaitWriteRegion(size_t& size);
+    void CommitWrite(size_t size);
+    void SetEndOfStream();
+
+    // Reader: returns false if aborted, or if the stream ended without any data
+    bool WaitForStart();
+    /*
+     * Waits until min_size bytes are buffered (fewer once the stream ended) and returns them as
+     * one contiguous region of at most guard_size bytes, or nullptr once drained or aborted.
+     */
+    uint8_t* WaitReadRegion(size_t min_size, size_t& size);
+    void Consume(size_t size);
+    // Called without the lock each time the reader is about to wait for data, set before the threads start
+    void SetReaderWaitCallback(std::function<void()> callback) { reader_wait_callback_ = std::move(callback); }
+    // Consumes size bytes even if they are not buffered yet, returns false if aborted or drained first
+    bool Skip(size_t size);
+
+    void Abort();
+    void Reset();
+
+    size_t Size() const;
+    StreamRingBufferStats GetStats();
+
+private:
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    uint8_t* buffer_ = nullptr;
+    const size_t capacity_;
+    const size_t guard_size_;
+    const size_t high_watermark_;
+    const size_t low_watermark_;
+    const size_t start_watermark_;
+
+    size_t read_pos_ = 0;
+    size_t write_pos_ = 0;
+    size_t size_ = 0;
+    bool end_of_stream_ = false;
+    bool aborted_ = false;
+    bool write_paused_ = false;
+    bool started_ = false;
+    StreamRingBufferStats stats_;
+    std::function<void()> reader_wait_callback_;
+};
+
+#endif // STREAM_RING_BUFFER_H
@@ -0,0 +1,146 @@
+#include "wav_music_decoder.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "WavMusicDecoder"
+
+
+static uint32_t ReadLe32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static uint16_t ReadLe16(const uint8_t* data) {
+    return data[0] | (data[1] << 8);
+}
+
+void WavMusicDecoder::Reset(size_t stream_offset) {
+    position_ = stream_offset;
+    skip_ = 0;
+    if (!fmt_parsed_ || data_offset_ == 0 || stream_offset < data_offset_) {
+        /* Start over, the file is parsed from the header again */
+        riff_parsed_ = false;
+        fmt_parsed_ = false;
+        in_data_ = false;
+        return;
+    }
+    /* Skip to the start of the next sample */
+    in_data_ = true;
+    skip_ = (block_align_ - (stream_offset - data_offset_) % block_align_) % block_align_;
+}
+
+MusicDecodeResult WavMusicDecoder::ParseHeader(const uint8_t* data, size_t size, size_t& consumed) {
+    while (!in_data_) {
+        if (skip_ > 0) {
+            size_t skipped = std::min(skip_, size - consumed);
+            consumed += skipped;
+            position_ += skipped;
+            skip_ -= skipped;
+            if (skip_ > 0) {
+                return kMusicDecodeNeedMore;
+            }
+        }
+
+        const uint8_t* chunk = data + consumed;
+        size_t remaining = size - consumed;
+        if (!riff_parsed_) {
+            if (remaining < 12) {
+                return kMusicDecodeNeedMore;
+            }
+            if (memcmp(chunk, "RIFF", 4) != 0 || memcmp(chunk + 8, "WAVE", 4) != 0) {
+                ESP_LOGE(TAG, "Not a RIFF/WAVE file");
+                consumed = size;
+                return kMusicDecodeError;
+            }
+            riff_parsed_ = true;
+            consumed += 12;
+            position_ += 12;
+            continue;
+        }
+
+        if (remaining < 8) {
+            return kMusicDecodeNeedMore;
+        }
+        uint32_t chunk_size = ReadLe32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (remaining < 24) {
+                return kMusicDecodeNeedMore;
+            }
+            uint16_t format_tag = ReadLe16(chunk + 8);
+            channels_ = ReadLe16(chunk + 10);
+            sample_rate_ = ReadLe32(chunk + 12);
+            block_align_ = ReadLe16(chunk + 20);
+            int bits_per_sample = ReadLe16(chunk + 22);
+            /* 0xFFFE is WAVE_FORMAT_EXTENSIBLE, which players write for plain PCM too */
+            if ((format_tag != 1 && format_tag != 0xFFFE) || bits_per_sample != 16 || channels_ < 1 ||
+                channels_ > 2 || sample_rate_ <= 0 || block_align_ != channels_ * 2) {
+                ESP_LOGE(TAG, "Unsupported WAV format: tag=0x%04X channels=%d rate=%d bits=%d", format_tag,
+                    channels_, sample_rate_, bits_per_sample);
+                consumed = size;
+                return kMusicDecodeError;
+            }
+            fmt_parsed_ = true;
+            ESP_LOGI(TAG, "WAV stream: %d Hz, %d channels", sample_rate_, channels_);
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!fmt_parsed_) {
+                ESP_LOGE(TAG, "Data chunk before the fmt chunk");
+                consumed = size;
+                return kMusicDecodeError;
+            }
+            consumed += 8;
+            position_ += 8;
+            data_offset_ = position_;
+            /* Streaming servers write 0 or 0xFFFFFFFF when the length is not known yet */
+            data_end_ = (chunk_size == 0 || chunk_size == UINT32_MAX) ? SIZE_MAX : data_offset_ + chunk_size;
+            in_data_ = true;
+            return kMusicDecodeFrame;
+        }
+        consumed += 8;
+        position_ += 8;
+        skip_ = chunk_size + (chunk_size & 1);
+    }
+    return kMusicDecodeFrame;
+}
+
+MusicDecodeResult WavMusicDecoder::DecodeFrame(const uint8_t* data, size_t size, size_t& consumed,
+    size_t& frame_offset, std::vector<int16_t>& pcm, MusicFrameInfo& info) {
+    consumed = 0;
+    frame_offset = 0;
+    if (!in_data_) {
+        auto result = ParseHeader(data, size, consumed);
+        if (result != kMusicDecodeFrame) {
+            return result;
+        }
+    }
+
+    if (skip_ > 0) {
+        size_t skipped = std::min(skip_, size - consumed);
+        consumed += skipped;
+        position_ += skipped;
+        skip_ -= skipped;
+    }
+    if (position_ >= data_end_) {
+        /* Chunks after the data, such as tags, are not audio */
+        position_ += size - consumed;
+        consumed = size;
+        return kMusicDecodeNeedMore;
+    }
+
+    size_t frame_size = std::min(size - consumed, (size_t)FRAME_SAMPLES * block_align_);
+    frame_size = std::min(frame_size, data_end_ - position_);
+    frame_size -= frame_size % block_align_;
+    if (frame_size == 0) {
+        return kMusicDecodeNeedMore;
+    }
+
+    frame_offset = consumed;
+    pcm.resize(frame_size / sizeof(int16_t));
+    memcpy(pcm.data(), data + consumed, frame_size);
+    consumed += frame_size;
+    position_ += frame_size;
+    info.sample_rate = sample_rate_;
+    info.channels = channels_;
+    info.bitrate = sample_rate_ * block_align_ * 8;
+    return kMusicDecodeFrame;
+}
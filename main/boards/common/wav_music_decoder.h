@@ -0,0 +1,35 @@
+#ifndef WAV_MUSIC_DECODER_H
+#define WAV_MUSIC_DECODER_H
+
+#include "music_decoder.h"
+
+// 16-bit PCM in a RIFF/WAVE container, chunks before the data chunk are skipped however large they are
+class WavMusicDecoder : public MusicDecoder {
+public:
+    WavMusicDecoder() = default;
+
+    virtual MusicFormat format() const override { return kMusicFormatWav; }
+    virtual bool Initialize() override { return true; }
+    virtual void Reset(size_t stream_offset) override;
+    virtual MusicDecodeResult DecodeFrame(const uint8_t* data, size_t size, size_t& consumed, size_t& frame_offset,
+        std::vector<int16_t>& pcm, MusicFrameInfo& info) override;
+
+private:
+    // Samples per channel handed out per frame, about as long as an MP3 frame
+    static constexpr int FRAME_SAMPLES = 1152;
+
+    bool riff_parsed_ = false;
+    bool fmt_parsed_ = false;
+    bool in_data_ = false;
+    int channels_ = 0;
+    int sample_rate_ = 0;
+    int block_align_ = 0;
+    size_t position_ = 0;           // Offset in the file of the next byte
+    size_t skip_ = 0;               // Bytes left of a chunk that is not needed, or to the next sample
+    size_t data_offset_ = 0;
+    size_t data_end_ = 0;
+
+    MusicDecodeResult ParseHeader(const uint8_t* data, size_t size, size_t& consumed);
+};
+
+#endif // WAV_MUSIC_DECODER_H
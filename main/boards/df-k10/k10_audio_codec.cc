@@ -3,7 +3,9 @@
 #include <esp_log.h>
 #include <driver/i2c_master.h>
 #include <driver/i2s_tdm.h>
-#include <cmath>
+#include <algorithm>
+
+#include "pcm_kernels.h"
 
 static const char TAG[] = "K10AudioCodec";
 
@@ -200,27 +202,22 @@ int K10AudioCodec::Read(int16_t* dest, int samples) {
 
 int K10AudioCodec::Write(const int16_t* data, int samples) {
     if (output_enabled_) {
-        std::vector<int32_t> buffer(samples * 2);  // Allocate buffer for 2x samples
-
-        // Apply volume adjustment (same as before)
-        int32_t volume_factor = pow(double(output_volume_) / 100.0, 2) * 65536;
-        for (int i = 0; i < samples; i++) {
-            int64_t temp = int64_t(data[i]) * volume_factor;
-            if (temp > INT32_MAX) {
-            buffer[i * 2] = INT32_MAX;
-            } else if (temp < INT32_MIN) {
-            buffer[i * 2] = INT32_MIN;
-            } else {
-            buffer[i * 2] = static_cast<int32_t>(temp);
-            }
-
-            // Repeat each sample for slow playback (assuming mono audio)
-            buffer[i * 2 + 1] = buffer[i * 2];
+        int32_t* buffer = tx_scratch_.data();
+        if (buffer == nullptr) {
+            return 0;
         }
 
-        size_t bytes_written;
-        ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer.data(), samples * 2 * sizeof(int32_t), &bytes_written, portMAX_DELAY));
-        return bytes_written / sizeof(int32_t);
+        // Apply the volume and repeat each sample on both slots (assuming mono audio)
+        int written = 0;
+        while (written < samples) {
+            int chunk = std::min(samples - written, AUDIO_CODEC_SCRATCH_SAMPLES / 2);
+            PcmGainWiden32Dup2(data + written, chunk, output_volume_factor_, buffer);
+
+            size_t bytes_written;
+            ESP_ERROR_CHECK(i2s_channel_write(tx_handle_, buffer, chunk * 2 * sizeof(int32_t), &bytes_written, portMAX_DELAY));
+            written += bytes_written / sizeof(int32_t) / 2;
+        }
+        return written * 2;
     }
     return samples;
 }
@@ -0,0 +1,70 @@
+#include "display_profiler.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "DisplayProfiler"
+
+
+void DisplayProfiler::Attach(lv_display_t* display, int log_interval_ms) {
+    Detach();
+    if (display == nullptr) {
+        return;
+    }
+    display_ = display;
+    log_interval_us_ = (int64_t)log_interval_ms * 1000;
+    render_start_us_ = 0;
+    period_start_us_ = esp_timer_get_time();
+    period_refreshes_ = 0;
+    period_refresh_us_ = 0;
+    period_max_us_ = 0;
+    lv_display_add_event_cb(display_, EventCallback, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, EventCallback, LV_EVENT_REFR_READY, this);
+}
+
+void DisplayProfiler::Detach() {
+    if (display_ != nullptr) {
+        lv_display_remove_event_cb_with_user_data(display_, EventCallback, this);
+        display_ = nullptr;
+    }
+}
+
+void DisplayProfiler::EventCallback(lv_event_t* e) {
+    auto self = static_cast<DisplayProfiler*>(lv_event_get_user_data(e));
+    // 没有失效区域时LVGL也会发REFR_READY，只统计真正渲染过的刷新
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        if (self->render_start_us_ == 0) {
+            self->render_start_us_ = esp_timer_get_time();
+        }
+    } else if (self->render_start_us_ != 0) {
+        uint32_t elapsed_us = esp_timer_get_time() - self->render_start_us_;
+        self->render_start_us_ = 0;
+        self->OnRefreshDone(elapsed_us);
+    }
+}
+
+void DisplayProfiler::OnRefreshDone(uint32_t elapsed_us) {
+    refreshes_++;
+    refresh_us_ += elapsed_us;
+    if (log_interval_us_ <= 0) {
+        return;
+    }
+
+    period_refreshes_++;
+    period_refresh_us_ += elapsed_us;
+    period_max_us_ = std::max(period_max_us_, elapsed_us);
+    int64_t now = esp_timer_get_time();
+    int64_t period_us = now - period_start_us_;
+    if (period_us < log_interval_us_) {
+        return;
+    }
+    ESP_LOGI(TAG, "%.1f frames/s, frame avg %lu us max %lu us, busy %.1f%%",
+        period_refreshes_ * 1000000.0f / period_us,
+        (uint32_t)(period_refresh_us_ / period_refreshes_), period_max_us_,
+        period_refresh_us_ * 100.0f / period_us);
+    period_start_us_ = now;
+    period_refreshes_ = 0;
+    period_refresh_us_ = 0;
+    period_max_us_ = 0;
+}
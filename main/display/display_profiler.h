@@ -0,0 +1,41 @@
+#ifndef DISPLAY_PROFILER_H
+#define DISPLAY_PROFILER_H
+
+#include <lvgl.h>
+#include <cstdint>
+
+/*
+ * LVGL显示的帧耗时统计
+ *
+ * 通过显示事件测量每次真正有绘制的刷新：从RENDER_START到REFR_READY，包括渲染和把缓冲区
+ * 经SPI/DMA发出去的等待。各板子用不同的LcdBufferPolicy对比这些数字，选出最快的缓冲区配置。
+ * 计数在LVGL任务里更新，读取时要持有显示锁。
+ */
+class DisplayProfiler {
+public:
+    // log_interval_ms大于0时，每隔这么久在LVGL任务里打印一次统计
+    void Attach(lv_display_t* display, int log_interval_ms);
+    void Detach();
+
+    // 累计值，使用者记下上次的值求差，互不干扰
+    inline uint32_t refreshes() const { return refreshes_; }
+    inline uint64_t refresh_us() const { return refresh_us_; }
+
+private:
+    lv_display_t* display_ = nullptr;
+    int64_t log_interval_us_ = 0;
+    int64_t render_start_us_ = 0;
+    uint32_t refreshes_ = 0;
+    uint64_t refresh_us_ = 0;
+
+    // 当前打印周期的统计
+    int64_t period_start_us_ = 0;
+    uint32_t period_refreshes_ = 0;
+    uint64_t period_refresh_us_ = 0;
+    uint32_t period_max_us_ = 0;
+
+    static void EventCallback(lv_event_t* e);
+    void OnRefreshDone(uint32_t elapsed_us);
+};
+
+#endif // DISPLAY_PROFILER_H
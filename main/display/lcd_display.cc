@@ -16,6 +16,7 @@
 #include "settings.h"
 
 #include "board.h"
+#include "application.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -24,6 +25,16 @@
 #define TAG "LcdDisplay"
 
 #define FFT_SIZE 512
+#ifdef CONFIG_SPECTRUM_DISPLAY_FPS
+#define SPECTRUM_FPS CONFIG_SPECTRUM_DISPLAY_FPS
+#else
+#define SPECTRUM_FPS 25
+#endif
+#ifdef CONFIG_DISPLAY_PROFILER
+#define DISPLAY_PROFILER_LOG_INTERVAL_MS 10000
+#else
+#define DISPLAY_PROFILER_LOG_INTERVAL_MS 0
+#endif
 static int current_heights[40] = {0};
 static float avg_power_spectrum[FFT_SIZE/2]={-25.0f};
 
@@ -105,9 +116,16 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     }
 }
 
+void LcdDisplay::LogBufferPolicy(const LcdBufferPolicy& policy) {
+    ESP_LOGI(TAG, "LVGL buffer: %d lines x%d in %s, transfer buffer %d lines, bounce buffer %s, free internal RAM %u",
+        policy.lines, policy.double_buffer ? 2 : 1, policy.spiram ? "PSRAM" : "internal RAM",
+        policy.trans_lines, policy.bounce_buffer ? "on" : "off",
+        heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+}
+
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts, const LcdBufferPolicy& buffer_policy)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
 
     // draw white
@@ -134,9 +152,9 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
-        .trans_size = 0,
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_policy.lines),
+        .double_buffer = buffer_policy.double_buffer,
+        .trans_size = static_cast<uint32_t>(buffer_policy.spiram ? width_ * buffer_policy.trans_lines : 0),
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -147,8 +165,8 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
+            .buff_dma = !buffer_policy.spiram,
+            .buff_spiram = buffer_policy.spiram,
             .sw_rotate = 0,
             .swap_bytes = 1,
             .full_refresh = 0,
@@ -161,31 +179,22 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    LogBufferPolicy(buffer_policy);
+    profiler_.Attach(display_, DISPLAY_PROFILER_LOG_INTERVAL_MS);
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
     }
 
-    // 初始化 FFT 相关内存
-    fft_real = (float*)heap_caps_malloc(FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    fft_imag = (float*)heap_caps_malloc(FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    hanning_window_float = (float*)heap_caps_malloc(FFT_SIZE * sizeof(float), MALLOC_CAP_SPIRAM);
-    
-    // 创建窗函数
-    for (int i = 0; i < FFT_SIZE; i++) {
-        hanning_window_float[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (FFT_SIZE - 1)));
-    }
+    // 初始化 FFT：窗函数和旋转因子只算一次
+    spectrum_fft_.Configure(FFT_SIZE);
     
     if(audio_data==nullptr){
         audio_data=(int16_t*)heap_caps_malloc(sizeof(int16_t)*1152, MALLOC_CAP_SPIRAM);
         memset(audio_data,0,sizeof(int16_t)*1152);
     }
-    if(frame_audio_data==nullptr){
-        frame_audio_data=(int16_t*)heap_caps_malloc(sizeof(int16_t)*1152, MALLOC_CAP_SPIRAM);
-        memset(frame_audio_data,0,sizeof(int16_t)*1152);
-    }
     
-    ESP_LOGI(TAG,"Initialize fft_input, audio_data, frame_audio_data, spectrum_data");
+    ESP_LOGI(TAG,"Initialize fft_input, audio_data, spectrum_data");
 
     SetupUI();
 }
@@ -194,7 +203,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                            int width, int height, int offset_x, int offset_y,
                            bool mirror_x, bool mirror_y, bool swap_xy,
-                           DisplayFonts fonts)
+                           DisplayFonts fonts, const LcdBufferPolicy& buffer_policy)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
 
     // draw white
@@ -216,8 +225,9 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
     const lvgl_port_display_cfg_t display_cfg = {
         .io_handle = panel_io_,
         .panel_handle = panel_,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = true,
+        .buffer_size = static_cast<uint32_t>(width_ * buffer_policy.lines),
+        .double_buffer = buffer_policy.double_buffer,
+        .trans_size = static_cast<uint32_t>(buffer_policy.spiram ? width_ * buffer_policy.trans_lines : 0),
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .rotation = {
@@ -226,16 +236,18 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
             .mirror_y = mirror_y,
         },
         .flags = {
-            .buff_dma = 1,
+            .buff_dma = !buffer_policy.spiram,
+            .buff_spiram = buffer_policy.spiram,
             .swap_bytes = 0,
             .full_refresh = 1,
             .direct_mode = 1,
         },
     };
 
+    // 避免撕裂模式下直接使用面板自己的帧缓冲，这时只有bounce_buffer起作用
     const lvgl_port_display_rgb_cfg_t rgb_cfg = {
         .flags = {
-            .bb_mode = true,
+            .bb_mode = buffer_policy.bounce_buffer,
             .avoid_tearing = true,
         }
     };
@@ -245,6 +257,8 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add RGB display");
         return;
     }
+    LogBufferPolicy(buffer_policy);
+    profiler_.Attach(display_, DISPLAY_PROFILER_LOG_INTERVAL_MS);
     
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -256,7 +270,7 @@ RgbLcdDisplay::RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
 MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                             int width, int height,  int offset_x, int offset_y,
                             bool mirror_x, bool mirror_y, bool swap_xy,
-                            DisplayFonts fonts)
+                            DisplayFonts fonts, const LcdBufferPolicy& buffer_policy)
     : LcdDisplay(panel_io, panel, fonts, width, height) {
 
     // Set the display to on
@@ -275,8 +289,9 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
             .io_handle = panel_io,
             .panel_handle = panel,
             .control_handle = nullptr,
-            .buffer_size = static_cast<uint32_t>(width_ * 50),
-            .double_buffer = false,
+            .buffer_size = static_cast<uint32_t>(width_ * buffer_policy.lines),
+            .double_buffer = buffer_policy.double_buffer,
+            .trans_size = static_cast<uint32_t>(buffer_policy.spiram ? width_ * buffer_policy.trans_lines : 0),
             .hres = static_cast<uint32_t>(width_),
             .vres = static_cast<uint32_t>(height_),
             .monochrome = false,
@@ -287,8 +302,8 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
             .mirror_y = mirror_y,
         },
         .flags = {
-            .buff_dma = true,
-            .buff_spiram =false,
+            .buff_dma = !buffer_policy.spiram,
+            .buff_spiram = buffer_policy.spiram,
             .sw_rotate = false,
         },
     };
@@ -303,6 +318,8 @@ MipiLcdDisplay::MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    LogBufferPolicy(buffer_policy);
+    profiler_.Attach(display_, DISPLAY_PROFILER_LOG_INTERVAL_MS);
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -316,6 +333,7 @@ LcdDisplay::~LcdDisplay() {
     if (fft_task_handle != nullptr) {
         ESP_LOGI(TAG, "Stopping FFT task in destructor");
         fft_task_should_stop = true;
+        xTaskNotifyGive(fft_task_handle);  // 任务可能正在等待新的音频
         
         // 等待任务停止
         int wait_count = 0;
@@ -325,6 +343,7 @@ LcdDisplay::~LcdDisplay() {
         }
         
         if (fft_task_handle != nullptr) {
+            Application::GetInstance().GetAudioService().GetOutputTap().RemoveListener(fft_task_handle);
             vTaskDelete(fft_task_handle);
             fft_task_handle = nullptr;
         }
@@ -344,6 +363,7 @@ LcdDisplay::~LcdDisplay() {
         lv_obj_del(container_);
     }
     if (display_ != nullptr) {
+        profiler_.Detach();
         lv_display_delete(display_);
     }
 
@@ -1222,6 +1242,14 @@ void LcdDisplay::create_canvas(){
     lv_obj_set_size(canvas_, canvas_width_, canvas_height_);
     lv_canvas_fill_bg(canvas_, lv_color_make(0, 0, 0), LV_OPA_TRANSP);
     lv_obj_move_foreground(canvas_);
+    lv_obj_update_layout(canvas_);
+    resetSpectrumBars();
+
+    // 统计频谱帧率，LVGL每次渲染刷新的耗时从profiler_的累计值求差
+    spectrum_stats_ = {};
+    spectrum_stats_start_us_ = esp_timer_get_time();
+    spectrum_refreshes_base_ = profiler_.refreshes();
+    spectrum_refresh_us_base_ = profiler_.refresh_us();
 
     ESP_LOGI(TAG, "canvas created successfully");
 
@@ -1251,11 +1279,47 @@ void LcdDisplay::start(){
 
 void LcdDisplay::drawSpectrumIfReady() {
     if (fft_data_ready) {
+        int64_t start_time = esp_timer_get_time();
         draw_spectrum(avg_power_spectrum, FFT_SIZE/2);
+        spectrum_stats_.draw_us += esp_timer_get_time() - start_time;
+        spectrum_stats_.frames++;
         fft_data_ready = false;
     }
 }
 
+void LcdDisplay::printSpectrumStats() {
+    SpectrumStats stats;
+    int64_t elapsed_us;
+    uint32_t refreshes;
+    uint64_t refresh_us;
+    {
+        DisplayLockGuard lock(this);
+        int64_t now = esp_timer_get_time();
+        stats = spectrum_stats_;
+        elapsed_us = now - spectrum_stats_start_us_;
+        refreshes = profiler_.refreshes() - spectrum_refreshes_base_;
+        refresh_us = profiler_.refresh_us() - spectrum_refresh_us_base_;
+        spectrum_stats_ = {};
+        spectrum_stats_start_us_ = now;
+        spectrum_refreshes_base_ = profiler_.refreshes();
+        spectrum_refresh_us_base_ = profiler_.refresh_us();
+    }
+    if (elapsed_us <= 0 || stats.frames == 0) {
+        return;
+    }
+    uint32_t refresh_avg_us = refreshes > 0 ? refresh_us / refreshes : 0;
+    ESP_LOGI(TAG, "Spectrum: %.1f fps, %.1f wake-ups/s, CPU %.1f%%, latency avg %lu us max %lu us",
+        stats.frames * 1000000.0f / elapsed_us,
+        stats.wakeups * 1000000.0f / elapsed_us,
+        stats.busy_us * 100.0f / elapsed_us,
+        (uint32_t)(stats.latency_us / stats.frames), stats.latency_max_us);
+    ESP_LOGI(TAG, "Spectrum: draw %lu us, %lu px/frame (%lu KB/s to the panel), %lu refreshes avg %lu us",
+        (uint32_t)(stats.draw_us / stats.frames),
+        (uint32_t)(stats.dirty_pixels / stats.frames),
+        (uint32_t)(stats.dirty_pixels * sizeof(uint16_t) * 1000000 / elapsed_us / 1024),
+        refreshes, refresh_avg_us);
+}
+
 void LcdDisplay::periodicUpdateTaskWrapper(void* arg) {
     auto self = static_cast<LcdDisplay*>(arg);
     self->periodicUpdateTask();
@@ -1272,56 +1336,43 @@ void LcdDisplay::periodicUpdateTask() {
     }
   
 
-    auto music = Board::GetInstance().GetMusic();
-        
-    const TickType_t displayInterval = pdMS_TO_TICKS(40);  
-    const TickType_t audioProcessInterval = pdMS_TO_TICKS(15); 
-    
-    TickType_t lastDisplayTime = xTaskGetTickCount();
-    TickType_t lastAudioTime = xTaskGetTickCount();
+    // 输出抽头每播放1/SPECTRUM_FPS秒的样本通知一次，这也限制了帧率；没有声音播放时任务一直睡眠
+    auto& tap = Application::GetInstance().GetAudioService().GetOutputTap();
+    int sample_rate = tap.sample_rate() > 0 ? tap.sample_rate() : 24000;
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    tap.AddListener(task, std::max(sample_rate / SPECTRUM_FPS, 1));
+
+    const TickType_t statsInterval = pdMS_TO_TICKS(10000);
+    TickType_t lastStatsTime = xTaskGetTickCount();
     
     while (!fft_task_should_stop) {
-        
-        TickType_t currentTime = xTaskGetTickCount();
-        
-        
-        if (currentTime - lastAudioTime >= audioProcessInterval) {
-            if(music->GetAudioData() != nullptr) {
-                readAudioData();  // 快速处理，不阻塞
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(100));
-            }
-            lastAudioTime = currentTime;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (fft_task_should_stop) {
+            break;
         }
-        
-        // 显示刷新（30Hz）
-        if (currentTime - lastDisplayTime >= displayInterval) {
-            if (fft_data_ready) {
-                DisplayLockGuard lock(this);
-                drawSpectrumIfReady();
-                lv_area_t refresh_area;
-                refresh_area.x1 = 0;
-                refresh_area.y1 = height_-100;
-                refresh_area.x2 = canvas_width_ -1;
-                refresh_area.y2 = height_ -1; // 只刷新频谱区域
-                lv_obj_invalidate_area(canvas_, &refresh_area);
-                //lv_obj_invalidate(canvas_);
-                fft_data_ready = false;
-                lastDisplayTime = currentTime;
-            }   // 绘制操作
-           
-            
-            // 更新FPS计数
-            //FPS();
+        int64_t wake_time = esp_timer_get_time();
+        int64_t write_time = tap.write_time_us();
+        spectrum_stats_.wakeups++;
+
+        // 只在有新样本从扬声器播出时计算频谱，暂停、跳转和播放结束后不再处理旧数据
+        if (readAudioData()) {
+            DisplayLockGuard lock(this);
+            drawSpectrumIfReady();  // 只刷新变化的柱子区域
+            uint32_t latency_us = esp_timer_get_time() - write_time;
+            spectrum_stats_.latency_us += latency_us;
+            spectrum_stats_.latency_max_us = std::max(spectrum_stats_.latency_max_us, latency_us);
         }
-        
-        
-        
-        vTaskDelay(pdMS_TO_TICKS(10));
-        // 短暂延迟
-        
+
+        // 每10秒打印一次帧率、唤醒次数和刷新耗时
+        TickType_t currentTime = xTaskGetTickCount();
+        if (currentTime - lastStatsTime >= statsInterval) {
+            printSpectrumStats();
+            lastStatsTime = currentTime;
+        }
+        spectrum_stats_.busy_us += esp_timer_get_time() - wake_time;
     }
     
+    tap.RemoveListener(task);
     ESP_LOGI(TAG, "FFT display task stopped");
     fft_task_handle = nullptr;  // 清空任务句柄
     vTaskDelete(NULL);  // 删除当前任务
@@ -1329,63 +1380,33 @@ void LcdDisplay::periodicUpdateTask() {
 
 
 
-void LcdDisplay::readAudioData(){
+bool LcdDisplay::readAudioData(){
    
-    auto music = Board::GetInstance().GetMusic();
-    
-    if(music->GetAudioData()!=nullptr){
-        
-    
-        if(audio_display_last_update<=2){
-            memcpy(audio_data,music->GetAudioData(),sizeof(int16_t)*1152);
-            for(int i=0;i<1152;i++){
-                frame_audio_data[i]+=audio_data[i];
-            }
-            audio_display_last_update++;
-            
-        }else{
-            const int HOP_SIZE = 512;
-            const int NUM_SEGMENTS = 1 + (1152 - FFT_SIZE) / HOP_SIZE;
-    
-            for (int seg = 0; seg < NUM_SEGMENTS; seg++) {
-                int start = seg * HOP_SIZE;
-                if (start + FFT_SIZE > 1152) break;
-
-        // 准备当前段数据
-                for (int i = 0; i < FFT_SIZE; i++) {
-                    int idx = start + i;
-                    //float sample =frame_audio_data[idx] / 32768.0f;
-                    float sample =frame_audio_data[idx] / 32768.0f;
-                    fft_real[i] = sample * hanning_window_float[i];
-                    fft_imag[i] = 0.0f;
-                    
-                }
+    // 从AudioService的输出抽头读取最近播放的样本，无锁，不阻塞播放，音乐和TTS都适用
+    auto& tap = Application::GetInstance().GetAudioService().GetOutputTap();
+    uint64_t position = 0;
+    if (!tap.Read(audio_data, 1152, 1, &position) || position == audio_tap_position_) {
+        return false;
+    }
+    audio_tap_position_ = position;
 
-                compute(fft_real, fft_imag, FFT_SIZE, true);
-        
-        // 计算功率谱并累加（双边）
-                for (int i = 0; i < FFT_SIZE/2; i++) {
-                    avg_power_spectrum[i] += fft_real[i] * fft_real[i]+fft_imag[i] * fft_imag[i]; // 功率 = 幅度平方
-                }
-            }
-        
-    // 计算平均值
-            for (int i = 0; i < FFT_SIZE/2; i++) {
-                avg_power_spectrum[i] /= NUM_SEGMENTS;
-            }
+    const int HOP_SIZE = 512;
+    const int NUM_SEGMENTS = 1 + (1152 - FFT_SIZE) / HOP_SIZE;
 
-        audio_display_last_update=0;
-        //memcpy(spectrum_data, avg_power_spectrum, sizeof(float) * FFT_SIZE/2);
-        fft_data_ready=true;
+    for (int seg = 0; seg < NUM_SEGMENTS; seg++) {
+        int start = seg * HOP_SIZE;
+        if (start + FFT_SIZE > 1152) break;
 
-        //draw_spectrum(avg_power_spectrum, FFT_SIZE/2);
-        memset(frame_audio_data,0,sizeof(int16_t)*1152);
+        // 加窗、实数FFT，功率谱（幅度平方）累加到avg_power_spectrum
+        spectrum_fft_.AddPowerSpectrum(audio_data + start, avg_power_spectrum);
+    }
 
-        }
-    }else{
-            ESP_LOGI(TAG, "audio_data is nullptr");
-            vTaskDelay(pdMS_TO_TICKS(500));
-        }   
+    // 计算平均值
+    for (int i = 0; i < FFT_SIZE/2; i++) {
+        avg_power_spectrum[i] /= NUM_SEGMENTS;
+    }
+    fft_data_ready=true;
+    return true;
 }
 
 uint16_t LcdDisplay::get_bar_color(int x_pos){
@@ -1421,7 +1442,6 @@ void LcdDisplay::draw_spectrum(float *power_spectrum,int fft_size){
     const int bar_max_height=canvas_height_-100;
     const int bar_width=240/bartotal;
     int x_pos=0;
-    int y_pos = (canvas_height_) - 1;
 
     float magnitude[bartotal]={0};
     float max_magnitude=0;
@@ -1478,8 +1498,15 @@ void LcdDisplay::draw_spectrum(float *power_spectrum,int fft_size){
         if (magnitude[bin] > max_magnitude) max_magnitude = magnitude[bin];
     }
 
-    clearScreen();
-    
+    // 画布坐标转换为屏幕坐标
+    lv_area_t canvas_coords;
+    lv_obj_get_coords(canvas_, &canvas_coords);
+
+    // LVGL最多记录LV_INV_BUF_SIZE个失效区域，超出就整屏刷新，所以相邻几根柱子的变化合并成一个区域
+    const int bars_per_group = 5;
+    lv_area_t group_area;
+    bool group_dirty = false;
+
     for (int k = 1; k < bartotal; k++) {  // 跳过直流分量（k=0）
         x_pos=canvas_width_/bartotal*(k-1);
         float mag=(magnitude[k] - MIN_DB) / (MAX_DB - MIN_DB);
@@ -1487,14 +1514,30 @@ void LcdDisplay::draw_spectrum(float *power_spectrum,int fft_size){
         bar_height=int(mag*(bar_max_height));
         
         int color=get_bar_color(k);
-        draw_bar(x_pos,y_pos,bar_width,bar_height, color,k-1);
-        //printf("x: %d, y: %d,\n", x_pos, bar_height);
+        lv_area_t dirty;
+        if (draw_bar(x_pos,bar_width,bar_height, color,k-1,dirty)) {
+            spectrum_stats_.dirty_pixels += lv_area_get_size(&dirty);
+            if (!group_dirty) {
+                group_area = dirty;
+                group_dirty = true;
+            } else {
+                group_area.x1 = std::min(group_area.x1, dirty.x1);
+                group_area.y1 = std::min(group_area.y1, dirty.y1);
+                group_area.x2 = std::max(group_area.x2, dirty.x2);
+                group_area.y2 = std::max(group_area.y2, dirty.y2);
+            }
+        }
+        if (group_dirty && (k % bars_per_group == 0 || k == bartotal - 1)) {
+            lv_area_move(&group_area, canvas_coords.x1, canvas_coords.y1);
+            lv_obj_invalidate_area(canvas_, &group_area);
+            group_dirty = false;
+        }
     }
-
-    
 }
 
-void LcdDisplay::draw_bar(int x,int y,int bar_width,int bar_height,uint16_t color,int bar_index){
+// 柱子由底部向上的方块和一个缓慢下落的峰值方块组成，只重画与上一帧不同的行，
+// 有变化时通过dirty返回需要刷新的画布区域
+bool LcdDisplay::draw_bar(int x,int bar_width,int bar_height,uint16_t color,int bar_index,lv_area_t& dirty){
 
     const int block_space=2;
     const int block_x_size=bar_width-block_space;
@@ -1503,6 +1546,7 @@ void LcdDisplay::draw_bar(int x,int y,int bar_width,int bar_height,uint16_t colo
     int blocks_per_col=(bar_height/(block_y_size+block_space));
     int start_x=(block_x_size+block_space)/2+x;
     
+    int peak_y=-1;
     if(current_heights[bar_index]<bar_height) 
     {
         current_heights[bar_index]=bar_height;
@@ -1511,20 +1555,69 @@ void LcdDisplay::draw_bar(int x,int y,int bar_width,int bar_height,uint16_t colo
         int fall_speed=2;
         current_heights[bar_index]=current_heights[bar_index]-fall_speed;
         if(current_heights[bar_index]>(block_y_size+block_space)) 
-        draw_block(start_x,canvas_height_-current_heights[bar_index],block_x_size,block_y_size,color,bar_index);
+        peak_y=canvas_height_-current_heights[bar_index];
 
     }
-   
-    draw_block(start_x,canvas_height_-1,block_x_size,block_y_size,color,bar_index);
+    // 第一个方块总是画出来
+    int blocks=std::max(blocks_per_col,1);
 
-    for(int j=1;j<blocks_per_col;j++){
-        
-        int start_y=j*(block_y_size+block_space);
-        draw_block(start_x,canvas_height_-start_y,block_x_size,block_y_size,color,bar_index); 
-        
+    // 第j个方块底行的y坐标，方块从底行向上画block_y_size行
+    auto block_bottom=[&](int j){
+        return j==0 ? canvas_height_-1 : canvas_height_-j*(block_y_size+block_space);
+    };
+
+    SpectrumBarState& state=spectrum_bars_[bar_index];
+    if(state.blocks==blocks && state.peak_y==peak_y){
+        return false;
     }
-    
 
+    // 变化的行：增减的方块和新旧峰值方块
+    int top=canvas_height_;
+    int bottom=-1;
+    auto add_rows=[&](int block_y){
+        top=std::min(top,block_y-block_y_size+1);
+        bottom=std::max(bottom,block_y);
+    };
+    if(state.blocks!=blocks){
+        int low=std::min<int>(state.blocks,blocks);
+        int high=std::max<int>(state.blocks,blocks);
+        add_rows(block_bottom(low));
+        add_rows(block_bottom(high-1));
+    }
+    if(state.peak_y!=peak_y){
+        if(state.peak_y>=0) add_rows(state.peak_y);
+        if(peak_y>=0) add_rows(peak_y);
+    }
+
+    // 先把这些行清成黑色，再画落在其中的方块和峰值
+    for(int row=top;row<=bottom;row++){
+        std::fill_n(&canvas_buffer_[row*canvas_width_+start_x],block_x_size,(uint16_t)COLOR_BLACK);
+    }
+    for(int j=0;j<blocks;j++){
+        int block_y=block_bottom(j);
+        if(block_y<top) break;
+        if(block_y-block_y_size+1<=bottom){
+            draw_block(start_x,block_y,block_x_size,block_y_size,color,bar_index);
+        }
+    }
+    if(peak_y>=0){
+        draw_block(start_x,peak_y,block_x_size,block_y_size,color,bar_index);
+    }
+
+    state.blocks=blocks;
+    state.peak_y=peak_y;
+    dirty.x1=start_x;
+    dirty.x2=start_x+block_x_size-1;
+    dirty.y1=top;
+    dirty.y2=bottom;
+    return true;
+}
+
+void LcdDisplay::resetSpectrumBars(){
+    for(auto& state : spectrum_bars_){
+        state.blocks=0;
+        state.peak_y=-1;
+    }
 }
 
 void LcdDisplay::draw_block(int x,int y,int block_x_size,int block_y_size,uint16_t color,int bar_index){
@@ -1544,6 +1637,9 @@ void LcdDisplay::draw_block(int x,int y,int block_x_size,int block_y_size,uint16
 }   
 
 void LcdDisplay::clearScreen() {
+    if (canvas_buffer_ == nullptr) {
+        return;
+    }
    // DisplayLockGuard lock(this);
     // 清屏为黑色
     //for (int i = 0; i < canvas_width_ * canvas_height_; i++) {
@@ -1551,6 +1647,9 @@ void LcdDisplay::clearScreen() {
     //}
     //lv_obj_invalidate(canvas_);
     std::fill_n(canvas_buffer_, canvas_width_ * canvas_height_, COLOR_BLACK);
+    // 画布已经是空的，下一帧从头画所有柱子
+    resetSpectrumBars();
+    lv_obj_invalidate(canvas_);
 
 }
 
@@ -1561,6 +1660,7 @@ void LcdDisplay::stopFft() {
     if (fft_task_handle != nullptr) {
         ESP_LOGI(TAG, "Stopping FFT display task");
         fft_task_should_stop = true;  // 设置停止标志
+        xTaskNotifyGive(fft_task_handle);  // 没有声音播放时任务一直在等待通知
         
         // 等待任务停止（最多等待1秒）
         int wait_count = 0;
@@ -1571,6 +1671,7 @@ void LcdDisplay::stopFft() {
         
         if (fft_task_handle != nullptr) {
             ESP_LOGW(TAG, "FFT task did not stop gracefully, force deleting");
+            Application::GetInstance().GetAudioService().GetOutputTap().RemoveListener(fft_task_handle);
             vTaskDelete(fft_task_handle);
             fft_task_handle = nullptr;
         } else {
@@ -1583,10 +1684,10 @@ void LcdDisplay::stopFft() {
     
     // 重置FFT状态变量
     fft_data_ready = false;
-    audio_display_last_update = 0;
     
     // 重置频谱条高度
     memset(current_heights, 0, sizeof(current_heights));
+    resetSpectrumBars();
     
     // 重置平均功率谱数据
     for (int i = 0; i < FFT_SIZE/2; i++) {
@@ -1655,59 +1756,3 @@ void LcdDisplay::MyUI(){
    
 
 }
-
-
-void LcdDisplay::compute(float* real, float* imag, int n, bool forward) {
-    // 位反转排序
-    int j = 0;
-    for (int i = 0; i < n; i++) {
-        if (j > i) {
-            std::swap(real[i], real[j]);
-            std::swap(imag[i], imag[j]);
-        }
-        
-        int m = n >> 1;
-        while (m >= 1 && j >= m) {
-            j -= m;
-            m >>= 1;
-        }
-        j += m;
-    }
-
-    // FFT计算
-    for (int s = 1; s <= (int)log2(n); s++) {
-        int m = 1 << s;
-        int m2 = m >> 1;
-        float w_real = 1.0f;
-        float w_imag = 0.0f;
-        float angle = (forward ? -2.0f : 2.0f) * M_PI / m;
-        float wm_real = cosf(angle);
-        float wm_imag = sinf(angle);
-        
-        for (int j = 0; j < m2; j++) {
-            for (int k = j; k < n; k += m) {
-                int k2 = k + m2;
-                float t_real = w_real * real[k2] - w_imag * imag[k2];
-                float t_imag = w_real * imag[k2] + w_imag * real[k2];
-                
-                real[k2] = real[k] - t_real;
-                imag[k2] = imag[k] - t_imag;
-                real[k] += t_real;
-                imag[k] += t_imag;
-            }
-            
-            float w_temp = w_real;
-            w_real = w_real * wm_real - w_imag * wm_imag;
-            w_imag = w_temp * wm_imag + w_imag * wm_real;
-        }
-    }
-    
-    // 正向变换需要缩放
-    if (forward) {
-        for (int i = 0; i < n; i++) {
-            real[i] /= n;
-            imag[i] /= n;
-        }
-    }
-    
-}
\ No newline at end of file
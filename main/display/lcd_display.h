@@ -2,6 +2,8 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "display_profiler.h"
+#include "real_fft.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -27,6 +29,19 @@ struct ThemeColors {
     lv_color_t low_battery;
 };
 
+// LVGL绘制缓冲区的配置，各板子可以打开CONFIG_DISPLAY_PROFILER对比帧耗时，选出最快的组合
+struct LcdBufferPolicy {
+    int lines;              // 每个绘制缓冲区的行数
+    bool double_buffer;     // 两个缓冲区交替，渲染下一块的同时DMA发送上一块
+    bool spiram;            // 缓冲区放在PSRAM，省下内部RAM，适合八线PSRAM的S3
+    int trans_lines;        // spiram时内部RAM里DMA传输缓冲区的行数，0表示由DMA直接读PSRAM
+    bool bounce_buffer;     // 仅RGB屏：面板创建时配置了bounce_buffer_size_px才能打开
+
+    // 各类屏幕原来的配置
+    static LcdBufferPolicy Spi() { return {20, false, false, 0, false}; }
+    static LcdBufferPolicy Rgb() { return {20, true, false, 0, true}; }
+    static LcdBufferPolicy Mipi() { return {50, false, false, 0, false}; }
+};
 
 class LcdDisplay : public Display {
 protected:
@@ -42,13 +57,16 @@ protected:
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
+    DisplayProfiler profiler_;
+
+    void LogBufferPolicy(const LcdBufferPolicy& policy);
 
     void SetupUI();
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
     // FFT 绘制方法
-    void readAudioData();
+    bool readAudioData();  // 读到新的样本并算好频谱返回true
     
     
   
@@ -65,7 +83,7 @@ protected:
     void create_canvas();
     uint16_t get_bar_color(int x_pos);
     void draw_spectrum(float *power_spectrum,int fft_size);
-    void draw_bar(int x,int y,int bar_width,int bar_height,uint16_t color,int bar_index);
+    bool draw_bar(int x,int bar_width,int bar_height,uint16_t color,int bar_index,lv_area_t& dirty);
     void draw_block(int x,int y,int block_x_size,int block_y_size,uint16_t color,int bar_index);
     
     int canvas_width_;
@@ -73,20 +91,42 @@ protected:
    
     
     int16_t* audio_data=nullptr;
-    int16_t* frame_audio_data=nullptr;
     uint32_t last_fft_update = 0;
     bool fft_data_ready = false;
     float* spectrum_data=nullptr;
 
     // FFT 相关变量
-    int audio_display_last_update = 0;
+    uint64_t audio_tap_position_ = 0;                // 上次读取时输出抽头的位置
     std::atomic<bool> fft_task_should_stop = false;  // FFT任务停止标志
     TaskHandle_t fft_task_handle = nullptr;          // FFT任务句柄
 
-    float* fft_real;
-    float* fft_imag;
-    float* hanning_window_float;
-    void compute(float* real, float* imag, int n, bool forward);
+    RealFft spectrum_fft_;  // 预先算好窗函数和旋转因子的实数FFT
+
+    // 每根频谱柱上次画到画布上的状态，只重绘并刷新有变化的部分
+    static constexpr int SPECTRUM_BARS = 40;
+    struct SpectrumBarState {
+        int16_t blocks;   // 已画的方块数
+        int16_t peak_y;   // 峰值方块底行的y坐标，-1表示没有画
+    };
+    SpectrumBarState spectrum_bars_[SPECTRUM_BARS] = {};
+    void resetSpectrumBars();
+
+    // 频谱帧率和耗时统计，只由频谱任务更新
+    struct SpectrumStats {
+        uint32_t wakeups;           // 频谱任务被唤醒的次数
+        uint64_t busy_us;           // 频谱任务醒着的时间，用来算CPU占用
+        uint64_t latency_us;        // 从样本写入输出抽头到画完一帧的延迟
+        uint32_t latency_max_us;
+        uint32_t frames;            // 绘制的频谱帧数
+        uint64_t draw_us;           // 栅格化耗时
+        uint64_t dirty_pixels;      // 失效（需要经SPI发送）的像素数
+    };
+    SpectrumStats spectrum_stats_ = {};
+    int64_t spectrum_stats_start_us_ = 0;
+    // 上次打印时显示刷新的累计值，LVGL刷新耗时从profiler_求差
+    uint32_t spectrum_refreshes_base_ = 0;
+    uint64_t spectrum_refresh_us_base_ = 0;
+    void printSpectrumStats();
     
     // 添加缺少的方法声明
     void drawSpectrumIfReady();
@@ -120,7 +160,8 @@ public:
     RgbLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
-                  DisplayFonts fonts);
+                  DisplayFonts fonts,
+                  const LcdBufferPolicy& buffer_policy = LcdBufferPolicy::Rgb());
 };
 
 // MIPI LCD显示器
@@ -129,7 +170,8 @@ public:
     MipiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                    int width, int height, int offset_x, int offset_y,
                    bool mirror_x, bool mirror_y, bool swap_xy,
-                   DisplayFonts fonts);
+                   DisplayFonts fonts,
+                   const LcdBufferPolicy& buffer_policy = LcdBufferPolicy::Mipi());
 };
 
 // // SPI LCD显示器
@@ -138,7 +180,8 @@ public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
                   bool mirror_x, bool mirror_y, bool swap_xy,
-                  DisplayFonts fonts);
+                  DisplayFonts fonts,
+                  const LcdBufferPolicy& buffer_policy = LcdBufferPolicy::Spi());
 };
 
 // QSPI LCD显示器
@@ -58,6 +58,15 @@
              return true;
          });
      
+     AddTool("self.get_audio_stats",
+         "Provides the audio pipeline latency statistics since boot, per stage (capture, audio processing, encoding, sending, "
+         "receiving, decoding, playing): count, average, p50, p95 and max in milliseconds, and a histogram.\n"
+         "Use this tool only when the user asks about the audio latency or for diagnostics.",
+         PropertyList(),
+         [](const PropertyList& properties) -> ReturnValue {
+             return Application::GetInstance().GetAudioService().GetStatsJson();
+         });
+
      auto backlight = board.GetBacklight();
      if (backlight) {
          AddTool("self.screen.set_brightness",
@@ -129,6 +138,57 @@
                  ESP_LOGI(TAG, "Music details result: %s", download_result.c_str());
                  return "{\"success\": true, \"message\": \"音乐开始播放\"}";
              });
+
+        AddTool("self.music.queue_song",
+            "把歌曲加到下一首。当用户要求当前歌曲播完后播放某首歌时使用此工具，当前歌曲播完后无缝播放；没有正在播放的歌曲时立刻播放。\n"
+            "参数:\n"
+            "  `song_name`: 要播放的歌曲名称（必需）。\n"
+            "  `artist_name`: 要播放的歌曲艺术家名称（可选，默认为空字符串）。\n"
+            "返回:\n"
+            "  排队结果信息。",
+            PropertyList({
+                Property("song_name", kPropertyTypeString),//歌曲名称（必需）
+                Property("artist_name", kPropertyTypeString, "")//艺术家名称（可选，默认为空字符串）
+            }),
+            [music](const PropertyList& properties) -> ReturnValue {
+                auto song_name = properties["song_name"].value<std::string>();
+                auto artist_name = properties["artist_name"].value<std::string>();
+                
+                auto esp32_music = static_cast<Esp32Music*>(music);
+                if (!esp32_music->QueueNext(song_name, artist_name)) {
+                    return "{\"success\": false, \"message\": \"获取音乐资源失败\"}";
+                }
+                return "{\"success\": true, \"message\": \"已加到下一首\"}";
+            });
+
+        AddTool("self.music.seek",
+            "跳转到当前歌曲的指定位置。比如用户说‘跳到一分钟’或者‘从第30秒开始播放’。\n"
+            "参数:\n"
+            "  `position`: 目标位置，单位秒。\n"
+            "返回:\n"
+            "  跳转结果信息。",
+            PropertyList({
+                Property("position", kPropertyTypeInteger, 0, 3600)//目标位置（秒）
+            }),
+            [music](const PropertyList& properties) -> ReturnValue {
+                auto position = properties["position"].value<int>();
+                
+                auto esp32_music = static_cast<Esp32Music*>(music);
+                if (!esp32_music->Seek((int64_t)position * 1000)) {
+                    return "{\"success\": false, \"message\": \"当前没有可以跳转的歌曲\"}";
+                }
+                return "{\"success\": true, \"message\": \"已跳转\"}";
+            });
+
+        AddTool("self.music.get_stats",
+            "获取音乐播放的统计信息，用于诊断卡顿。只有用户问到音乐为什么卡、网速或者播放状态时才调用。\n"
+            "返回:\n"
+            "  从本次开始播放起的下载速度(kbps)和首字节时间、缓冲区大小和最近一分钟的变化、"
+            "缓冲区欠载次数和时长、每帧解码耗时(微秒)以及采样率切换次数。",
+            PropertyList(),
+            [music](const PropertyList& properties) -> ReturnValue {
+                return music->GetStatsJson();
+            });
  
          AddTool("self.music.set_display_mode",
              "设置音乐播放时的显示模式。可以选择显示频谱或歌词，比如用户说‘打开频谱’或者‘显示频谱’，‘打开歌词’或者‘显示歌词’就设置对应的显示模式。\n"
@@ -1,14 +1,37 @@
 #include "protocol.h"
+#include "settings.h"
 
 #include <esp_log.h>
 
 #define TAG "Protocol"
 
+ObjectPool<AudioStreamPacket>& AudioStreamPacket::Pool() {
+    // Never destroyed, packets may still be released while the program exits
+    static auto pool = new ObjectPool<AudioStreamPacket>(AUDIO_STREAM_PACKET_POOL_SIZE, [](AudioStreamPacket& packet) {
+        packet.sample_rate = 0;
+        packet.frame_duration = 0;
+        packet.timestamp = 0;
+        packet.sequence = 0;
+        packet.stamps = AudioLatencyStamps();
+        packet.payload.clear();
+        if (packet.payload.capacity() > AUDIO_STREAM_PACKET_MAX_PAYLOAD) {
+            std::vector<uint8_t>().swap(packet.payload);
+            return true;
+        }
+        return false;
+    });
+    return *pool;
+}
+
+ObjectPool<AudioStreamPacket>::Ptr AudioStreamPacket::Create() {
+    return Pool().Acquire();
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
-void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
+void Protocol::OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback) {
     on_incoming_audio_ = callback;
 }
 
@@ -80,3 +103,31 @@ bool Protocol::IsTimeout() const {
     }
     return timeout;
 }
+
+bool Protocol::IsValidFrameDuration(int frame_duration) {
+    return frame_duration == 20 || frame_duration == 40 || frame_duration == 60 || frame_duration == 120;
+}
+
+// The frame duration can be set per deployment through the OTA config, e.g. "websocket": {"frame_duration": 20}
+void Protocol::LoadUplinkFrameDuration(const std::string& settings_namespace) {
+    Settings settings(settings_namespace, false);
+    int frame_duration = settings.GetInt("frame_duration", DEFAULT_OPUS_FRAME_DURATION_MS);
+    if (!IsValidFrameDuration(frame_duration)) {
+        ESP_LOGW(TAG, "Invalid frame duration %d ms, using %d ms", frame_duration, DEFAULT_OPUS_FRAME_DURATION_MS);
+        frame_duration = DEFAULT_OPUS_FRAME_DURATION_MS;
+    }
+    uplink_frame_duration_ = frame_duration;
+}
+
+// The server may ask for another uplink frame duration than the one proposed in the hello message
+void Protocol::ParseUplinkFrameDuration(const cJSON* audio_params) {
+    auto uplink_frame_duration = cJSON_GetObjectItem(audio_params, "uplink_frame_duration");
+    if (!cJSON_IsNumber(uplink_frame_duration)) {
+        return;
+    }
+    if (IsValidFrameDuration(uplink_frame_duration->valueint)) {
+        uplink_frame_duration_ = uplink_frame_duration->valueint;
+    } else {
+        ESP_LOGW(TAG, "Server asked for an invalid uplink frame duration: %d", uplink_frame_duration->valueint);
+    }
+}
@@ -1,19 +1,44 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include <sdkconfig.h>
 #include <cJSON.h>
 #include <string>
 #include <functional>
 #include <chrono>
 #include <vector>
 
+#include "object_pool.h"
+#include "audio_latency.h"
+
+// Uplink Opus frame duration proposed in the hello message, one of 20 / 40 / 60 / 120 ms
+#ifdef CONFIG_OPUS_FRAME_DURATION_MS
+#define DEFAULT_OPUS_FRAME_DURATION_MS CONFIG_OPUS_FRAME_DURATION_MS
+#else
+#define DEFAULT_OPUS_FRAME_DURATION_MS 60
+#endif
+#define MIN_OPUS_FRAME_DURATION_MS 20
+
+// Decode and send queues with 20ms frames (2 x 120 packets) plus the packets in flight
+#define AUDIO_STREAM_PACKET_POOL_SIZE 248
+// Payload capacity kept by a recycled packet, enough for any single Opus frame
+#define AUDIO_STREAM_PACKET_MAX_PAYLOAD 1500
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Incremented per packet by the sender, 0 if the packet is not part of a stream
     std::vector<uint8_t> payload;
+    AudioLatencyStamps stamps;  // Local only, never sent
+
+    // Packets are recycled through a shared pool instead of being allocated for every frame
+    static ObjectPool<AudioStreamPacket>& Pool();
+    static ObjectPool<AudioStreamPacket>::Ptr Create();
 };
 
+using AudioStreamPacketPtr = ObjectPool<AudioStreamPacket>::Ptr;
+
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
@@ -51,11 +76,14 @@ public:
     inline int server_frame_duration() const {
         return server_frame_duration_;
     }
+    inline int uplink_frame_duration() const {
+        return uplink_frame_duration_;
+    }
     inline const std::string& session_id() const {
         return session_id_;
     }
 
-    void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
+    void OnIncomingAudio(std::function<void(AudioStreamPacketPtr packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
@@ -65,26 +93,31 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    virtual bool SendAudio(AudioStreamPacketPtr packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
 
+    static bool IsValidFrameDuration(int frame_duration);
+
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
-    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
+    std::function<void(AudioStreamPacketPtr packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    int uplink_frame_duration_ = DEFAULT_OPUS_FRAME_DURATION_MS;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
 
+    void LoadUplinkFrameDuration(const std::string& settings_namespace);
+    void ParseUplinkFrameDuration(const cJSON* audio_params);
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
@@ -26,7 +26,7 @@ bool WebsocketProtocol::Start() {
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool WebsocketProtocol::SendAudio(AudioStreamPacketPtr packet) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
@@ -108,6 +108,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
         return false;
     }
     
+    remote_sequence_ = 0;
     websocket_ = network->CreateWebSocket(0);
     if (websocket_ == nullptr) {
         ESP_LOGE(TAG, "Failed to create WebSocket instance");
@@ -126,9 +127,10 @@ bool WebsocketProtocol::OpenAudioChannel() {
             if (version_ == 2) {
                 if (len < sizeof(BinaryProtocol2)) return;
                 auto bp2 = (BinaryProtocol2*)data;
-                auto packet = std::make_unique<AudioStreamPacket>();
+                auto packet = AudioStreamPacket::Create();
                 packet->sample_rate = server_sample_rate_;  // 
                 packet->frame_duration = server_frame_duration_;  // 
+                packet->sequence = ++remote_sequence_;  // TCP keeps the order, number the frames for the jitter buffer
                 packet->timestamp = ntohl(bp2->timestamp);
                 packet->payload.assign(bp2->payload, bp2->payload + ntohl(bp2->payload_size));
                 if (on_incoming_audio_ != nullptr) {
@@ -137,18 +139,20 @@ bool WebsocketProtocol::OpenAudioChannel() {
             } else if (version_ == 3) {
                 if (len < sizeof(BinaryProtocol3)) return;
                 auto bp3 = (BinaryProtocol3*)data;
-                auto packet = std::make_unique<AudioStreamPacket>();
+                auto packet = AudioStreamPacket::Create();
                 packet->sample_rate = server_sample_rate_;  // 
                 packet->frame_duration = server_frame_duration_;  // 
+                packet->sequence = ++remote_sequence_;
                 packet->payload.assign(bp3->payload, bp3->payload + ntohs(bp3->payload_size));
                 if (on_incoming_audio_ != nullptr) {
                     on_incoming_audio_(std::move(packet));
                 }
             } else {
                 // 汾1ֱƵ
-                auto packet = std::make_unique<AudioStreamPacket>();
+                auto packet = AudioStreamPacket::Create();
                 packet->sample_rate = server_sample_rate_;  // 
                 packet->frame_duration = server_frame_duration_;  // 
+                packet->sequence = ++remote_sequence_;
                 packet->payload.assign(data, data + len);
                 if (on_incoming_audio_ != nullptr) {
                     on_incoming_audio_(std::move(packet));
@@ -310,11 +314,12 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "mcp", true);
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
+    LoadUplinkFrameDuration("websocket");
     cJSON* audio_params = cJSON_CreateObject();
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", uplink_frame_duration_);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -346,6 +351,7 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         if (cJSON_IsNumber(frame_duration)) {
             server_frame_duration_ = frame_duration->valueint;
         }
+        ParseUplinkFrameDuration(audio_params);
     }
 
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
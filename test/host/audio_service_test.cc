@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <cstring>
+
+#include "loopback_fixture.h"
+#include "test_util.h"
+
+namespace {
+
+TEST_F(LoopbackTest, PlaysBackTheMicrophone) {
+    Start(24000, true);
+    auto input = GenerateSine(16000, 440, 8000, 16000);
+    codec_->SetInput(input);
+    StartLoopback();
+    service_->EnableVoiceProcessing(true);
+
+    ASSERT_TRUE(WaitUntil([this]() { return codec_->input_position() >= 16000; }, 5000));
+    service_->EnableVoiceProcessing(false);
+    ASSERT_TRUE(WaitUntil([this]() { return service_->IsIdle(); }, 5000));
+    /* The last frame leaves the mixer once nothing follows it */
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto output = codec_->output();
+    ASSERT_GT(output.size(), 24000u * 8 / 10);
+    EXPECT_GT(protocol_.sent_packets(), 10u);
+    /* Skip the concealment and resampler start-up, then the tone must dominate */
+    size_t begin = output.size() / 4;
+    size_t end = output.size() * 3 / 4;
+    double tone = TonePower(output, begin, end, 24000, 440);
+    EXPECT_GT(tone, 0.5 * MeanPower(output, begin, end));
+    EXPECT_GT(tone, 0.01);
+}
+
+TEST_F(LoopbackTest, PlaySoundDecodesEveryFrame) {
+    Start(16000, false);
+    const int frames = 5;
+    const size_t frame_samples = 960;
+    std::string sound;
+    for (int i = 0; i < frames; i++) {
+        BinaryProtocol3 header = {};
+        header.payload_size = htons(frame_samples);
+        sound.append((const char*)&header, sizeof(header));
+        /* One byte per sample in the host Opus stand-in */
+        sound.append(frame_samples, (char)16);
+    }
+    service_->PlaySound(sound);
+
+    ASSERT_TRUE(WaitUntil([this]() { return codec_->output_samples() >= frames * frame_samples; }, 2000));
+    auto output = codec_->output();
+    EXPECT_EQ(output.size(), frames * frame_samples);
+    EXPECT_EQ(output[frame_samples], 16 * 256);
+}
+
+TEST_F(LoopbackTest, PcmStreamIsResampledAndClocked) {
+    Start(24000, true);
+    const int frames = 20;
+    const size_t frame_samples = 1152;
+    auto tone = GenerateSine(44100, 1000, 8000, frames * frame_samples);
+    std::vector<int16_t> pcm;
+    for (int i = 0; i < frames; i++) {
+        pcm.assign(tone.begin() + i * frame_samples, tone.begin() + (i + 1) * frame_samples);
+        int64_t position_us = (int64_t)i * frame_samples * 1000000 / 44100;
+        ASSERT_TRUE(service_->PushPcmToPlaybackQueue(std::move(pcm), 44100, position_us));
+    }
+    service_->EndPcmStream(false);
+
+    size_t expected = frames * frame_samples * 24000 / 44100;
+    ASSERT_TRUE(WaitUntil([&]() { return codec_->output_samples() >= expected * 95 / 100; }, 3000));
+    EXPECT_GE(service_->GetPcmPlaybackPosition(), 0);
+
+    auto output = codec_->output();
+    size_t begin = output.size() / 4;
+    size_t end = output.size() * 3 / 4;
+    EXPECT_GT(TonePower(output, begin, end, 24000, 1000), 0.9 * MeanPower(output, begin, end));
+}
+
+} // namespace
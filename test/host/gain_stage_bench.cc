@@ -0,0 +1,141 @@
+/*
+ * Cost of the software gain stage of the I2S codecs (NoAudioCodec, K10AudioCodec) per output call,
+ * and of the 32-bit to 16-bit input stage per read. The previous code allocated a 32-bit buffer
+ * per call, evaluated pow() for the volume and multiplied in 64 bits with clipping; the current
+ * one converts through a fixed scratch buffer with the cached Q16 factor and the pcm_kernels loops.
+ *
+ * Only the conversion is timed, the I2S write or read is left out.
+ *
+ * Usage: gain_stage_bench [--calls=N] [--samples=N]
+ */
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "audio_codec.h"
+#include "pcm_kernels.h"
+#include "wav_audio_codec.h"
+#include "test_util.h"
+
+namespace {
+
+// The previous NoAudioCodec::Write, returning the buffer it handed to the I2S driver
+void WriteAllocating(const int16_t* data, int samples, int volume, std::vector<int32_t>& sink) {
+    std::vector<int32_t> buffer(samples);
+    int32_t volume_factor = pow(double(volume) / 100.0, 2) * 65536;
+    for (int i = 0; i < samples; i++) {
+        int64_t temp = int64_t(data[i]) * volume_factor;
+        if (temp > INT32_MAX) {
+            buffer[i] = INT32_MAX;
+        } else if (temp < INT32_MIN) {
+            buffer[i] = INT32_MIN;
+        } else {
+            buffer[i] = static_cast<int32_t>(temp);
+        }
+    }
+    sink.swap(buffer);
+}
+
+// The current NoAudioCodec::Write, one scratch buffer at a time
+void WriteScratch(const int16_t* data, int samples, int32_t volume_factor, int32_t* scratch, std::vector<int32_t>& sink) {
+    int written = 0;
+    while (written < samples) {
+        int chunk = std::min(samples - written, AUDIO_CODEC_SCRATCH_SAMPLES);
+        PcmGainWiden32(data + written, chunk, volume_factor, scratch);
+        std::copy(scratch, scratch + chunk, sink.begin() + written);
+        written += chunk;
+    }
+}
+
+// The previous NoAudioCodec::Read after the I2S read
+void ReadAllocating(const std::vector<int32_t>& i2s, int16_t* dest, int samples) {
+    std::vector<int32_t> bit32_buffer(samples);
+    std::copy(i2s.begin(), i2s.begin() + samples, bit32_buffer.begin());
+    for (int i = 0; i < samples; i++) {
+        int32_t value = bit32_buffer[i] >> 12;
+        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+    }
+}
+
+void ReadScratch(const std::vector<int32_t>& i2s, int16_t* dest, int samples, int32_t* scratch) {
+    int read = 0;
+    while (read < samples) {
+        int chunk = std::min(samples - read, AUDIO_CODEC_SCRATCH_SAMPLES);
+        std::copy(i2s.begin() + read, i2s.begin() + read + chunk, scratch);
+        PcmNarrow32(scratch, chunk, 12, dest + read);
+        read += chunk;
+    }
+}
+
+template <typename F>
+double MedianCycles(long calls, F&& call) {
+    std::vector<uint64_t> cycles(calls);
+    for (long i = 0; i < calls; i++) {
+        uint64_t start = CycleCount();
+        call(i);
+        cycles[i] = CycleCount() - start;
+    }
+    std::nth_element(cycles.begin(), cycles.begin() + calls / 2, cycles.end());
+    return cycles[calls / 2];
+}
+
+void Print(const char* name, double before, double after, int samples) {
+    std::printf("  %-10s allocating=%.0f scratch=%.0f (%.2fx, %.2f cycles/sample)\n",
+        name, before, after, before / after, after / samples);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long calls = BenchmarkOption(argc, argv, "calls", 5000);
+    int samples = BenchmarkOption(argc, argv, "samples", 1440);
+    auto pcm = GenerateSine(24000, 440, 32767, samples);
+    /* Full scale 24-bit microphone samples in the high bits, as the I2S peripheral delivers them */
+    std::vector<int32_t> i2s(samples);
+    for (int i = 0; i < samples; i++) {
+        i2s[i] = int32_t(pcm[i]) << 13;
+    }
+
+    AudioCodecScratchBuffer tx_scratch;
+    AudioCodecScratchBuffer rx_scratch;
+    WavAudioCodec codec(16000, 24000, false);
+    std::vector<int32_t> old_out, new_out(samples), dup_old(2 * samples), dup_new(2 * samples);
+    std::vector<int16_t> old_in(samples), new_in(samples);
+    bool ok = true;
+
+    for (int volume : {70, 100}) {
+        codec.SetOutputVolume(volume);
+        int32_t factor = codec.output_volume_factor();
+        std::printf("samples=%d volume=%d calls=%ld (cycles per call, median)\n", samples, volume, calls);
+
+        double before = MedianCycles(calls, [&](long) { WriteAllocating(pcm.data(), samples, volume, old_out); });
+        double after = MedianCycles(calls, [&](long) { WriteScratch(pcm.data(), samples, factor, tx_scratch.data(), new_out); });
+        Print("write", before, after, samples);
+        ok = ok && old_out == new_out;
+
+        /* A mono stream on a stereo bus, as K10AudioCodec writes it */
+        before = MedianCycles(calls, [&](long) {
+            int32_t volume_factor = pow(double(volume) / 100.0, 2) * 65536;
+            for (int i = 0; i < samples; i++) {
+                int64_t temp = int64_t(pcm[i]) * volume_factor;
+                int32_t value = temp > INT32_MAX ? INT32_MAX : temp < INT32_MIN ? INT32_MIN : (int32_t)temp;
+                dup_old[2 * i] = value;
+                dup_old[2 * i + 1] = value;
+            }
+        });
+        after = MedianCycles(calls, [&](long) { PcmGainWiden32Dup2(pcm.data(), samples, factor, dup_new.data()); });
+        Print("write dup2", before, after, samples);
+        ok = ok && dup_old == dup_new;
+    }
+
+    double before = MedianCycles(calls, [&](long) { ReadAllocating(i2s, old_in.data(), samples); });
+    double after = MedianCycles(calls, [&](long) { ReadScratch(i2s, new_in.data(), samples, rx_scratch.data()); });
+    Print("read", before, after, samples);
+    ok = ok && old_in == new_in;
+
+    if (!ok) {
+        std::printf("FAILED: the scratch path does not match the allocating one\n");
+        return 1;
+    }
+    return 0;
+}
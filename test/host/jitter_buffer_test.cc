@@ -0,0 +1,227 @@
+#include <gtest/gtest.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "jitter_buffer.h"
+
+namespace {
+
+constexpr int kFrameMs = 60;
+
+struct TracePacket {
+    uint32_t sequence;
+    int64_t arrival_ms;
+};
+
+struct ReplayResult {
+    JitterBufferStats stats;
+    std::vector<uint32_t> played;   // Sequence of every frame the speaker played, 0 for a concealed one
+    uint32_t starved_slots = 0;     // Speaker slots with nothing queued, between two played frames
+    double added_latency_ms = 0;    // Mean time from the arrival of a packet to the start of its playback
+
+    double ConcealmentRatio() const {
+        return played.empty() ? 0 : (double)stats.concealed / played.size();
+    }
+};
+
+inline int64_t SendTimeMs(uint32_t sequence) {
+    return (int64_t)(sequence - 1) * kFrameMs;
+}
+
+// Packets sent every frame from sequence 1, arriving after delay_ms, the even ones jitter_ms later
+std::vector<TracePacket> SteadyTrace(uint32_t count, int64_t delay_ms, int64_t jitter_ms = 0) {
+    std::vector<TracePacket> trace;
+    for (uint32_t sequence = 1; sequence <= count; sequence++) {
+        trace.push_back({sequence, SendTimeMs(sequence) + delay_ms + (sequence % 2 == 0 ? jitter_ms : 0)});
+    }
+    return trace;
+}
+
+void Drop(std::vector<TracePacket>& trace, uint32_t sequence) {
+    trace.erase(std::remove_if(trace.begin(), trace.end(),
+        [sequence](const TracePacket& packet) { return packet.sequence == sequence; }), trace.end());
+}
+
+/*
+ * Replays an arrival trace on a simulated clock with a 1 ms step. The decode side asks the buffer
+ * for a frame on every step while the 2 entry playback queue has room, the way OpusDecodeTask
+ * drains it, so only the playout clock of the buffer paces the frames. The speaker takes one frame
+ * from the queue every kFrameMs once the first one is queued.
+ */
+ReplayResult Replay(std::vector<TracePacket> trace) {
+    std::stable_sort(trace.begin(), trace.end(),
+        [](const TracePacket& a, const TracePacket& b) { return a.arrival_ms < b.arrival_ms; });
+    std::map<uint32_t, int64_t> arrival_ms;
+
+    JitterBuffer buffer;
+    ReplayResult result;
+    std::deque<uint32_t> playback_queue;
+    bool speaking = false;
+    int64_t speaker_next_ms = 0;
+    uint32_t starved = 0;
+    double latency_sum = 0;
+    size_t latency_count = 0;
+    size_t next = 0;
+    int64_t end_ms = trace.empty() ? 0 : trace.back().arrival_ms + 2000;
+
+    for (int64_t now_ms = 0; now_ms <= end_ms; now_ms++) {
+        esp_timer_host_set_time(now_ms * 1000);
+        for (; next < trace.size() && trace[next].arrival_ms <= now_ms; next++) {
+            auto packet = AudioStreamPacket::Create();
+            packet->sample_rate = 16000;
+            packet->frame_duration = kFrameMs;
+            packet->sequence = trace[next].sequence;
+            arrival_ms[packet->sequence] = now_ms;
+            buffer.OnArrival(packet->sequence, packet->frame_duration);
+            if (!buffer.Full()) {
+                buffer.Put(std::move(packet));
+            }
+        }
+
+        while (playback_queue.size() < 2) {
+            AudioStreamPacketPtr packet;
+            int wait_ms;
+            JitterBufferResult get = buffer.Get(packet, wait_ms);
+            if (get == kJitterBufferWait) {
+                break;
+            }
+            playback_queue.push_back(get == kJitterBufferFrame ? packet->sequence : 0);
+        }
+
+        if (!speaking && !playback_queue.empty()) {
+            speaking = true;
+            speaker_next_ms = now_ms;
+        }
+        if (speaking && now_ms >= speaker_next_ms) {
+            if (playback_queue.empty()) {
+                starved++;
+                speaker_next_ms = now_ms + kFrameMs;
+                continue;
+            }
+            uint32_t sequence = playback_queue.front();
+            playback_queue.pop_front();
+            result.played.push_back(sequence);
+            if (sequence != 0) {
+                latency_sum += now_ms - arrival_ms[sequence];
+                latency_count++;
+            }
+            /* Only the slots missed before a frame that did play count, not the end of the stream */
+            result.starved_slots += starved;
+            starved = 0;
+            speaker_next_ms += kFrameMs;
+        }
+    }
+    esp_timer_host_set_time(-1);
+
+    result.stats = buffer.GetStats();
+    result.added_latency_ms = latency_count > 0 ? latency_sum / latency_count : 0;
+    return result;
+}
+
+void Report(const char* name, const ReplayResult& result) {
+    const auto& stats = result.stats;
+    std::printf("%s: played=%zu concealed=%lu (%.2f%%) skipped=%lu late=%lu underruns=%lu starved=%lu "
+        "buffer delay=%.1f ms added latency=%.1f ms\n", name, result.played.size(),
+        (unsigned long)stats.concealed, result.ConcealmentRatio() * 100, (unsigned long)stats.skipped,
+        (unsigned long)stats.late, (unsigned long)stats.underruns, (unsigned long)result.starved_slots,
+        stats.frames > 0 ? (double)stats.total_delay_ms / stats.frames : 0.0, result.added_latency_ms);
+}
+
+TEST(JitterBufferTest, SteadyStreamUnderrunsOnlyAtItsEnd) {
+    auto result = Replay(SteadyTrace(100, 50));
+    Report("steady", result);
+    EXPECT_EQ(result.stats.frames, 100u);
+    EXPECT_EQ(result.stats.concealed, 0u);
+    EXPECT_EQ(result.stats.skipped, 0u);
+    EXPECT_EQ(result.stats.underruns, 1u);
+    EXPECT_EQ(result.starved_slots, 0u);
+    /* Without jitter nothing is held back */
+    EXPECT_LT(result.added_latency_ms, kFrameMs);
+}
+
+TEST(JitterBufferTest, IsolatedLossIsConcealed) {
+    /* The first late packet stalls the buffer, the depth built up after that covers the loss */
+    auto trace = SteadyTrace(100, 50, 20);
+    Drop(trace, 40);
+    auto result = Replay(trace);
+    Report("isolated loss", result);
+    EXPECT_EQ(result.stats.concealed, 1u);
+    EXPECT_EQ(result.stats.skipped, 0u);
+    EXPECT_EQ(result.stats.underruns, 2u);
+    ASSERT_EQ(result.played.size(), 100u);
+    EXPECT_EQ(result.played[38], 39u);
+    EXPECT_EQ(result.played[39], 0u);
+    EXPECT_EQ(result.played[40], 41u);
+    EXPECT_LE(result.starved_slots, 1u);
+}
+
+TEST(JitterBufferTest, LossAfterStallIsConcealed) {
+    /* 31 to 34 are held up and arrive together, the buffer runs empty, and 32 never arrives */
+    auto trace = SteadyTrace(60, 50);
+    for (auto& packet : trace) {
+        if (packet.sequence >= 31 && packet.sequence <= 34) {
+            packet.arrival_ms = SendTimeMs(34) + 50;
+        }
+    }
+    Drop(trace, 32);
+    auto result = Replay(trace);
+    Report("loss after stall", result);
+    EXPECT_EQ(result.stats.concealed, 1u);
+    EXPECT_EQ(result.stats.skipped, 0u);
+    EXPECT_EQ(result.stats.late, 0u);
+    EXPECT_EQ(result.stats.underruns, 2u);
+    ASSERT_EQ(result.played.size(), 60u);
+    EXPECT_EQ(result.played[30], 31u);
+    EXPECT_EQ(result.played[31], 0u);
+    EXPECT_EQ(result.played[32], 33u);
+}
+
+TEST(JitterBufferTest, PauseBetweenSentencesKeepsTheSequence) {
+    auto trace = SteadyTrace(50, 50);
+    for (uint32_t sequence = 51; sequence <= 100; sequence++) {
+        trace.push_back({sequence, SendTimeMs(sequence) + 2000 + 50});
+    }
+    auto result = Replay(trace);
+    Report("pause", result);
+    EXPECT_EQ(result.stats.frames, 100u);
+    EXPECT_EQ(result.stats.concealed, 0u);
+    EXPECT_EQ(result.stats.skipped, 0u);
+    EXPECT_EQ(result.stats.underruns, 2u);
+}
+
+TEST(JitterBufferTest, JitteryTraceReplay) {
+    /* 40 ms base delay, exponential jitter with a 20 ms mean, 2% random loss */
+    std::mt19937 random(1234);
+    std::exponential_distribution<double> jitter(1.0 / 20);
+    std::bernoulli_distribution loss(0.02);
+    std::vector<TracePacket> trace;
+    uint32_t lost = 0;
+    const uint32_t count = 1000;
+    for (uint32_t sequence = 1; sequence <= count; sequence++) {
+        if (loss(random)) {
+            lost++;
+            continue;
+        }
+        int64_t delay = 40 + std::min<int64_t>((int64_t)jitter(random), 300);
+        trace.push_back({sequence, SendTimeMs(sequence) + delay});
+    }
+
+    auto result = Replay(trace);
+    Report("jittery", result);
+    const auto& stats = result.stats;
+    EXPECT_EQ(stats.frames + stats.concealed + stats.skipped, count);
+    EXPECT_EQ(stats.skipped, 0u);
+    /* Every lost packet is concealed, late ones only add to that */
+    EXPECT_GE(stats.concealed, lost);
+    EXPECT_LT(result.ConcealmentRatio(), 0.05);
+    EXPECT_LT(stats.underruns, count / 20);
+    EXPECT_LT(result.added_latency_ms, JITTER_BUFFER_MAX_TARGET_MS);
+}
+
+} // namespace
@@ -0,0 +1,119 @@
+#include "local_http_server.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// One request to the LocalHttpServer, with the response computed when it opens
+class LocalHttp : public Http {
+public:
+    explicit LocalHttp(LocalHttpServer& server) : server_(server) {}
+
+    void SetTimeout(int timeout_ms) override {}
+    void SetHeader(const std::string& key, const std::string& value) override { headers_[key] = value; }
+    void SetContent(std::string&& content) override {}
+    int Write(const char* buffer, size_t buffer_size) override { return buffer_size; }
+
+    bool Open(const std::string& method, const std::string& url) override {
+        LocalHttpServer::Fault fault;
+        std::string range = headers_.count("Range") ? headers_["Range"] : "";
+        std::lock_guard<std::mutex> lock(server_.mutex_);
+        server_.ranges_.push_back(range);
+        if (!server_.faults_.empty()) {
+            fault = server_.faults_.front();
+            server_.faults_.pop_front();
+        }
+        if (fault.refuse) {
+            return false;
+        }
+        auto file = server_.files_.find(url);
+        if (fault.status != 0 || file == server_.files_.end()) {
+            status_code_ = fault.status != 0 ? fault.status : 404;
+            return true;
+        }
+
+        const std::string& content = file->second.content;
+        content_type_ = file->second.content_type;
+        size_t begin = 0;
+        size_t end = content.size();
+        status_code_ = 200;
+        if (server_.range_support_ && range.compare(0, 6, "bytes=") == 0) {
+            char* dash;
+            begin = std::strtoull(range.c_str() + 6, &dash, 10);
+            if (dash[0] == '-' && dash[1] != '\0') {
+                end = std::min<size_t>(end, std::strtoull(dash + 1, nullptr, 10) + 1);
+            }
+            if (begin >= content.size()) {
+                status_code_ = 416;
+                return true;
+            }
+            status_code_ = 206;
+        }
+        body_ = content.substr(begin, end - begin);
+        close_after_ = fault.close_after;
+        read_error_ = fault.read_error;
+        return true;
+    }
+
+    void Close() override {}
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (position_ >= close_after_) {
+            return read_error_ ? -1 : 0;
+        }
+        size_t size = std::min({buffer_size, body_.size() - position_, close_after_ - position_});
+        memcpy(buffer, body_.data() + position_, size);
+        position_ += size;
+        return size;
+    }
+
+    int GetStatusCode() override { return status_code_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        return key == "Content-Type" ? content_type_ : "";
+    }
+
+    size_t GetBodyLength() override { return body_.size(); }
+
+    std::string ReadAll() override {
+        std::string all = body_.substr(position_);
+        position_ = body_.size();
+        return all;
+    }
+
+private:
+    LocalHttpServer& server_;
+    std::map<std::string, std::string> headers_;
+    int status_code_ = 0;
+    std::string content_type_;
+    std::string body_;
+    size_t position_ = 0;
+    size_t close_after_ = SIZE_MAX;
+    bool read_error_ = false;
+};
+
+void LocalHttpServer::AddFile(const std::string& url, std::string content, const std::string& content_type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[url] = File{std::move(content), content_type};
+}
+
+void LocalHttpServer::SetRangeSupport(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    range_support_ = enabled;
+}
+
+void LocalHttpServer::QueueFault(const Fault& fault, int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < count; i++) {
+        faults_.push_back(fault);
+    }
+}
+
+std::unique_ptr<Http> LocalHttpServer::CreateHttp() {
+    return std::make_unique<LocalHttp>(*this);
+}
+
+std::vector<std::string> LocalHttpServer::ranges() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ranges_;
+}
@@ -0,0 +1,50 @@
+#ifndef LOCAL_HTTP_SERVER_H
+#define LOCAL_HTTP_SERVER_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <http.h>
+
+/*
+ * In-process stand-in for the music server: serves files from memory to the Http connections it
+ * creates, answers "Range: bytes=a-b" with 206 (or ignores it and answers 200), and injects the
+ * faults queued for the next requests in order.
+ */
+class LocalHttpServer {
+public:
+    struct Fault {
+        bool refuse = false;            // Open() fails
+        int status = 0;                 // Answer with this status instead of the file
+        size_t close_after = SIZE_MAX;  // The connection ends after this many body bytes
+        bool read_error = false;        // ... with a read error instead of a close
+    };
+
+    void AddFile(const std::string& url, std::string content, const std::string& content_type);
+    void SetRangeSupport(bool enabled);
+    void QueueFault(const Fault& fault, int count = 1);
+    std::unique_ptr<Http> CreateHttp();
+
+    // The Range header of every request so far, empty for requests without one
+    std::vector<std::string> ranges();
+
+private:
+    friend class LocalHttp;
+    struct File {
+        std::string content;
+        std::string content_type;
+    };
+
+    std::mutex mutex_;
+    std::map<std::string, File> files_;
+    bool range_support_ = true;
+    std::deque<Fault> faults_;
+    std::vector<std::string> ranges_;
+};
+
+#endif // LOCAL_HTTP_SERVER_H
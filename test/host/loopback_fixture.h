@@ -0,0 +1,79 @@
+#ifndef LOOPBACK_FIXTURE_H
+#define LOOPBACK_FIXTURE_H
+
+#include <gtest/gtest.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "audio_service.h"
+#include "loopback_protocol.h"
+#include "wav_audio_codec.h"
+
+// AudioService on a WavAudioCodec, with its send queue echoed back through a LoopbackProtocol
+class LoopbackTest : public ::testing::Test {
+protected:
+    std::unique_ptr<WavAudioCodec> codec_;
+    std::unique_ptr<AudioService> service_;
+    LoopbackProtocol protocol_;
+
+    void Start(int output_sample_rate, bool real_time) {
+        codec_ = std::make_unique<WavAudioCodec>(16000, output_sample_rate, real_time);
+        service_ = std::make_unique<AudioService>();
+        service_->Initialize(codec_.get());
+        service_->Start();
+    }
+
+    /* Echoes the send queue through the protocol into the decode queue, like Application does */
+    void StartLoopback() {
+        protocol_.OnIncomingAudio([this](AudioStreamPacketPtr packet) {
+            service_->PushPacketToDecodeQueue(std::move(packet), true);
+        });
+        AudioServiceCallbacks callbacks;
+        callbacks.on_send_queue_available = [this]() {
+            std::lock_guard<std::mutex> lock(pump_mutex_);
+            pump_pending_ = true;
+            pump_cv_.notify_one();
+        };
+        service_->SetCallbacks(callbacks);
+        pump_ = std::thread([this]() {
+            std::unique_lock<std::mutex> lock(pump_mutex_);
+            while (!pump_stopped_) {
+                pump_cv_.wait(lock, [this]() { return pump_pending_ || pump_stopped_; });
+                pump_pending_ = false;
+                lock.unlock();
+                while (auto packet = service_->PopPacketFromSendQueue()) {
+                    protocol_.SendAudio(std::move(packet));
+                }
+                lock.lock();
+            }
+        });
+        protocol_.OpenAudioChannel();
+    }
+
+    void TearDown() override {
+        if (pump_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(pump_mutex_);
+                pump_stopped_ = true;
+                pump_cv_.notify_one();
+            }
+            pump_.join();
+        }
+        if (service_) {
+            service_->Stop();
+            HostWaitForTasks();
+        }
+    }
+
+private:
+    std::thread pump_;
+    std::mutex pump_mutex_;
+    std::condition_variable pump_cv_;
+    bool pump_pending_ = false;
+    bool pump_stopped_ = false;
+};
+
+#endif // LOOPBACK_FIXTURE_H
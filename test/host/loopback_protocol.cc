@@ -0,0 +1,91 @@
+#include "loopback_protocol.h"
+
+#include <esp_log.h>
+
+#define TAG "LoopbackProtocol"
+
+void LoopbackProtocol::SetLinkModel(LinkModel link_model) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    link_model_ = link_model;
+}
+
+void LoopbackProtocol::ReceiveJson(const std::string& json) {
+    auto root = cJSON_Parse(json.c_str());
+    if (root == nullptr) {
+        ESP_LOGE(TAG, "Invalid JSON: %s", json.c_str());
+        return;
+    }
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    if (on_incoming_json_ != nullptr) {
+        on_incoming_json_(root);
+    }
+    cJSON_Delete(root);
+}
+
+std::vector<std::string> LoopbackProtocol::sent_texts() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sent_texts_;
+}
+
+bool LoopbackProtocol::Start() {
+    return true;
+}
+
+bool LoopbackProtocol::OpenAudioChannel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        opened_ = true;
+        error_occurred_ = false;
+    }
+    session_id_ = "loopback";
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    if (on_audio_channel_opened_ != nullptr) {
+        on_audio_channel_opened_();
+    }
+    return true;
+}
+
+void LoopbackProtocol::CloseAudioChannel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        opened_ = false;
+    }
+    if (on_audio_channel_closed_ != nullptr) {
+        on_audio_channel_closed_();
+    }
+}
+
+bool LoopbackProtocol::IsAudioChannelOpened() const {
+    return opened_ && !error_occurred_;
+}
+
+bool LoopbackProtocol::SendAudio(AudioStreamPacketPtr packet) {
+    LinkModel link_model;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!opened_) {
+            return false;
+        }
+        /* The server numbers its packets from 1, 0 means a packet outside of a stream */
+        packet->sequence = ++sent_packets_;
+        link_model = link_model_;
+    }
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    auto deliver = [this](AudioStreamPacketPtr echoed) {
+        if (on_incoming_audio_ != nullptr) {
+            on_incoming_audio_(std::move(echoed));
+        }
+    };
+    if (link_model) {
+        link_model(std::move(packet), deliver);
+    } else {
+        deliver(std::move(packet));
+    }
+    return true;
+}
+
+bool LoopbackProtocol::SendText(const std::string& text) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sent_texts_.push_back(text);
+    return true;
+}
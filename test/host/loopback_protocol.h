@@ -0,0 +1,47 @@
+#ifndef LOOPBACK_PROTOCOL_H
+#define LOOPBACK_PROTOCOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <atomic>
+
+#include "protocol.h"
+
+/*
+ * Protocol for the host build that plays the server: every audio packet sent is numbered
+ * like the server does and handed straight back to the incoming audio callback. A link
+ * model may drop, hold back or reorder the echoed packets to reproduce network traces.
+ * The JSON messages are recorded instead of being sent.
+ */
+class LoopbackProtocol : public Protocol {
+public:
+    // Gets every echoed packet, calls deliver for each packet (possibly another one) to hand over now
+    using LinkModel = std::function<void(AudioStreamPacketPtr packet, std::function<void(AudioStreamPacketPtr)> deliver)>;
+
+    LoopbackProtocol() = default;
+
+    void SetLinkModel(LinkModel link_model);
+    // Feeds a message as if the server had sent it
+    void ReceiveJson(const std::string& json);
+    std::vector<std::string> sent_texts();
+    inline uint32_t sent_packets() const { return sent_packets_; }
+
+    bool Start() override;
+    bool OpenAudioChannel() override;
+    void CloseAudioChannel() override;
+    bool IsAudioChannelOpened() const override;
+    bool SendAudio(AudioStreamPacketPtr packet) override;
+
+private:
+    std::mutex mutex_;
+    std::atomic<bool> opened_ = false;
+    std::atomic<uint32_t> sent_packets_ = 0;
+    LinkModel link_model_;
+    std::vector<std::string> sent_texts_;
+
+    bool SendText(const std::string& text) override;
+};
+
+#endif // LOOPBACK_PROTOCOL_H
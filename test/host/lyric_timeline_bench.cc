@@ -0,0 +1,164 @@
+/*
+ * LyricTimeline::Parse on large LRC files, against the istringstream parser Esp32Music::ParseLyrics
+ * used before, and the binary search of Find() against the linear scan of the old display update.
+ *
+ * Usage: lyric_timeline_bench [--lines=N] [--runs=N]
+ */
+#include <atomic>
+#include <cstdio>
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lyric_timeline.h"
+#include "test_util.h"
+
+// operator new calls per parse, the arena of LyricTimeline comes from heap_caps_malloc and is not counted
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// The previous Esp32Music::ParseLyrics, without its logging
+bool ParseLyricsOld(const std::string& lyric_content, std::vector<std::pair<int, std::string>>& lyrics) {
+    lyrics.clear();
+    std::istringstream stream(lyric_content);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        if (line.length() > 10 && line[0] == '[') {
+            size_t close_bracket = line.find(']');
+            if (close_bracket != std::string::npos) {
+                std::string tag_or_time = line.substr(1, close_bracket - 1);
+                std::string content = line.substr(close_bracket + 1);
+                size_t colon_pos = tag_or_time.find(':');
+                if (colon_pos != std::string::npos) {
+                    std::string left_part = tag_or_time.substr(0, colon_pos);
+                    bool is_time_format = true;
+                    for (char c : left_part) {
+                        if (!isdigit(c)) {
+                            is_time_format = false;
+                            break;
+                        }
+                    }
+                    if (!is_time_format) {
+                        continue;
+                    }
+                    try {
+                        int minutes = std::stoi(tag_or_time.substr(0, colon_pos));
+                        float seconds = std::stof(tag_or_time.substr(colon_pos + 1));
+                        int timestamp_ms = minutes * 60 * 1000 + (int)(seconds * 1000);
+                        std::string safe_lyric_text;
+                        if (!content.empty()) {
+                            safe_lyric_text = content;
+                            safe_lyric_text.shrink_to_fit();
+                        }
+                        lyrics.push_back(std::make_pair(timestamp_ms, safe_lyric_text));
+                    } catch (const std::exception& e) {
+                    }
+                }
+            }
+        }
+    }
+    std::sort(lyrics.begin(), lyrics.end());
+    return !lyrics.empty();
+}
+
+// Metadata, then one line per 2.5 s with Chinese text. One time tag per line, the old parser only read the first
+std::string MakeLrc(long lines) {
+    std::string lrc = "[ti:Benchmark]\r\n[ar:Host]\r\n[al:Large]\r\n[by:lyric_timeline_bench]\r\n";
+    char tag[32];
+    for (long i = 0; i < lines; i++) {
+        long ms = i * 2500;
+        std::snprintf(tag, sizeof(tag), "[%02ld:%02ld.%02ld]", ms / 60000, ms / 1000 % 60, ms / 10 % 100);
+        lrc += tag;
+        lrc += "第" + std::to_string(i) + "句歌词 line of lyrics number " + std::to_string(i) + "\r\n";
+    }
+    return lrc;
+}
+
+template <typename F>
+std::pair<double, double> Time(long runs, F&& run) {
+    uint64_t best = UINT64_MAX;
+    uint64_t allocations_before = allocations;
+    for (long i = 0; i < runs; i++) {
+        uint64_t start = CycleCount();
+        run();
+        best = std::min(best, CycleCount() - start);
+    }
+    return {double(best), double(allocations - allocations_before) / runs};
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long lines = BenchmarkOption(argc, argv, "lines", 20000);
+    long runs = BenchmarkOption(argc, argv, "runs", 5);
+    std::string lrc = MakeLrc(lines);
+
+    std::vector<std::pair<int, std::string>> old_lyrics;
+    auto old_parse = Time(runs, [&]() { ParseLyricsOld(lrc, old_lyrics); });
+    LyricTimeline timeline;
+    auto new_parse = Time(runs, [&]() { timeline.Parse(lrc.data(), lrc.size()); });
+
+    std::printf("%ld lines, %zu KB (cycles per parse, best of %ld)\n", lines, lrc.size() / 1024, runs);
+    std::printf("  istringstream parser   %.0f cycles, %.0f operator new, %zu entries\n", old_parse.first,
+        old_parse.second, old_lyrics.size());
+    std::printf("  LyricTimeline::Parse   %.0f cycles, %.0f operator new, %zu entries (%.1fx)\n", new_parse.first,
+        new_parse.second, timeline.size(), old_parse.first / new_parse.first);
+
+    /* Positions across the song, as a seek or the lyric timer looks them up */
+    const long lookups = 100000;
+    int64_t duration_ms = (int64_t)lines * 2500;
+    long checksum_old = 0;
+    long checksum_new = 0;
+    auto linear = Time(1, [&]() {
+        for (long i = 0; i < lookups; i++) {
+            int64_t position = i * 7919 % duration_ms;
+            int index = -1;
+            for (size_t k = 0; k < old_lyrics.size() && old_lyrics[k].first <= position; k++) {
+                index = k;
+            }
+            checksum_old += index;
+        }
+    });
+    auto binary = Time(1, [&]() {
+        for (long i = 0; i < lookups; i++) {
+            checksum_new += timeline.Find(i * 7919 % duration_ms);
+        }
+    });
+    std::printf("  lookup: linear scan %.0f cycles, Find() %.0f cycles (per lookup)\n", linear.first / lookups,
+        binary.first / lookups);
+
+    bool ok = timeline.size() == old_lyrics.size() && checksum_old == checksum_new;
+    for (size_t i = 0; ok && i < old_lyrics.size(); i++) {
+        ok = timeline.time_ms(i) == old_lyrics[i].first;
+    }
+    if (!ok) {
+        std::printf("FAILED: the timeline does not match the previous parser\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "lyric_timeline.h"
+
+namespace {
+
+bool Parse(LyricTimeline& timeline, const std::string& content) {
+    return timeline.Parse(content.data(), content.size());
+}
+
+TEST(LyricTimelineTest, ParsesTimeTagsInOrder) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline,
+        "\xEF\xBB\xBF[ti:Song]\r\n"
+        "[ar:Artist]\r\n"
+        "[00:05.50]second\r\n"
+        "[00:01.00]first\r\n"
+        "[01:02.345]third\n"
+        "[02:03:25]colon fraction\n"
+        "[03:04]no fraction"));
+    ASSERT_EQ(timeline.size(), 5u);
+    EXPECT_EQ(timeline.time_ms(0), 1000);
+    EXPECT_STREQ(timeline.text(0), "first");
+    EXPECT_EQ(timeline.time_ms(1), 5500);
+    EXPECT_STREQ(timeline.text(1), "second");
+    EXPECT_EQ(timeline.time_ms(2), 62345);
+    EXPECT_STREQ(timeline.text(2), "third");
+    EXPECT_EQ(timeline.time_ms(3), 123250);
+    EXPECT_EQ(timeline.time_ms(4), 184000);
+    EXPECT_STREQ(timeline.text(4), "no fraction");
+}
+
+TEST(LyricTimelineTest, LineWithSeveralTimesIsStoredOnce) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[00:10.00][00:30.00]chorus\n[00:20.00]verse\n"));
+    ASSERT_EQ(timeline.size(), 3u);
+    EXPECT_STREQ(timeline.text(0), "chorus");
+    EXPECT_STREQ(timeline.text(1), "verse");
+    EXPECT_STREQ(timeline.text(2), "chorus");
+    EXPECT_EQ(timeline.text(0), timeline.text(2));
+}
+
+TEST(LyricTimelineTest, EqualTimesKeepTheFileOrder) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[00:01.00]original\n[00:01.00]translation\n"));
+    EXPECT_STREQ(timeline.text(0), "original");
+    EXPECT_STREQ(timeline.text(1), "translation");
+}
+
+TEST(LyricTimelineTest, BlankLinesHaveEmptyText) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[00:01.00]\n[00:02.00]text\n[00:03.00]\r\n"));
+    ASSERT_EQ(timeline.size(), 3u);
+    EXPECT_STREQ(timeline.text(0), "");
+    EXPECT_STREQ(timeline.text(2), "");
+}
+
+TEST(LyricTimelineTest, AppliesTheOffsetTag) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[offset:+500]\n[00:00.20]clamped\n[00:02.00]earlier\n"));
+    EXPECT_EQ(timeline.time_ms(0), 0);
+    EXPECT_EQ(timeline.time_ms(1), 1500);
+
+    ASSERT_TRUE(Parse(timeline, "[offset: -250]\n[00:02.00]later\n"));
+    EXPECT_EQ(timeline.time_ms(0), 2250);
+}
+
+TEST(LyricTimelineTest, IgnoresMalformedTags) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[xx:10]bad\n[00:1x]bad\n[00:01.00\nunterminated\n[00:04.00]good\n"));
+    ASSERT_EQ(timeline.size(), 1u);
+    EXPECT_STREQ(timeline.text(0), "good");
+}
+
+TEST(LyricTimelineTest, FailsWithoutTimedLines) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[00:01.00]line\n"));
+    EXPECT_FALSE(Parse(timeline, "[ti:Only metadata]\nplain text\n"));
+    EXPECT_TRUE(timeline.empty());
+    EXPECT_FALSE(timeline.Parse(nullptr, 0));
+}
+
+TEST(LyricTimelineTest, FindsTheLineShownAtAPosition) {
+    LyricTimeline timeline;
+    ASSERT_TRUE(Parse(timeline, "[00:01.00]a\n[00:02.00]b\n[00:04.00]c\n"));
+    EXPECT_EQ(timeline.Find(0), -1);
+    EXPECT_EQ(timeline.Find(999), -1);
+    EXPECT_EQ(timeline.Find(1000), 0);
+    EXPECT_EQ(timeline.Find(3999), 1);
+    EXPECT_EQ(timeline.Find(4000), 2);
+    EXPECT_EQ(timeline.Find(600000), 2);
+
+    EXPECT_EQ(timeline.NextTimeMs(-1), 1000);
+    EXPECT_EQ(timeline.NextTimeMs(1), 4000);
+    EXPECT_EQ(timeline.NextTimeMs(2), -1);
+}
+
+} // namespace
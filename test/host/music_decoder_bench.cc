@@ -0,0 +1,192 @@
+/*
+ * Decode cost per frame of the MusicDecoder implementations, fed like the play thread feeds them:
+ * contiguous regions of MUSIC_DECODER_MIN_INPUT bytes, advanced by what each call consumed.
+ *
+ * Only what builds on the host is timed. WAV is the real decoder. Ogg/Opus is the real Ogg demuxer
+ * on top of the host Opus stand-in, so its numbers are the container cost without the codec.
+ * Helix MP3 is not part of the host build, an MP3 stream is only sniffed. AAC has no decoder on
+ * any build, the bench only checks that an ADTS stream is sniffed and refused.
+ *
+ * Usage: music_decoder_bench [--seconds=N]
+ */
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opus.h>
+
+#include "music_decoder.h"
+#include "test_util.h"
+
+#define SAMPLE_RATE 48000
+#define OPUS_FRAME_SAMPLES 960
+
+namespace {
+
+void AppendLe(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        out.push_back(uint8_t(value >> (8 * i)));
+    }
+}
+
+std::vector<int16_t> StereoTone(size_t frames) {
+    auto left = GenerateSine(SAMPLE_RATE, 440, 12000, frames);
+    auto right = GenerateSine(SAMPLE_RATE, 660, 12000, frames);
+    std::vector<int16_t> pcm(frames * 2);
+    for (size_t i = 0; i < frames; i++) {
+        pcm[2 * i] = left[i];
+        pcm[2 * i + 1] = right[i];
+    }
+    return pcm;
+}
+
+std::vector<uint8_t> MakeWav(const std::vector<int16_t>& pcm) {
+    std::vector<uint8_t> wav;
+    uint32_t data_size = pcm.size() * 2;
+    wav.insert(wav.end(), {'R', 'I', 'F', 'F'});
+    AppendLe(wav, 36 + data_size, 4);
+    wav.insert(wav.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    AppendLe(wav, 16, 4);
+    AppendLe(wav, 1, 2);
+    AppendLe(wav, 2, 2);
+    AppendLe(wav, SAMPLE_RATE, 4);
+    AppendLe(wav, SAMPLE_RATE * 4, 4);
+    AppendLe(wav, 4, 2);
+    AppendLe(wav, 16, 2);
+    wav.insert(wav.end(), {'d', 'a', 't', 'a'});
+    AppendLe(wav, data_size, 4);
+    for (int16_t sample : pcm) {
+        AppendLe(wav, uint16_t(sample), 2);
+    }
+    return wav;
+}
+
+// One packet per page, the CRC is left at zero as the demuxer does not check it
+void AppendOggPage(std::vector<uint8_t>& out, const std::vector<uint8_t>& packet, uint8_t header_type,
+    uint64_t granule, uint32_t sequence) {
+    out.insert(out.end(), {'O', 'g', 'g', 'S', 0, header_type});
+    AppendLe(out, granule, 8);
+    AppendLe(out, 0x58495a48, 4);
+    AppendLe(out, sequence, 4);
+    AppendLe(out, 0, 4);
+    std::vector<uint8_t> lacing(packet.size() / 255, 255);
+    lacing.push_back(packet.size() % 255);
+    out.push_back(lacing.size());
+    out.insert(out.end(), lacing.begin(), lacing.end());
+    out.insert(out.end(), packet.begin(), packet.end());
+}
+
+std::vector<uint8_t> MakeOggOpus(const std::vector<int16_t>& pcm) {
+    std::vector<uint8_t> ogg;
+    std::vector<uint8_t> head = {'O', 'p', 'u', 's', 'H', 'e', 'a', 'd', 1, 2};
+    AppendLe(head, 0, 2);
+    AppendLe(head, SAMPLE_RATE, 4);
+    AppendLe(head, 0, 2);
+    head.push_back(0);
+    AppendOggPage(ogg, head, 0x02, 0, 0);
+    std::vector<uint8_t> tags = {'O', 'p', 'u', 's', 'T', 'a', 'g', 's', 0, 0, 0, 0, 0, 0, 0, 0};
+    AppendOggPage(ogg, tags, 0, 0, 1);
+
+    int error;
+    OpusEncoder* encoder = opus_encoder_create(SAMPLE_RATE, 2, OPUS_APPLICATION_AUDIO, &error);
+    std::vector<uint8_t> packet(OPUS_FRAME_SAMPLES * 2);
+    uint32_t sequence = 2;
+    for (size_t i = 0; i + OPUS_FRAME_SAMPLES * 2 <= pcm.size(); i += OPUS_FRAME_SAMPLES * 2) {
+        int size = opus_encode(encoder, pcm.data() + i, OPUS_FRAME_SAMPLES, packet.data(), packet.size());
+        AppendOggPage(ogg, std::vector<uint8_t>(packet.begin(), packet.begin() + size), 0,
+            i / 2 + OPUS_FRAME_SAMPLES, sequence++);
+    }
+    opus_encoder_destroy(encoder);
+    return ogg;
+}
+
+struct Result {
+    uint32_t frames = 0;
+    uint32_t errors = 0;
+    size_t samples = 0;
+    std::vector<int64_t> frame_cycles;
+    uint64_t total_cycles = 0;
+    std::vector<int16_t> pcm;
+};
+
+Result Decode(MusicDecoder& decoder, const std::vector<uint8_t>& stream) {
+    Result result;
+    std::vector<int16_t> pcm;
+    size_t position = 0;
+    while (position < stream.size()) {
+        size_t size = std::min<size_t>(MUSIC_DECODER_MIN_INPUT, stream.size() - position);
+        size_t consumed = 0;
+        size_t frame_offset = 0;
+        MusicFrameInfo info;
+        uint64_t start = CycleCount();
+        auto decoded = decoder.DecodeFrame(stream.data() + position, size, consumed, frame_offset, pcm, info);
+        uint64_t cycles = CycleCount() - start;
+        result.total_cycles += cycles;
+        position += consumed;
+        if (decoded == kMusicDecodeFrame) {
+            result.frames++;
+            result.frame_cycles.push_back(cycles);
+            result.samples += pcm.size();
+            result.pcm.insert(result.pcm.end(), pcm.begin(), pcm.end());
+        } else if (decoded == kMusicDecodeError) {
+            result.errors++;
+        } else if (consumed == 0) {
+            break;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long seconds = BenchmarkOption(argc, argv, "seconds", 5);
+    auto pcm = StereoTone(seconds * SAMPLE_RATE);
+
+    struct Stream {
+        const char* name;
+        std::string content_type;
+        std::vector<uint8_t> data;
+        MusicFormat expected;
+    };
+    std::vector<Stream> streams;
+    streams.push_back({"wav", "audio/wav", MakeWav(pcm), kMusicFormatWav});
+    streams.push_back({"ogg/opus", "audio/ogg", MakeOggOpus(pcm), kMusicFormatOggOpus});
+    /* An ID3 tag then an MPEG-1 Layer III header, only the sniffing runs */
+    streams.push_back({"mp3", "audio/mpeg", {'I', 'D', '3', 4, 0, 0, 0, 0, 0, 0, 0xff, 0xfb, 0x90, 0x64}, kMusicFormatMp3});
+    /* An ADTS header of an AAC-LC frame, sniffed and refused */
+    streams.push_back({"aac", "audio/aac", {0xff, 0xf1, 0x50, 0x80, 0x02, 0x1f, 0xfc}, kMusicFormatAac});
+
+    bool ok = true;
+    std::printf("%lds of 48 kHz stereo, %d byte regions\n", seconds, MUSIC_DECODER_MIN_INPUT);
+    for (auto& stream : streams) {
+        MusicFormat format = DetectMusicFormat(stream.data.data(), stream.data.size(), "");
+        MusicFormat by_type = DetectMusicFormat(nullptr, 0, stream.content_type);
+        ok = ok && format == stream.expected && by_type == stream.expected;
+        auto decoder = CreateMusicDecoder(format);
+        if (decoder == nullptr) {
+            std::printf("  %-9s sniffed as %s, %s\n", stream.name, MusicFormatName(format),
+                format == kMusicFormatAac ? "not supported" : "no decoder in the host build");
+            continue;
+        }
+        ok = ok && format != kMusicFormatAac;
+
+        auto result = Decode(*decoder, stream.data);
+        std::printf("  %-9s sniffed as %s, frames=%u errors=%u cycles/frame p50=%lld p99=%lld, %.1f kcycles per second of audio\n",
+            stream.name, MusicFormatName(format), result.frames, result.errors,
+            (long long)Percentile(result.frame_cycles, 0.5), (long long)Percentile(result.frame_cycles, 0.99),
+            result.total_cycles / 1000.0 / seconds);
+        ok = ok && result.errors == 0;
+        if (format == kMusicFormatWav) {
+            ok = ok && result.pcm == pcm;
+        } else {
+            /* The stand-in codec keeps 8 bits per sample, only the length is exact */
+            ok = ok && result.samples == pcm.size() / (OPUS_FRAME_SAMPLES * 2) * OPUS_FRAME_SAMPLES * 2;
+        }
+    }
+    if (!ok) {
+        std::printf("FAILED: a stream was sniffed or decoded wrongly\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "object_pool.h"
+#include "loopback_fixture.h"
+#include "test_util.h"
+
+/* Every operator new of the process is counted, the soak test expects none per frame */
+static std::atomic<uint64_t> allocations = 0;
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct Item {
+    std::vector<int> storage;
+};
+
+TEST(ObjectPoolTest, RecyclesObjectsAndTheirStorage) {
+    ObjectPool<Item> pool(2, [](Item& item) { item.storage.clear(); return false; });
+    Item* first;
+    {
+        auto item = pool.Acquire();
+        item->storage.resize(32);
+        first = item.get();
+    }
+    auto item = pool.Acquire();
+    EXPECT_EQ(item.get(), first);
+    EXPECT_TRUE(item->storage.empty());
+    EXPECT_GE(item->storage.capacity(), 32u);
+    EXPECT_EQ(pool.GetStats().created, 2u);
+}
+
+TEST(ObjectPoolTest, FallsBackToTheHeapWhenExhausted) {
+    ObjectPool<Item> pool(2, nullptr);
+    EXPECT_EQ(pool.GetStats().created, 2u);
+    {
+        auto a = pool.Acquire();
+        auto b = pool.Acquire();
+        auto c = pool.Acquire();
+        auto stats = pool.GetStats();
+        EXPECT_EQ(stats.fallbacks, 1u);
+        EXPECT_EQ(stats.in_use, 3u);
+        EXPECT_EQ(stats.peak_in_use, 3u);
+    }
+    /* Only max_size objects are kept, the third one was freed */
+    auto a = pool.Acquire();
+    auto b = pool.Acquire();
+    EXPECT_EQ(pool.GetStats().created, 3u);
+    auto c = pool.Acquire();
+    EXPECT_EQ(pool.GetStats().created, 4u);
+}
+
+TEST(ObjectPoolTest, TrimsStorageAboveItsBound) {
+    ObjectPool<Item> pool(1, [](Item& item) {
+        item.storage.clear();
+        if (item.storage.capacity() > 64) {
+            std::vector<int>().swap(item.storage);
+            return true;
+        }
+        return false;
+    });
+    pool.Acquire()->storage.resize(1000);
+    EXPECT_EQ(pool.GetStats().trimmed, 1u);
+    EXPECT_EQ(pool.Acquire()->storage.capacity(), 0u);
+}
+
+/*
+ * Runs the loopback in real time and checks the heap is left alone once the pipeline warmed up.
+ * The pools create all their objects up front but their buffers grow on first use. The free lists
+ * are LIFO, so only the peak_in_use objects on top are ever handed out and each of their buffers
+ * grows once (a packet that only carried downlink audio grows when the encoder first writes to
+ * it); anything beyond that is a per-frame allocation.
+ */
+TEST_F(LoopbackTest, SteadyStateDoesNotAllocate) {
+    Start(16000, true);
+    const size_t seconds = 6;
+    codec_->SetInput(GenerateSine(16000, 440, 8000, seconds * 16000));
+    codec_->ReserveOutput(2 * seconds * 16000);
+    StartLoopback();
+    service_->EnableVoiceProcessing(true);
+
+    auto input_ms = [this]() { return codec_->input_position() / 16; };
+    ASSERT_TRUE(WaitUntil([&]() { return input_ms() >= 2000; }, 5000));
+    auto packets_before = AudioStreamPacket::Pool().GetStats();
+    auto tasks_before = service_->GetTaskPoolStats();
+    uint64_t allocations_before = allocations;
+    size_t output_before = codec_->output_samples();
+
+    ASSERT_TRUE(WaitUntil([&]() { return input_ms() >= (seconds - 1) * 1000; }, 10000));
+    uint64_t allocated = allocations - allocations_before;
+    auto packets_after = AudioStreamPacket::Pool().GetStats();
+    auto tasks_after = service_->GetTaskPoolStats();
+    size_t frames = (codec_->output_samples() - output_before) / 960;
+
+    uint32_t working_set = packets_after.peak_in_use + tasks_after.peak_in_use;
+
+    std::printf("frames=%zu allocations=%llu packets: acquired=%lu created=%lu peak=%lu tasks: acquired=%lu created=%lu peak=%lu\n",
+        frames, (unsigned long long)allocated,
+        (unsigned long)(packets_after.acquired - packets_before.acquired),
+        (unsigned long)packets_after.created, (unsigned long)packets_after.peak_in_use,
+        (unsigned long)(tasks_after.acquired - tasks_before.acquired),
+        (unsigned long)tasks_after.created, (unsigned long)tasks_after.peak_in_use);
+    ASSERT_GT(frames, 40u);
+    EXPECT_EQ(packets_after.fallbacks, 0u);
+    EXPECT_EQ(tasks_after.fallbacks, 0u);
+    EXPECT_EQ(packets_after.created, packets_before.created);
+    EXPECT_EQ(tasks_after.created, tasks_before.created);
+    EXPECT_LE(allocated, working_set);
+}
+
+} // namespace
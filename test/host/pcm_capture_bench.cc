@@ -0,0 +1,173 @@
+/*
+ * Cost per frame of the stereo (microphone + reference) capture path of AudioService::ReadAudioData
+ * and AudioInputTask: split the channels, resample them, interleave them again and keep the
+ * microphone. The allocating sample by sample loops it replaced run the same frames.
+ *
+ * Resampling goes through the host OpusResampler, so the "frame" numbers include a linear
+ * interpolator rather than the target one; the "kernels" numbers leave it out.
+ *
+ * Usage: pcm_capture_bench [--frames=N] [--input_rate=N]
+ */
+#include <cstdio>
+#include <vector>
+
+#include "opus_resampler.h"
+#include "pcm_kernels.h"
+#include "test_util.h"
+
+#define OUTPUT_RATE 16000
+#define FRAME_MS 60
+
+namespace {
+
+struct Capture {
+    OpusResampler mic_resampler;
+    OpusResampler reference_resampler;
+    bool resample;
+
+    explicit Capture(int input_rate) : resample(input_rate != OUTPUT_RATE) {
+        mic_resampler.Configure(input_rate, OUTPUT_RATE);
+        reference_resampler.Configure(input_rate, OUTPUT_RATE);
+    }
+};
+
+// The previous code: new vectors for each step and one sample per iteration
+void CaptureAllocating(Capture& capture, const std::vector<int16_t>& input, std::vector<int16_t>& data) {
+    data = input;
+    auto mic_channel = std::vector<int16_t>(data.size() / 2);
+    auto reference_channel = std::vector<int16_t>(data.size() / 2);
+    for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+        mic_channel[i] = data[j];
+        reference_channel[i] = data[j + 1];
+    }
+    if (capture.resample) {
+        auto resampled_mic = std::vector<int16_t>(capture.mic_resampler.GetOutputSamples(mic_channel.size()));
+        auto resampled_reference = std::vector<int16_t>(capture.reference_resampler.GetOutputSamples(reference_channel.size()));
+        capture.mic_resampler.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
+        capture.reference_resampler.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
+        mic_channel = std::move(resampled_mic);
+        reference_channel = std::move(resampled_reference);
+    }
+    data.resize(mic_channel.size() * 2);
+    for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+        data[j] = mic_channel[i];
+        data[j + 1] = reference_channel[i];
+    }
+    auto mono_data = std::vector<int16_t>(data.size() / 2);
+    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
+        mono_data[i] = data[j];
+    }
+    data = std::move(mono_data);
+}
+
+// The current code: scratch buffers that are only resized and the pcm_kernels loops
+struct Scratch {
+    std::vector<int16_t> buffer, mic, reference, resampled_mic, resampled_reference;
+};
+
+void CapturePreallocated(Capture& capture, Scratch& scratch, const std::vector<int16_t>& input, std::vector<int16_t>& data) {
+    scratch.buffer.resize(input.size());
+    std::copy(input.begin(), input.end(), scratch.buffer.begin());
+    size_t frames = scratch.buffer.size() / 2;
+    scratch.mic.resize(frames);
+    scratch.reference.resize(frames);
+    PcmDeinterleave2(scratch.buffer.data(), frames, scratch.mic.data(), scratch.reference.data());
+    const int16_t* mic = scratch.mic.data();
+    const int16_t* reference = scratch.reference.data();
+    if (capture.resample) {
+        scratch.resampled_mic.resize(capture.mic_resampler.GetOutputSamples(frames));
+        scratch.resampled_reference.resize(capture.reference_resampler.GetOutputSamples(frames));
+        capture.mic_resampler.Process(mic, frames, scratch.resampled_mic.data());
+        capture.reference_resampler.Process(reference, frames, scratch.resampled_reference.data());
+        frames = scratch.resampled_mic.size();
+        mic = scratch.resampled_mic.data();
+        reference = scratch.resampled_reference.data();
+    }
+    data.resize(frames * 2);
+    PcmInterleave2(mic, reference, frames, data.data());
+    PcmExtractFirstChannel2(data.data(), frames, data.data());
+    data.resize(frames);
+}
+
+struct Result {
+    double cycles_per_frame;
+    uint64_t checksum = 0;
+};
+
+template <typename F>
+Result Run(long frames, F&& capture_frame) {
+    std::vector<uint64_t> cycles(frames);
+    Result result;
+    for (long i = 0; i < frames; i++) {
+        uint64_t start = CycleCount();
+        const auto& data = capture_frame(i);
+        cycles[i] = CycleCount() - start;
+        result.checksum = result.checksum * 31 + data[i % data.size()];
+    }
+    /* The median keeps the preemptions and page faults of the host out of the number */
+    std::nth_element(cycles.begin(), cycles.begin() + frames / 2, cycles.end());
+    result.cycles_per_frame = cycles[frames / 2];
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long frames = BenchmarkOption(argc, argv, "frames", 2000);
+    bool ok = true;
+    for (long input_rate : {16000L, BenchmarkOption(argc, argv, "input_rate", 48000)}) {
+        /* A few different frames so nothing is hoisted out of the loop */
+        std::vector<std::vector<int16_t>> inputs;
+        for (int i = 0; i < 4; i++) {
+            inputs.push_back(GenerateSine(input_rate, 300 + 100 * i, 8000, 2 * input_rate * FRAME_MS / 1000));
+        }
+
+        Capture old_capture(input_rate);
+        std::vector<int16_t> old_data;
+        auto allocating = Run(frames, [&](long i) -> const std::vector<int16_t>& {
+            CaptureAllocating(old_capture, inputs[i % inputs.size()], old_data);
+            return old_data;
+        });
+
+        Capture new_capture(input_rate);
+        Scratch scratch;
+        std::vector<int16_t> new_data;
+        auto preallocated = Run(frames, [&](long i) -> const std::vector<int16_t>& {
+            CapturePreallocated(new_capture, scratch, inputs[i % inputs.size()], new_data);
+            return new_data;
+        });
+
+        /* The kernels alone, on the same stereo frame without the resampler */
+        const auto& input = inputs[0];
+        size_t stereo_frames = input.size() / 2;
+        std::vector<int16_t> left(stereo_frames), right(stereo_frames), interleaved(input.size());
+        auto scalar = Run(frames, [&](long i) -> const std::vector<int16_t>& {
+            for (size_t k = 0, j = 0; k < stereo_frames; ++k, j += 2) {
+                left[k] = input[j];
+                right[k] = input[j + 1];
+            }
+            for (size_t k = 0, j = 0; k < stereo_frames; ++k, j += 2) {
+                interleaved[j] = left[k];
+                interleaved[j + 1] = right[k];
+            }
+            return interleaved;
+        });
+        auto kernels = Run(frames, [&](long i) -> const std::vector<int16_t>& {
+            PcmDeinterleave2(input.data(), stereo_frames, left.data(), right.data());
+            PcmInterleave2(left.data(), right.data(), stereo_frames, interleaved.data());
+            return interleaved;
+        });
+
+        std::printf("input=%ldHz stereo %dms frames=%ld (cycles per frame, median)\n", input_rate, FRAME_MS, frames);
+        std::printf("  frame    allocating=%.0f preallocated=%.0f (%.2fx)\n", allocating.cycles_per_frame,
+            preallocated.cycles_per_frame, allocating.cycles_per_frame / preallocated.cycles_per_frame);
+        std::printf("  kernels  scalar=%.0f pcm_kernels=%.0f (%.2fx)\n", scalar.cycles_per_frame,
+            kernels.cycles_per_frame, scalar.cycles_per_frame / kernels.cycles_per_frame);
+        ok = ok && old_data == new_data && allocating.checksum == preallocated.checksum && interleaved == input;
+    }
+    if (!ok) {
+        std::printf("FAILED: the preallocated path does not match the allocating one\n");
+        return 1;
+    }
+    return 0;
+}
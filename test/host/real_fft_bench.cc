@@ -0,0 +1,122 @@
+/*
+ * RealFft against the complex radix-2 FFT LcdDisplay::compute() used for the spectrum analyzer,
+ * on the same windowed power spectrum: cycles per transform for the display size and a few others.
+ *
+ * Usage: real_fft_bench [--runs=N]
+ */
+#include <cmath>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "real_fft.h"
+#include "test_util.h"
+
+namespace {
+
+// The previous LcdDisplay::compute()
+void ComplexFft(float* real, float* imag, int n, bool forward) {
+    int j = 0;
+    for (int i = 0; i < n; i++) {
+        if (j > i) {
+            std::swap(real[i], real[j]);
+            std::swap(imag[i], imag[j]);
+        }
+        int m = n >> 1;
+        while (m >= 1 && j >= m) {
+            j -= m;
+            m >>= 1;
+        }
+        j += m;
+    }
+    for (int s = 1; s <= (int)log2(n); s++) {
+        int m = 1 << s;
+        int m2 = m >> 1;
+        float w_real = 1.0f;
+        float w_imag = 0.0f;
+        float angle = (forward ? -2.0f : 2.0f) * M_PI / m;
+        float wm_real = cosf(angle);
+        float wm_imag = sinf(angle);
+        for (int j = 0; j < m2; j++) {
+            for (int k = j; k < n; k += m) {
+                int k2 = k + m2;
+                float t_real = w_real * real[k2] - w_imag * imag[k2];
+                float t_imag = w_real * imag[k2] + w_imag * real[k2];
+                real[k2] = real[k] - t_real;
+                imag[k2] = imag[k] - t_imag;
+                real[k] += t_real;
+                imag[k] += t_imag;
+            }
+            float w_temp = w_real;
+            w_real = w_real * wm_real - w_imag * wm_imag;
+            w_imag = w_temp * wm_imag + w_imag * wm_real;
+        }
+    }
+    if (forward) {
+        for (int i = 0; i < n; i++) {
+            real[i] /= n;
+            imag[i] /= n;
+        }
+    }
+}
+
+template <typename F>
+double MedianCycles(long runs, F&& run) {
+    std::vector<int64_t> cycles(runs);
+    for (long i = 0; i < runs; i++) {
+        uint64_t start = CycleCount();
+        run();
+        cycles[i] = CycleCount() - start;
+    }
+    return Percentile(cycles, 0.5);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long runs = BenchmarkOption(argc, argv, "runs", 2000);
+    bool ok = true;
+    std::printf("windowed power spectrum (cycles per block, median of %ld)\n", runs);
+    for (int size : {256, 512, 1024, 2048}) {
+        auto samples = GenerateSine(16000, 1000, 12000, size);
+        std::vector<float> window(size);
+        for (int i = 0; i < size; i++) {
+            window[i] = 0.5 * (1.0 - cos(2.0 * M_PI * i / (size - 1)));
+        }
+
+        std::vector<float> real(size), imag(size), old_power(size / 2);
+        double complex_cycles = MedianCycles(runs, [&]() {
+            for (int i = 0; i < size; i++) {
+                real[i] = samples[i] / 32768.0f * window[i];
+                imag[i] = 0.0f;
+            }
+            ComplexFft(real.data(), imag.data(), size, true);
+            for (int i = 0; i < size / 2; i++) {
+                old_power[i] = real[i] * real[i] + imag[i] * imag[i];
+            }
+        });
+
+        RealFft fft;
+        fft.Configure(size);
+        std::vector<float> new_power(size / 2);
+        double real_cycles = MedianCycles(runs, [&]() {
+            std::fill(new_power.begin(), new_power.end(), 0.0f);
+            fft.AddPowerSpectrum(samples.data(), new_power.data());
+        });
+
+        /* Both give the same display: compare the bins within the 60 dB range of the bars */
+        float peak = *std::max_element(old_power.begin(), old_power.end());
+        for (int k = 1; k < size / 2; k++) {
+            if (old_power[k] > peak * 1e-6f) {
+                ok = ok && std::fabs(10 * std::log10(new_power[k] / old_power[k])) < 0.01;
+            }
+        }
+        std::printf("  %4d points  complex FFT %.0f  RealFft %.0f  (%.2fx)\n", size, complex_cycles, real_cycles,
+            complex_cycles / real_cycles);
+    }
+    if (!ok) {
+        std::printf("FAILED: RealFft and the complex FFT disagree\n");
+        return 1;
+    }
+    return 0;
+}
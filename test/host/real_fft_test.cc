@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+#include "real_fft.h"
+#include "test_util.h"
+
+namespace {
+
+// Straight O(N^2) DFT in double precision
+std::vector<std::complex<double>> ReferenceDft(const std::vector<double>& x) {
+    size_t n = x.size();
+    std::vector<std::complex<double>> spectrum(n);
+    for (size_t k = 0; k < n; k++) {
+        std::complex<double> sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            double angle = -2.0 * M_PI * double((k * i) % n) / n;
+            sum += x[i] * std::complex<double>(std::cos(angle), std::sin(angle));
+        }
+        spectrum[k] = sum;
+    }
+    return spectrum;
+}
+
+TEST(RealFftTest, RejectsUnsupportedSizes) {
+    RealFft fft;
+    EXPECT_FALSE(fft.Configure(4));
+    EXPECT_FALSE(fft.Configure(100));
+    EXPECT_FALSE(fft.Configure(8192));
+    EXPECT_TRUE(fft.Configure(8));
+    EXPECT_EQ(fft.bins(), 4);
+}
+
+TEST(RealFftTest, MatchesAReferenceDft) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    for (int size = 8; size <= 4096; size *= 2) {
+        RealFft fft;
+        ASSERT_TRUE(fft.Configure(size));
+        std::vector<float> in(size);
+        std::vector<double> x(size);
+        for (int i = 0; i < size; i++) {
+            in[i] = uniform(random);
+            x[i] = in[i];
+        }
+        std::vector<float> out(size);
+        fft.Forward(in.data(), out.data());
+        auto reference = ReferenceDft(x);
+
+        /* Error relative to the RMS of the spectrum, float rounding grows with log2(size) */
+        double error = 0;
+        double energy = 0;
+        auto accumulate = [&](double value, double expected) {
+            error = std::max(error, std::abs(value - expected));
+            energy += expected * expected;
+        };
+        accumulate(out[0], reference[0].real());
+        accumulate(out[1], reference[size / 2].real());
+        for (int k = 1; k < size / 2; k++) {
+            accumulate(out[2 * k], reference[k].real());
+            accumulate(out[2 * k + 1], reference[k].imag());
+        }
+        double rms = std::sqrt(energy / size);
+        EXPECT_LT(error / rms, 2e-5) << "size " << size;
+    }
+}
+
+TEST(RealFftTest, PowerSpectrumHasTheDisplayScale) {
+    const int size = 512;
+    RealFft fft;
+    ASSERT_TRUE(fft.Configure(size));
+
+    /* A full scale sine centered on bin 32 gives about 1/16 there and almost nothing far away */
+    auto tone = GenerateSine(size, 32, 32767, size);
+    std::vector<float> power(fft.bins(), 0.0f);
+    fft.AddPowerSpectrum(tone.data(), power.data());
+    EXPECT_NEAR(power[32], 1.0 / 16, 0.005);
+    EXPECT_LT(power[100] / power[32], 1e-6);
+
+    /* The same as the Hann window and the 1/N scaling of the previous display code, in double */
+    std::vector<double> windowed(size);
+    for (int i = 0; i < size; i++) {
+        windowed[i] = tone[i] / 32768.0 * 0.5 * (1.0 - std::cos(2.0 * M_PI * i / (size - 1))) / size;
+    }
+    auto reference = ReferenceDft(windowed);
+    for (int k = 1; k < size / 2; k++) {
+        EXPECT_NEAR(power[k], std::norm(reference[k]), 1e-6) << "bin " << k;
+    }
+
+    /* Calls add up, for averaging several blocks */
+    fft.AddPowerSpectrum(tone.data(), power.data());
+    EXPECT_NEAR(power[32], 2 * std::norm(reference[32]), 1e-5);
+}
+
+} // namespace
@@ -0,0 +1,168 @@
+/*
+ * PcmResampler against the linear interpolation Application::AddAudioData used for music frames:
+ * cycles per output sample and THD+N of a 997 Hz tone, for the rate pairs of the playback path.
+ *
+ * The old code only upsampled by the integer part of the ratio, so 44.1 -> 48 kHz went through
+ * unconverted, and it switched the I2S rate instead of downsampling; those rows have no numbers.
+ *
+ * Usage: resampler_bench [--seconds=N] [--block=N]
+ */
+#include <cstdio>
+#include <vector>
+
+#include "pcm_resampler.h"
+#include "test_util.h"
+
+#define TONE_HZ 997.0
+
+namespace {
+
+// The previous upsampling loop of Application::AddAudioData, integer ratios only
+void ResampleLinear(const std::vector<int16_t>& pcm_data, float upsample_ratio, std::vector<int16_t>& resampled) {
+    resampled.clear();
+    resampled.reserve(static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f));
+    for (size_t i = 0; i < pcm_data.size(); ++i) {
+        resampled.push_back(pcm_data[i]);
+        int interpolation_count = static_cast<int>(upsample_ratio) - 1;
+        if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
+            int16_t current = pcm_data[i];
+            int16_t next = pcm_data[i + 1];
+            for (int j = 1; j <= interpolation_count; ++j) {
+                float t = static_cast<float>(j) / (interpolation_count + 1);
+                resampled.push_back(static_cast<int16_t>(current + (next - current) * t));
+            }
+        } else if (interpolation_count > 0) {
+            for (int j = 1; j <= interpolation_count; ++j) {
+                resampled.push_back(pcm_data[i]);
+            }
+        }
+    }
+}
+
+/*
+ * THD+N in dB: the tone is fitted by least squares (sine, cosine and DC), everything else
+ * in pcm[begin, end) counts as distortion and noise.
+ */
+double ThdN(const std::vector<int16_t>& pcm, size_t begin, size_t end, int sample_rate, double frequency) {
+    double m[3][4] = {};
+    for (size_t i = begin; i < end; i++) {
+        double w = 2 * M_PI * frequency * i / sample_rate;
+        double basis[3] = {std::sin(w), std::cos(w), 1.0};
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 3; c++) {
+                m[r][c] += basis[r] * basis[c];
+            }
+            m[r][3] += basis[r] * pcm[i];
+        }
+    }
+    for (int p = 0; p < 3; p++) {
+        for (int r = p + 1; r < 3; r++) {
+            double f = m[r][p] / m[p][p];
+            for (int c = p; c < 4; c++) {
+                m[r][c] -= f * m[p][c];
+            }
+        }
+    }
+    double x[3];
+    for (int r = 2; r >= 0; r--) {
+        x[r] = m[r][3];
+        for (int c = r + 1; c < 3; c++) {
+            x[r] -= m[r][c] * x[c];
+        }
+        x[r] /= m[r][r];
+    }
+    double residual = 0;
+    for (size_t i = begin; i < end; i++) {
+        double w = 2 * M_PI * frequency * i / sample_rate;
+        double error = pcm[i] - (x[0] * std::sin(w) + x[1] * std::cos(w) + x[2]);
+        residual += error * error;
+    }
+    double tone = (x[0] * x[0] + x[1] * x[1]) / 2 * (end - begin);
+    return 10 * std::log10(residual / tone);
+}
+
+struct Result {
+    double cycles_per_sample = 0;
+    double thdn_db = 0;
+    size_t samples = 0;
+};
+
+template <typename F>
+Result Measure(const std::vector<std::vector<int16_t>>& blocks, int output_rate, F&& process) {
+    /* Best of a few passes, to keep the host scheduler out of the number */
+    Result result;
+    std::vector<int16_t> output;
+    for (int pass = 0; pass < 3; pass++) {
+        output.clear();
+        uint64_t cycles = 0;
+        for (auto& block : blocks) {
+            uint64_t start = CycleCount();
+            process(block, output);
+            cycles += CycleCount() - start;
+        }
+        double per_sample = double(cycles) / output.size();
+        if (pass == 0 || per_sample < result.cycles_per_sample) {
+            result.cycles_per_sample = per_sample;
+        }
+    }
+    /* Skip the filter delay and the first block, measure over the middle of the output */
+    result.samples = output.size();
+    result.thdn_db = ThdN(output, output.size() / 4, output.size() * 3 / 4, output_rate, TONE_HZ);
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long seconds = BenchmarkOption(argc, argv, "seconds", 2);
+    long block = BenchmarkOption(argc, argv, "block", 1152);
+    const int pairs[][2] = {{16000, 48000}, {24000, 48000}, {22050, 44100}, {44100, 48000}, {48000, 24000}, {48000, 16000}};
+    bool ok = true;
+
+    std::printf("%-15s %-26s %s\n", "rate", "linear cycles/sample THD+N", "polyphase cycles/sample THD+N");
+    for (auto& pair : pairs) {
+        int input_rate = pair[0];
+        int output_rate = pair[1];
+        auto tone = GenerateSine(input_rate, TONE_HZ, 16000, seconds * input_rate);
+        std::vector<std::vector<int16_t>> blocks;
+        for (size_t i = 0; i + block <= tone.size(); i += block) {
+            blocks.emplace_back(tone.begin() + i, tone.begin() + i + block);
+        }
+
+        PcmResampler resampler;
+        std::vector<int16_t> scratch;
+        auto polyphase = Measure(blocks, output_rate, [&](const std::vector<int16_t>& in, std::vector<int16_t>& out) {
+            if (out.empty()) {
+                resampler.Configure(input_rate, output_rate);
+            }
+            scratch.resize(resampler.GetOutputSamples(in.size()));
+            size_t written = resampler.Process(in.data(), in.size(), scratch.data());
+            out.insert(out.end(), scratch.begin(), scratch.begin() + written);
+        });
+
+        char linear_text[32] = "-";
+        if (output_rate > input_rate && output_rate % input_rate == 0) {
+            float ratio = output_rate / static_cast<float>(input_rate);
+            std::vector<int16_t> resampled;
+            auto linear = Measure(blocks, output_rate, [&](const std::vector<int16_t>& in, std::vector<int16_t>& out) {
+                ResampleLinear(in, ratio, resampled);
+                out.insert(out.end(), resampled.begin(), resampled.end());
+            });
+            std::snprintf(linear_text, sizeof(linear_text), "%.1f %.1fdB", linear.cycles_per_sample, linear.thdn_db);
+        }
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%d->%d", input_rate, output_rate);
+        std::printf("%-15s %-26s %.1f %.1fdB\n", name, linear_text, polyphase.cycles_per_sample, polyphase.thdn_db);
+
+        /* The output count must follow the ratio and the tone must come out clean */
+        size_t expected = (size_t)blocks.size() * block * output_rate / input_rate;
+        ok = ok && polyphase.samples + output_rate / 1000 >= expected && polyphase.samples <= expected + 1;
+        ok = ok && polyphase.thdn_db < -70;
+    }
+    if (!ok) {
+        std::printf("FAILED: PcmResampler output length or THD+N out of bounds\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "resumable_download.h"
+#include "local_http_server.h"
+
+namespace {
+
+#define SONG_URL "http://music.local/song.mp3"
+#define MAX_RETRIES 3
+
+class ResumableDownloadTest : public ::testing::Test {
+protected:
+    LocalHttpServer server_;
+    std::string song_;
+    std::string received_;
+    std::vector<size_t> response_offsets_;
+    bool running_ = true;
+    size_t stop_after_ = SIZE_MAX;
+
+    void SetUp() override {
+        for (size_t i = 0; i < 50000; i++) {
+            song_.push_back(char(i * 7 + i / 251));
+        }
+        server_.AddFile(SONG_URL, song_, "audio/mpeg");
+    }
+
+    bool Run(size_t offset, size_t end) {
+        return download_.Run(SONG_URL, offset, end);
+    }
+
+    ResumableDownload download_{MAX_RETRIES, 1, Callbacks()};
+
+private:
+    uint8_t region_[1500];
+
+    ResumableDownloadCallbacks Callbacks() {
+        ResumableDownloadCallbacks callbacks;
+        callbacks.create_http = [this]() { return server_.CreateHttp(); };
+        callbacks.is_running = [this]() { return running_; };
+        callbacks.on_response = [this](int status_code, size_t offset, size_t body_end, const std::string& content_type) {
+            EXPECT_EQ(content_type, "audio/mpeg");
+            response_offsets_.push_back(offset);
+        };
+        callbacks.wait_write_region = [this](size_t& size) {
+            size = sizeof(region_);
+            return region_;
+        };
+        callbacks.commit_write = [this](const uint8_t* data, size_t size) {
+            received_.append((const char*)data, size);
+            running_ = received_.size() < stop_after_;
+        };
+        return callbacks;
+    }
+};
+
+TEST_F(ResumableDownloadTest, DownloadsTheWholeFile) {
+    ASSERT_TRUE(Run(0, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(server_.ranges(), std::vector<std::string>({"bytes=0-"}));
+}
+
+TEST_F(ResumableDownloadTest, ResumesFromTheLastByteAfterAnEarlyClose) {
+    LocalHttpServer::Fault fault;
+    fault.close_after = 20000;
+    server_.QueueFault(fault, 2);
+    ASSERT_TRUE(Run(0, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(server_.ranges(), std::vector<std::string>({"bytes=0-", "bytes=20000-", "bytes=40000-"}));
+    EXPECT_EQ(response_offsets_, std::vector<size_t>({0, 20000, 40000}));
+}
+
+TEST_F(ResumableDownloadTest, RetriesReadErrorsRefusedConnectionsAndServerErrors) {
+    LocalHttpServer::Fault read_error;
+    read_error.close_after = 12345;
+    read_error.read_error = true;
+    LocalHttpServer::Fault refused;
+    refused.refuse = true;
+    LocalHttpServer::Fault unavailable;
+    unavailable.status = 503;
+    server_.QueueFault(read_error);
+    server_.QueueFault(refused);
+    server_.QueueFault(unavailable);
+    ASSERT_TRUE(Run(0, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(server_.ranges(), std::vector<std::string>({"bytes=0-", "bytes=12345-", "bytes=12345-", "bytes=12345-"}));
+}
+
+TEST_F(ResumableDownloadTest, DropsTheBytesAlreadyWrittenWhenRangeIsIgnored) {
+    server_.SetRangeSupport(false);
+    LocalHttpServer::Fault fault;
+    fault.close_after = 30000;
+    server_.QueueFault(fault);
+    ASSERT_TRUE(Run(0, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(download_.requests(), 2u);
+}
+
+TEST_F(ResumableDownloadTest, ReadsAPartOfTheFile) {
+    /* The prefetch of the next song, and its remainder once the current one finished */
+    ASSERT_TRUE(Run(0, 16384));
+    ASSERT_TRUE(Run(16384, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(server_.ranges(), std::vector<std::string>({"bytes=0-16383", "bytes=16384-"}));
+}
+
+TEST_F(ResumableDownloadTest, NothingLeftPastTheEnd) {
+    EXPECT_TRUE(Run(song_.size(), 0));
+    EXPECT_TRUE(received_.empty());
+}
+
+TEST_F(ResumableDownloadTest, GivesUpAfterTheRetries) {
+    LocalHttpServer::Fault refused;
+    refused.refuse = true;
+    server_.QueueFault(refused, MAX_RETRIES + 1);
+    EXPECT_FALSE(Run(0, 0));
+    EXPECT_EQ(download_.requests(), MAX_RETRIES + 1u);
+}
+
+TEST_F(ResumableDownloadTest, DataResetsTheRetryCount) {
+    /* Every connection delivers some data before it drops, so the download never gives up */
+    LocalHttpServer::Fault fault;
+    fault.close_after = 5000;
+    server_.QueueFault(fault, 9);
+    ASSERT_TRUE(Run(0, 0));
+    EXPECT_EQ(received_, song_);
+    EXPECT_EQ(download_.requests(), 10u);
+}
+
+TEST_F(ResumableDownloadTest, ClientErrorsAreNotRetried) {
+    LocalHttpServer::Fault fault;
+    fault.status = 404;
+    server_.QueueFault(fault);
+    EXPECT_FALSE(Run(0, 0));
+    EXPECT_EQ(download_.requests(), 1u);
+}
+
+TEST_F(ResumableDownloadTest, StopsWhenNoLongerRunning) {
+    stop_after_ = 10000;
+    EXPECT_FALSE(Run(0, 0));
+    EXPECT_LT(received_.size(), song_.size());
+    EXPECT_EQ(download_.offset(), received_.size());
+}
+
+} // namespace
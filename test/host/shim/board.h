@@ -0,0 +1,7 @@
+#ifndef HOST_BOARD_H
+#define HOST_BOARD_H
+
+// The audio pipeline is given its codec, the host build has no board
+class AudioCodec;
+
+#endif // HOST_BOARD_H
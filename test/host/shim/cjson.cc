@@ -0,0 +1,391 @@
+#include "cJSON.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+
+cJSON* NewItem(int type) {
+    auto item = (cJSON*)std::calloc(1, sizeof(cJSON));
+    item->type = type;
+    return item;
+}
+
+char* Duplicate(const char* string) {
+    size_t length = std::strlen(string) + 1;
+    auto copy = (char*)std::malloc(length);
+    std::memcpy(copy, string, length);
+    return copy;
+}
+
+void Append(cJSON* parent, cJSON* item) {
+    if (parent->child == nullptr) {
+        parent->child = item;
+        item->prev = item;
+        return;
+    }
+    /* As in cJSON, the prev pointer of the first child points to the last one */
+    cJSON* last = parent->child->prev;
+    last->next = item;
+    item->prev = last;
+    parent->child->prev = item;
+}
+
+void PrintString(const char* string, std::string& out) {
+    out += '"';
+    for (const char* p = string; *p != '\0'; p++) {
+        unsigned char c = *p;
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    out += '"';
+}
+
+void Print(const cJSON* item, std::string& out) {
+    switch (item->type) {
+    case cJSON_False: out += "false"; break;
+    case cJSON_True: out += "true"; break;
+    case cJSON_NULL: out += "null"; break;
+    case cJSON_Number: {
+        char number[32];
+        double value = item->valuedouble;
+        if (value == std::floor(value) && std::fabs(value) < 1e15) {
+            std::snprintf(number, sizeof(number), "%.0f", value);
+        } else {
+            std::snprintf(number, sizeof(number), "%.17g", value);
+        }
+        out += number;
+        break;
+    }
+    case cJSON_String: PrintString(item->valuestring, out); break;
+    case cJSON_Array:
+    case cJSON_Object: {
+        bool object = item->type == cJSON_Object;
+        out += object ? '{' : '[';
+        for (const cJSON* child = item->child; child != nullptr; child = child->next) {
+            if (child != item->child) {
+                out += ',';
+            }
+            if (object) {
+                PrintString(child->string, out);
+                out += ':';
+            }
+            Print(child, out);
+        }
+        out += object ? '}' : ']';
+        break;
+    }
+    default: break;
+    }
+}
+
+struct Parser {
+    const char* p;
+
+    void SkipSpace() {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+        }
+    }
+
+    bool ParseString(std::string& out) {
+        if (*p != '"') {
+            return false;
+        }
+        p++;
+        while (*p != '"') {
+            if (*p == '\0') {
+                return false;
+            }
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            p++;
+            switch (*p) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                unsigned code = 0;
+                if (std::sscanf(p + 1, "%4x", &code) != 1) {
+                    return false;
+                }
+                p += 4;
+                /* Enough for the protocol messages, no surrogate pairs */
+                if (code < 0x80) {
+                    out += (char)code;
+                } else if (code < 0x800) {
+                    out += (char)(0xc0 | (code >> 6));
+                    out += (char)(0x80 | (code & 0x3f));
+                } else {
+                    out += (char)(0xe0 | (code >> 12));
+                    out += (char)(0x80 | ((code >> 6) & 0x3f));
+                    out += (char)(0x80 | (code & 0x3f));
+                }
+                break;
+            }
+            case '\0': return false;
+            default: out += *p; break;
+            }
+            p++;
+        }
+        p++;
+        return true;
+    }
+
+    cJSON* ParseValue() {
+        SkipSpace();
+        if (*p == '{' || *p == '[') {
+            bool object = *p == '{';
+            char end = object ? '}' : ']';
+            cJSON* item = NewItem(object ? cJSON_Object : cJSON_Array);
+            p++;
+            SkipSpace();
+            if (*p == end) {
+                p++;
+                return item;
+            }
+            while (true) {
+                std::string name;
+                if (object) {
+                    SkipSpace();
+                    if (!ParseString(name)) {
+                        cJSON_Delete(item);
+                        return nullptr;
+                    }
+                    SkipSpace();
+                    if (*p++ != ':') {
+                        cJSON_Delete(item);
+                        return nullptr;
+                    }
+                }
+                cJSON* child = ParseValue();
+                if (child == nullptr) {
+                    cJSON_Delete(item);
+                    return nullptr;
+                }
+                if (object) {
+                    child->string = Duplicate(name.c_str());
+                }
+                Append(item, child);
+                SkipSpace();
+                if (*p == ',') {
+                    p++;
+                    continue;
+                }
+                if (*p++ != end) {
+                    cJSON_Delete(item);
+                    return nullptr;
+                }
+                return item;
+            }
+        }
+        if (*p == '"') {
+            std::string value;
+            if (!ParseString(value)) {
+                return nullptr;
+            }
+            return cJSON_CreateString(value.c_str());
+        }
+        if (std::strncmp(p, "true", 4) == 0) {
+            p += 4;
+            return NewItem(cJSON_True);
+        }
+        if (std::strncmp(p, "false", 5) == 0) {
+            p += 5;
+            return NewItem(cJSON_False);
+        }
+        if (std::strncmp(p, "null", 4) == 0) {
+            p += 4;
+            return NewItem(cJSON_NULL);
+        }
+        char* end = nullptr;
+        double number = std::strtod(p, &end);
+        if (end == p) {
+            return nullptr;
+        }
+        p = end;
+        return cJSON_CreateNumber(number);
+    }
+};
+
+} // namespace
+
+cJSON* cJSON_Parse(const char* value) {
+    if (value == nullptr) {
+        return nullptr;
+    }
+    Parser parser{value};
+    cJSON* item = parser.ParseValue();
+    if (item == nullptr) {
+        return nullptr;
+    }
+    parser.SkipSpace();
+    if (*parser.p != '\0') {
+        cJSON_Delete(item);
+        return nullptr;
+    }
+    return item;
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    if (item == nullptr) {
+        return nullptr;
+    }
+    std::string out;
+    Print(item, out);
+    return Duplicate(out.c_str());
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item != nullptr) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        std::free(item->valuestring);
+        std::free(item->string);
+        std::free(item);
+        item = next;
+    }
+}
+
+void cJSON_free(void* object) {
+    std::free(object);
+}
+
+cJSON* cJSON_CreateObject(void) {
+    return NewItem(cJSON_Object);
+}
+
+cJSON* cJSON_CreateArray(void) {
+    return NewItem(cJSON_Array);
+}
+
+cJSON* cJSON_CreateNumber(double num) {
+    cJSON* item = NewItem(cJSON_Number);
+    item->valuedouble = num;
+    if (num >= 2147483647.0) {
+        item->valueint = 2147483647;
+    } else if (num <= -2147483648.0) {
+        item->valueint = -2147483647 - 1;
+    } else {
+        item->valueint = (int)num;
+    }
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    cJSON* item = NewItem(cJSON_String);
+    item->valuestring = Duplicate(string);
+    return item;
+}
+
+cJSON* cJSON_CreateBool(cJSON_bool boolean) {
+    return NewItem(boolean ? cJSON_True : cJSON_False);
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* string, cJSON* item) {
+    if (object == nullptr || string == nullptr || item == nullptr) {
+        return 0;
+    }
+    std::free(item->string);
+    item->string = Duplicate(string);
+    Append(object, item);
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == nullptr || item == nullptr) {
+        return 0;
+    }
+    Append(array, item);
+    return 1;
+}
+
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) {
+    cJSON* item = cJSON_CreateNumber(number);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) {
+    cJSON* item = cJSON_CreateString(string);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, cJSON_bool boolean) {
+    cJSON* item = cJSON_CreateBool(boolean);
+    cJSON_AddItemToObject(object, name, item);
+    return item;
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* string) {
+    if (object == nullptr || string == nullptr) {
+        return nullptr;
+    }
+    for (cJSON* child = object->child; child != nullptr; child = child->next) {
+        if (child->string != nullptr && std::strcmp(child->string, string) == 0) {
+            return child;
+        }
+    }
+    return nullptr;
+}
+
+int cJSON_GetArraySize(const cJSON* array) {
+    int size = 0;
+    for (cJSON* child = array != nullptr ? array->child : nullptr; child != nullptr; child = child->next) {
+        size++;
+    }
+    return size;
+}
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index) {
+    cJSON* child = array != nullptr ? array->child : nullptr;
+    while (child != nullptr && index-- > 0) {
+        child = child->next;
+    }
+    return child;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON* item) {
+    return item != nullptr && item->type == cJSON_Number;
+}
+
+cJSON_bool cJSON_IsString(const cJSON* item) {
+    return item != nullptr && item->type == cJSON_String;
+}
+
+cJSON_bool cJSON_IsBool(const cJSON* item) {
+    return item != nullptr && (item->type == cJSON_True || item->type == cJSON_False);
+}
+
+cJSON_bool cJSON_IsTrue(const cJSON* item) {
+    return item != nullptr && item->type == cJSON_True;
+}
+
+cJSON_bool cJSON_IsArray(const cJSON* item) {
+    return item != nullptr && item->type == cJSON_Array;
+}
+
+cJSON_bool cJSON_IsObject(const cJSON* item) {
+    return item != nullptr && item->type == cJSON_Object;
+}
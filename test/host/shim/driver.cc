@@ -0,0 +1,13 @@
+#include "driver/i2s_std.h"
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) {
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle) {
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t handle, const i2s_std_clk_config_t* clk_cfg) {
+    return ESP_ERR_INVALID_STATE;
+}
@@ -0,0 +1,14 @@
+#ifndef HOST_DRIVER_I2S_COMMON_H
+#define HOST_DRIVER_I2S_COMMON_H
+
+#include <cstdint>
+#include "esp_err.h"
+
+// The host codecs have no I2S channel, AudioCodec only sees null handles
+struct i2s_channel_obj_t;
+typedef i2s_channel_obj_t* i2s_chan_handle_t;
+
+esp_err_t i2s_channel_enable(i2s_chan_handle_t handle);
+esp_err_t i2s_channel_disable(i2s_chan_handle_t handle);
+
+#endif // HOST_DRIVER_I2S_COMMON_H
@@ -0,0 +1,208 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+std::atomic<int> log_level = ESP_LOG_WARN;
+std::mutex log_mutex;
+
+} // namespace
+
+const char* esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    default: return "UNKNOWN ERROR";
+    }
+}
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    if (level > log_level) {
+        return;
+    }
+    static const char letters[] = "NEWIDV";
+    std::lock_guard<std::mutex> lock(log_mutex);
+    std::fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(esp_timer_get_time() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    std::vfprintf(stderr, format, args);
+    va_end(args);
+    std::fputc('\n', stderr);
+}
+
+static std::atomic<int64_t> host_time_us{-1};
+
+static int64_t SteadyTimeUs() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void esp_timer_host_set_time(int64_t time_us) {
+    host_time_us = time_us;
+}
+
+int64_t esp_timer_get_time() {
+    int64_t time_us = host_time_us;
+    return time_us >= 0 ? time_us : SteadyTimeUs();
+}
+
+struct HostTimer {
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    bool active = false;
+    bool periodic = false;
+    bool deleted = false;
+    int64_t period_us = 0;
+    int64_t deadline_us = 0;
+
+    void Run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!deleted) {
+            if (!active) {
+                cv.wait(lock);
+                continue;
+            }
+            int64_t now = SteadyTimeUs();
+            if (now < deadline_us) {
+                cv.wait_for(lock, std::chrono::microseconds(deadline_us - now));
+                continue;
+            }
+            if (periodic) {
+                deadline_us += period_us;
+                if (args.skip_unhandled_events && deadline_us < now) {
+                    deadline_us = now + period_us;
+                }
+            } else {
+                active = false;
+            }
+            lock.unlock();
+            args.callback(args.arg);
+            lock.lock();
+        }
+    }
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    if (args == nullptr || args->callback == nullptr || out_handle == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto timer = new HostTimer();
+    timer->args = *args;
+    timer->thread = std::thread([timer]() { timer->Run(); });
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+static esp_err_t StartTimer(esp_timer_handle_t timer, uint64_t timeout_us, bool periodic) {
+    if (timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->periodic = periodic;
+    timer->period_us = timeout_us;
+    timer->deadline_us = SteadyTimeUs() + timeout_us;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return StartTimer(timer, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return StartTimer(timer, period_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (timer == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    {
+        std::lock_guard<std::mutex> lock(timer->mutex);
+        if (timer->active) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        timer->deleted = true;
+        timer->cv.notify_all();
+    }
+    /* Deleting from the own callback would join the running thread */
+    if (timer->thread.get_id() == std::this_thread::get_id()) {
+        timer->thread.detach();
+        return ESP_OK;
+    }
+    timer->thread.join();
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    return timer->active;
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return std::malloc(size);
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+    return std::calloc(n, size);
+}
+
+void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+    return std::realloc(ptr, size);
+}
+
+void* heap_caps_malloc_prefer(size_t size, size_t num, ...) {
+    return std::malloc(size);
+}
+
+void* heap_caps_calloc_prefer(size_t n, size_t size, size_t num, ...) {
+    return std::calloc(n, size);
+}
+
+void heap_caps_free(void* ptr) {
+    std::free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+    return 8 * 1024 * 1024;
+}
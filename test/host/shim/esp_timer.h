@@ -0,0 +1,40 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <cstdint>
+#include <sdkconfig.h>
+#include "esp_err.h"
+
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct HostTimer;
+typedef HostTimer* esp_timer_handle_t;
+
+// Microseconds on the steady clock
+int64_t esp_timer_get_time();
+// Host only: esp_timer_get_time() returns time_us from now on, a negative value goes back to the steady clock.
+// For single threaded trace replays, the timers and the FreeRTOS stand-ins keep the steady clock
+void esp_timer_host_set_time(int64_t time_us);
+
+// Every timer calls back from its own thread
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+#endif // HOST_ESP_TIMER_H
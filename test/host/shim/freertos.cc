@@ -0,0 +1,155 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct HostTask {
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications = 0;
+};
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+namespace {
+
+thread_local HostTask* current_task = nullptr;
+
+std::mutex tasks_mutex;
+std::condition_variable tasks_cv;
+int running_tasks = 0;
+
+/* Waits on cv until ready() or the ticks ran out, portMAX_DELAY waits forever */
+template <typename Predicate>
+bool WaitFor(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+} // namespace
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth,
+    void* arg, UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, created_task, tskNO_AFFINITY);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth,
+    void* arg, UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+    /* Tasks are never freed, a handle may still be notified after its task returned */
+    auto task = new HostTask();
+    task->name = name != nullptr ? name : "";
+    if (created_task != nullptr) {
+        *created_task = task;
+    }
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        running_tasks++;
+    }
+    std::thread([function, arg, task]() {
+        current_task = task;
+        function(arg);
+        /* A task function that returns without vTaskDelete(NULL) ends here too */
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        running_tasks--;
+        tasks_cv.notify_all();
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    /* The thread ends when the task function returns, which follows right after this call */
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    /* Threads not created through xTaskCreate() (e.g. main) get a task on first use */
+    if (current_task == nullptr) {
+        current_task = new HostTask();
+    }
+    return current_task;
+}
+
+TickType_t xTaskGetTickCount() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications++;
+    task->cv.notify_one();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait) {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    WaitFor(task->cv, lock, ticks_to_wait, [task]() { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+void HostWaitForTasks() {
+    std::unique_lock<std::mutex> lock(tasks_mutex);
+    tasks_cv.wait(lock, []() { return running_tasks == 0; });
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto ready = [group, bits, wait_for_all]() {
+        return wait_for_all ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool satisfied = WaitFor(group->cv, lock, ticks_to_wait, ready);
+    EventBits_t value = group->bits;
+    if (satisfied && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
@@ -0,0 +1,24 @@
+#ifndef HOST_HTTP_H
+#define HOST_HTTP_H
+
+#include <string>
+#include <cstddef>
+
+// Same interface as Http of esp-ml307, see local_http_server.h for the host implementation
+class Http {
+public:
+    virtual ~Http() = default;
+    virtual void SetTimeout(int timeout_ms) = 0;
+    virtual void SetHeader(const std::string& key, const std::string& value) = 0;
+    virtual void SetContent(std::string&& content) = 0;
+    virtual bool Open(const std::string& method, const std::string& url) = 0;
+    virtual void Close() = 0;
+    virtual int Read(char* buffer, size_t buffer_size) = 0;
+    virtual int Write(const char* buffer, size_t buffer_size) = 0;
+    virtual int GetStatusCode() = 0;
+    virtual std::string GetResponseHeader(const std::string& key) const = 0;
+    virtual size_t GetBodyLength() = 0;
+    virtual std::string ReadAll() = 0;
+};
+
+#endif // HOST_HTTP_H
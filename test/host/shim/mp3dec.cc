@@ -0,0 +1,27 @@
+extern "C" {
+#include "mp3dec.h"
+}
+
+// C linkage like the library, mp3_music_decoder.h includes the header in extern "C"
+extern "C" {
+
+
+HMP3Decoder MP3InitDecoder(void) {
+    return nullptr;
+}
+
+void MP3FreeDecoder(HMP3Decoder hMP3Decoder) {
+}
+
+int MP3FindSyncWord(unsigned char* buf, int nBytes) {
+    return -1;
+}
+
+int MP3Decode(HMP3Decoder hMP3Decoder, unsigned char** inbuf, int* bytesLeft, short* outbuf, int useSize) {
+    return -1;
+}
+
+void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo* mp3FrameInfo) {
+}
+
+} // extern "C"
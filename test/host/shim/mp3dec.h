@@ -0,0 +1,31 @@
+#ifndef HOST_MP3DEC_H
+#define HOST_MP3DEC_H
+
+/*
+ * Declarations of the Helix MP3 decoder (esp-libhelix-mp3). The decoder itself is not part of the
+ * host build: MP3InitDecoder() returns nullptr, so no MP3 decoder can be created.
+ */
+typedef void* HMP3Decoder;
+
+typedef struct {
+    int bitrate;
+    int nChans;
+    int samprate;
+    int bitsPerSample;
+    int outputSamps;
+    int layer;
+    int version;
+} MP3FrameInfo;
+
+#define MAX_NCHAN 2
+#define MAX_NGRAN 2
+#define MAX_NSAMP 576
+#define ERR_MP3_INDATA_UNDERFLOW -1
+
+HMP3Decoder MP3InitDecoder(void);
+void MP3FreeDecoder(HMP3Decoder hMP3Decoder);
+int MP3FindSyncWord(unsigned char* buf, int nBytes);
+int MP3Decode(HMP3Decoder hMP3Decoder, unsigned char** inbuf, int* bytesLeft, short* outbuf, int useSize);
+void MP3GetLastFrameInfo(HMP3Decoder hMP3Decoder, MP3FrameInfo* mp3FrameInfo);
+
+#endif // HOST_MP3DEC_H
@@ -0,0 +1,127 @@
+#include "nvs_flash.h"
+
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <variant>
+
+namespace {
+
+using Value = std::variant<int32_t, std::string>;
+
+std::mutex nvs_mutex;
+std::map<std::string, std::map<std::string, Value>> namespaces;
+std::map<nvs_handle_t, std::string> handles;
+nvs_handle_t next_handle = 1;
+
+std::map<std::string, Value>* Find(nvs_handle_t handle) {
+    auto it = handles.find(handle);
+    if (it == handles.end()) {
+        return nullptr;
+    }
+    return &namespaces[it->second];
+}
+
+} // namespace
+
+esp_err_t nvs_flash_init() {
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t open_mode, nvs_handle_t* out_handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    /* Like on the device, a namespace that was never written cannot be opened read only */
+    if (open_mode == NVS_READONLY && namespaces.find(name) == namespaces.end()) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    namespaces[name];
+    *out_handle = next_handle++;
+    handles[*out_handle] = name;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    handles.erase(handle);
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto it = values->find(key);
+    if (it == values->end() || !std::holds_alternative<std::string>(it->second)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    auto& value = std::get<std::string>(it->second);
+    if (out_value == nullptr) {
+        *length = value.size() + 1;
+        return ESP_OK;
+    }
+    if (*length < value.size() + 1) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    std::memcpy(out_value, value.c_str(), value.size() + 1);
+    *length = value.size() + 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    (*values)[key] = std::string(value);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char* key, int32_t* out_value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    auto it = values->find(key);
+    if (it == values->end() || !std::holds_alternative<int32_t>(it->second)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *out_value = std::get<int32_t>(it->second);
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char* key, int32_t value) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    (*values)[key] = value;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return values->erase(key) > 0 ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle) {
+    std::lock_guard<std::mutex> lock(nvs_mutex);
+    auto values = Find(handle);
+    if (values == nullptr) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    values->clear();
+    return ESP_OK;
+}
@@ -0,0 +1,192 @@
+#include "opus.h"
+#include "opus_encoder.h"
+#include "opus_decoder.h"
+#include "opus_resampler.h"
+
+#include <cstdarg>
+#include <cstdlib>
+
+struct OpusEncoder {
+    int sample_rate;
+    int channels;
+    bool dtx;
+};
+
+struct OpusDecoder {
+    int sample_rate;
+    int channels;
+};
+
+// Below this level a frame counts as silence for DTX
+#define HOST_OPUS_DTX_THRESHOLD 256
+
+OpusEncoder* opus_encoder_create(opus_int32 fs, int channels, int application, int* error) {
+    *error = OPUS_OK;
+    return new OpusEncoder{(int)fs, channels, false};
+}
+
+void opus_encoder_destroy(OpusEncoder* st) {
+    delete st;
+}
+
+int opus_encoder_ctl(OpusEncoder* st, int request, ...) {
+    if (request == OPUS_RESET_STATE) {
+        return OPUS_OK;
+    }
+    va_list args;
+    va_start(args, request);
+    opus_int32 value = va_arg(args, opus_int32);
+    va_end(args);
+    if (request == OPUS_SET_DTX_REQUEST) {
+        st->dtx = value != 0;
+    }
+    return OPUS_OK;
+}
+
+opus_int32 opus_encode(OpusEncoder* st, const opus_int16* pcm, int frame_size, unsigned char* data, opus_int32 max_data_bytes) {
+    int samples = frame_size * st->channels;
+    if (st->dtx) {
+        bool silent = true;
+        for (int i = 0; i < samples && silent; i++) {
+            silent = std::abs(pcm[i]) < HOST_OPUS_DTX_THRESHOLD;
+        }
+        if (silent && max_data_bytes >= 1) {
+            data[0] = 0;
+            return 1;
+        }
+    }
+    if (samples > max_data_bytes) {
+        return OPUS_BUFFER_TOO_SMALL;
+    }
+    for (int i = 0; i < samples; i++) {
+        data[i] = (unsigned char)(pcm[i] >> 8);
+    }
+    return samples;
+}
+
+OpusDecoder* opus_decoder_create(opus_int32 fs, int channels, int* error) {
+    *error = OPUS_OK;
+    return new OpusDecoder{(int)fs, channels};
+}
+
+void opus_decoder_destroy(OpusDecoder* st) {
+    delete st;
+}
+
+int opus_decoder_ctl(OpusDecoder* st, int request, ...) {
+    return OPUS_OK;
+}
+
+int opus_decode(OpusDecoder* st, const unsigned char* data, opus_int32 len, opus_int16* pcm, int frame_size, int decode_fec) {
+    if (data == nullptr || len <= 1) {
+        for (int i = 0; i < frame_size * st->channels; i++) {
+            pcm[i] = 0;
+        }
+        return frame_size;
+    }
+    if (len > frame_size * st->channels) {
+        return OPUS_BUFFER_TOO_SMALL;
+    }
+    for (int i = 0; i < len; i++) {
+        pcm[i] = (opus_int16)((int8_t)data[i] * 256);
+    }
+    return len / st->channels;
+}
+
+OpusEncoderWrapper::OpusEncoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    int error;
+    audio_enc_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    frame_size_ = sample_rate / 1000 * channels * duration_ms;
+}
+
+OpusEncoderWrapper::~OpusEncoderWrapper() {
+    opus_encoder_destroy(audio_enc_);
+}
+
+void OpusEncoderWrapper::SetDtx(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    opus_encoder_ctl(audio_enc_, OPUS_SET_DTX(enable ? 1 : 0));
+}
+
+void OpusEncoderWrapper::SetComplexity(int complexity) {
+}
+
+void OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::function<void(std::vector<uint8_t>&& opus)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_buffer_.insert(in_buffer_.end(), pcm.begin(), pcm.end());
+    while (in_buffer_.size() >= (size_t)frame_size_) {
+        std::vector<uint8_t> opus(frame_size_);
+        auto ret = opus_encode(audio_enc_, in_buffer_.data(), frame_size_, opus.data(), opus.size());
+        if (ret < 0) {
+            return;
+        }
+        opus.resize(ret);
+        in_buffer_.erase(in_buffer_.begin(), in_buffer_.begin() + frame_size_);
+        handler(std::move(opus));
+    }
+}
+
+bool OpusEncoderWrapper::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pcm.size() != (size_t)frame_size_) {
+        return false;
+    }
+    opus.resize(frame_size_);
+    auto ret = opus_encode(audio_enc_, pcm.data(), frame_size_, opus.data(), opus.size());
+    if (ret < 0) {
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
+
+void OpusEncoderWrapper::ResetState() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_buffer_.clear();
+}
+
+OpusDecoderWrapper::OpusDecoderWrapper(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+    int error;
+    audio_dec_ = opus_decoder_create(sample_rate, channels, &error);
+    frame_size_ = sample_rate / 1000 * channels * duration_ms;
+}
+
+OpusDecoderWrapper::~OpusDecoderWrapper() {
+    opus_decoder_destroy(audio_dec_);
+}
+
+bool OpusDecoderWrapper::Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pcm.resize(frame_size_);
+    auto ret = opus_decode(audio_dec_, opus.data(), opus.size(), pcm.data(), pcm.size(), 0);
+    if (ret < 0) {
+        return false;
+    }
+    pcm.resize(ret);
+    return true;
+}
+
+void OpusDecoderWrapper::ResetState() {
+}
+
+void OpusResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+}
+
+int OpusResampler::GetOutputSamples(int input_samples) const {
+    return (int64_t)input_samples * output_sample_rate_ / input_sample_rate_;
+}
+
+void OpusResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    int output_samples = GetOutputSamples(input_samples);
+    for (int i = 0; i < output_samples; i++) {
+        int64_t position = (int64_t)i * input_sample_rate_ * 256 / output_sample_rate_;
+        int index = position >> 8;
+        int fraction = position & 0xff;
+        int next = index + 1 < input_samples ? index + 1 : index;
+        output[i] = (int16_t)((input[index] * (256 - fraction) + input[next] * fraction) >> 8);
+    }
+}
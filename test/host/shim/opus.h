@@ -0,0 +1,54 @@
+#ifndef HOST_OPUS_H
+#define HOST_OPUS_H
+
+#include <cstdint>
+
+/*
+ * Stand-in for libopus in the host build. The "codec" keeps the top 8 bits of every sample,
+ * one byte per sample, so a 60 ms frame at 16 kHz fits in the 1000 byte packets asked by
+ * UplinkOpusEncoder. With DTX enabled a silent frame is sent as a single byte, and an empty
+ * or single byte packet decodes to a frame of silence like the PLC of the real decoder.
+ */
+typedef int16_t opus_int16;
+typedef int32_t opus_int32;
+
+struct OpusEncoder;
+struct OpusDecoder;
+
+#define OPUS_OK 0
+#define OPUS_BAD_ARG -1
+#define OPUS_BUFFER_TOO_SMALL -2
+#define OPUS_INVALID_PACKET -4
+#define OPUS_UNIMPLEMENTED -5
+
+#define OPUS_APPLICATION_VOIP 2048
+#define OPUS_APPLICATION_AUDIO 2049
+#define OPUS_SIGNAL_VOICE 3001
+#define OPUS_SIGNAL_MUSIC 3002
+
+#define OPUS_SET_COMPLEXITY_REQUEST 4010
+#define OPUS_SET_BITRATE_REQUEST 4002
+#define OPUS_SET_INBAND_FEC_REQUEST 4012
+#define OPUS_SET_PACKET_LOSS_PERC_REQUEST 4014
+#define OPUS_SET_DTX_REQUEST 4016
+#define OPUS_SET_SIGNAL_REQUEST 4024
+#define OPUS_RESET_STATE 4028
+
+#define OPUS_SET_COMPLEXITY(x) OPUS_SET_COMPLEXITY_REQUEST, (opus_int32)(x)
+#define OPUS_SET_BITRATE(x) OPUS_SET_BITRATE_REQUEST, (opus_int32)(x)
+#define OPUS_SET_INBAND_FEC(x) OPUS_SET_INBAND_FEC_REQUEST, (opus_int32)(x)
+#define OPUS_SET_PACKET_LOSS_PERC(x) OPUS_SET_PACKET_LOSS_PERC_REQUEST, (opus_int32)(x)
+#define OPUS_SET_DTX(x) OPUS_SET_DTX_REQUEST, (opus_int32)(x)
+#define OPUS_SET_SIGNAL(x) OPUS_SET_SIGNAL_REQUEST, (opus_int32)(x)
+
+OpusEncoder* opus_encoder_create(opus_int32 fs, int channels, int application, int* error);
+void opus_encoder_destroy(OpusEncoder* st);
+int opus_encoder_ctl(OpusEncoder* st, int request, ...);
+opus_int32 opus_encode(OpusEncoder* st, const opus_int16* pcm, int frame_size, unsigned char* data, opus_int32 max_data_bytes);
+
+OpusDecoder* opus_decoder_create(opus_int32 fs, int channels, int* error);
+void opus_decoder_destroy(OpusDecoder* st);
+int opus_decoder_ctl(OpusDecoder* st, int request, ...);
+int opus_decode(OpusDecoder* st, const unsigned char* data, opus_int32 len, opus_int16* pcm, int frame_size, int decode_fec);
+
+#endif // HOST_OPUS_H
@@ -0,0 +1,10 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+/*
+ * Configuration of the host build: no audio processor, no wake word and no audio debugger.
+ * Options not set here fall back to the defaults in the code.
+ */
+#define CONFIG_OPUS_FRAME_DURATION_MS 60
+
+#endif // HOST_SDKCONFIG_H
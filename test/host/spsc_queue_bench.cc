@@ -0,0 +1,201 @@
+/*
+ * Latency and wakeups of SpscQueue driven like the AudioService queues: the consumer task sleeps
+ * on its notification, the producer notifies it after each push and waits on an event bit while
+ * the ring is full. The deque + mutex + condition variable shared by the tasks, which it replaced,
+ * runs the same load.
+ *
+ * Usage: spsc_queue_bench [--items=N] [--interval_us=N]
+ */
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/event_groups.h>
+
+#include "spsc_queue.h"
+#include "test_util.h"
+
+#define QUEUE_CAPACITY 40
+#define EVENT_QUEUE_AVAILABLE (1 << 0)
+
+namespace {
+
+struct Result {
+    std::vector<int64_t> latencies;
+    uint32_t wakeups = 0;
+    uint32_t spurious_wakeups = 0;
+    uint32_t producer_waits = 0;
+    bool in_order = true;
+    int64_t elapsed_us = 0;
+};
+
+void Pace(int64_t start_us, long index, long interval_us) {
+    if (interval_us <= 0) {
+        return;
+    }
+    int64_t due = start_us + index * interval_us;
+    int64_t now = NowUs();
+    if (due > now) {
+        std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+    }
+}
+
+struct SpscContext {
+    SpscQueue<int64_t> queue{QUEUE_CAPACITY};
+    EventGroupHandle_t event_group = xEventGroupCreate();
+    long items;
+    Result result;
+};
+
+void SpscConsumer(void* arg) {
+    auto context = (SpscContext*)arg;
+    auto& result = context->result;
+    long received = 0;
+    int64_t last = -1;
+    bool woken = false;
+    while (received < context->items) {
+        int64_t stamp = 0;
+        bool made_room = false;
+        if (!context->queue.Pop(stamp, made_room)) {
+            if (woken) {
+                result.spurious_wakeups++;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            result.wakeups++;
+            woken = true;
+            continue;
+        }
+        woken = false;
+        if (made_room) {
+            xEventGroupSetBits(context->event_group, EVENT_QUEUE_AVAILABLE);
+        }
+        result.latencies.push_back(NowUs() - stamp);
+        result.in_order = result.in_order && stamp >= last;
+        last = stamp;
+        received++;
+    }
+    vTaskDelete(NULL);
+}
+
+Result RunSpsc(long items, long interval_us) {
+    SpscContext context;
+    context.items = items;
+    context.result.latencies.reserve(items);
+    TaskHandle_t consumer;
+    xTaskCreate(SpscConsumer, "consumer", 4096, &context, 2, &consumer);
+
+    int64_t start = NowUs();
+    for (long i = 0; i < items; i++) {
+        Pace(start, i, interval_us);
+        while (true) {
+            xEventGroupClearBits(context.event_group, EVENT_QUEUE_AVAILABLE);
+            if (context.queue.Push(NowUs())) {
+                break;
+            }
+            context.result.producer_waits++;
+            xEventGroupWaitBits(context.event_group, EVENT_QUEUE_AVAILABLE, pdFALSE, pdFALSE, portMAX_DELAY);
+        }
+        xTaskNotifyGive(consumer);
+    }
+    HostWaitForTasks();
+    context.result.elapsed_us = NowUs() - start;
+    vEventGroupDelete(context.event_group);
+    return context.result;
+}
+
+// The queue of the previous AudioService: one mutex and condition variable for every task
+Result RunMutex(long items, long interval_us) {
+    Result result;
+    result.latencies.reserve(items);
+    std::deque<int64_t> queue;
+    std::mutex mutex;
+    std::condition_variable cv;
+
+    /* Another task sleeping on the same condition variable, like the output task did */
+    bool done = false;
+    std::thread bystander([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!done) {
+            cv.wait(lock);
+            result.spurious_wakeups++;
+        }
+    });
+
+    int64_t start = NowUs();
+    std::thread consumer([&]() {
+        long received = 0;
+        int64_t last = -1;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (received < items) {
+            /* The old tasks shared the condition variable, any notify_all() woke all of them */
+            while (queue.empty()) {
+                cv.wait(lock);
+                result.wakeups++;
+                if (queue.empty()) {
+                    result.spurious_wakeups++;
+                }
+            }
+            int64_t stamp = queue.front();
+            queue.pop_front();
+            cv.notify_all();
+            result.latencies.push_back(NowUs() - stamp);
+            result.in_order = result.in_order && stamp >= last;
+            last = stamp;
+            received++;
+        }
+    });
+    for (long i = 0; i < items; i++) {
+        Pace(start, i, interval_us);
+        std::unique_lock<std::mutex> lock(mutex);
+        if (queue.size() >= QUEUE_CAPACITY) {
+            result.producer_waits++;
+        }
+        cv.wait(lock, [&]() { return queue.size() < QUEUE_CAPACITY; });
+        queue.push_back(NowUs());
+        cv.notify_all();
+    }
+    consumer.join();
+    result.elapsed_us = NowUs() - start;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cv.notify_all();
+    }
+    bystander.join();
+    return result;
+}
+
+void Print(const char* name, long items, const Result& result) {
+    std::printf("%-14s items=%ld p50=%lldus p99=%lldus max=%lldus wakeups=%u spurious=%u producer_waits=%u %.0f items/s\n",
+        name, items, (long long)Percentile(result.latencies, 0.5), (long long)Percentile(result.latencies, 0.99),
+        (long long)Percentile(result.latencies, 1.0), result.wakeups, result.spurious_wakeups, result.producer_waits,
+        items * 1e6 / std::max<int64_t>(1, result.elapsed_us));
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    long items = BenchmarkOption(argc, argv, "items", 20000);
+    long interval_us = BenchmarkOption(argc, argv, "interval_us", 200);
+    /* Bursts fill the ring and exercise the producer wait, paced items measure the wakeup latency */
+    bool ok = true;
+    for (long interval : {0L, interval_us}) {
+        std::printf("interval=%ldus\n", interval);
+        long count = interval > 0 ? std::min(items, 2000000L / interval) : items;
+        auto spsc = RunSpsc(count, interval);
+        Print("spsc+notify", count, spsc);
+        auto mutex = RunMutex(count, interval);
+        Print("deque+mutex", count, mutex);
+        ok = ok && spsc.in_order && (long)spsc.latencies.size() == count;
+    }
+    if (!ok) {
+        std::printf("FAILED: items lost or out of order\n");
+        return 1;
+    }
+    return 0;
+}
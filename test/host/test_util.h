@@ -0,0 +1,98 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Helpers shared by the host tests and benchmarks
+
+inline std::vector<int16_t> GenerateSine(int sample_rate, double frequency, double amplitude, size_t samples) {
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)std::lround(amplitude * std::sin(2 * M_PI * frequency * i / sample_rate));
+    }
+    return pcm;
+}
+
+// Power of one frequency in pcm[begin, end) (Goertzel), normalized so a full scale sine gives 0.5
+inline double TonePower(const std::vector<int16_t>& pcm, size_t begin, size_t end, int sample_rate, double frequency) {
+    double coefficient = 2 * std::cos(2 * M_PI * frequency / sample_rate);
+    double s1 = 0, s2 = 0;
+    for (size_t i = begin; i < end; i++) {
+        double s0 = pcm[i] / 32768.0 + coefficient * s1 - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    double n = end - begin;
+    return (s1 * s1 + s2 * s2 - coefficient * s1 * s2) * 2 / (n * n);
+}
+
+inline double MeanPower(const std::vector<int16_t>& pcm, size_t begin, size_t end) {
+    double sum = 0;
+    for (size_t i = begin; i < end; i++) {
+        double sample = pcm[i] / 32768.0;
+        sum += sample * sample;
+    }
+    return end > begin ? sum / (end - begin) : 0;
+}
+
+inline bool WaitUntil(std::function<bool()> condition, int timeout_ms) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+// Value at fraction (0-1) of the sorted values, 0 if there are none
+inline int64_t Percentile(std::vector<int64_t> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Integer option of a benchmark given as --name=value, default_value if it is not there
+inline long BenchmarkOption(int argc, char** argv, const char* name, long default_value) {
+    std::string prefix = std::string("--") + name + "=";
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], prefix.c_str(), prefix.size()) == 0) {
+            return std::strtol(argv[i] + prefix.size(), nullptr, 10);
+        }
+    }
+    return default_value;
+}
+
+inline int64_t NowUs() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+// Time stamp counter where there is one (reference cycles on x86), nanoseconds otherwise
+inline uint64_t CycleCount() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+#endif
+}
+
+#endif // TEST_UTIL_H
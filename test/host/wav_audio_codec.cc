@@ -0,0 +1,161 @@
+#include "wav_audio_codec.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#define TAG "WavAudioCodec"
+
+struct WavHeader {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    char data[4];
+    uint32_t data_size;
+} __attribute__((packed));
+
+WavAudioCodec::WavAudioCodec(int input_sample_rate, int output_sample_rate, bool real_time)
+    : real_time_(real_time) {
+    duplex_ = true;
+    input_reference_ = false;
+    input_channels_ = 1;
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+}
+
+WavAudioCodec::~WavAudioCodec() {
+}
+
+void WavAudioCodec::SetInput(std::vector<int16_t> samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    input_ = std::move(samples);
+    input_position_ = 0;
+}
+
+bool WavAudioCodec::LoadInput(const std::string& path) {
+    std::vector<int16_t> samples;
+    int sample_rate;
+    if (!ReadWavFile(path, samples, sample_rate)) {
+        return false;
+    }
+    if (sample_rate != input_sample_rate_) {
+        ESP_LOGE(TAG, "%s is %d Hz, the input runs at %d Hz", path.c_str(), sample_rate, input_sample_rate_);
+        return false;
+    }
+    SetInput(std::move(samples));
+    return true;
+}
+
+bool WavAudioCodec::SaveOutput(const std::string& path) {
+    return WriteWavFile(path, output(), output_sample_rate_);
+}
+
+void WavAudioCodec::ReserveOutput(size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_.reserve(samples);
+}
+
+std::vector<int16_t> WavAudioCodec::output() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_;
+}
+
+size_t WavAudioCodec::output_samples() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_.size();
+}
+
+size_t WavAudioCodec::input_position() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return input_position_;
+}
+
+void WavAudioCodec::Pace(int64_t& clock_us, int samples, int sample_rate) {
+    /* The clock restarts after an idle period, like an I2S channel that drained its DMA */
+    int64_t now = esp_timer_get_time();
+    clock_us = std::max(clock_us, now);
+    clock_us += (int64_t)samples * 1000000 / sample_rate;
+    int64_t ahead = clock_us - now - (int64_t)output_latency_samples() * 1000000 / sample_rate;
+    if (ahead > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(ahead));
+    }
+}
+
+int WavAudioCodec::Read(int16_t* dest, int samples) {
+    if (real_time_) {
+        /* A capture returns once its last sample was recorded */
+        int64_t now = esp_timer_get_time();
+        input_clock_us_ = std::max(input_clock_us_, now) + (int64_t)samples * 1000000 / input_sample_rate_;
+        std::this_thread::sleep_for(std::chrono::microseconds(input_clock_us_ - now));
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t available = input_.size() - std::min(input_.size(), input_position_);
+    size_t copied = std::min(available, (size_t)samples);
+    std::memcpy(dest, input_.data() + input_position_, copied * sizeof(int16_t));
+    std::fill(dest + copied, dest + samples, 0);
+    input_position_ += copied;
+    return samples;
+}
+
+int WavAudioCodec::Write(const int16_t* data, int samples) {
+    if (real_time_) {
+        Pace(output_clock_us_, samples, output_sample_rate_);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    output_.insert(output_.end(), data, data + samples);
+    return samples;
+}
+
+bool WavAudioCodec::ReadWavFile(const std::string& path, std::vector<int16_t>& samples, int& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    WavHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.riff, "RIFF", 4) != 0 ||
+        std::memcmp(header.wave, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "%s is not a WAV file", path.c_str());
+        return false;
+    }
+    if (header.format != 1 || header.channels != 1 || header.bits_per_sample != 16) {
+        ESP_LOGE(TAG, "%s is not 16-bit mono PCM", path.c_str());
+        return false;
+    }
+    samples.resize(header.data_size / sizeof(int16_t));
+    file.read((char*)samples.data(), samples.size() * sizeof(int16_t));
+    samples.resize(file.gcount() / sizeof(int16_t));
+    sample_rate = header.sample_rate;
+    return true;
+}
+
+bool WavAudioCodec::WriteWavFile(const std::string& path, const std::vector<int16_t>& samples, int sample_rate) {
+    WavHeader header;
+    uint32_t data_size = samples.size() * sizeof(int16_t);
+    std::memcpy(header.riff, "RIFF", 4);
+    header.riff_size = sizeof(header) - 8 + data_size;
+    std::memcpy(header.wave, "WAVE", 4);
+    std::memcpy(header.fmt, "fmt ", 4);
+    header.fmt_size = 16;
+    header.format = 1;
+    header.channels = 1;
+    header.sample_rate = sample_rate;
+    header.byte_rate = sample_rate * sizeof(int16_t);
+    header.block_align = sizeof(int16_t);
+    header.bits_per_sample = 16;
+    std::memcpy(header.data, "data", 4);
+    header.data_size = data_size;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)samples.data(), data_size);
+    return file.good();
+}
@@ -0,0 +1,52 @@
+#ifndef WAV_AUDIO_CODEC_H
+#define WAV_AUDIO_CODEC_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#include "audio_codec.h"
+
+/*
+ * Mono AudioCodec backed by sample buffers instead of I2S, for the host build.
+ *
+ * The microphone plays the input samples once and then silence. Everything written to the
+ * speaker is appended to the output, which can be saved as a WAV file. With real_time set,
+ * Read() and Write() block like the I2S DMA does, so the pipeline runs at the speed of the
+ * sample clock; otherwise they return right away and the pipeline runs as fast as it can.
+ */
+class WavAudioCodec : public AudioCodec {
+public:
+    WavAudioCodec(int input_sample_rate, int output_sample_rate, bool real_time);
+    virtual ~WavAudioCodec();
+
+    void SetInput(std::vector<int16_t> samples);
+    bool LoadInput(const std::string& path);
+    bool SaveOutput(const std::string& path);
+    // Keeps the recording from growing the heap while the pipeline runs
+    void ReserveOutput(size_t samples);
+
+    std::vector<int16_t> output();
+    size_t output_samples();
+    size_t input_position();
+
+    static bool ReadWavFile(const std::string& path, std::vector<int16_t>& samples, int& sample_rate);
+    static bool WriteWavFile(const std::string& path, const std::vector<int16_t>& samples, int sample_rate);
+
+private:
+    bool real_time_;
+    std::mutex mutex_;
+    std::vector<int16_t> input_;
+    size_t input_position_ = 0;
+    std::vector<int16_t> output_;
+    int64_t input_clock_us_ = 0;
+    int64_t output_clock_us_ = 0;
+
+    void Pace(int64_t& clock_us, int samples, int sample_rate);
+
+    virtual int Read(int16_t* dest, int samples) override;
+    virtual int Write(const int16_t* data, int samples) override;
+};
+
+#endif // WAV_AUDIO_CODEC_H